@@ -0,0 +1,29 @@
+#include <stdarg.h>
+#include "Arduino.h"
+
+HardwareSerial Serial;
+
+
+size_t HardwareSerial::print(const char* text) {
+  size_t length = strlen(text);
+  bytes += length;
+  if (!quiet) {
+    fputs(text, stdout);
+  }
+  return length;
+}
+
+
+size_t HardwareSerial::println(const char* text) {
+  return print(text) + print("\n");
+}
+
+
+size_t HardwareSerial::printf(const char* format, ...) {
+  char text[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  return print(text);
+}
@@ -0,0 +1,40 @@
+// Host stand-in for the parts of the Arduino core used by the modules in src/, for the native environment.
+// Time comes from the simulated clock (fake_clock.h) and Serial writes to stdout.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fake_clock.h"
+
+inline unsigned long millis() {
+  return (unsigned long)(fakeClockMicros() / 1000);
+}
+
+inline unsigned long micros() {
+  return (unsigned long)fakeClockMicros();
+}
+
+inline void delay(uint32_t ms) {
+  fakeClockAdvance((uint64_t)ms * 1000);
+}
+
+inline void delayMicroseconds(uint32_t us) {
+  fakeClockAdvance(us);
+}
+
+class HardwareSerial {
+public:
+  size_t print(const char* text);
+  size_t println(const char* text = "");
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+  bool quiet = false;     // Drops the output, e.g. for benchmarks that log on purpose.
+  uint32_t bytes = 0;     // Bytes printed, including dropped ones.
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,52 @@
+// Host stand-in for the File class of the ESP32 FS library, for the native environment.
+// Files live in memory in the fake SD card (SD.h), so their contents survive closing and reopening
+// like on the card, and "rebooting" a module only means initializing its state again.
+
+#pragma once
+
+#include <Arduino.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+class SDClass;
+
+// A file or folder of the fake card.
+typedef struct {
+  bool directory;
+  std::vector<uint8_t> data;
+} FakeSdEntry_t;
+
+class File {
+public:
+  File();
+
+  operator bool() const;
+  size_t write(uint8_t data);
+  size_t write(const uint8_t* data, size_t length);
+  size_t print(const char* text);
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+  int read();
+  size_t read(uint8_t* data, size_t length);
+  int available();
+  bool seek(uint32_t position);
+  size_t position() const;
+  size_t size() const;
+  void flush();
+  void close();
+  bool isDirectory() const;
+
+private:
+  friend class SDClass;
+
+  SDClass* card;
+  std::shared_ptr<FakeSdEntry_t> entry;
+  size_t offset;
+  bool writable;
+  bool append;
+  bool dirty;             // Written since the last flush.
+};
@@ -0,0 +1,305 @@
+#include <stdarg.h>
+#include "SD.h"
+
+SDClass SD;
+
+
+// Number of sectors touched by 'length' bytes at 'offset'.
+static uint32_t sectors(size_t offset, size_t length) {
+  if (length == 0) {
+    return 0;
+  }
+  return (offset + length - 1) / FAKE_SD_SECTOR_SIZE - offset / FAKE_SD_SECTOR_SIZE + 1;
+}
+
+
+SDClass::SDClass() : present(true), space(-1), lookup_us(1500), sector_read_us(250), sector_write_us(600) {
+  resetStats();
+}
+
+
+bool SDClass::begin(uint8_t cs) {
+  (void)cs;
+  return lookup("/");
+}
+
+
+void SDClass::end() {
+}
+
+
+bool SDClass::exists(const char* path) {
+  return lookup(path) && entries.count(path) > 0;
+}
+
+
+bool SDClass::mkdir(const char* path) {
+  if (!lookup(path) || !parentExists(path)) {
+    return false;
+  }
+  if (entries.count(path) == 0) {
+    entries[path] = std::make_shared<FakeSdEntry_t>();
+    entries[path]->directory = true;
+    access(0, 1);
+  }
+  return entries[path]->directory;
+}
+
+
+// Opens a file like the ESP32 library: "r" needs an existing file, "w" creates or truncates it
+// and "a" creates it or appends to it. The folder of the file has to exist.
+File SDClass::open(const char* path, const char* mode) {
+  File file;
+  if (!lookup(path)) {
+    return file;
+  }
+  auto found = entries.find(path);
+  if (mode[0] == 'r') {
+    if (found == entries.end()) {
+      stats.errors++;
+      return file;
+    }
+    file.entry = found->second;
+  }
+  else {
+    if (found == entries.end()) {
+      if (!parentExists(path)) {
+        stats.errors++;
+        return file;
+      }
+      entries[path] = std::make_shared<FakeSdEntry_t>();
+      entries[path]->directory = false;
+      found = entries.find(path);
+    }
+    if (found->second->directory) {
+      stats.errors++;
+      return file;
+    }
+    file.entry = found->second;
+    file.writable = true;
+    file.append = mode[0] == 'a';
+    if (mode[0] == 'w') {
+      file.entry->data.clear();
+    }
+  }
+
+  stats.opens++;
+  file.card = this;
+  file.offset = file.append ? file.entry->data.size() : 0;
+  return file;
+}
+
+
+bool SDClass::remove(const char* path) {
+  if (!lookup(path) || entries.count(path) == 0) {
+    return false;
+  }
+  entries.erase(path);
+  access(0, 1);
+  return true;
+}
+
+
+bool SDClass::rename(const char* from, const char* to) {
+  if (!lookup(from) || entries.count(from) == 0 || entries.count(to) > 0 || !parentExists(to)) {
+    return false;
+  }
+  entries[to] = entries[from];
+  entries.erase(from);
+  access(0, 1);
+  return true;
+}
+
+
+void SDClass::format() {
+  entries.clear();
+}
+
+
+void SDClass::resetStats() {
+  memset(&stats, 0, sizeof(stats));
+}
+
+
+std::vector<uint8_t>* SDClass::contents(const char* path) {
+  auto found = entries.find(path);
+  if (found == entries.end() || found->second->directory) {
+    return NULL;
+  }
+  return &found->second->data;
+}
+
+
+// Counts a path lookup. Returns false if the card is missing.
+bool SDClass::lookup(const char* path) {
+  (void)path;
+  if (!present) {
+    stats.errors++;
+    return false;
+  }
+  stats.lookups++;
+  stats.busy_us += lookup_us;
+  fakeClockAdvance(lookup_us);
+  return true;
+}
+
+
+bool SDClass::parentExists(const std::string& path) {
+  size_t slash = path.rfind('/');
+  if (slash == 0 || slash == std::string::npos) {
+    return true;
+  }
+  auto found = entries.find(path.substr(0, slash));
+  return found != entries.end() && found->second->directory;
+}
+
+
+void SDClass::access(uint32_t sector_reads, uint32_t sector_writes) {
+  uint64_t us = (uint64_t)sector_reads * sector_read_us + (uint64_t)sector_writes * sector_write_us;
+  stats.sector_reads += sector_reads;
+  stats.sector_writes += sector_writes;
+  stats.busy_us += us;
+  fakeClockAdvance(us);
+}
+
+
+File::File() : card(NULL), offset(0), writable(false), append(false), dirty(false) {
+}
+
+
+File::operator bool() const {
+  return entry != NULL;
+}
+
+
+size_t File::write(uint8_t data) {
+  return write(&data, 1);
+}
+
+
+// Writes at the current position, or at the end in append mode. A full card takes only part of the bytes.
+size_t File::write(const uint8_t* data, size_t length) {
+  if (!entry || !writable || !card->present) {
+    if (card != NULL) {
+      card->stats.errors++;
+    }
+    return 0;
+  }
+  if (append) {
+    offset = entry->data.size();
+  }
+  size_t written = length;
+  if (card->space >= 0 && (int64_t)written > card->space) {
+    written = card->space;
+    card->stats.errors++;
+  }
+  if (written == 0) {
+    return 0;
+  }
+
+  // A sector that is only partly written and already holds data has to be read first: the first one
+  // if the write starts inside it, the last one if the write ends inside existing data.
+  uint32_t reads = 0;
+  size_t end = offset + written;
+  if (offset % FAKE_SD_SECTOR_SIZE != 0) {
+    reads++;
+  }
+  if (end % FAKE_SD_SECTOR_SIZE != 0 && end < entry->data.size() &&
+      (offset % FAKE_SD_SECTOR_SIZE == 0 || sectors(offset, written) > 1)) {
+    reads++;
+  }
+
+  if (entry->data.size() < end) {
+    entry->data.resize(end);
+  }
+  memcpy(entry->data.data() + offset, data, written);
+  card->access(reads, sectors(offset, written));
+  card->stats.bytes_written += written;
+  if (card->space >= 0) {
+    card->space -= written;
+  }
+  offset = end;
+  dirty = true;
+  return written;
+}
+
+
+size_t File::print(const char* text) {
+  return write((const uint8_t*)text, strlen(text));
+}
+
+
+size_t File::printf(const char* format, ...) {
+  char text[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  return length > 0 ? write((const uint8_t*)text, length < (int)sizeof(text) ? length : sizeof(text) - 1) : 0;
+}
+
+
+int File::read() {
+  uint8_t data;
+  return read(&data, 1) == 1 ? data : -1;
+}
+
+
+size_t File::read(uint8_t* data, size_t length) {
+  if (!entry || !card->present || offset >= entry->data.size()) {
+    return 0;
+  }
+  if (length > entry->data.size() - offset) {
+    length = entry->data.size() - offset;
+  }
+  memcpy(data, entry->data.data() + offset, length);
+  card->access(sectors(offset, length), 0);
+  card->stats.bytes_read += length;
+  offset += length;
+  return length;
+}
+
+
+int File::available() {
+  return entry ? entry->data.size() - offset : 0;
+}
+
+
+bool File::seek(uint32_t position) {
+  if (!entry || position > entry->data.size()) {
+    return false;
+  }
+  offset = position;
+  return true;
+}
+
+
+size_t File::position() const {
+  return offset;
+}
+
+
+size_t File::size() const {
+  return entry ? entry->data.size() : 0;
+}
+
+
+// Updates the directory entry of a file written since the last flush.
+void File::flush() {
+  if (entry && dirty && card->present) {
+    card->access(0, 1);
+    dirty = false;
+  }
+}
+
+
+void File::close() {
+  flush();
+  entry.reset();
+  card = NULL;
+}
+
+
+bool File::isDirectory() const {
+  return entry && entry->directory;
+}
@@ -0,0 +1,63 @@
+// Host stand-in for the ESP32 SD library, for the native environment: an in-memory card.
+// Besides the bytes moved it counts what costs time on a real card and adds that time to the statistics
+// and to the simulated clock, so the hold time of the spi_mutex can be measured on a host:
+//   - every path lookup (exists, open, mkdir, remove, rename) walks the FAT directory: lookup_us,
+//   - every sector touched by a write is written: sector_write_us, plus a read of a partly written sector
+//     that already holds data (read-modify-write): sector_read_us,
+//   - every sector touched by a read: sector_read_us,
+//   - closing or flushing a modified file updates its directory entry: sector_write_us.
+// The card can be removed (present = false) and the space left can be limited to make writes fail.
+
+#pragma once
+
+#include <map>
+#include "FS.h"
+
+static const uint16_t FAKE_SD_SECTOR_SIZE = 512;
+
+typedef struct {
+  uint32_t lookups;
+  uint32_t opens;
+  uint32_t sector_reads;
+  uint32_t sector_writes;
+  uint32_t bytes_read;
+  uint32_t bytes_written;
+  uint32_t errors;          // Failed opens, lookups and writes.
+  uint64_t busy_us;
+} FakeSdStats_t;
+
+class SDClass {
+public:
+  SDClass();
+
+  bool begin(uint8_t cs = 5);
+  void end();
+  bool exists(const char* path);
+  bool mkdir(const char* path);
+  File open(const char* path, const char* mode = FILE_READ);
+  bool remove(const char* path);
+  bool rename(const char* from, const char* to);
+
+  // Simulation.
+  void format();                              // Deletes every file and folder.
+  void resetStats();
+  std::vector<uint8_t>* contents(const char* path);   // Contents of a file, NULL if there is none.
+
+  FakeSdStats_t stats;
+  bool present;                               // False makes every access fail, like a removed card.
+  int64_t space;                              // Bytes that can still be written, negative for unlimited.
+  uint32_t lookup_us;
+  uint32_t sector_read_us;
+  uint32_t sector_write_us;
+
+private:
+  friend class File;
+
+  bool lookup(const char* path);
+  bool parentExists(const std::string& path);
+  void access(uint32_t sector_reads, uint32_t sector_writes);
+
+  std::map<std::string, std::shared_ptr<FakeSdEntry_t>> entries;
+};
+
+extern SDClass SD;
@@ -0,0 +1,173 @@
+#include "Wire.h"
+
+TwoWire Wire(0);
+TwoWire Wire1(1);
+
+static const uint32_t DEFAULT_FREQUENCY = 100000;
+
+
+TwoWire::TwoWire(uint8_t bus_num) : bus_num(bus_num), frequency(DEFAULT_FREQUENCY), tx_address(0), tx_length(0),
+                                    rx_length(0), rx_position(0) {
+  for (uint8_t i = 0; i < FAKE_I2C_MAX_DEVICES; i++) {
+    devices[i] = NULL;
+  }
+  begins = 0;
+  resetStats();
+}
+
+
+bool TwoWire::begin() {
+  begins++;
+  return true;
+}
+
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency) {
+  (void)sda;
+  (void)scl;
+  if (frequency != 0) {
+    this->frequency = frequency;
+  }
+  return begin();
+}
+
+
+bool TwoWire::end() {
+  return true;
+}
+
+
+bool TwoWire::setClock(uint32_t frequency) {
+  this->frequency = frequency;
+  return true;
+}
+
+
+uint32_t TwoWire::getClock() {
+  return frequency;
+}
+
+
+void TwoWire::beginTransmission(uint16_t address) {
+  tx_address = address;
+  tx_length = 0;
+}
+
+
+size_t TwoWire::write(uint8_t data) {
+  if (tx_length == sizeof(tx_buffer)) {
+    return 0;
+  }
+  tx_buffer[tx_length++] = data;
+  return 1;
+}
+
+
+size_t TwoWire::write(const uint8_t* data, size_t length) {
+  size_t written = 0;
+  while (written < length && write(data[written]) == 1) {
+    written++;
+  }
+  return written;
+}
+
+
+// Returns 0 on success, 2 if the address was not acknowledged and 3 if the data was not, like the ESP32 core.
+uint8_t TwoWire::endTransmission(bool send_stop) {
+  (void)send_stop;
+  transfer(tx_length);
+  stats.bytes_written += tx_length;
+
+  FakeI2cDevice* device = find(tx_address);
+  if (device == NULL) {
+    stats.errors++;
+    return 2;
+  }
+  if (!device->receive(tx_buffer, tx_length)) {
+    stats.errors++;
+    return 3;
+  }
+  return 0;
+}
+
+
+// Returns the number of bytes received, 0 if the device did not answer.
+size_t TwoWire::requestFrom(uint16_t address, size_t length, bool send_stop) {
+  (void)send_stop;
+  if (length > sizeof(rx_buffer)) {
+    length = sizeof(rx_buffer);
+  }
+  rx_length = 0;
+  rx_position = 0;
+
+  FakeI2cDevice* device = find(address);
+  if (device == NULL || !device->transmit(rx_buffer, length)) {
+    transfer(0);
+    stats.errors++;
+    return 0;
+  }
+  transfer(length);
+  stats.bytes_read += length;
+  rx_length = length;
+  return length;
+}
+
+
+int TwoWire::available() {
+  return rx_length - rx_position;
+}
+
+
+int TwoWire::read() {
+  return rx_position < rx_length ? rx_buffer[rx_position++] : -1;
+}
+
+
+void TwoWire::attach(uint8_t address, FakeI2cDevice* device) {
+  detach(address);
+  for (uint8_t i = 0; i < FAKE_I2C_MAX_DEVICES; i++) {
+    if (devices[i] == NULL) {
+      addresses[i] = address;
+      devices[i] = device;
+      return;
+    }
+  }
+}
+
+
+void TwoWire::detach(uint8_t address) {
+  for (uint8_t i = 0; i < FAKE_I2C_MAX_DEVICES; i++) {
+    if (devices[i] != NULL && addresses[i] == address) {
+      devices[i] = NULL;
+    }
+  }
+}
+
+
+void TwoWire::resetStats() {
+  stats.transactions = 0;
+  stats.bytes_written = 0;
+  stats.bytes_read = 0;
+  stats.errors = 0;
+  stats.busy_us = 0;
+}
+
+
+FakeI2cDevice* TwoWire::find(uint16_t address) {
+  for (uint8_t i = 0; i < FAKE_I2C_MAX_DEVICES; i++) {
+    if (devices[i] != NULL && addresses[i] == address) {
+      return devices[i];
+    }
+  }
+  return NULL;
+}
+
+
+// Counts one transaction of 'length' data bytes and lets the simulated time pass that it takes on the bus.
+void TwoWire::transfer(size_t length) {
+  uint64_t clocks = 9 * (1 + length) + 2;
+  uint64_t us = (clocks * 1000000 + frequency - 1) / frequency;
+  stats.transactions++;
+  stats.busy_us += us;
+  fakeClockAdvance(us);
+}
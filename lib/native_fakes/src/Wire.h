@@ -0,0 +1,78 @@
+// Host stand-in for the Arduino TwoWire API, for the native environment.
+// Simulated devices (e.g. fake_bmp280.h, fake_ssd1306.h) are attached to a bus at their address.
+// A transaction to an address without a device, or one the device refuses, is NACKed like on the real bus.
+// Every transaction is counted with its bytes and errors, and the time it takes at the bus clock
+// (9 clocks per byte including the address byte, plus start and stop) is added to the statistics
+// and to the simulated clock, so the hold time of the bus mutex can be measured on a host.
+
+#pragma once
+
+#include <Arduino.h>
+
+// Size of the transmit and receive buffers, as in the ESP32 core. Longer writes are cut off.
+static const uint8_t FAKE_I2C_BUFFER_LENGTH = 128;
+static const uint8_t FAKE_I2C_MAX_DEVICES = 8;
+
+class FakeI2cDevice {
+public:
+  virtual ~FakeI2cDevice() {}
+
+  // Receives the bytes of a write transaction (none for an address probe). Returns false to NACK it.
+  virtual bool receive(const uint8_t* data, size_t length) = 0;
+
+  // Fills 'data' with the bytes of a read transaction. Returns false to NACK it.
+  virtual bool transmit(uint8_t* data, size_t length) = 0;
+};
+
+typedef struct {
+  uint32_t transactions;  // Write and read transactions, including failed ones.
+  uint32_t bytes_written; // Data bytes written, excluding address bytes.
+  uint32_t bytes_read;
+  uint32_t errors;        // NACKed transactions.
+  uint64_t busy_us;       // Time the bus was busy.
+} FakeI2cStats_t;
+
+class TwoWire {
+public:
+  explicit TwoWire(uint8_t bus_num);
+
+  bool begin();
+  bool begin(int sda, int scl, uint32_t frequency = 0);
+  bool end();
+  bool setClock(uint32_t frequency);
+  uint32_t getClock();
+
+  void beginTransmission(uint16_t address);
+  uint8_t endTransmission(bool send_stop = true);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t* data, size_t length);
+  size_t requestFrom(uint16_t address, size_t length, bool send_stop = true);
+  int available();
+  int read();
+
+  // Simulation.
+  void attach(uint8_t address, FakeI2cDevice* device);
+  void detach(uint8_t address);
+  void resetStats();
+
+  FakeI2cStats_t stats;
+  uint32_t begins;        // Calls of begin(), i.e. bus resets.
+
+private:
+  FakeI2cDevice* find(uint16_t address);
+  void transfer(size_t length);
+
+  uint8_t bus_num;
+  uint32_t frequency;
+  uint8_t addresses[FAKE_I2C_MAX_DEVICES];
+  FakeI2cDevice* devices[FAKE_I2C_MAX_DEVICES];
+  uint16_t tx_address;
+  uint8_t tx_buffer[FAKE_I2C_BUFFER_LENGTH];
+  size_t tx_length;
+  uint8_t rx_buffer[FAKE_I2C_BUFFER_LENGTH];
+  size_t rx_length;
+  size_t rx_position;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
@@ -0,0 +1,68 @@
+#include "fake_bmp280.h"
+
+static const uint8_t REGISTER_CALIBRATION = 0x88;
+static const uint8_t REGISTER_CHIP_ID = 0xD0;
+static const uint8_t REGISTER_CTRL_MEAS = 0xF4;
+static const uint8_t REGISTER_DATA = 0xF7;
+static const uint8_t CHIP_ID = 0x58;
+static const uint8_t MODE_MASK = 0x03;
+static const uint8_t MODE_FORCED = 0x01;
+
+// dig_T1 to dig_P9 of the datasheet example.
+static const int32_t EXAMPLE_CALIBRATION[12] = {27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000};
+
+
+FakeBmp280::FakeBmp280() : pointer(0), connected(true), register_writes(0), forced_measurements(0) {
+  memset(registers, 0, sizeof(registers));
+  registers[REGISTER_CHIP_ID] = CHIP_ID;
+  for (uint8_t i = 0; i < 12; i++) {
+    registers[REGISTER_CALIBRATION + 2 * i] = EXAMPLE_CALIBRATION[i] & 0xFF;
+    registers[REGISTER_CALIBRATION + 2 * i + 1] = (EXAMPLE_CALIBRATION[i] >> 8) & 0xFF;
+  }
+  setRaw(FAKE_BMP280_EXAMPLE_ADC_P, FAKE_BMP280_EXAMPLE_ADC_T);
+}
+
+
+// The first byte selects the register, every following pair is a value and the next register.
+bool FakeBmp280::receive(const uint8_t* data, size_t length) {
+  if (!connected) {
+    return false;
+  }
+  for (size_t i = 0; i < length; i += 2) {
+    pointer = data[i];
+    if (i + 1 == length) {
+      break;
+    }
+    registers[pointer] = data[i + 1];
+    register_writes++;
+
+    // A forced measurement completes right away and the sensor goes back to sleep.
+    if (pointer == REGISTER_CTRL_MEAS && (data[i + 1] & MODE_MASK) == MODE_FORCED) {
+      forced_measurements++;
+      registers[pointer] &= ~MODE_MASK;
+    }
+  }
+  return true;
+}
+
+
+bool FakeBmp280::transmit(uint8_t* data, size_t length) {
+  if (!connected) {
+    return false;
+  }
+  for (size_t i = 0; i < length; i++) {
+    data[i] = registers[(uint8_t)(pointer + i)];
+  }
+  return true;
+}
+
+
+// Data registers: press_msb, press_lsb, press_xlsb, temp_msb, temp_lsb, temp_xlsb, the xlsb holding bits 3:0 in 7:4.
+void FakeBmp280::setRaw(int32_t adc_pressure, int32_t adc_temperature) {
+  registers[REGISTER_DATA] = (adc_pressure >> 12) & 0xFF;
+  registers[REGISTER_DATA + 1] = (adc_pressure >> 4) & 0xFF;
+  registers[REGISTER_DATA + 2] = (adc_pressure << 4) & 0xF0;
+  registers[REGISTER_DATA + 3] = (adc_temperature >> 12) & 0xFF;
+  registers[REGISTER_DATA + 4] = (adc_temperature >> 4) & 0xFF;
+  registers[REGISTER_DATA + 5] = (adc_temperature << 4) & 0xF0;
+}
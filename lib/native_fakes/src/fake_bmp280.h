@@ -0,0 +1,30 @@
+// Simulated BMP280 for the fake I2C bus (Wire.h).
+// It holds the register file of the sensor: the chip id, the calibration of the example in section 3.12
+// of the datasheet and the data registers, which return the raw readings set with setRaw.
+// Writes are register/value pairs and reads auto-increment from the last written register, as on the sensor.
+// A write of forced mode to ctrl_meas counts as one measurement, after which the mode returns to sleep.
+
+#pragma once
+
+#include "Wire.h"
+
+// Raw readings of the datasheet example, 25.08 C and 100653.27 Pa with its calibration.
+static const int32_t FAKE_BMP280_EXAMPLE_ADC_T = 519888;
+static const int32_t FAKE_BMP280_EXAMPLE_ADC_P = 415148;
+
+class FakeBmp280 : public FakeI2cDevice {
+public:
+  FakeBmp280();
+
+  bool receive(const uint8_t* data, size_t length) override;
+  bool transmit(uint8_t* data, size_t length) override;
+
+  // Sets the 20-bit raw readings returned by the data registers.
+  void setRaw(int32_t adc_pressure, int32_t adc_temperature);
+
+  uint8_t registers[256];
+  uint8_t pointer;                // Register the next read starts at.
+  bool connected;                 // False NACKs every transaction, like a sensor that came loose.
+  uint32_t register_writes;
+  uint32_t forced_measurements;
+};
@@ -0,0 +1,19 @@
+#include <atomic>
+#include "fake_clock.h"
+
+static std::atomic<uint64_t> now_us(0);
+
+
+uint64_t fakeClockMicros() {
+  return now_us.load(std::memory_order_relaxed);
+}
+
+
+void fakeClockAdvance(uint64_t us) {
+  now_us.fetch_add(us, std::memory_order_relaxed);
+}
+
+
+void fakeClockSet(uint64_t us) {
+  now_us.store(us, std::memory_order_relaxed);
+}
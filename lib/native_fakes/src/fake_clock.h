@@ -0,0 +1,17 @@
+// Simulated time of the native environment.
+// millis() and micros() read this clock instead of the host clock, and the fake buses advance it by the
+// time their transfers would take on the device, so bus hold times and latencies measured with micros()
+// are deterministic and do not depend on the speed of the host.
+
+#pragma once
+
+#include <stdint.h>
+
+// Returns the simulated time in microseconds since the start of the program (or the last fakeClockSet).
+uint64_t fakeClockMicros();
+
+// Moves the simulated time forward by 'us'.
+void fakeClockAdvance(uint64_t us);
+
+// Sets the simulated time, e.g. to start every test at the same time.
+void fakeClockSet(uint64_t us);
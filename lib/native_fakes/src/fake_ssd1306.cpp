@@ -0,0 +1,97 @@
+#include "fake_ssd1306.h"
+
+static const uint8_t CONTROL_COMMAND = 0x00;
+static const uint8_t CONTROL_DATA = 0x40;
+static const uint8_t COMMAND_COLUMN_ADDRESS = 0x21;
+static const uint8_t COMMAND_PAGE_ADDRESS = 0x22;
+
+
+// Number of argument bytes that follow a command, for the commands the Adafruit driver sends.
+static uint8_t argumentCount(uint8_t command) {
+  switch (command) {
+    case COMMAND_COLUMN_ADDRESS:
+    case COMMAND_PAGE_ADDRESS:
+      return 2;
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+
+FakeSsd1306::FakeSsd1306() : connected(true), command_bytes(0), data_bytes(0), first_column(0),
+                             last_column(FAKE_SSD1306_WIDTH - 1), first_page(0), last_page(FAKE_SSD1306_PAGES - 1),
+                             column(0), page(0), pending_command(0), pending_arguments(0), received_arguments(0) {
+  memset(ram, 0, sizeof(ram));
+}
+
+
+bool FakeSsd1306::receive(const uint8_t* data, size_t length) {
+  if (!connected) {
+    return false;
+  }
+  // An address probe.
+  if (length == 0) {
+    return true;
+  }
+
+  if (data[0] == CONTROL_COMMAND) {
+    for (size_t i = 1; i < length; i++) {
+      command(data[i]);
+    }
+    command_bytes += length;
+    return true;
+  }
+  if (data[0] != CONTROL_DATA) {
+    return false;
+  }
+
+  // Horizontal addressing: the column wraps to the start of the window on the next page.
+  for (size_t i = 1; i < length; i++) {
+    ram[page][column] = data[i];
+    if (column == last_column) {
+      column = first_column;
+      page = page == last_page ? first_page : page + 1;
+    }
+    else {
+      column++;
+    }
+  }
+  data_bytes += length;
+  return true;
+}
+
+
+// The display can not be read over I2C.
+bool FakeSsd1306::transmit(uint8_t* data, size_t length) {
+  (void)data;
+  (void)length;
+  return false;
+}
+
+
+void FakeSsd1306::command(uint8_t byte) {
+  if (pending_arguments == 0) {
+    pending_command = byte;
+    pending_arguments = argumentCount(byte);
+    received_arguments = 0;
+    return;
+  }
+
+  arguments[received_arguments++ % 2] = byte;
+  if (--pending_arguments > 0) {
+    return;
+  }
+  if (pending_command == COMMAND_COLUMN_ADDRESS) {
+    first_column = arguments[0] % FAKE_SSD1306_WIDTH;
+    last_column = arguments[1] % FAKE_SSD1306_WIDTH;
+    column = first_column;
+  }
+  else if (pending_command == COMMAND_PAGE_ADDRESS) {
+    // The Adafruit driver sends 0xFF as the last page.
+    first_page = arguments[0] % FAKE_SSD1306_PAGES;
+    last_page = arguments[1] < FAKE_SSD1306_PAGES ? arguments[1] : FAKE_SSD1306_PAGES - 1;
+    page = first_page;
+  }
+}
@@ -0,0 +1,35 @@
+// Simulated SSD1306 for the fake I2C bus (Wire.h).
+// A transaction starts with a control byte: 0x00 for a stream of commands, 0x40 for display data.
+// The page and column address commands set the window that data is written to in horizontal
+// addressing mode, and the data lands in a copy of the display RAM that tests can compare with
+// the framebuffer. Command and data bytes are counted separately.
+
+#pragma once
+
+#include "Wire.h"
+
+static const uint8_t FAKE_SSD1306_WIDTH = 128;
+static const uint8_t FAKE_SSD1306_PAGES = 8;
+
+class FakeSsd1306 : public FakeI2cDevice {
+public:
+  FakeSsd1306();
+
+  bool receive(const uint8_t* data, size_t length) override;
+  bool transmit(uint8_t* data, size_t length) override;
+
+  uint8_t ram[FAKE_SSD1306_PAGES][FAKE_SSD1306_WIDTH];
+  bool connected;
+  uint32_t command_bytes;
+  uint32_t data_bytes;
+
+private:
+  void command(uint8_t byte);
+
+  uint8_t first_column, last_column, first_page, last_page;
+  uint8_t column, page;
+  uint8_t pending_command;        // Command waiting for its arguments.
+  uint8_t pending_arguments;
+  uint8_t arguments[2];
+  uint8_t received_arguments;
+};
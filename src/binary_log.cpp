@@ -0,0 +1,139 @@
+#include <math.h>
+#include "binary_log.h"
+#include "byte_order.h"
+
+
+// Computes the CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320) of a buffer bit by bit.
+// A block is at most 512 bytes and is written every few minutes so a lookup table is not worth 1 KB of RAM.
+uint32_t binaryLogCrc32(uint32_t crc, const uint8_t* data, size_t length) {
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+
+// Empties the block.
+void binaryLogBlockReset(BinaryLogBlock_t* block) {
+  block->base_time = 0;
+  block->count = 0;
+  block->sensor_id = 0;
+}
+
+
+// Adds a record to the block, converting the values to fixed point.
+// It returns false if the block is full or the time is before the base time
+// or too far after it to fit in 16 bits.
+bool binaryLogBlockAdd(BinaryLogBlock_t* block, uint32_t time, const SensorData_t* data) {
+  if (block->count == BINARY_LOG_MAX_RECORDS) {
+    return false;
+  }
+  if (block->count == 0) {
+    block->base_time = time;
+  }
+  if (time < block->base_time || time - block->base_time > UINT16_MAX) {
+    return false;
+  }
+
+  // Clamp the values to the range of the fixed point fields.
+  float temperature = roundf(data->temperature * 100.0f);
+  if (temperature > INT16_MAX) {
+    temperature = INT16_MAX;
+  }
+  if (temperature < INT16_MIN) {
+    temperature = INT16_MIN;
+  }
+  // 4294967040 is the largest float below 2^32, converting anything larger to uint32_t is undefined.
+  float pressure = roundf(data->pressure * 100.0f);
+  if (pressure > 4294967040.0f) {
+    pressure = 4294967040.0f;
+  }
+  if (pressure < 0.0f) {
+    pressure = 0.0f;
+  }
+
+  block->delta[block->count] = time - block->base_time;
+  block->temperature[block->count] = (int16_t)temperature;
+  block->pressure[block->count] = (uint32_t)pressure;
+  block->count++;
+  return true;
+}
+
+
+// Serializes the block into 'out' and returns the number of bytes written.
+size_t binaryLogBlockEncode(const BinaryLogBlock_t* block, uint8_t* out) {
+  putU32(out, BINARY_LOG_MAGIC);
+  out[4] = BINARY_LOG_VERSION;
+  out[5] = block->count;
+  out[6] = BINARY_LOG_RECORD_SIZE;
+  out[7] = block->sensor_id;
+  putU32(out + 8, block->base_time);
+
+  uint8_t* record = out + BINARY_LOG_HEADER_SIZE;
+  for (uint8_t i = 0; i < block->count; i++) {
+    putU16(record, block->delta[i]);
+    putU16(record + 2, (uint16_t)block->temperature[i]);
+    putU32(record + 4, block->pressure[i]);
+    record += BINARY_LOG_RECORD_SIZE;
+  }
+
+  // The CRC covers the header up to the CRC field and all the records.
+  size_t records_size = block->count * BINARY_LOG_RECORD_SIZE;
+  uint32_t crc = binaryLogCrc32(0, out, 12);
+  crc = binaryLogCrc32(crc, out + BINARY_LOG_HEADER_SIZE, records_size);
+  putU32(out + 12, crc);
+
+  return BINARY_LOG_HEADER_SIZE + records_size;
+}
+
+
+// Parses and validates the block at the start of 'in'.
+BinaryLogStatus_t binaryLogBlockDecode(const uint8_t* in, size_t length, BinaryLogBlock_t* block, size_t* block_size) {
+  if (length < BINARY_LOG_HEADER_SIZE) {
+    return BINARY_LOG_TRUNCATED;
+  }
+  if (getU32(in) != BINARY_LOG_MAGIC || in[4] != BINARY_LOG_VERSION || in[6] != BINARY_LOG_RECORD_SIZE ||
+      in[5] == 0 || in[5] > BINARY_LOG_MAX_RECORDS) {
+    return BINARY_LOG_BAD_HEADER;
+  }
+
+  size_t records_size = in[5] * BINARY_LOG_RECORD_SIZE;
+  if (length < BINARY_LOG_HEADER_SIZE + records_size) {
+    return BINARY_LOG_TRUNCATED;
+  }
+
+  uint32_t crc = binaryLogCrc32(0, in, 12);
+  crc = binaryLogCrc32(crc, in + BINARY_LOG_HEADER_SIZE, records_size);
+  if (crc != getU32(in + 12)) {
+    return BINARY_LOG_BAD_CRC;
+  }
+
+  block->count = in[5];
+  block->sensor_id = in[7];
+  block->base_time = getU32(in + 8);
+  const uint8_t* record = in + BINARY_LOG_HEADER_SIZE;
+  for (uint8_t i = 0; i < block->count; i++) {
+    block->delta[i] = getU16(record);
+    block->temperature[i] = (int16_t)getU16(record + 2);
+    block->pressure[i] = getU32(record + 4);
+    record += BINARY_LOG_RECORD_SIZE;
+  }
+
+  *block_size = BINARY_LOG_HEADER_SIZE + records_size;
+  return BINARY_LOG_OK;
+}
+
+
+// Returns record 'index' of a decoded block with the values converted back to floating point.
+BinaryLogRecord_t binaryLogBlockRecord(const BinaryLogBlock_t* block, uint8_t index) {
+  BinaryLogRecord_t record;
+  record.time = block->base_time + block->delta[index];
+  record.data.temperature = block->temperature[index] / 100.0f;
+  record.data.pressure = block->pressure[index] / 100.0f;
+  record.sensor_id = block->sensor_id;
+  return record;
+}
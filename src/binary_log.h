@@ -0,0 +1,82 @@
+// Compact binary format for the SD card log, an alternative to the CSV format.
+// A log file is a sequence of self describing blocks:
+//
+//   offset  size  field
+//   0       4     magic "WSLB" (BINARY_LOG_MAGIC, little endian)
+//   4       1     format version (BINARY_LOG_VERSION)
+//   5       1     number of records in the block (1 - BINARY_LOG_MAX_RECORDS)
+//   6       1     size of one record in bytes (BINARY_LOG_RECORD_SIZE)
+//   7       1     ID of the sensor of every record in the block (see sensor_registry.h)
+//   8       4     base time, seconds since 1970-01-01 UTC
+//   12      4     CRC-32 of bytes 0-11 followed by all record bytes
+//   16      8*n   records
+//
+// and every record is:
+//
+//   0       2     seconds since the base time of the block (unsigned)
+//   2       2     temperature in 1/100 degrees Celsius (signed)
+//   4       4     pressure in 1/100 hPa (unsigned)
+//
+// All values are little endian. Fahrenheit is not stored since it can be derived from Celsius.
+// The sensor ID byte was reserved (0) before several sensors were supported, so older logs decode as sensor 0.
+// The host decoder in tools/ uses it as well.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sensor_utils.h"
+
+static const uint32_t BINARY_LOG_MAGIC = 0x424C5357;  // "WSLB"
+static const uint8_t BINARY_LOG_VERSION = 1;
+static const uint8_t BINARY_LOG_HEADER_SIZE = 16;
+static const uint8_t BINARY_LOG_RECORD_SIZE = 8;
+static const uint8_t BINARY_LOG_MAX_RECORDS = 62;     // Makes a full block exactly 512 bytes.
+static const uint16_t BINARY_LOG_MAX_BLOCK_SIZE = BINARY_LOG_HEADER_SIZE + BINARY_LOG_MAX_RECORDS * BINARY_LOG_RECORD_SIZE;
+
+// A decoded record.
+typedef struct {
+  uint32_t time;       // Seconds since 1970-01-01 UTC.
+  SensorData_t data;
+  uint8_t sensor_id;
+} BinaryLogRecord_t;
+
+// A block of records being built or decoded.
+typedef struct {
+  uint32_t base_time;
+  uint8_t count;
+  uint8_t sensor_id;   // Sensor of every record, set by the owner of a block being built (0 after a reset).
+  uint16_t delta[BINARY_LOG_MAX_RECORDS];
+  int16_t temperature[BINARY_LOG_MAX_RECORDS];
+  uint32_t pressure[BINARY_LOG_MAX_RECORDS];
+} BinaryLogBlock_t;
+
+// Computes the CRC-32 (IEEE 802.3) of a buffer, continuing from a previous crc (0 to start).
+uint32_t binaryLogCrc32(uint32_t crc, const uint8_t* data, size_t length);
+
+// Empties the block and sets its sensor ID to 0.
+void binaryLogBlockReset(BinaryLogBlock_t* block);
+
+// Adds a record to the block. The first record sets the base time of the block.
+// It returns false if the block is full or 'time' can not be stored relative to its base time,
+// in which case the block has to be written out and reset first.
+bool binaryLogBlockAdd(BinaryLogBlock_t* block, uint32_t time, const SensorData_t* data);
+
+// Serializes the block into 'out' which must hold BINARY_LOG_MAX_BLOCK_SIZE bytes.
+// It returns the number of bytes written.
+size_t binaryLogBlockEncode(const BinaryLogBlock_t* block, uint8_t* out);
+
+// Result of decoding a block.
+typedef enum {
+  BINARY_LOG_OK,
+  BINARY_LOG_TRUNCATED,   // Not enough bytes for the block.
+  BINARY_LOG_BAD_HEADER,  // Wrong magic, version or sizes.
+  BINARY_LOG_BAD_CRC      // Block is complete but corrupted.
+} BinaryLogStatus_t;
+
+// Parses the block at the start of 'in'. On success 'block' holds the records and
+// 'block_size' the number of bytes the block occupies.
+BinaryLogStatus_t binaryLogBlockDecode(const uint8_t* in, size_t length, BinaryLogBlock_t* block, size_t* block_size);
+
+// Returns record 'index' of a decoded block.
+BinaryLogRecord_t binaryLogBlockRecord(const BinaryLogBlock_t* block, uint8_t index);
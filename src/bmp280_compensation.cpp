@@ -0,0 +1,64 @@
+#include "bmp280_compensation.h"
+
+
+// Parses the little endian calibration registers 0x88 - 0x9F.
+void bmp280ParseCalibration(const uint8_t* bytes, Bmp280Calibration_t* calibration) {
+  uint16_t words[BMP280_CALIBRATION_SIZE / 2];
+  for (uint8_t i = 0; i < BMP280_CALIBRATION_SIZE / 2; i++) {
+    words[i] = bytes[2 * i] | (bytes[2 * i + 1] << 8);
+  }
+
+  calibration->dig_T1 = words[0];
+  calibration->dig_T2 = (int16_t)words[1];
+  calibration->dig_T3 = (int16_t)words[2];
+  calibration->dig_P1 = words[3];
+  calibration->dig_P2 = (int16_t)words[4];
+  calibration->dig_P3 = (int16_t)words[5];
+  calibration->dig_P4 = (int16_t)words[6];
+  calibration->dig_P5 = (int16_t)words[7];
+  calibration->dig_P6 = (int16_t)words[8];
+  calibration->dig_P7 = (int16_t)words[9];
+  calibration->dig_P8 = (int16_t)words[10];
+  calibration->dig_P9 = (int16_t)words[11];
+}
+
+
+// Extracts the raw values from the data registers 0xF7 - 0xFC (press_msb, press_lsb, press_xlsb, temp_msb, temp_lsb, temp_xlsb).
+void bmp280ParseRaw(const uint8_t* bytes, int32_t* adc_pressure, int32_t* adc_temperature) {
+  *adc_pressure = ((int32_t)bytes[0] << 12) | ((int32_t)bytes[1] << 4) | (bytes[2] >> 4);
+  *adc_temperature = ((int32_t)bytes[3] << 12) | ((int32_t)bytes[4] << 4) | (bytes[5] >> 4);
+}
+
+
+// Datasheet function bmp280_compensate_T_int32.
+int32_t bmp280CompensateTemperature(const Bmp280Calibration_t* calibration, int32_t adc_temperature, int32_t* t_fine) {
+  int32_t var1 = ((((adc_temperature >> 3) - ((int32_t)calibration->dig_T1 << 1))) * ((int32_t)calibration->dig_T2)) >> 11;
+  int32_t var2 = (((((adc_temperature >> 4) - ((int32_t)calibration->dig_T1)) *
+                    ((adc_temperature >> 4) - ((int32_t)calibration->dig_T1))) >> 12) *
+                  ((int32_t)calibration->dig_T3)) >> 14;
+  *t_fine = var1 + var2;
+  return (*t_fine * 5 + 128) >> 8;
+}
+
+
+// Datasheet function bmp280_compensate_P_int64.
+uint32_t bmp280CompensatePressure(const Bmp280Calibration_t* calibration, int32_t adc_pressure, int32_t t_fine) {
+  int64_t var1 = ((int64_t)t_fine) - 128000;
+  int64_t var2 = var1 * var1 * (int64_t)calibration->dig_P6;
+  var2 = var2 + ((var1 * (int64_t)calibration->dig_P5) << 17);
+  var2 = var2 + (((int64_t)calibration->dig_P4) << 35);
+  var1 = ((var1 * var1 * (int64_t)calibration->dig_P3) >> 8) + ((var1 * (int64_t)calibration->dig_P2) << 12);
+  var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)calibration->dig_P1) >> 33;
+
+  // Avoid a division by zero with a missing or corrupted calibration.
+  if (var1 == 0) {
+    return 0;
+  }
+
+  int64_t p = 1048576 - adc_pressure;
+  p = (((p << 31) - var2) * 3125) / var1;
+  var1 = (((int64_t)calibration->dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+  var2 = (((int64_t)calibration->dig_P8) * p) >> 19;
+  p = ((p + var1 + var2) >> 8) + (((int64_t)calibration->dig_P7) << 4);
+  return (uint32_t)p;
+}
@@ -0,0 +1,41 @@
+// Integer compensation of raw BMP280 readings, as given in section 8.2 of the Bosch BMP280 datasheet.
+// The temperature is computed once and its t_fine value reused for the pressure,
+// so a sample needs a single burst read of the six data registers and no floating point math.
+
+#pragma once
+
+#include <stdint.h>
+
+// Number of calibration bytes stored from register 0x88 onwards.
+static const uint8_t BMP280_CALIBRATION_SIZE = 24;
+
+// Value the data registers hold when a measurement was skipped (oversampling set to skip).
+static const int32_t BMP280_ADC_SKIPPED = 0x80000;
+
+// Factory calibration parameters of one sensor.
+typedef struct {
+  uint16_t dig_T1;
+  int16_t dig_T2;
+  int16_t dig_T3;
+  uint16_t dig_P1;
+  int16_t dig_P2;
+  int16_t dig_P3;
+  int16_t dig_P4;
+  int16_t dig_P5;
+  int16_t dig_P6;
+  int16_t dig_P7;
+  int16_t dig_P8;
+  int16_t dig_P9;
+} Bmp280Calibration_t;
+
+// Parses the BMP280_CALIBRATION_SIZE little endian bytes read from register 0x88.
+void bmp280ParseCalibration(const uint8_t* bytes, Bmp280Calibration_t* calibration);
+
+// Extracts the 20-bit raw pressure and temperature from the six bytes read from register 0xF7.
+void bmp280ParseRaw(const uint8_t* bytes, int32_t* adc_pressure, int32_t* adc_temperature);
+
+// Returns the temperature in 1/100 degrees Celsius and stores t_fine for the pressure compensation.
+int32_t bmp280CompensateTemperature(const Bmp280Calibration_t* calibration, int32_t adc_temperature, int32_t* t_fine);
+
+// Returns the pressure in Pa as unsigned Q24.8 fixed point (divide by 256 for Pa), or 0 on invalid calibration.
+uint32_t bmp280CompensatePressure(const Bmp280Calibration_t* calibration, int32_t adc_pressure, int32_t t_fine);
@@ -0,0 +1,144 @@
+#include "bmp280_driver.h"
+
+// Register addresses and values from the BMP280 datasheet.
+static const uint8_t BMP280_REGISTER_CALIBRATION = 0x88;
+static const uint8_t BMP280_REGISTER_CHIP_ID = 0xD0;
+static const uint8_t BMP280_REGISTER_CTRL_MEAS = 0xF4;
+static const uint8_t BMP280_REGISTER_CONFIG = 0xF5;
+static const uint8_t BMP280_REGISTER_DATA = 0xF7;
+static const uint8_t BMP280_CHIP_ID = 0x58;
+static const uint8_t BME280_CHIP_ID = 0x60;  // Same temperature and pressure registers and compensation.
+static const uint8_t BMP280_DATA_SIZE = 6;
+
+
+// Writes one register.
+static bool writeRegister(Bmp280_t* sensor, uint8_t reg, uint8_t value) {
+  sensor->transactions++;
+  sensor->bus_bytes += 2;
+  sensor->wire->beginTransmission(sensor->address);
+  sensor->wire->write(reg);
+  sensor->wire->write(value);
+  if (sensor->wire->endTransmission() != 0) {
+    sensor->errors++;
+    return false;
+  }
+  return true;
+}
+
+
+// Reads 'length' consecutive registers starting at 'reg' in one transaction (repeated start).
+static bool readRegisters(Bmp280_t* sensor, uint8_t reg, uint8_t* buffer, uint8_t length) {
+  sensor->transactions++;
+  sensor->bus_bytes += 1 + length;
+  sensor->wire->beginTransmission(sensor->address);
+  sensor->wire->write(reg);
+  if (sensor->wire->endTransmission(false) != 0) {
+    sensor->errors++;
+    return false;
+  }
+  if (sensor->wire->requestFrom(sensor->address, (size_t)length) != length) {
+    sensor->errors++;
+    return false;
+  }
+  for (uint8_t i = 0; i < length; i++) {
+    buffer[i] = sensor->wire->read();
+  }
+  return true;
+}
+
+
+// Value of the ctrl_meas register for a configuration.
+static uint8_t ctrlMeas(const Bmp280Config_t* config) {
+  return (config->temperature_oversampling << 5) | (config->pressure_oversampling << 2) | config->mode;
+}
+
+
+// Checks the chip id, reads the calibration and applies the configuration.
+bool bmp280Begin(Bmp280_t* sensor, TwoWire* wire, uint8_t address, const Bmp280Config_t* config) {
+  sensor->wire = wire;
+  sensor->address = address;
+
+  if (!bmp280Probe(sensor)) {
+    return false;
+  }
+
+  uint8_t calibration[BMP280_CALIBRATION_SIZE];
+  if (!readRegisters(sensor, BMP280_REGISTER_CALIBRATION, calibration, sizeof(calibration))) {
+    return false;
+  }
+  bmp280ParseCalibration(calibration, &sensor->calibration);
+
+  return bmp280Configure(sensor, config);
+}
+
+
+// Applies a new configuration.
+// The sensor is put to sleep first since the config register is only reliably written in sleep mode.
+bool bmp280Configure(Bmp280_t* sensor, const Bmp280Config_t* config) {
+  sensor->config = *config;
+
+  if (!writeRegister(sensor, BMP280_REGISTER_CTRL_MEAS, BMP280_MODE_SLEEP)) {
+    return false;
+  }
+  if (!writeRegister(sensor, BMP280_REGISTER_CONFIG, (config->standby << 5) | (config->filter << 2))) {
+    return false;
+  }
+
+  // In forced mode the measurement is only triggered on demand.
+  Bmp280Config_t idle = *config;
+  if (idle.mode == BMP280_MODE_FORCED) {
+    idle.mode = BMP280_MODE_SLEEP;
+  }
+  return writeRegister(sensor, BMP280_REGISTER_CTRL_MEAS, ctrlMeas(&idle));
+}
+
+
+// Maximum measurement time: 1.25 ms + 2.3 ms per temperature and pressure oversampling step + 0.575 ms for pressure.
+// Computed in microseconds and rounded up to whole milliseconds.
+uint32_t bmp280MeasurementTimeMs(const Bmp280Config_t* config) {
+  static const uint8_t SAMPLES[] = {0, 1, 2, 4, 8, 16};
+  uint32_t time_us = 1250 + 2300 * SAMPLES[config->temperature_oversampling];
+  if (config->pressure_oversampling != BMP280_OVERSAMPLING_SKIP) {
+    time_us += 2300 * SAMPLES[config->pressure_oversampling] + 575;
+  }
+  return (time_us + 999) / 1000;
+}
+
+
+// Triggers a measurement in forced mode. The sensor returns to sleep when it is done.
+bool bmp280StartMeasurement(Bmp280_t* sensor) {
+  if (sensor->config.mode != BMP280_MODE_FORCED) {
+    return true;
+  }
+  return writeRegister(sensor, BMP280_REGISTER_CTRL_MEAS, ctrlMeas(&sensor->config));
+}
+
+
+// Burst reads the six data registers and compensates them.
+bool bmp280ReadMeasurement(Bmp280_t* sensor, SensorData_t* data) {
+  uint8_t raw[BMP280_DATA_SIZE];
+  if (!readRegisters(sensor, BMP280_REGISTER_DATA, raw, sizeof(raw))) {
+    return false;
+  }
+
+  int32_t adc_pressure, adc_temperature;
+  bmp280ParseRaw(raw, &adc_pressure, &adc_temperature);
+  if (adc_temperature == BMP280_ADC_SKIPPED) {
+    return false;
+  }
+
+  int32_t t_fine;
+  data->temperature = bmp280CompensateTemperature(&sensor->calibration, adc_temperature, &t_fine) / 100.0f;
+  data->pressure = bmp280CompensatePressure(&sensor->calibration, adc_pressure, t_fine) / 25600.0f;
+  return true;
+}
+
+
+// Reads the chip id register and checks it.
+bool bmp280Probe(Bmp280_t* sensor) {
+  uint8_t chip_id = 0;
+  if (!readRegisters(sensor, BMP280_REGISTER_CHIP_ID, &chip_id, 1)) {
+    return false;
+  }
+  return chip_id == BMP280_CHIP_ID || chip_id == BME280_CHIP_ID;
+}
@@ -0,0 +1,91 @@
+// Minimal BMP280 driver that reads a complete sample with a single I2C burst read.
+// The Adafruit driver reads the temperature registers again for every pressure reading to get t_fine
+// and compensates in floating point. Here the six data registers (pressure and temperature)
+// are read in one transaction and compensated once with the datasheet integer formulas.
+// Oversampling, IIR filter, standby time and the power mode are configurable.
+// None of these functions take the i2c_mutex, the caller must hold it.
+
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "sensor_utils.h"
+#include "bmp280_compensation.h"
+
+// Oversampling settings (osrs_t / osrs_p fields of register 0xF4).
+typedef enum {
+  BMP280_OVERSAMPLING_SKIP = 0,
+  BMP280_OVERSAMPLING_X1 = 1,
+  BMP280_OVERSAMPLING_X2 = 2,
+  BMP280_OVERSAMPLING_X4 = 3,
+  BMP280_OVERSAMPLING_X8 = 4,
+  BMP280_OVERSAMPLING_X16 = 5
+} Bmp280Oversampling_t;
+
+// IIR filter coefficient (filter field of register 0xF5).
+typedef enum {
+  BMP280_FILTER_OFF = 0,
+  BMP280_FILTER_X2 = 1,
+  BMP280_FILTER_X4 = 2,
+  BMP280_FILTER_X8 = 3,
+  BMP280_FILTER_X16 = 4
+} Bmp280Filter_t;
+
+// Inactive time between measurements in normal mode (t_sb field of register 0xF5).
+typedef enum {
+  BMP280_STANDBY_0_5_MS = 0,
+  BMP280_STANDBY_62_5_MS = 1,
+  BMP280_STANDBY_125_MS = 2,
+  BMP280_STANDBY_250_MS = 3,
+  BMP280_STANDBY_500_MS = 4,
+  BMP280_STANDBY_1000_MS = 5,
+  BMP280_STANDBY_2000_MS = 6,
+  BMP280_STANDBY_4000_MS = 7
+} Bmp280Standby_t;
+
+// Power mode (mode field of register 0xF4).
+// In forced mode every measurement is triggered by bmp280StartMeasurement and the sensor sleeps in between.
+// In normal mode the sensor measures continuously and bmp280ReadMeasurement returns the latest result.
+typedef enum {
+  BMP280_MODE_SLEEP = 0,
+  BMP280_MODE_FORCED = 1,
+  BMP280_MODE_NORMAL = 3
+} Bmp280Mode_t;
+
+typedef struct {
+  Bmp280Oversampling_t temperature_oversampling;
+  Bmp280Oversampling_t pressure_oversampling;
+  Bmp280Filter_t filter;
+  Bmp280Standby_t standby;
+  Bmp280Mode_t mode;
+} Bmp280Config_t;
+
+typedef struct {
+  TwoWire* wire;
+  uint8_t address;
+  Bmp280Config_t config;
+  Bmp280Calibration_t calibration;
+
+  // Statistics.
+  uint32_t transactions;  // I2C transactions started.
+  uint32_t bus_bytes;     // Bytes transferred, excluding address bytes.
+  uint32_t errors;        // Failed transactions.
+} Bmp280_t;
+
+// Checks the chip id, reads the calibration and applies the configuration.
+bool bmp280Begin(Bmp280_t* sensor, TwoWire* wire, uint8_t address, const Bmp280Config_t* config);
+
+// Applies a new configuration to an initialized sensor.
+bool bmp280Configure(Bmp280_t* sensor, const Bmp280Config_t* config);
+
+// Returns the maximum time in milliseconds one measurement takes with the given configuration (datasheet section 9.1).
+uint32_t bmp280MeasurementTimeMs(const Bmp280Config_t* config);
+
+// Triggers a measurement in forced mode. Does nothing in normal mode.
+bool bmp280StartMeasurement(Bmp280_t* sensor);
+
+// Burst reads the data registers and returns the compensated temperature (Celsius) and pressure (hPa).
+bool bmp280ReadMeasurement(Bmp280_t* sensor, SensorData_t* data);
+
+// Reads the chip id register. Used as a cheap probe to check that the sensor still responds.
+bool bmp280Probe(Bmp280_t* sensor);
@@ -0,0 +1,26 @@
+// Helpers to store and load the little endian values of the SD card formats (binary_log.h,
+// compressed_log.h and sd_log_index.h) independently of the host byte order.
+
+#pragma once
+
+#include <stdint.h>
+
+inline void putU16(uint8_t* out, uint16_t value) {
+  out[0] = value & 0xFF;
+  out[1] = value >> 8;
+}
+
+inline void putU32(uint8_t* out, uint32_t value) {
+  out[0] = value & 0xFF;
+  out[1] = (value >> 8) & 0xFF;
+  out[2] = (value >> 16) & 0xFF;
+  out[3] = value >> 24;
+}
+
+inline uint16_t getU16(const uint8_t* in) {
+  return in[0] | (in[1] << 8);
+}
+
+inline uint32_t getU32(const uint8_t* in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
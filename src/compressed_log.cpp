@@ -0,0 +1,229 @@
+#include <math.h>
+#include <string.h>
+#include "compressed_log.h"
+#include "byte_order.h"
+
+
+// Bucket of a variable length field: prefix of 'prefix_bits' one bits (terminated by a zero
+// bit except for the last bucket) followed by 'value_bits' bits of the zigzag encoded value.
+typedef struct {
+  uint8_t prefix_bits;
+  uint8_t value_bits;
+} Bucket_t;
+
+static const uint8_t BUCKET_COUNT = 5;
+static const Bucket_t TIME_BUCKETS[BUCKET_COUNT] = {{1, 0}, {2, 7}, {3, 12}, {4, 20}, {4, 32}};
+static const Bucket_t VALUE_BUCKETS[BUCKET_COUNT] = {{1, 0}, {2, 4}, {3, 8}, {4, 16}, {4, 32}};
+
+
+// Maps signed values to unsigned ones so that small magnitudes of either sign get small codes.
+// The differences are computed in uint32_t (wrapping instead of overflowing) and only taken as signed here.
+static uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+
+// Returns the smallest bucket that can hold the zigzag encoded 'value'.
+static uint8_t findBucket(const Bucket_t* buckets, uint32_t value) {
+  uint8_t bucket = 0;
+  while (bucket < BUCKET_COUNT - 1 && (buckets[bucket].value_bits < 32 ? value >> buckets[bucket].value_bits : 1) != 0) {
+    bucket++;
+  }
+  return bucket;
+}
+
+
+// Appends the 'count' low bits of 'value' to the bit stream, most significant bit first.
+// The stream bytes past the used bits are always zero, so only one bits have to be set.
+static void writeBits(uint8_t* stream, uint16_t* bit, uint32_t value, uint8_t count) {
+  for (uint8_t i = count; i-- > 0; (*bit)++) {
+    if ((value >> i) & 1) {
+      stream[*bit >> 3] |= 0x80 >> (*bit & 7);
+    }
+  }
+}
+
+static void writeField(uint8_t* stream, uint16_t* bit, const Bucket_t* buckets, uint8_t bucket, uint32_t value) {
+  uint8_t prefix_bits = buckets[bucket].prefix_bits;
+  // All one bits, terminated by a zero bit unless it is the last bucket.
+  uint32_t prefix = bucket == BUCKET_COUNT - 1 ? (1u << prefix_bits) - 1 : ((1u << prefix_bits) - 1) & ~1u;
+  writeBits(stream, bit, prefix, prefix_bits);
+  writeBits(stream, bit, value, buckets[bucket].value_bits);
+}
+
+
+// Reads 'count' bits from the bit stream. Returns false if the stream ends first.
+static bool readBits(CompressedLogReader_t* reader, uint8_t count, uint32_t* value) {
+  if (reader->bit + count > reader->stream_bits) {
+    return false;
+  }
+  *value = 0;
+  for (uint8_t i = 0; i < count; i++, reader->bit++) {
+    *value = (*value << 1) | ((reader->stream[reader->bit >> 3] >> (7 - (reader->bit & 7))) & 1);
+  }
+  return true;
+}
+
+static bool readField(CompressedLogReader_t* reader, const Bucket_t* buckets, int32_t* value) {
+  uint8_t bucket = 0;
+  uint32_t bit;
+  while (bucket < BUCKET_COUNT - 1) {
+    if (!readBits(reader, 1, &bit)) {
+      return false;
+    }
+    if (bit == 0) {
+      break;
+    }
+    bucket++;
+  }
+
+  uint32_t encoded;
+  if (!readBits(reader, buckets[bucket].value_bits, &encoded)) {
+    return false;
+  }
+  *value = unzigzag(encoded);
+  return true;
+}
+
+
+// Empties the block.
+void compressedLogReset(CompressedLogBlock_t* block) {
+  memset(block->data, 0, sizeof(block->data));
+  block->count = 0;
+  block->sensor_id = 0;
+  block->bits = 0;
+  block->base_time = 0;
+  block->last_time = 0;
+  block->last_delta = 0;
+  block->last_temperature = 0;
+  block->last_pressure = 0;
+}
+
+
+// Appends a record, converting the values to 1/100 fixed point.
+// The size of the record is known before anything is written, so a record that does not fit leaves the block unchanged.
+bool compressedLogAdd(CompressedLogBlock_t* block, uint32_t time, const SensorData_t* data) {
+  if (block->count == UINT16_MAX) {
+    return false;
+  }
+  if (block->count == 0) {
+    block->base_time = time;
+    block->last_time = time;
+  }
+
+  uint32_t delta = time - block->last_time;
+  int32_t temperature = (int32_t)lroundf(data->temperature * 100.0f);
+  int32_t pressure = (int32_t)lroundf(data->pressure * 100.0f);
+
+  uint32_t time_value = zigzag((int32_t)(delta - block->last_delta));
+  uint32_t temperature_value = zigzag((int32_t)((uint32_t)temperature - (uint32_t)block->last_temperature));
+  uint32_t pressure_value = zigzag((int32_t)((uint32_t)pressure - (uint32_t)block->last_pressure));
+  uint8_t time_bucket = findBucket(TIME_BUCKETS, time_value);
+  uint8_t temperature_bucket = findBucket(VALUE_BUCKETS, temperature_value);
+  uint8_t pressure_bucket = findBucket(VALUE_BUCKETS, pressure_value);
+
+  uint16_t bits = TIME_BUCKETS[time_bucket].prefix_bits + TIME_BUCKETS[time_bucket].value_bits +
+                  VALUE_BUCKETS[temperature_bucket].prefix_bits + VALUE_BUCKETS[temperature_bucket].value_bits +
+                  VALUE_BUCKETS[pressure_bucket].prefix_bits + VALUE_BUCKETS[pressure_bucket].value_bits;
+  if (block->bits + bits > COMPRESSED_LOG_MAX_PAYLOAD_SIZE * 8) {
+    return false;
+  }
+
+  uint8_t* stream = block->data + COMPRESSED_LOG_HEADER_SIZE;
+  writeField(stream, &block->bits, TIME_BUCKETS, time_bucket, time_value);
+  writeField(stream, &block->bits, VALUE_BUCKETS, temperature_bucket, temperature_value);
+  writeField(stream, &block->bits, VALUE_BUCKETS, pressure_bucket, pressure_value);
+
+  block->last_time = time;
+  block->last_delta = delta;
+  block->last_temperature = temperature;
+  block->last_pressure = pressure;
+  block->count++;
+  return true;
+}
+
+
+// Writes the header and CRC and returns the size of the block.
+size_t compressedLogFinish(CompressedLogBlock_t* block) {
+  uint16_t stream_size = (block->bits + 7) / 8;
+  uint8_t* out = block->data;
+
+  putU32(out, COMPRESSED_LOG_MAGIC);
+  out[4] = COMPRESSED_LOG_VERSION;
+  out[5] = block->sensor_id;
+  putU16(out + 6, block->count);
+  putU32(out + 8, block->base_time);
+  putU16(out + 12, stream_size);
+  putU16(out + 14, 0);
+
+  // The CRC covers the header up to the CRC field and the bit stream.
+  uint32_t crc = binaryLogCrc32(0, out, 16);
+  crc = binaryLogCrc32(crc, out + COMPRESSED_LOG_HEADER_SIZE, stream_size);
+  putU32(out + 16, crc);
+
+  return COMPRESSED_LOG_HEADER_SIZE + stream_size;
+}
+
+
+// Validates the block at the start of 'in' and prepares the reader.
+BinaryLogStatus_t compressedLogOpen(const uint8_t* in, size_t length, CompressedLogReader_t* reader, size_t* block_size) {
+  if (length < COMPRESSED_LOG_HEADER_SIZE) {
+    return BINARY_LOG_TRUNCATED;
+  }
+  uint16_t stream_size = getU16(in + 12);
+  if (getU32(in) != COMPRESSED_LOG_MAGIC || in[4] != COMPRESSED_LOG_VERSION ||
+      getU16(in + 6) == 0 || stream_size > COMPRESSED_LOG_MAX_PAYLOAD_SIZE) {
+    return BINARY_LOG_BAD_HEADER;
+  }
+  if (length < COMPRESSED_LOG_HEADER_SIZE + (size_t)stream_size) {
+    return BINARY_LOG_TRUNCATED;
+  }
+
+  uint32_t crc = binaryLogCrc32(0, in, 16);
+  crc = binaryLogCrc32(crc, in + COMPRESSED_LOG_HEADER_SIZE, stream_size);
+  if (crc != getU32(in + 16)) {
+    return BINARY_LOG_BAD_CRC;
+  }
+
+  reader->stream = in + COMPRESSED_LOG_HEADER_SIZE;
+  reader->stream_bits = stream_size * 8;
+  reader->bit = 0;
+  reader->count = getU16(in + 6);
+  reader->index = 0;
+  reader->sensor_id = in[5];
+  reader->time = getU32(in + 8);
+  reader->delta = 0;
+  reader->temperature = 0;
+  reader->pressure = 0;
+
+  *block_size = COMPRESSED_LOG_HEADER_SIZE + stream_size;
+  return BINARY_LOG_OK;
+}
+
+
+// Decodes the next record with the values converted back to floating point.
+bool compressedLogNext(CompressedLogReader_t* reader, BinaryLogRecord_t* record) {
+  int32_t delta_of_delta, temperature_delta, pressure_delta;
+  if (reader->index == reader->count ||
+      !readField(reader, TIME_BUCKETS, &delta_of_delta) ||
+      !readField(reader, VALUE_BUCKETS, &temperature_delta) ||
+      !readField(reader, VALUE_BUCKETS, &pressure_delta)) {
+    return false;
+  }
+
+  reader->delta += (uint32_t)delta_of_delta;
+  reader->time += reader->delta;
+  reader->temperature = (int32_t)((uint32_t)reader->temperature + (uint32_t)temperature_delta);
+  reader->pressure = (int32_t)((uint32_t)reader->pressure + (uint32_t)pressure_delta);
+  reader->index++;
+
+  record->time = reader->time;
+  record->data.temperature = reader->temperature / 100.0f;
+  record->data.pressure = reader->pressure / 100.0f;
+  record->sensor_id = reader->sensor_id;
+  return true;
+}
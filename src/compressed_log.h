@@ -0,0 +1,89 @@
+// Compressed binary format for the SD card log and for catch-up uploads, in the style of Gorilla
+// (Pelkonen et al., VLDB 2015). Time stamps are stored as the difference between consecutive
+// time deltas (delta of delta), which is zero for windows logged at a fixed interval, and the values
+// as deltas of their 1/100 fixed point representation (the same resolution as binary_log.h).
+// Temperature and pressure change slowly, so a typical record takes one to two bytes instead of
+// 8 bytes in binary_log.h or about 70 characters of CSV.
+//
+// A compressed log is a sequence of self describing blocks of at most 512 bytes:
+//
+//   offset  size  field
+//   0       4     magic "WSLC" (COMPRESSED_LOG_MAGIC, little endian)
+//   4       1     format version (COMPRESSED_LOG_VERSION)
+//   5       1     ID of the sensor of every record in the block (see sensor_registry.h)
+//   6       2     number of records in the block
+//   8       4     base time, seconds since 1970-01-01 UTC
+//   12      2     size of the bit stream in bytes
+//   14      2     reserved, 0
+//   16      4     CRC-32 of bytes 0-15 followed by the bit stream
+//   20      n     bit stream, most significant bit first, padded with zero bits
+//
+// Every record is three variable length fields, each relative to the previous record
+// of the block (the first record is relative to the base time, a delta of 0 and values of 0):
+//
+//   time:      zigzag(delta of delta) as  '0' (0) | '10' + 7 bits | '110' + 12 bits | '1110' + 20 bits | '1111' + 32 bits
+//   values:    zigzag(delta) as           '0' (0) | '10' + 4 bits | '110' + 8 bits  | '1110' + 16 bits | '1111' + 32 bits
+//
+// with the temperature in 1/100 degrees Celsius followed by the pressure in 1/100 hPa.
+// A block always starts from scratch so one corrupted block only loses its own records.
+// It only holds the records of one sensor, so the deltas stay small with several sensors logging.
+// The sensor ID byte was reserved (0) before several sensors were supported, so older logs decode as sensor 0.
+// The host decoder in tools/ uses it as well.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sensor_utils.h"
+#include "binary_log.h"
+
+static const uint32_t COMPRESSED_LOG_MAGIC = 0x434C5357;  // "WSLC"
+static const uint8_t COMPRESSED_LOG_VERSION = 1;
+static const uint8_t COMPRESSED_LOG_HEADER_SIZE = 20;
+static const uint16_t COMPRESSED_LOG_MAX_BLOCK_SIZE = 512;
+static const uint16_t COMPRESSED_LOG_MAX_PAYLOAD_SIZE = COMPRESSED_LOG_MAX_BLOCK_SIZE - COMPRESSED_LOG_HEADER_SIZE;
+
+// A block being built. 'data' holds the encoded block, the header is filled in by compressedLogFinish.
+typedef struct {
+  uint8_t data[COMPRESSED_LOG_MAX_BLOCK_SIZE];
+  uint16_t count;            // Records in the block.
+  uint8_t sensor_id;         // Sensor of every record, set by the owner (0 after a reset).
+  uint16_t bits;             // Bits of the bit stream used so far.
+  uint32_t base_time;
+  uint32_t last_time;
+  uint32_t last_delta;       // Differences are taken modulo 2^32, so a clock jump can not overflow.
+  int32_t last_temperature;  // 1/100 degrees Celsius.
+  int32_t last_pressure;     // 1/100 hPa.
+} CompressedLogBlock_t;
+
+// Empties the block and sets its sensor ID to 0.
+void compressedLogReset(CompressedLogBlock_t* block);
+
+// Appends a record to the block. The first record sets the base time of the block.
+// It returns false if the record does not fit, in which case the block has to be finished and reset first.
+bool compressedLogAdd(CompressedLogBlock_t* block, uint32_t time, const SensorData_t* data);
+
+// Writes the header and CRC into block->data and returns the size of the block in bytes.
+// Records can still be added afterwards, the block just has to be finished again.
+size_t compressedLogFinish(CompressedLogBlock_t* block);
+
+// Reads the records of an encoded block one at a time.
+typedef struct {
+  const uint8_t* stream;
+  uint32_t stream_bits;
+  uint32_t bit;
+  uint16_t count;
+  uint16_t index;
+  uint8_t sensor_id;
+  uint32_t time;
+  uint32_t delta;
+  int32_t temperature;
+  int32_t pressure;
+} CompressedLogReader_t;
+
+// Validates the block at the start of 'in' and prepares 'reader' to decode it.
+// On success 'block_size' holds the number of bytes the block occupies.
+BinaryLogStatus_t compressedLogOpen(const uint8_t* in, size_t length, CompressedLogReader_t* reader, size_t* block_size);
+
+// Decodes the next record of the block into 'record'. It returns false once all records have been read.
+bool compressedLogNext(CompressedLogReader_t* reader, BinaryLogRecord_t* record);
@@ -0,0 +1,44 @@
+#include "decimator.h"
+
+
+// Starts a new window.
+static void resetWindow(Decimator_t* decimator) {
+  decimator->count = 0;
+  decimator->temperature_sum = 0.0;
+  decimator->pressure_sum = 0.0;
+  decimator->pressure_min = 0.0;
+  decimator->pressure_max = 0.0;
+}
+
+
+// Initializes the decimator.
+void decimatorInit(Decimator_t* decimator, uint16_t factor) {
+  decimator->factor = factor > 0 ? factor : 1;
+  decimator->pressure_range = 0.0;
+  resetWindow(decimator);
+}
+
+
+// Adds one reading to the current window and outputs the average once it is complete.
+// The sums stay well within float precision for the window lengths used here (at most a few hundred readings).
+bool decimatorAdd(Decimator_t* decimator, const SensorData_t* reading, SensorData_t* output) {
+  if (decimator->count == 0 || reading->pressure < decimator->pressure_min) {
+    decimator->pressure_min = reading->pressure;
+  }
+  if (decimator->count == 0 || reading->pressure > decimator->pressure_max) {
+    decimator->pressure_max = reading->pressure;
+  }
+  decimator->temperature_sum += reading->temperature;
+  decimator->pressure_sum += reading->pressure;
+  decimator->count++;
+
+  if (decimator->count < decimator->factor) {
+    return false;
+  }
+
+  output->temperature = decimator->temperature_sum / decimator->count;
+  output->pressure = decimator->pressure_sum / decimator->count;
+  decimator->pressure_range = decimator->pressure_max - decimator->pressure_min;
+  resetWindow(decimator);
+  return true;
+}
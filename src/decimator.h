@@ -0,0 +1,27 @@
+// Decimation stage for the high rate acquisition mode.
+// The sensor is read at a multiple of the output rate and every 'factor' readings are
+// averaged into one output sample. The average is a boxcar low-pass filter whose first
+// zero is at the output rate, so noise and short spikes above the output rate are
+// suppressed before the rate is reduced. The pressure range (max - min) of each output
+// window is kept so short transients that the average smooths out can still be detected.
+
+#pragma once
+
+#include <stdint.h>
+#include "sensor_utils.h"
+
+typedef struct {
+  uint16_t factor;          // Readings per output sample.
+  uint16_t count;           // Readings in the current window.
+  float temperature_sum;
+  float pressure_sum;
+  float pressure_min;
+  float pressure_max;
+  float pressure_range;     // Pressure range of the last completed window.
+} Decimator_t;
+
+// Initializes the decimator to output one sample every 'factor' readings.
+void decimatorInit(Decimator_t* decimator, uint16_t factor);
+
+// Adds one reading. Returns true and stores the average in 'output' when a window is complete.
+bool decimatorAdd(Decimator_t* decimator, const SensorData_t* reading, SensorData_t* output);
@@ -0,0 +1,87 @@
+#include "device_health.h"
+
+
+// Initializes the health of a device that has not been initialized yet.
+void deviceHealthInit(DeviceHealth_t* health, const char* name, uint32_t probe_interval_ms, uint32_t reinit_interval_ms) {
+  health->name = name;
+  health->transactions.store(0, std::memory_order_relaxed);
+  health->transaction_errors.store(0, std::memory_order_relaxed);
+  health->ok = false;
+  health->probe_interval_ms = probe_interval_ms;
+  health->reinit_interval_ms = reinit_interval_ms;
+  health->last_probe_ms = 0;
+  health->last_reinit_ms = 0;
+  health->seen_transactions = 0;
+  health->seen_errors = 0;
+  health->probes = 0;
+  health->probe_failures = 0;
+  health->probe_time_us_total = 0;
+  health->probe_time_us_max = 0;
+  health->reinits = 0;
+  health->reinit_failures = 0;
+}
+
+
+// A failed device is re-initialized right away the first time and then every reinit interval. Otherwise the device is probed if it reported errors since the last check,
+// or if it reported no transactions and was not probed within the probe interval.
+DeviceCheck_t deviceHealthCheck(DeviceHealth_t* health, uint32_t now_ms) {
+  if (!health->ok) {
+    if (health->reinits == 0 || now_ms - health->last_reinit_ms >= health->reinit_interval_ms) {
+      return DEVICE_CHECK_REINIT;
+    }
+    return DEVICE_CHECK_NONE;
+  }
+
+  uint32_t transactions = health->transactions.load(std::memory_order_relaxed);
+  uint32_t errors = health->transaction_errors.load(std::memory_order_relaxed);
+  bool active = transactions != health->seen_transactions;
+  bool failing = errors != health->seen_errors;
+  health->seen_transactions = transactions;
+  health->seen_errors = errors;
+
+  if (failing) {
+    return DEVICE_CHECK_PROBE;
+  }
+  if (active) {
+    // Error free traffic counts as a successful probe.
+    health->last_probe_ms = now_ms;
+    return DEVICE_CHECK_NONE;
+  }
+  if (now_ms - health->last_probe_ms >= health->probe_interval_ms) {
+    return DEVICE_CHECK_PROBE;
+  }
+  return DEVICE_CHECK_NONE;
+}
+
+
+// Records the result of a probe.
+void deviceHealthProbed(DeviceHealth_t* health, bool ok, uint32_t duration_us, uint32_t now_ms) {
+  health->probes++;
+  health->probe_time_us_total += duration_us;
+  if (duration_us > health->probe_time_us_max) {
+    health->probe_time_us_max = duration_us;
+  }
+  health->last_probe_ms = now_ms;
+
+  if (!ok) {
+    health->probe_failures++;
+    health->ok = false;
+  }
+}
+
+
+// Records the result of a re-initialization.
+// Errors reported while the device was failing are not held against it afterwards.
+void deviceHealthReinitialized(DeviceHealth_t* health, bool ok, uint32_t now_ms) {
+  health->reinits++;
+  health->last_reinit_ms = now_ms;
+  if (!ok) {
+    health->reinit_failures++;
+    return;
+  }
+
+  health->ok = true;
+  health->last_probe_ms = now_ms;
+  health->seen_transactions = health->transactions.load(std::memory_order_relaxed);
+  health->seen_errors = health->transaction_errors.load(std::memory_order_relaxed);
+}
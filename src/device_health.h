@@ -0,0 +1,65 @@
+// Health tracking for one hardware device (BMP280, SSD1306 or SD card).
+// The tasks that talk to a device report the outcome of their real transactions (passive counters),
+// so as long as a device is busy and error free the monitor does not have to touch it at all.
+// Only if a device was idle or reported errors since the last check the monitor sends a cheap probe
+// (a chip id read, an address ACK or a single sector read), and only a failed probe leads to the
+// expensive re-initialization of the device.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// What the monitor has to do for a device on this check.
+typedef enum {
+  DEVICE_CHECK_NONE,    // Recent error free traffic, the device is fine.
+  DEVICE_CHECK_PROBE,   // No traffic or errors since the last check, probe the device.
+  DEVICE_CHECK_REINIT   // The device failed (or was never initialized) and is due for a re-initialization.
+} DeviceCheck_t;
+
+typedef struct {
+  const char* name;
+
+  // Written by the tasks using the device (deviceHealthReport), read by the monitor.
+  std::atomic<uint32_t> transactions;
+  std::atomic<uint32_t> transaction_errors;
+
+  // Written by the monitor only.
+  bool ok;                          // False until the device is initialized and after a failed probe.
+  uint32_t probe_interval_ms;       // Minimum time between probes of an idle device.
+  uint32_t reinit_interval_ms;      // Minimum time between re-initializations of a failed device.
+  uint32_t last_probe_ms;
+  uint32_t last_reinit_ms;
+  uint32_t seen_transactions;       // Passive counters at the last check.
+  uint32_t seen_errors;
+
+  // Statistics.
+  uint32_t probes;
+  uint32_t probe_failures;
+  uint32_t probe_time_us_total;     // Time spent on probes, including waiting for the bus.
+  uint32_t probe_time_us_max;
+  uint32_t reinits;
+  uint32_t reinit_failures;
+} DeviceHealth_t;
+
+// Initializes the health of a device that has not been initialized yet.
+// An idle device is probed at most every 'probe_interval_ms' and a failed device is re-initialized
+// at most every 'reinit_interval_ms', so a missing device does not keep its bus busy.
+void deviceHealthInit(DeviceHealth_t* health, const char* name, uint32_t probe_interval_ms, uint32_t reinit_interval_ms);
+
+// Reports the outcome of a real transaction with the device. Can be called from any task.
+inline void deviceHealthReport(DeviceHealth_t* health, bool ok) {
+  health->transactions.fetch_add(1, std::memory_order_relaxed);
+  if (!ok) {
+    health->transaction_errors.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// Decides what the monitor has to do for the device at 'now_ms' based on the transactions reported since the last check.
+DeviceCheck_t deviceHealthCheck(DeviceHealth_t* health, uint32_t now_ms);
+
+// Records the result of a probe that took 'duration_us'. A failed probe marks the device as failed.
+void deviceHealthProbed(DeviceHealth_t* health, bool ok, uint32_t duration_us, uint32_t now_ms);
+
+// Records the result of a re-initialization.
+void deviceHealthReinitialized(DeviceHealth_t* health, bool ok, uint32_t now_ms);
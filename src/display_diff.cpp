@@ -0,0 +1,36 @@
+#include "display_diff.h"
+
+
+// Compares the framebuffer with the shadow copy of what the display currently shows, page by page.
+uint16_t displayDiff(const uint8_t* frame, const uint8_t* shadow, uint8_t width, uint8_t pages, DisplayDirtyPage_t* dirty) {
+  uint16_t bytes = 0;
+
+  for (uint8_t page = 0; page < pages; page++) {
+    const uint8_t* frame_page = frame + page * width;
+    const uint8_t* shadow_page = shadow + page * width;
+    DisplayDirtyPage_t* range = &dirty[page];
+    range->dirty = false;
+
+    // Find the first changed column.
+    uint8_t first = 0;
+    while (first < width && frame_page[first] == shadow_page[first]) {
+      first++;
+    }
+    if (first == width) {
+      continue;
+    }
+
+    // Find the last changed column.
+    uint8_t last = width - 1;
+    while (frame_page[last] == shadow_page[last]) {
+      last--;
+    }
+
+    range->dirty = true;
+    range->first_column = first;
+    range->last_column = last;
+    bytes += last - first + 1;
+  }
+
+  return bytes;
+}
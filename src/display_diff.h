@@ -0,0 +1,20 @@
+// Finds the parts of an SSD1306 framebuffer that changed since the last transfer.
+// The SSD1306 memory is organized in pages of 8 pixel rows, each page holding one byte per column,
+// which is also the layout of the Adafruit_SSD1306 buffer. For every page the range of
+// changed columns is reported, so only those bytes have to be sent over I2C.
+
+#pragma once
+
+#include <stdint.h>
+
+// Changed column range of one page.
+typedef struct {
+  bool dirty;
+  uint8_t first_column;
+  uint8_t last_column;
+} DisplayDirtyPage_t;
+
+// Compares 'frame' with 'shadow' (both 'width' * 'pages' bytes) and fills 'dirty' with one entry per page.
+// It returns the number of bytes that differ between the first and last changed column of every page,
+// i.e. the number of data bytes a partial refresh has to send (0 if nothing changed).
+uint16_t displayDiff(const uint8_t* frame, const uint8_t* shadow, uint8_t width, uint8_t pages, DisplayDirtyPage_t* dirty);
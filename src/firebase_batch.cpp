@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include "firebase_batch.h"
+
+
+// Empties the batch.
+void firebaseBatchReset(FirebaseBatch_t* batch) {
+  batch->json[0] = '{';
+  batch->json[1] = '\0';
+  batch->length = 1;
+  batch->windows = 0;
+  batch->first_window_ms = 0;
+}
+
+
+// Adds the averages of one window to the batch as three "path/value_name": value pairs.
+// It returns false if the batch is full.
+bool firebaseBatchAdd(FirebaseBatch_t* batch, const char* path, const SensorData_t* average, uint32_t now_ms) {
+  if (batch->windows == FIREBASE_BATCH_MAX_WINDOWS) {
+    return false;
+  }
+
+  size_t space = sizeof(batch->json) - batch->length;
+  int written = snprintf(batch->json + batch->length, space,
+                         "%s\"%s/temperature_c\":%.2f,\"%s/temperature_f\":%.2f,\"%s/pressure_hpa\":%.2f",
+                         batch->windows > 0 ? "," : "",
+                         path, average->temperature,
+                         path, toFahrenheit(average->temperature),
+                         path, average->pressure);
+
+  // Keep the batch unchanged if the window did not fit (only possible with an over long path).
+  if (written < 0 || (size_t)written >= space - 1) {
+    batch->json[batch->length] = '\0';
+    return false;
+  }
+
+  if (batch->windows == 0) {
+    batch->first_window_ms = now_ms;
+  }
+  batch->length += written;
+  batch->windows++;
+  return true;
+}
+
+
+// Adds a compressed log block to the empty batch as a base64 (RFC 4648) string.
+// A 512 byte block takes 684 characters, well below the size of a batch of plain windows.
+bool firebaseBatchAddBlock(FirebaseBatch_t* batch, const char* path, const uint8_t* block, size_t size, uint8_t windows, uint32_t now_ms) {
+  static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  size_t space = sizeof(batch->json) - batch->length;
+  int written = snprintf(batch->json + batch->length, space, "\"%s\":\"", path);
+  // Room for the base64 text, the closing quote and the closing brace.
+  if (batch->windows > 0 || written < 0 || (size_t)written + (size + 2) / 3 * 4 + 2 >= space) {
+    batch->json[batch->length] = '\0';
+    return false;
+  }
+
+  char* out = batch->json + batch->length + written;
+  for (size_t i = 0; i < size; i += 3) {
+    uint32_t group = (uint32_t)block[i] << 16;
+    if (i + 1 < size) {
+      group |= (uint32_t)block[i + 1] << 8;
+    }
+    if (i + 2 < size) {
+      group |= block[i + 2];
+    }
+    *out++ = BASE64[(group >> 18) & 0x3F];
+    *out++ = BASE64[(group >> 12) & 0x3F];
+    *out++ = i + 1 < size ? BASE64[(group >> 6) & 0x3F] : '=';
+    *out++ = i + 2 < size ? BASE64[group & 0x3F] : '=';
+  }
+  *out++ = '"';
+  *out = '\0';
+
+  batch->first_window_ms = now_ms;
+  batch->length = out - batch->json;
+  batch->windows = windows;
+  return true;
+}
+
+
+// Returns true if the batch should be sent now.
+bool firebaseBatchDue(const FirebaseBatch_t* batch, uint8_t max_windows, uint32_t max_delay_ms, uint32_t now_ms) {
+  if (batch->windows == 0) {
+    return false;
+  }
+  return batch->windows >= max_windows || now_ms - batch->first_window_ms >= max_delay_ms;
+}
+
+
+// Terminates the JSON object and returns it.
+// One byte is always kept free for the closing brace by firebaseBatchAdd.
+const char* firebaseBatchFinish(FirebaseBatch_t* batch) {
+  batch->json[batch->length++] = '}';
+  batch->json[batch->length] = '\0';
+  return batch->json;
+}
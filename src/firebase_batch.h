@@ -0,0 +1,50 @@
+// Builds the JSON body of a single Firebase Realtime Database multi-path update
+// that carries the averages of one or more windows, e.g.
+//
+//   {"2026/October/17/12_00_00/temperature_c":23.45,"2026/October/17/12_00_00/temperature_f":74.21,
+//    "2026/October/17/12_00_00/pressure_hpa":1013.25, ... next window ...}
+//
+// Sent as an update to the database root, this writes every window in one request
+// instead of one request per value.
+// Windows caught up from the queue can instead be sent as one base64 encoded compressed log block.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sensor_utils.h"
+
+// Maximum number of windows one batch can carry.
+static const uint8_t FIREBASE_BATCH_MAX_WINDOWS = 10;
+
+// Maximum length of the path of one window, e.g. "sensor3/2026/September/30/23_59_59".
+static const uint8_t FIREBASE_BATCH_PATH_SIZE = 38;
+
+// JSON size of one window: three keys of the path plus the value name, quotes, separators and values.
+static const uint16_t FIREBASE_BATCH_WINDOW_JSON_SIZE = 3 * (FIREBASE_BATCH_PATH_SIZE + 16 + 16);
+static const uint16_t FIREBASE_BATCH_JSON_SIZE = FIREBASE_BATCH_MAX_WINDOWS * FIREBASE_BATCH_WINDOW_JSON_SIZE + 2;
+
+typedef struct {
+  char json[FIREBASE_BATCH_JSON_SIZE];
+  size_t length;
+  uint8_t windows;            // Number of windows in the batch.
+  uint32_t first_window_ms;   // Time the first window was added, for the maximum batching delay.
+} FirebaseBatch_t;
+
+// Empties the batch.
+void firebaseBatchReset(FirebaseBatch_t* batch);
+
+// Adds the averages of one window stored under 'path' (without leading '/') to the batch.
+// It returns false if the batch is full.
+bool firebaseBatchAdd(FirebaseBatch_t* batch, const char* path, const SensorData_t* average, uint32_t now_ms);
+
+// Adds an encoded compressed log block (see compressed_log.h) carrying 'windows' windows as a single
+// "path":"<base64 of the block>" pair, which is how queued windows are caught up in FIREBASE_UPLOAD_COMPRESSED.
+// It returns false if the batch already holds windows or the block does not fit.
+bool firebaseBatchAddBlock(FirebaseBatch_t* batch, const char* path, const uint8_t* block, size_t size, uint8_t windows, uint32_t now_ms);
+
+// Returns true if the batch holds 'max_windows' windows or its oldest window has waited 'max_delay_ms'.
+bool firebaseBatchDue(const FirebaseBatch_t* batch, uint8_t max_windows, uint32_t max_delay_ms, uint32_t now_ms);
+
+// Terminates the JSON object and returns it. No windows can be added afterwards.
+const char* firebaseBatchFinish(FirebaseBatch_t* batch);
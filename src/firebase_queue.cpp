@@ -0,0 +1,313 @@
+#include "firebase_queue.h"
+
+// Record of the queue before the sensor ID was added.
+typedef struct {
+  uint32_t time;
+  SensorData_t data;
+} LegacyQueueRecord_t;
+
+// Records moved per step of the migration.
+static const uint8_t MIGRATION_CHUNK_RECORDS = 32;
+
+
+// Persists the read position of the queue in 'path'.
+static bool writePosition(const char* path, uint32_t head) {
+  File file = SD.open(path, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+  bool ok = file.write((const uint8_t*)&head, sizeof(head)) == sizeof(head);
+  file.close();
+  return ok;
+}
+
+
+// Copies up to 'max_count' records from byte offset 'offset' up to the tail into 'records'.
+static uint8_t readRecords(FirebaseQueue_t* queue, uint32_t offset, FirebaseQueueRecord_t* records, uint8_t max_count) {
+  if (!queue->loaded || offset >= queue->tail) {
+    return 0;
+  }
+
+  uint32_t available = (queue->tail - offset) / sizeof(FirebaseQueueRecord_t);
+  uint8_t count = available < max_count ? available : max_count;
+
+  File data = SD.open(FIREBASE_QUEUE_DATA_PATH, FILE_READ);
+  if (!data) {
+    queue->loaded = false;
+    return 0;
+  }
+  if (!data.seek(offset)) {
+    data.close();
+    return 0;
+  }
+  size_t read = data.read((uint8_t*)records, count * sizeof(FirebaseQueueRecord_t));
+  data.close();
+
+  return read / sizeof(FirebaseQueueRecord_t);
+}
+
+
+// Reads the time of the record at head to keep the age of the queue up to date.
+static void readOldestTime(FirebaseQueue_t* queue) {
+  FirebaseQueueRecord_t record;
+  queue->oldest_time = 0;
+  if (readRecords(queue, queue->head, &record, 1) == 1) {
+    queue->oldest_time = record.time;
+  }
+}
+
+
+// Reads the read position persisted in 'path', rounded down to a record of 'record_size' bytes. 0 if there is none.
+static bool readPosition(const char* path, size_t record_size, uint32_t* head) {
+  *head = 0;
+  if (!SD.exists(path)) {
+    return true;
+  }
+  File pos = SD.open(path, FILE_READ);
+  if (!pos) {
+    return false;
+  }
+  if (pos.read((uint8_t*)head, sizeof(*head)) == sizeof(*head)) {
+    *head -= *head % record_size;
+  }
+  else {
+    *head = 0;
+  }
+  pos.close();
+  return true;
+}
+
+
+// Appends the records of a queue in the older format that were not uploaded yet to the journal,
+// as windows of the first sensor, and deletes the old files.
+// The old read position is advanced after every chunk, so a reboot or a card error during the
+// migration resumes it without losing records. At most the chunk being written is appended twice.
+static bool migrateLegacyQueue(FirebaseQueue_t* queue) {
+  if (!SD.exists(FIREBASE_QUEUE_LEGACY_DATA_PATH)) {
+    return true;
+  }
+  uint32_t head;
+  if (!readPosition(FIREBASE_QUEUE_LEGACY_POS_PATH, sizeof(LegacyQueueRecord_t), &head)) {
+    return false;
+  }
+
+  while (true) {
+    LegacyQueueRecord_t legacy[MIGRATION_CHUNK_RECORDS];
+    File old_data = SD.open(FIREBASE_QUEUE_LEGACY_DATA_PATH, FILE_READ);
+    if (!old_data) {
+      return false;
+    }
+    size_t read = old_data.seek(head) ? old_data.read((uint8_t*)legacy, sizeof(legacy)) : 0;
+    old_data.close();
+    uint8_t count = read / sizeof(LegacyQueueRecord_t);
+    if (count == 0) {
+      break;
+    }
+
+    FirebaseQueueRecord_t records[MIGRATION_CHUNK_RECORDS];
+    memset(records, 0, sizeof(records));
+    for (uint8_t i = 0; i < count; i++) {
+      records[i].time = legacy[i].time;
+      records[i].data = legacy[i].data;
+    }
+    File data = SD.open(FIREBASE_QUEUE_DATA_PATH, FILE_APPEND);
+    if (!data) {
+      return false;
+    }
+    size_t length = count * sizeof(FirebaseQueueRecord_t);
+    size_t written = data.write((const uint8_t*)records, length);
+    data.close();
+    if (written != length) {
+      return false;
+    }
+
+    head += count * sizeof(LegacyQueueRecord_t);
+    queue->migrated += count;
+    if (!writePosition(FIREBASE_QUEUE_LEGACY_POS_PATH, head)) {
+      return false;
+    }
+  }
+
+  SD.remove(FIREBASE_QUEUE_LEGACY_DATA_PATH);
+  SD.remove(FIREBASE_QUEUE_LEGACY_POS_PATH);
+  return true;
+}
+
+
+// Reads the queue offsets from the card.
+// The tail is the size of the journal, the head is the persisted read position.
+// A position beyond the journal or not on a record boundary (e.g. a torn write) is corrected.
+bool firebaseQueueLoad(FirebaseQueue_t* queue) {
+  queue->loaded = false;
+  queue->head = 0;
+  queue->tail = 0;
+  queue->oldest_time = 0;
+
+  if (!migrateLegacyQueue(queue)) {
+    return false;
+  }
+
+  if (SD.exists(FIREBASE_QUEUE_DATA_PATH)) {
+    File data = SD.open(FIREBASE_QUEUE_DATA_PATH, FILE_READ);
+    if (!data) {
+      return false;
+    }
+    queue->tail = data.size() - data.size() % sizeof(FirebaseQueueRecord_t);
+    data.close();
+  }
+
+  if (!readPosition(FIREBASE_QUEUE_POS_PATH, sizeof(FirebaseQueueRecord_t), &queue->head)) {
+    return false;
+  }
+
+  if (queue->head > queue->tail) {
+    queue->head = queue->tail;
+  }
+
+  // Whatever was in flight is sent again.
+  queue->sent = queue->head;
+  queue->range_count = 0;
+
+  queue->loaded = true;
+  readOldestTime(queue);
+  return true;
+}
+
+
+// Appends records to the end of the journal.
+bool firebaseQueuePush(FirebaseQueue_t* queue, const FirebaseQueueRecord_t* records, uint8_t count) {
+  if (!queue->loaded && !firebaseQueueLoad(queue)) {
+    queue->dropped += count;
+    return false;
+  }
+
+  File data = SD.open(FIREBASE_QUEUE_DATA_PATH, FILE_APPEND);
+  if (!data) {
+    queue->dropped += count;
+    queue->loaded = false;
+    return false;
+  }
+
+  size_t length = count * sizeof(FirebaseQueueRecord_t);
+  size_t written = data.write((const uint8_t*)records, length);
+  data.close();
+
+  // A partial write leaves a torn record which is cut off by the next load.
+  if (written != length) {
+    queue->dropped += count;
+    queue->loaded = false;
+    return false;
+  }
+
+  if (queue->head == queue->tail) {
+    queue->oldest_time = records[0].time;
+  }
+  queue->tail += length;
+  queue->enqueued += count;
+  return true;
+}
+
+
+// Copies up to 'max_count' of the oldest records that were not sent yet into 'records'.
+uint8_t firebaseQueuePeek(FirebaseQueue_t* queue, FirebaseQueueRecord_t* records, uint8_t max_count) {
+  return readRecords(queue, queue->sent, records, max_count);
+}
+
+
+// Starts a range after the records in flight.
+bool firebaseQueueSent(FirebaseQueue_t* queue, uint8_t count, uint8_t requests, uint32_t* range_id) {
+  if (queue->range_count == FIREBASE_QUEUE_MAX_RANGES) {
+    return false;
+  }
+  uint32_t unsent = firebaseQueueUnsent(queue);
+  if (count > unsent) {
+    count = unsent;
+  }
+
+  // 0 is left for payloads that did not come from the queue.
+  if (++queue->last_range_id == 0) {
+    queue->last_range_id = 1;
+  }
+  FirebaseQueueRange_t* range = &queue->ranges[queue->range_count++];
+  range->id = queue->last_range_id;
+  range->end = queue->sent + count * sizeof(FirebaseQueueRecord_t);
+  range->pending = requests;
+  queue->sent = range->end;
+  *range_id = range->id;
+  return true;
+}
+
+
+// Returns the index of a range in flight, or range_count if it is not in flight.
+static uint8_t findRange(const FirebaseQueue_t* queue, uint32_t range_id) {
+  uint8_t index = 0;
+  while (index < queue->range_count && queue->ranges[index].id != range_id) {
+    index++;
+  }
+  return index;
+}
+
+
+// Counts down the requests of the range.
+void firebaseQueueAcked(FirebaseQueue_t* queue, uint32_t range_id) {
+  uint8_t index = findRange(queue, range_id);
+  if (index < queue->range_count && queue->ranges[index].pending > 0) {
+    queue->ranges[index].pending--;
+  }
+}
+
+
+// Moves the send position back to the start of the range and forgets the ranges from there on.
+// Their requests may still be acknowledged, which is ignored, and their records are sent again.
+void firebaseQueueResend(FirebaseQueue_t* queue, uint32_t range_id) {
+  uint8_t index = findRange(queue, range_id);
+  if (index == queue->range_count) {
+    return;
+  }
+  queue->sent = index == 0 ? queue->head : queue->ranges[index - 1].end;
+  queue->range_count = index;
+}
+
+
+// Removes the records of the acknowledged ranges at the front, they are always the oldest records.
+bool firebaseQueueRemoveAcked(FirebaseQueue_t* queue) {
+  if (!queue->loaded || queue->range_count == 0 || queue->ranges[0].pending > 0) {
+    return true;
+  }
+
+  uint8_t done = 0;
+  while (done < queue->range_count && queue->ranges[done].pending == 0) {
+    done++;
+  }
+  uint32_t end = queue->ranges[done - 1].end;
+  queue->drained += (end - queue->head) / sizeof(FirebaseQueueRecord_t);
+  queue->head = end;
+  memmove(queue->ranges, queue->ranges + done, (queue->range_count - done) * sizeof(FirebaseQueueRange_t));
+  queue->range_count -= done;
+
+  // The queue is empty, start over with fresh journal files.
+  if (queue->head == queue->tail) {
+    SD.remove(FIREBASE_QUEUE_DATA_PATH);
+    SD.remove(FIREBASE_QUEUE_POS_PATH);
+    queue->head = 0;
+    queue->sent = 0;
+    queue->tail = 0;
+    queue->oldest_time = 0;
+    return true;
+  }
+
+  readOldestTime(queue);
+  return writePosition(FIREBASE_QUEUE_POS_PATH, queue->head);
+}
+
+
+// Returns the number of records in the queue.
+uint32_t firebaseQueueDepth(const FirebaseQueue_t* queue) {
+  return (queue->tail - queue->head) / sizeof(FirebaseQueueRecord_t);
+}
+
+
+// Returns the number of records not sent yet.
+uint32_t firebaseQueueUnsent(const FirebaseQueue_t* queue) {
+  return (queue->tail - queue->sent) / sizeof(FirebaseQueueRecord_t);
+}
@@ -0,0 +1,95 @@
+// Store and forward queue for Firebase uploads, journaled to the SD card.
+// Windows that could not be uploaded are appended to FIREBASE_QUEUE_DATA_PATH as fixed size records
+// and the read position is kept in FIREBASE_QUEUE_POS_PATH, so the queue survives reboots.
+// Only the head/tail offsets live in RAM, the queued windows themselves stay on the card,
+// so an outage of any length costs no memory.
+// Records that were sent stay in the queue until every request carrying them is acknowledged, so a
+// reboot or a failed request while they are in flight sends them again instead of losing them.
+// The database writes every window to a path of its own, so a window sent twice is stored once.
+// None of these functions take the spi_mutex, the caller must hold it unless noted otherwise.
+
+#pragma once
+
+#include <Arduino.h>
+#include "FS.h"
+#include "SD.h"
+#include "sensor_utils.h"
+
+// The records gained the sensor ID when several sensors were supported. A queue of the older 12 byte
+// records ({time, data}, all of the first sensor) is moved into the new files when the queue is loaded.
+static const char* const FIREBASE_QUEUE_DATA_PATH = "/firebase_queue2.dat";
+static const char* const FIREBASE_QUEUE_POS_PATH = "/firebase_queue2.pos";
+static const char* const FIREBASE_QUEUE_LEGACY_DATA_PATH = "/firebase_queue.dat";
+static const char* const FIREBASE_QUEUE_LEGACY_POS_PATH = "/firebase_queue.pos";
+
+// Ranges of sent records that can wait for their acknowledgement at the same time,
+// at least the number of requests in flight (see upload_pipeline.h).
+static const uint8_t FIREBASE_QUEUE_MAX_RANGES = 4;
+
+// One queued window.
+typedef struct {
+  uint32_t time;        // Seconds since 1970-01-01 UTC the window was completed.
+  SensorData_t data;    // Averages of the window.
+  uint8_t sensor_id;    // Sensor the window was taken from.
+  uint8_t reserved[3];  // Written as 0, makes the padding of the record on the card explicit.
+} FirebaseQueueRecord_t;
+
+// Records sent together, in one or more requests.
+typedef struct {
+  uint32_t id;
+  uint32_t end;         // Byte offset after the last record of the range.
+  uint8_t pending;      // Requests not acknowledged yet.
+} FirebaseQueueRange_t;
+
+typedef struct {
+  bool loaded;          // Offsets have been read from the card.
+  uint32_t head;        // Byte offset of the oldest record not acknowledged yet.
+  uint32_t sent;        // Byte offset after the newest record sent, the records from head to here are in flight.
+  uint32_t tail;        // Byte offset after the newest record.
+  uint32_t oldest_time; // Time of the record at head, 0 if the queue is empty.
+
+  // Ranges in flight, oldest first. They are kept in RAM only, after a reboot every record is unsent again.
+  FirebaseQueueRange_t ranges[FIREBASE_QUEUE_MAX_RANGES];
+  uint8_t range_count;
+  uint32_t last_range_id;
+
+  // Statistics.
+  uint32_t enqueued;    // Windows written to the queue.
+  uint32_t drained;     // Windows removed from the queue once their upload was acknowledged.
+  uint32_t dropped;     // Windows lost because the card could not be written.
+  uint32_t migrated;    // Windows moved over from a queue of the older record format.
+} FirebaseQueue_t;
+
+// Reads the queue offsets from the card, after moving the records of a queue in the older format
+// to the end of the queue. Safe to call again after a card error.
+bool firebaseQueueLoad(FirebaseQueue_t* queue);
+
+// Appends 'count' records to the end of the queue. The records are dropped and counted if this fails.
+bool firebaseQueuePush(FirebaseQueue_t* queue, const FirebaseQueueRecord_t* records, uint8_t count);
+
+// Copies up to 'max_count' of the oldest records that were not sent yet into 'records'.
+// It returns the number of records copied.
+uint8_t firebaseQueuePeek(FirebaseQueue_t* queue, FirebaseQueueRecord_t* records, uint8_t max_count);
+
+// Marks the next 'count' records returned by firebaseQueuePeek as sent in 'requests' requests and returns the ID
+// of the range in 'range_id' (never 0). It returns false if FIREBASE_QUEUE_MAX_RANGES ranges are already in flight.
+// Only changes the RAM state, the spi_mutex is not needed.
+bool firebaseQueueSent(FirebaseQueue_t* queue, uint8_t count, uint8_t requests, uint32_t* range_id);
+
+// Records the acknowledgement of one request of a range. Acknowledgements of a range that is no longer in flight
+// are ignored. Only changes the RAM state, the records are removed by firebaseQueueRemoveAcked.
+void firebaseQueueAcked(FirebaseQueue_t* queue, uint32_t range_id);
+
+// A request of a range failed: the range and every range sent after it are taken back, so their records
+// are returned by firebaseQueuePeek again. Only changes the RAM state, the spi_mutex is not needed.
+void firebaseQueueResend(FirebaseQueue_t* queue, uint32_t range_id);
+
+// Removes the records of the oldest ranges whose requests were all acknowledged and persists the new read position.
+// When the queue becomes empty the journal files are deleted so they don't grow forever.
+bool firebaseQueueRemoveAcked(FirebaseQueue_t* queue);
+
+// Returns the number of records in the queue, including the ones in flight.
+uint32_t firebaseQueueDepth(const FirebaseQueue_t* queue);
+
+// Returns the number of records in the queue that were not sent yet.
+uint32_t firebaseQueueUnsent(const FirebaseQueue_t* queue);
@@ -0,0 +1,64 @@
+#include "heap_watch.h"
+
+
+// Initializes the watch without a baseline.
+void heapWatchInit(HeapWatch_t* watch, uint32_t tolerance) {
+  watch->started = false;
+  watch->baseline_free = 0;
+  watch->baseline_min_free = 0;
+  watch->tolerance = tolerance;
+  watch->free = 0;
+  watch->min_free = 0;
+  watch->largest_block = 0;
+  watch->samples = 0;
+  watch->min_largest_block = 0;
+  watch->growth_events = 0;
+  watch->reported_min_free = 0;
+}
+
+
+// Sets the baseline.
+void heapWatchStart(HeapWatch_t* watch, uint32_t free, uint32_t min_free, uint32_t largest_block) {
+  watch->started = true;
+  watch->baseline_free = free;
+  watch->baseline_min_free = min_free;
+  watch->reported_min_free = min_free;
+  watch->free = free;
+  watch->min_free = min_free;
+  watch->largest_block = largest_block;
+  watch->samples = 0;
+  watch->min_largest_block = largest_block;
+  watch->growth_events = 0;
+}
+
+
+// Only a new low of the low water mark counts, so a footprint that grew once is not reported on every sample.
+bool heapWatchSample(HeapWatch_t* watch, uint32_t free, uint32_t min_free, uint32_t largest_block) {
+  watch->free = free;
+  watch->min_free = min_free;
+  watch->largest_block = largest_block;
+  if (!watch->started) {
+    return false;
+  }
+
+  watch->samples++;
+  if (largest_block < watch->min_largest_block) {
+    watch->min_largest_block = largest_block;
+  }
+
+  if (min_free + watch->tolerance < watch->baseline_min_free && min_free < watch->reported_min_free) {
+    watch->reported_min_free = min_free;
+    watch->growth_events++;
+    return true;
+  }
+  return false;
+}
+
+
+// Returns how far the lowest free heap has fallen below the baseline.
+uint32_t heapWatchGrowth(const HeapWatch_t* watch) {
+  if (!watch->started || watch->min_free >= watch->baseline_min_free) {
+    return 0;
+  }
+  return watch->baseline_min_free - watch->min_free;
+}
@@ -0,0 +1,40 @@
+// Tracks the heap footprint after startup to show that it stays flat over long uptimes.
+// Once everything that allocates at startup has run (tasks, drivers, the network and TLS stacks),
+// the monitor sets a baseline. From then on every sample records the free heap, the lowest free heap
+// since boot and the largest free block (which shrinks when the heap fragments). A low water mark
+// that falls more than a tolerance below the baseline means something keeps allocating after startup.
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+  bool started;                 // The baseline has been set.
+  uint32_t baseline_free;       // Free heap when the baseline was set.
+  uint32_t baseline_min_free;   // Lowest free heap since boot when the baseline was set.
+  uint32_t tolerance;           // Growth below baseline_min_free that is still accepted, in bytes.
+
+  // Last sample.
+  uint32_t free;
+  uint32_t min_free;
+  uint32_t largest_block;
+
+  // Statistics since the baseline.
+  uint32_t samples;
+  uint32_t min_largest_block;   // Smallest largest free block seen, a measure of fragmentation.
+  uint32_t growth_events;       // Samples whose low water mark was a new low beyond the tolerance.
+  uint32_t reported_min_free;   // Low water mark of the last growth event, so each new low is reported once.
+} HeapWatch_t;
+
+// Initializes the watch without a baseline. Samples before heapWatchStart are only recorded.
+void heapWatchInit(HeapWatch_t* watch, uint32_t tolerance);
+
+// Sets the baseline from the current free heap, the lowest free heap since boot and the largest free block.
+void heapWatchStart(HeapWatch_t* watch, uint32_t free, uint32_t min_free, uint32_t largest_block);
+
+// Records a sample. It returns true if the lowest free heap since boot reached a new low more than
+// 'tolerance' bytes below the baseline, i.e. the heap footprint grew after startup.
+bool heapWatchSample(HeapWatch_t* watch, uint32_t free, uint32_t min_free, uint32_t largest_block);
+
+// Returns how far the lowest free heap has fallen below the baseline in bytes (0 if it has not).
+uint32_t heapWatchGrowth(const HeapWatch_t* watch);
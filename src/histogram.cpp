@@ -0,0 +1,64 @@
+#include "histogram.h"
+
+
+// Returns the bucket of a value: the index of its highest set bit.
+static uint8_t bucketOf(uint32_t value) {
+  uint8_t bucket = value == 0 ? 0 : 31 - __builtin_clz(value);
+  return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+
+// Clears the histogram.
+void histogramReset(Histogram_t* histogram) {
+  for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    histogram->buckets[i] = 0;
+  }
+  histogram->count = 0;
+  histogram->min = 0;
+  histogram->max = 0;
+  histogram->sum = 0;
+}
+
+
+// Adds one value.
+void histogramAdd(Histogram_t* histogram, uint32_t value) {
+  histogram->buckets[bucketOf(value)]++;
+  if (histogram->count == 0 || value < histogram->min) {
+    histogram->min = value;
+  }
+  if (value > histogram->max) {
+    histogram->max = value;
+  }
+  histogram->count++;
+  histogram->sum += value;
+}
+
+
+// Returns the mean of the values added so far.
+uint32_t histogramMean(const Histogram_t* histogram) {
+  return histogram->count > 0 ? histogram->sum / histogram->count : 0;
+}
+
+
+// Walks the buckets until 'percent' of the values are covered and returns the upper limit of that bucket.
+uint32_t histogramPercentile(const Histogram_t* histogram, float percent) {
+  if (histogram->count == 0) {
+    return 0;
+  }
+
+  uint32_t target = (uint32_t)(histogram->count * percent / 100.0f + 0.5f);
+  if (target == 0) {
+    target = 1;
+  }
+
+  uint32_t covered = 0;
+  for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    covered += histogram->buckets[i];
+    if (covered >= target) {
+      // The last bucket also holds every larger value.
+      uint32_t limit = i == HISTOGRAM_BUCKETS - 1 ? histogram->max : (2u << i) - 1;
+      return limit < histogram->max ? limit : histogram->max;
+    }
+  }
+  return histogram->max;
+}
@@ -0,0 +1,31 @@
+// Fixed size histogram of durations with power of two buckets.
+// Bucket i counts the values whose highest set bit is bit i (bucket 0 also holds 0),
+// so 24 buckets cover 0 us up to 16 s with a constant relative resolution and
+// adding a value costs a single bit scan.
+
+#pragma once
+
+#include <stdint.h>
+
+static const uint8_t HISTOGRAM_BUCKETS = 24;
+
+typedef struct {
+  uint32_t buckets[HISTOGRAM_BUCKETS];
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+} Histogram_t;
+
+// Clears the histogram.
+void histogramReset(Histogram_t* histogram);
+
+// Adds one value. Values beyond the last bucket are counted in the last bucket.
+void histogramAdd(Histogram_t* histogram, uint32_t value);
+
+// Returns the mean of the values added so far (0 if there are none).
+uint32_t histogramMean(const Histogram_t* histogram);
+
+// Returns an upper bound of the 'percent' percentile (e.g. 99.0), which is the upper limit
+// of the bucket holding it but never more than the maximum value (0 if there are no values).
+uint32_t histogramPercentile(const Histogram_t* histogram, float percent);
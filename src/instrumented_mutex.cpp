@@ -0,0 +1,30 @@
+#include "instrumented_mutex.h"
+
+
+// Creates the mutex in its own buffer.
+bool mutexCreate(InstrumentedMutex_t* mutex, const char* name) {
+  mutexStatsInit(&mutex->stats, name);
+  mutex->handle = xSemaphoreCreateMutexStatic(&mutex->buffer);
+  return mutex->handle != NULL;
+}
+
+
+// Takes the mutex and records how long it took and which task holds it now.
+bool mutexTake(InstrumentedMutex_t* mutex, uint32_t timeout_ms) {
+  uint32_t request_us = micros();
+  if (xSemaphoreTake(mutex->handle, timeout_ms / portTICK_PERIOD_MS) != pdTRUE) {
+    mutexStatsTimedOut(&mutex->stats);
+    return false;
+  }
+
+  uint32_t now_us = micros();
+  mutexStatsAcquired(&mutex->stats, pcTaskGetName(NULL), now_us - request_us, now_us);
+  return true;
+}
+
+
+// Records the hold time and gives back the mutex.
+void mutexGive(InstrumentedMutex_t* mutex) {
+  mutexStatsReleased(&mutex->stats, micros());
+  xSemaphoreGive(mutex->handle);
+}
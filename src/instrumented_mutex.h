@@ -0,0 +1,23 @@
+// FreeRTOS mutex that records its contention statistics (see mutex_stats.h).
+// Every task takes the shared bus mutexes through mutexTake / mutexGive so the statistics
+// show where time is lost waiting for a bus and which task was holding it when a wait timed out.
+
+#pragma once
+
+#include <Arduino.h>
+#include "mutex_stats.h"
+
+typedef struct {
+  SemaphoreHandle_t handle;
+  StaticSemaphore_t buffer;   // The mutex itself, so creating it does not use the heap.
+  MutexStats_t stats;
+} InstrumentedMutex_t;
+
+// Creates the mutex in 'mutex->buffer'.
+bool mutexCreate(InstrumentedMutex_t* mutex, const char* name);
+
+// Takes the mutex, waiting at most 'timeout_ms'. Returns false if it timed out.
+bool mutexTake(InstrumentedMutex_t* mutex, uint32_t timeout_ms);
+
+// Gives back the mutex taken with mutexTake.
+void mutexGive(InstrumentedMutex_t* mutex);
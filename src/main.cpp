@@ -1,19 +1,30 @@
-// Note: You might see a "Wire.cpp" I2C error in the serial monitor
-// if sensor or dipslay is disconnected while the system is running.
-// This is due to the detection latency between the hardware check (5 seconds) 
-// and the sensor read (1 second). 
-// This can easily be solved by setting "HARDWARE_CHECK_INTERVAL_MS" to *1000*
-// But at the cost of performance becasue the hardware check will run every second.
+// Note: You might still see a single "Wire.cpp" I2C error in the serial monitor
+// if sensor or display is disconnected while the system is running.
+// The failed transaction is reported to the hardware check (see device_health.h),
+// which probes the device within HARDWARE_CHECK_INTERVAL_MS. The tasks keep running and only pause
+// the work that needs the missing device.
 // The error is completely harmless and can be ignored.
-// That is why I have set the hardware check interval to 5 seconds.
+// Devices are only re-initialized after a probe failed, so the check can run every second
+// without costing more bus time than the old full re-initialization every 5 seconds.
 
 #define ENABLE_USER_AUTH
 #define ENABLE_DATABASE
 
+// With STATIC_ALLOCATION the task stacks and control blocks are static buffers instead of heap blocks.
+// Build with -D STATIC_ALLOCATION=0 to let FreeRTOS allocate the tasks from the heap instead.
+#ifndef STATIC_ALLOCATION
+#define STATIC_ALLOCATION 1
+#endif
+
+// The heap footprint is watched after startup (see heap_watch.h) and growth is reported and counted.
+// With STATIC_ALLOCATION nothing of the firmware itself allocates after startup, so by default any growth
+// also trips an assertion. Build with -D HEAP_GROWTH_ASSERT=0 to only report it.
+#ifndef HEAP_GROWTH_ASSERT
+#define HEAP_GROWTH_ASSERT STATIC_ALLOCATION
+#endif
+
 #include <Arduino.h>
 #include <Wire.h>
-#include <Adafruit_Sensor.h>
-#include <Adafruit_BMP280.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #include <time.h>
@@ -22,6 +33,29 @@
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
 #include <FirebaseClient.h>
+#include "sensor_utils.h"
+#include "sample_seqlock.h"
+#include "sample_ring.h"
+#include "stream_stats.h"
+#include "sd_log_writer.h"
+#include "sd_log_reader.h"
+#include "binary_log.h"
+#include "compressed_log.h"
+#include "firebase_batch.h"
+#include "firebase_queue.h"
+#include "display_diff.h"
+#include "bmp280_driver.h"
+#include "device_health.h"
+#include "window_backlog.h"
+#include "window_journal.h"
+#include "task_profile.h"
+#include "instrumented_mutex.h"
+#include "decimator.h"
+#include "rollup_store.h"
+#include "wifi_link.h"
+#include "upload_pipeline.h"
+#include "heap_watch.h"
+#include "sensor_registry.h"
 
 // Macro to convert milliseconds to FreeRTOS ticks.
 // Used this to make code more generic and usable
@@ -44,12 +78,13 @@ static const int BAUD_RATE = 115200;
 // Define the GPIO pins used for I2C and SPI communication
 static const uint8_t MY_SDA = 21;
 static const uint8_t MY_SCL = 22;
+static const uint8_t MY_SDA1 = 25;  // Second I2C bus, only started if a sensor is configured on it (see SENSORS).
+static const uint8_t MY_SCL1 = 26;
 static const uint8_t SD_CS = 5;
 static const uint8_t LED = LED_BUILTIN;
 
 // Display and sensor configuration constants.
 static const uint8_t SCREEN_ADDRESS = 0x3C; // I2C address for the SSD1306 display. Can also be 0x3D for some displays.
-static const uint8_t SENSOR_ADDRESS = 0x76; // I2C address for the BMP280 sensor. Can also be 0x77 for some sensors.
 static const uint8_t SCREEN_WIDTH = 128;
 static const uint8_t SCREEN_HEIGHT = 64;
 static const int8_t OLED_RESET = -1; // Reset pin (-1 if sharing Arduino reset pin)
@@ -57,32 +92,239 @@ static const uint8_t DISPLAY_CURSOR_X = 0;
 static const uint8_t DISPLAY_CURSOR_Y = 0;
 static const uint8_t DISPLAY_TEXT_SIZE = 2;
 static const uint16_t DISPLAY_TEXT_COLOR = SSD1306_WHITE;
+static const uint8_t DISPLAY_LINE_SIZE = 16;
+static const uint8_t DISPLAY_LINES = 4;  // Title or pressure trend, Celsius, Fahrenheit and hPa lines.
+static const uint8_t DISPLAY_SENSOR_FRAMES = 3;  // With several SENSORS each one is shown for this many frames in turn.
+static const uint8_t DISPLAY_PAGES = SCREEN_HEIGHT / 8;  // The SSD1306 stores 8 pixel rows per page.
+static const uint16_t DISPLAY_FRAME_SIZE = SCREEN_WIDTH * DISPLAY_PAGES;
+
+// I2C settings for the partial display refresh.
+// The ESP32 Wire buffer holds 128 bytes, one of which is the SSD1306 data control byte.
+// The clocks match the ones Adafruit_SSD1306 uses during and after its own transfers.
+static const uint8_t DISPLAY_I2C_CHUNK_SIZE = 127;
+static const uint32_t DISPLAY_I2C_CLOCK_HZ = 400000;
+static const uint32_t I2C_CLOCK_HZ = 100000;
+// Bytes (excluding address bytes) display.display() sends for a full frame:
+// the addressing command list, the column end command and the data in chunks with a control byte each.
+static const uint16_t DISPLAY_FULL_FRAME_I2C_BYTES = 6 + 2 + DISPLAY_FRAME_SIZE + (DISPLAY_FRAME_SIZE + DISPLAY_I2C_CHUNK_SIZE - 1) / DISPLAY_I2C_CHUNK_SIZE;
+
+// BMP280 measurement settings of the low power mode.
+// Forced mode lets the sensor sleep between readings, the oversampling matches the datasheet
+// "weather monitoring" profile with more pressure oversampling since the IIR filter is off.
+// One measurement takes bmp280MeasurementTimeMs(&SENSOR_LOW_POWER_CONFIG) = 43 ms with these settings.
+static const Bmp280Config_t SENSOR_LOW_POWER_CONFIG = {
+  BMP280_OVERSAMPLING_X2,   // Temperature oversampling.
+  BMP280_OVERSAMPLING_X16,  // Pressure oversampling.
+  BMP280_FILTER_OFF,
+  BMP280_STANDBY_0_5_MS,    // Unused in forced mode.
+  BMP280_MODE_FORCED
+};
+
+// BMP280 measurement settings of the high rate mode.
+// Normal mode measures continuously, one measurement takes 14 ms (1.25 + 2.3 + 4 * 2.3 + 0.575 ms)
+// plus 0.5 ms standby, so a new result is ready about every 14 ms (~70 Hz). The IIR filter is off
+// so short pressure transients are not smoothed before the decimation stage sees them.
+static const Bmp280Config_t SENSOR_HIGH_RATE_CONFIG = {
+  BMP280_OVERSAMPLING_X1,   // Temperature oversampling.
+  BMP280_OVERSAMPLING_X4,   // Pressure oversampling.
+  BMP280_FILTER_OFF,
+  BMP280_STANDBY_0_5_MS,
+  BMP280_MODE_NORMAL
+};
 
 // Define the intervals for various tasks in milliseconds.
-static const int WIFI_CONNECT_INTERVAL_MS = 500;
-static const int SENSOR_READ_INTERVAL_MS = 1000;
+static const int SENSOR_READ_INTERVAL_MS = 1000;       // Interval of the samples published to the consumers.
 static const int SERIAL_READ_INTERVAL_MS = 100;
 static const int DISPLAY_UPDATE_INTERVAL_MS = 1000;
-static const int SDCARD_SAMPLE_INTERVAL_MS = 1000; 
-static const int FIREBASE_SAMPLE_INTERVAL_MS = 1000; 
 static const int NO_ERROR_LED_INTERVAL_MS = 2500;
 static const int HW_ERROR_LED_INTERVAL_MS = 500;
-static const int HARDWARE_CHECK_INTERVAL_MS = 5000;
+static const int HARDWARE_CHECK_INTERVAL_MS = 1000;    // How often the device health is checked while running.
+static const int HARDWARE_REINIT_INTERVAL_MS = 5000;   // How often failed devices are re-initialized.
+static const int SD_CARD_PROBE_INTERVAL_MS = 5000;     // Minimum time between sector read probes of an idle SD card.
+static const int LED_ON_MS = 100;
+static const int SYSTEM_MONITOR_INTERVAL_MS = 100;
+static const int WIFI_STATUS_INTERVAL_MS = 500;        // How often the connection and time synchronization are checked.
+static const uint32_t WIFI_CONNECT_TIMEOUT_MS = 10000;  // Time a connection attempt may take before it is retried.
+static const uint32_t WIFI_BACKOFF_MIN_MS = 1000;       // Delay before retrying a lost link, doubled after every failed attempt
+static const uint32_t WIFI_BACKOFF_MAX_MS = 60000;      // up to this delay. Half of the delay is random (see wifi_link.h).
+static const int SDCARD_FLUSH_INTERVAL_MS = 300000;  // Maximum time a log record may wait in RAM before it is written to the SD card.
+
+// The display shows the pressure trend in hPa per hour once this many 1 minute rollups exist,
+// computed over at most the last PRESSURE_TREND_MAX_MINUTES minutes (see rollup_store.h).
+static const uint16_t PRESSURE_TREND_MIN_MINUTES = 10;
+static const uint16_t PRESSURE_TREND_MAX_MINUTES = 60;
+
+// Sensor acquisition mode.
+// LOW_POWER triggers one forced measurement every SENSOR_READ_INTERVAL_MS.
+// HIGH_RATE runs the BMP280 in normal mode and reads it SENSOR_HIGH_RATE_HZ times per second.
+// The readings are averaged down to one sample every SENSOR_READ_INTERVAL_MS (see decimator.h),
+// so the consumers receive the same rate in both modes. Windows whose pressure range exceeds
+// PRESSURE_TRANSIENT_HPA are reported as transients. SENSOR_HIGH_RATE_HZ must be at most 70
+// with SENSOR_HIGH_RATE_CONFIG and divide 1000 / SENSOR_READ_INTERVAL_MS evenly.
+typedef enum {SENSOR_MODE_LOW_POWER, SENSOR_MODE_HIGH_RATE} SensorMode_t;
+static const SensorMode_t SENSOR_MODE = SENSOR_MODE_LOW_POWER;
+static const uint16_t SENSOR_HIGH_RATE_HZ = 50;
+static const float PRESSURE_TRANSIENT_HPA = 0.3;
+static const Bmp280Config_t* const SENSOR_CONFIG = SENSOR_MODE == SENSOR_MODE_HIGH_RATE ? &SENSOR_HIGH_RATE_CONFIG : &SENSOR_LOW_POWER_CONFIG;
+static const int SENSOR_SAMPLE_INTERVAL_MS = SENSOR_MODE == SENSOR_MODE_HIGH_RATE ? 1000 / SENSOR_HIGH_RATE_HZ : SENSOR_READ_INTERVAL_MS;
+static const uint16_t SENSOR_DECIMATION = SENSOR_READ_INTERVAL_MS / SENSOR_SAMPLE_INTERVAL_MS;
+static const int SENSOR_STATS_INTERVAL_MS = 60000;
+
+// The BMP280 sensors, all read in the configured SENSOR_MODE. The index in this table is the sensor ID
+// carried by every sample, SD card record and Firebase window (see sensor_registry.h).
+// A BMP280 is at 0x76 or 0x77 depending on its SDO pin, so one bus takes two sensors and the second bus
+// (Wire1 on MY_SDA1 / MY_SCL1) two more. 'read_interval_ms' must be a multiple of SENSOR_SAMPLE_INTERVAL_MS,
+// a sensor read less often publishes its samples (and completes its windows) less often.
+// The history, the "History" command and the pressure trend on the display follow SENSOR_PRIMARY.
+typedef struct {
+  const char* name;           // Shown in the device health and the serial messages.
+  uint8_t bus;                // Index into I2C_BUSES.
+  uint8_t address;
+  uint32_t read_interval_ms;
+} SensorInfo_t;
+
+static constexpr SensorInfo_t SENSORS[] = {
+  {"BMP280-0", 0, 0x76, SENSOR_SAMPLE_INTERVAL_MS},
+  // {"BMP280-1", 0, 0x77, SENSOR_SAMPLE_INTERVAL_MS},
+  // {"BMP280-2", 1, 0x76, SENSOR_SAMPLE_INTERVAL_MS},
+};
+static const uint8_t SENSOR_COUNT = sizeof(SENSORS) / sizeof(SENSORS[0]);
+static const uint8_t SENSOR_PRIMARY = 0;
+static const uint8_t SENSOR_ALL = (1 << SENSOR_COUNT) - 1;   // Mask of every sensor ID.
+static_assert(SENSOR_COUNT <= SENSOR_REGISTRY_SIZE, "Too many SENSORS for the sensor registry");
 
 // How long a task will wait in Milliseconds to acquire a mutex before giving up.
-static const int SENSOR_MUTEX_WAIT_MS = 10;
 static const int I2C_MUTEX_WAIT_MS = 100;
 static const int SPI_MUTEX_WAIT_MS = 100;
+// A mutex held for longer than this is reported by the systemMonitor as a possible leak.
+static const uint32_t MUTEX_LEAK_WARNING_MS = 2000;
+
+// Number of samples to average for SD card and Firebase uploads.
+// Samples are aggregated in constant memory so these windows are not limited in length.
+static const uint32_t MAX_SDCARD_SAMPLES = 30;    // Number of samples to average for one SD card log.
+static const uint32_t MAX_FIREBASE_SAMPLES = 60;  // Number of samples to average for one Firebase upload.
+
+// Returns the shortest 'read_interval_ms' of the SENSORS from 'id' on.
+constexpr uint32_t shortestReadInterval(uint8_t id = 0) {
+  return id + 1 >= SENSOR_COUNT ? SENSORS[id].read_interval_ms
+         : SENSORS[id].read_interval_ms < shortestReadInterval(id + 1) ? SENSORS[id].read_interval_ms
+         : shortestReadInterval(id + 1);
+}
 
-// Maximum number of samples to average for SD card and Firebase uploads.
-static const uint8_t MAX_SDCARD_SAMPLES = 30;    // Number of samples to average for one SD card log.
-static const uint8_t MAX_FIREBASE_SAMPLES = 60;  // Number of samples to average for one Firebase upload.
+// Time between two windows logged by the sensor read most often. A window is MAX_SDCARD_SAMPLES samples
+// of SENSOR_DECIMATION reads each.
+static const uint32_t SD_LOG_WINDOW_INTERVAL_MS = MAX_SDCARD_SAMPLES * SENSOR_DECIMATION * shortestReadInterval();
+
+// How far records of different sensors can be out of time order in the binary SD card formats, in seconds:
+// a block is written at the first window logged after it is SDCARD_FLUSH_INTERVAL_MS old (see logBinaryToSdCard),
+// so it stays open for less than SDCARD_FLUSH_INTERVAL_MS plus the time to the next window of any sensor.
+// querySdLog widens its range by this much, so it must cover that whole time rounded up to a second.
+static const uint32_t SD_LOG_SENSOR_REORDER_S = (SDCARD_FLUSH_INTERVAL_MS + SD_LOG_WINDOW_INTERVAL_MS + 999) / 1000;
+static_assert(SD_LOG_SENSOR_REORDER_S * 1000 >= SDCARD_FLUSH_INTERVAL_MS + SD_LOG_WINDOW_INTERVAL_MS,
+              "SD_LOG_SENSOR_REORDER_S must cover the longest time a binary block stays open");
+
+// Windows are uploaded to Firebase in batches of one multi-path update request.
+// A batch is sent when it holds FIREBASE_BATCH_WINDOWS windows (at most FIREBASE_BATCH_MAX_WINDOWS)
+// or when its oldest window has waited FIREBASE_BATCH_MAX_DELAY_MS, whichever comes first.
+// While the Wi-Fi link is poor (see wifi_link.h) batches are only sent once full, so fewer and larger requests
+// go over the weak link, and while it is down the windows are queued right away.
+static const uint8_t FIREBASE_BATCH_WINDOWS = 1;
+static const uint32_t FIREBASE_BATCH_MAX_DELAY_MS = 300000;
+
+// Windows that could not be uploaded are queued on the SD card and drained oldest first
+// in batches of FIREBASE_BATCH_MAX_WINDOWS, at most one batch every FIREBASE_QUEUE_DRAIN_INTERVAL_MS.
+// While the Wi-Fi link is poor the queue is drained every FIREBASE_QUEUE_DRAIN_POOR_INTERVAL_MS instead.
+static const uint32_t FIREBASE_QUEUE_DRAIN_INTERVAL_MS = 2000;
+static const uint32_t FIREBASE_QUEUE_DRAIN_POOR_INTERVAL_MS = 10000;
+// Format of the catch-up uploads of queued windows.
+// JSON writes every window under its own path like the live uploads. COMPRESSED sends up to
+// FIREBASE_COMPRESSED_DRAIN_WINDOWS windows per drain as base64 encoded compressed log blocks
+// (see compressed_log.h), one request per sensor under "compressed/[sensor<ID>/]<time of the first window>",
+// which a long backlog catches up with far fewer requests and bytes. The blocks can be decoded with tools/sdlog_decode.cpp.
+typedef enum {FIREBASE_UPLOAD_JSON, FIREBASE_UPLOAD_COMPRESSED} FirebaseUploadFormat_t;
+static const FirebaseUploadFormat_t FIREBASE_UPLOAD_FORMAT = FIREBASE_UPLOAD_JSON;
+static const uint8_t FIREBASE_COMPRESSED_DRAIN_WINDOWS = 120;
+// Every upload request owns a slot of the firebase_pipeline until it is acknowledged (see upload_pipeline.h).
+// At most FIREBASE_MAX_IN_FLIGHT requests are queued in the async client at a time, which bounds the memory
+// held by the TLS client and lets a backlog drain send several batches without waiting for every acknowledgement.
+// A request that fails or is not acknowledged within FIREBASE_REQUEST_TIMEOUT_MS is retried up to
+// FIREBASE_MAX_ATTEMPTS times, FIREBASE_RETRY_MIN_MS apart doubling up to FIREBASE_RETRY_MAX_MS,
+// and then its windows are queued on the SD card.
+static const uint8_t FIREBASE_MAX_IN_FLIGHT = 3;
+static const uint8_t FIREBASE_MAX_ATTEMPTS = 4;
+static const uint32_t FIREBASE_REQUEST_TIMEOUT_MS = 30000;
+static const uint32_t FIREBASE_RETRY_MIN_MS = 2000;
+static const uint32_t FIREBASE_RETRY_MAX_MS = 30000;
+// Compressed blocks one catch-up drain can send at once, one per sensor but at most one per request in flight.
+static const uint8_t FIREBASE_COMPRESSED_BLOCKS = SENSOR_COUNT < FIREBASE_MAX_IN_FLIGHT ? SENSOR_COUNT : FIREBASE_MAX_IN_FLIGHT;
+// Maximum time the Firebase task sleeps without a new sample, so the queue is drained
+// even while the sensor is not publishing.
+static const uint32_t FIREBASE_TASK_WAKE_INTERVAL_MS = 1000;
+
+// How often firebaseBackground services the Firebase client.
+// While requests are in flight or the app is authenticating it runs every FIREBASE_ACTIVE_LOOP_INTERVAL_MS,
+// otherwise it sleeps FIREBASE_IDLE_LOOP_INTERVAL_MS, which is plenty to catch the auth token refresh deadline.
+// A new request wakes it up immediately.
+static const int FIREBASE_ACTIVE_LOOP_INTERVAL_MS = 10;
+static const int FIREBASE_IDLE_LOOP_INTERVAL_MS = 1000;
+static const int FIREBASE_CPU_REPORT_INTERVAL_MS = 60000;
+static const int DISPLAY_STATS_INTERVAL_MS = 60000;
+static const int TASK_STATS_INTERVAL_MS = 600000;   // How often the systemMonitor prints the compact task statistics.
+
+// The heap is sampled every HEAP_CHECK_INTERVAL_MS. Its baseline is set HEAP_BASELINE_DELAY_MS after Firebase
+// was initialized, when the network and TLS stacks have made their first connection and upload.
+// With STATIC_ALLOCATION any low water mark below the baseline counts as growth, otherwise only a low water
+// mark more than HEAP_GROWTH_TOLERANCE_BYTES below it. Growth asserts with HEAP_GROWTH_ASSERT.
+static const uint32_t HEAP_CHECK_INTERVAL_MS = 10000;
+static const uint32_t HEAP_BASELINE_DELAY_MS = 300000;
+static const uint32_t HEAP_GROWTH_TOLERANCE_BYTES = STATIC_ALLOCATION ? 0 : 4096;
+
+// Stack sizes of the tasks in bytes.
+// Check the stack high water marks with the "Stats" command before changing them.
+// readSensor (decimator, per sensor state) and displayData (snprintf into four lines) both format floats,
+// which alone can take more than 1 KB of stack in newlib's printf, so they get 4 KB.
+static const uint32_t SYSTEM_MONITOR_STACK_SIZE = 16384;
+static const uint32_t READ_SENSOR_STACK_SIZE = 4096;
+static const uint32_t DISPLAY_DATA_STACK_SIZE = 4096;
+static const uint32_t SD_CARD_LOGGER_STACK_SIZE = 4096;
+static const uint32_t READ_SERIAL_STACK_SIZE = 4096;
+static const uint32_t FIREBASE_UPLOAD_STACK_SIZE = 8192;
+static const uint32_t FIREBASE_BACKGROUND_STACK_SIZE = 8192;
 
 // Buffer sizes for serial input and SD card paths.
-static const uint8_t SERIAL_BUFFER_SIZE = 20;
+static const uint8_t SERIAL_BUFFER_SIZE = 64;  // Fits "Query <from> <to> <resolution>" with full date times.
 static const uint8_t SD_CARD_FOLDER_PATH_SIZE = 20;
-static const uint8_t SD_CARD_FILE_PATH_SIZE = 40;
+static const uint8_t SD_CARD_FILE_PATH_SIZE = SD_LOG_PATH_SIZE;
 static const uint8_t SD_CARD_TIME_SIZE = 10;
+static const uint8_t SD_CARD_RECORD_SIZE = 128;
+
+// Journal of the windows logged before the wall clock was known, as raw BackloggedWindow_t records.
+// Its times are monotonic and only valid during the boot that wrote it, so a journal found at boot is
+// renamed to SD_CARD_UNSYNCED_STALE_PATH for manual recovery instead of being replayed.
+static const char* const SD_CARD_UNSYNCED_PATH = "/unsynced.dat";
+static const char* const SD_CARD_UNSYNCED_STALE_PATH = "/unsynced_stale.dat";
+static const uint8_t SD_CARD_UNSYNCED_REPLAY_BATCH = 8;  // Windows read from the journal per spi_mutex hold.
+
+// Format of the SD card log files.
+// CSV is human readable, BINARY stores fixed size fixed point records with a CRC per block
+// (see binary_log.h) and COMPRESSED stores delta of delta encoded records, typically 1-2 bytes each
+// (see compressed_log.h). Both binary formats can be converted to CSV with tools/sdlog_decode.cpp.
+typedef enum {SD_LOG_FORMAT_CSV, SD_LOG_FORMAT_BINARY, SD_LOG_FORMAT_COMPRESSED} SdLogFormat_t;
+static const SdLogFormat_t SD_LOG_FORMAT = SD_LOG_FORMAT_CSV;
+
+// First line of every CSV log file. The sensor ID is the last column so older files still parse the same way.
+static const char* SD_CARD_CSV_HEADER = "Time,Temperature_C,Temperature_F,Pressure_hPa,"
+                                        "Temperature_Min_C,Temperature_Max_C,Temperature_StdDev_C,"
+                                        "Pressure_Min_hPa,Pressure_Max_hPa,Pressure_StdDev_hPa,Sensor\n";
+
+// The task functions, defined below.
+void systemMonitor(void* p);
+void readSensor(void* p);
+void displayData(void* p);
+void sdCardLogger(void* p);
+void readSerial(void* p);
+void firebaseUpload(void* p);
+void firebaseBackground(void* p);
 
 // These handles are used by the systemMonitor to manage the lifecycle of other tasks.
 static TaskHandle_t systemMonitor_h = NULL;
@@ -93,10 +335,87 @@ static TaskHandle_t readSerial_h = NULL;
 static TaskHandle_t firebaseUpload_h = NULL;
 static TaskHandle_t firebaseBackground_h = NULL;
 
+// Loop profiles of the tasks (see task_profile.h). Each one is only written by its own task.
+static TaskProfile_t systemMonitor_profile;
+static TaskProfile_t readSensor_profile;
+static TaskProfile_t displayData_profile;
+static TaskProfile_t sdCardLogger_profile;
+static TaskProfile_t readSerial_profile;
+static TaskProfile_t firebaseUpload_profile;
+static TaskProfile_t firebaseBackground_profile;
+
+#if STATIC_ALLOCATION
+// Stacks and control blocks of the tasks. On the ESP32 a StackType_t is one byte.
+static StackType_t systemMonitor_stack[SYSTEM_MONITOR_STACK_SIZE];
+static StackType_t readSensor_stack[READ_SENSOR_STACK_SIZE];
+static StackType_t displayData_stack[DISPLAY_DATA_STACK_SIZE];
+static StackType_t sdCardLogger_stack[SD_CARD_LOGGER_STACK_SIZE];
+static StackType_t readSerial_stack[READ_SERIAL_STACK_SIZE];
+static StackType_t firebaseUpload_stack[FIREBASE_UPLOAD_STACK_SIZE];
+static StackType_t firebaseBackground_stack[FIREBASE_BACKGROUND_STACK_SIZE];
+static StaticTask_t task_buffers[7];   // One per entry of TASKS.
+#define TASK_MEMORY(stack, index) stack, &task_buffers[index]
+#else
+#define TASK_MEMORY(stack, index) NULL, NULL
+#endif
+
+// The tasks with the parameters they are created with (see createTask), also shown by the task statistics.
+typedef struct {
+  const char* name;
+  TaskHandle_t* handle;
+  uint32_t stack_size;
+  TaskProfile_t* profile;
+  TaskFunction_t function;
+  UBaseType_t priority;
+  BaseType_t core;
+  StackType_t* stack;         // Static stack and control block, NULL if the task is allocated from the heap.
+  StaticTask_t* buffer;
+} TaskInfo_t;
+
+// The systemMonitor has a higher priority than the other tasks so that it can manage the system effectively.
+// The sensor, display and SD card run on core 0, the serial input and Firebase on core 1.
+static const TaskInfo_t TASKS[] = {
+  {"System Monitor", &systemMonitor_h, SYSTEM_MONITOR_STACK_SIZE, &systemMonitor_profile, systemMonitor, 5, 0, TASK_MEMORY(systemMonitor_stack, 0)},
+  {"Read Sensor", &readSensor_h, READ_SENSOR_STACK_SIZE, &readSensor_profile, readSensor, 4, 0, TASK_MEMORY(readSensor_stack, 1)},
+  {"Display Data", &displayData_h, DISPLAY_DATA_STACK_SIZE, &displayData_profile, displayData, 3, 0, TASK_MEMORY(displayData_stack, 2)},
+  {"SD Card Logger", &sdCardLogger_h, SD_CARD_LOGGER_STACK_SIZE, &sdCardLogger_profile, sdCardLogger, 2, 0, TASK_MEMORY(sdCardLogger_stack, 3)},
+  {"Read Serial", &readSerial_h, READ_SERIAL_STACK_SIZE, &readSerial_profile, readSerial, 3, 1, TASK_MEMORY(readSerial_stack, 4)},
+  {"Firebase Upload", &firebaseUpload_h, FIREBASE_UPLOAD_STACK_SIZE, &firebaseUpload_profile, firebaseUpload, 2, 1, TASK_MEMORY(firebaseUpload_stack, 5)},
+  {"Firebase Background", &firebaseBackground_h, FIREBASE_BACKGROUND_STACK_SIZE, &firebaseBackground_profile, firebaseBackground, 1, 1, TASK_MEMORY(firebaseBackground_stack, 6)}
+};
+static const uint8_t TASK_COUNT = sizeof(TASKS) / sizeof(TASKS[0]);
+
 // These mutexes are used to protect shared resources from concurrent access.
-static SemaphoreHandle_t sensor_mutex;  // Protects the global sensor_data struct 
-static SemaphoreHandle_t i2c_mutex;     // Protects the shared I2C hardware bus used by the sensor and display
-static SemaphoreHandle_t spi_mutex;     // Protects the shared I2C hardware bus used by the SD card
+// Both record their wait and hold times, timeouts and current holder (see instrumented_mutex.h).
+static InstrumentedMutex_t i2c_mutex;   // Protects the shared I2C hardware bus used by the sensors and display
+static InstrumentedMutex_t i2c1_mutex;  // Protects the second I2C hardware bus used by sensors only
+static InstrumentedMutex_t spi_mutex;   // Protects the shared SPI hardware bus used by the SD card
+
+// The I2C buses the sensors can be on, indexed by SensorInfo_t.bus. The display is always on the first one.
+typedef struct {
+  TwoWire* wire;
+  uint8_t sda;
+  uint8_t scl;
+  InstrumentedMutex_t* mutex;
+} I2cBus_t;
+
+static const I2cBus_t I2C_BUSES[SENSOR_REGISTRY_BUSES] = {
+  {&Wire, MY_SDA, MY_SCL, &i2c_mutex},
+  {&Wire1, MY_SDA1, MY_SCL1, &i2c1_mutex}
+};
+
+// Returns whether a device is on I2C bus 'bus', so an unused bus is neither started nor reported.
+bool i2cBusUsed(uint8_t bus) {
+  if (bus == 0) {
+    return true;
+  }
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    if (SENSORS[id].bus == bus) {
+      return true;
+    }
+  }
+  return false;
+}
 
 // Firebase objects and authentication for asynchronous operations.
 UserAuth user_auth(WEB_API_KEY, USER_EMAIL, USER_PASS);
@@ -105,24 +424,121 @@ WiFiClientSecure ssl_client;
 using AsyncClient = AsyncClientClass;
 AsyncClient async_client(ssl_client);
 RealtimeDatabase database;
-AsyncResult dbResult;
 
-// Hardware device objects.
-Adafruit_BMP280 bmp;
+// Hardware device objects, one driver per entry of SENSORS.
+Bmp280_t bmp[SENSOR_COUNT];
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 
-// This struct defines the format for a single sensor reading.
+// The global shared data structure that holds the latest sample of every sensor, indexed by sensor ID.
+// It is written only by readSensor and read lock-free by every consumer (see sample_seqlock.h).
+static SampleSeqlock_t latest_samples[SENSOR_COUNT];
+
+// Schedule, latest readings and statistics of the sensors (see sensor_registry.h).
+// Written only by readSensor, the statistics are shown by the "Sensors" command.
+static SensorRegistry_t sensor_registry;
+
+// History of the published samples of SENSOR_PRIMARY at 1 s, 1 min and 1 h resolution (see rollup_store.h).
+// It is updated only by readSensor and read by the display and the "History" command.
+// Every access is a few hundred bytes of copying at most, so a spinlock is used instead of a mutex.
+static RollupStore_t rollup_store;
+static portMUX_TYPE rollup_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Every sample of every sensor is also pushed into this ring so that the SD card and Firebase tasks
+// consume the full sample stream exactly once, each through its own cursor.
+static SampleRing_t sample_ring;
+static SampleRingCursor_t sd_card_cursor;
+static SampleRingCursor_t firebase_cursor;
+
+// Windows waiting to be uploaded to Firebase in one request.
+// Kept out of the task stack since the JSON body is over a kilobyte.
+static FirebaseBatch_t firebase_batch;
+static FirebaseQueueRecord_t firebase_batch_records[FIREBASE_BATCH_MAX_WINDOWS];  // The windows in firebase_batch.
+
+// Store and forward queue of windows waiting on the SD card for connectivity (see firebase_queue.h).
+static FirebaseQueue_t firebase_queue;
+
+// Upload requests waiting for their acknowledgement. Owned by the firebaseUpload task,
+// the completions are reported by firebaseUploadResult from the firebaseBackground task.
+static UploadPipeline_t firebase_pipeline;
+// The JSON body of the request being sent, rebuilt from the payload of its slot for every attempt.
+static FirebaseBatch_t firebase_send_batch;
+
+// How the payload of a firebase_pipeline slot is stored.
+typedef enum {
+  FIREBASE_PAYLOAD_RECORDS,   // FirebaseQueueRecord_t windows, sent as one path per window.
+  FIREBASE_PAYLOAD_BLOCK      // A compressed log block, sent under "compressed/[sensor<ID>/]<time of the first window>".
+} FirebasePayloadKind_t;
+
+// Buffered writer that keeps the SD card day file open (see sd_log_writer.h),
+// and the time the SD card task held the spi_mutex for it.
+static SdLogWriter_t sd_log_writer;
+static uint32_t sd_spi_hold_us_total = 0;
+static uint32_t sd_spi_hold_us_max = 0;
+
+// Blocks of binary records being collected in SD_LOG_FORMAT_BINARY or SD_LOG_FORMAT_COMPRESSED,
+// one per sensor since a block carries the ID of its sensor, along with the day file each belongs to.
 typedef struct {
-  float temperature;
-  float pressure;
-} SensorData_t;
-
-// The global shared data structure that holds the latest sensor reading.
-// This is protected by the 'sensor_mutex'.
-static SensorData_t sensor_data;
-
-// Flag to indicate if the hardware is functioning correctly.
-bool hardware_ok = true; 
+  BinaryLogBlock_t binary;
+  CompressedLogBlock_t compressed;
+  uint32_t start_ms;
+  char folder_path[SD_CARD_FOLDER_PATH_SIZE];
+  char file_path[SD_CARD_FILE_PATH_SIZE];
+} SdBinaryBlock_t;
+static SdBinaryBlock_t sd_binary_blocks[SENSOR_COUNT];
+
+// Copy of what the display currently shows, used to send only the changed parts of a new frame.
+// It is invalidated whenever the display is (re)initialized so the next frame is sent in full.
+// The flag is written by the systemMonitor when it re-initializes the display and read by displayData
+// outside the i2c_mutex to skip unchanged frames, so it is atomic.
+static uint8_t display_shadow[DISPLAY_FRAME_SIZE];
+static std::atomic<bool> display_shadow_valid(false);
+
+// Share of CPU time spent in firebase.loop() over the last FIREBASE_CPU_REPORT_INTERVAL_MS, in percent.
+static float firebase_cpu_percent = 0.0;
+
+// Health of each device, fed by the tasks using it and checked by the systemMonitor (see device_health.h).
+static DeviceHealth_t sensor_health[SENSOR_COUNT];
+static DeviceHealth_t display_health;
+static DeviceHealth_t sd_card_health;
+
+// Sector buffer for the SD card probe.
+static uint8_t sd_card_probe_sector[SD_LOG_SECTOR_SIZE];
+
+// Windows logged while the SD card was missing or the wall clock was not known yet, stamped with
+// the monotonic time of their last sample and replayed to the card once both are available.
+// Only used by the sdCardLogger task.
+static WindowBacklog_t sd_card_backlog;
+
+// Windows moved from a full sd_card_backlog to SD_CARD_UNSYNCED_PATH before the wall clock was known,
+// and how far the replay of that journal has got. Only used by the sdCardLogger task.
+static WindowJournal_t sd_unsynced_journal;
+
+// Windows completed by the firebaseUpload task before the wall clock was known, stamped with monotonic time.
+static WindowBacklog_t firebase_unsynced_backlog;
+
+// Heap footprint after startup, sampled by the systemMonitor (see heap_watch.h).
+static HeapWatch_t heap_watch;
+
+// Wi-Fi connection manager, updated by the systemMonitor. The link quality is read by the firebaseUpload task.
+static WifiLink_t wifi_link;
+
+// Set by the systemMonitor once NTP has synchronized the wall clock. Until then the sensor, display and
+// SD card tasks already run and windows are stamped with the monotonic sample time (see wallClockTime).
+static std::atomic<bool> wall_clock_synced(false);
+
+// Frames that could not be shown because the display was missing.
+static uint32_t display_frames_dropped = 0;
+
+// Capability map of the devices that are currently working, one bit per device.
+// It is written by the systemMonitor after every hardware check. Each task only pauses
+// the work that needs a missing device, so a fault in one device does not stop the others.
+// The sensors are kept apart in available_sensors, one bit per sensor ID, so the readSensor task
+// keeps reading the sensors that are still there.
+static const uint8_t DEVICE_DISPLAY = 1 << 0;
+static const uint8_t DEVICE_SD_CARD = 1 << 1;
+static const uint8_t DEVICE_ALL = DEVICE_DISPLAY | DEVICE_SD_CARD;
+static std::atomic<uint8_t> available_devices(0);
+static std::atomic<uint8_t> available_sensors(0);
 
 
 //===========================================================================================
@@ -130,115 +546,448 @@ bool hardware_ok = true;
 //===========================================================================================
 
 
-// Converts Celsius to Fahrenheit.
-// This is a simple conversion formula: F = C * 9/5 + 32
-float toFahrenheit(float celsius) {
-  return celsius * 9.0 / 5.0 + 32.0;
+// Some libraries like Adafruit_SSD1306 might not give an error if the device is not connected.
+// This function checks if a device is connected by attempting to begin communication with it.
+// at the specified I2C address on the given bus.
+bool deviceConnected(TwoWire* wire, uint8_t address) {
+  wire->beginTransmission(address);
+  return wire->endTransmission() == 0;
+}
+
+// Returns true if all the given devices are currently working.
+bool deviceAvailable(uint8_t devices) {
+  return (available_devices.load(std::memory_order_relaxed) & devices) == devices;
+}
+
+// Returns true if the sensor with the given ID is currently working.
+bool sensorAvailable(uint8_t id) {
+  return (available_sensors.load(std::memory_order_relaxed) >> id) & 1;
+}
+
+// Probes and (re)initialization functions for every device.
+// The I2C ones must be called with the mutex of their bus held, the SD card ones with the spi_mutex held.
+// A probe is a single short transaction, a (re)initialization resets the device and its driver state.
+// 'id' is the sensor ID for the sensor functions and unused by the others.
+bool probeSensor(uint8_t id) {
+  return bmp280Probe(&bmp[id]);
+}
+
+bool initSensor(uint8_t id) {
+  TwoWire* wire = I2C_BUSES[SENSORS[id].bus].wire;
+  return deviceConnected(wire, SENSORS[id].address) && bmp280Begin(&bmp[id], wire, SENSORS[id].address, SENSOR_CONFIG);
 }
 
+bool probeDisplay(uint8_t id) {
+  return deviceConnected(&Wire, SCREEN_ADDRESS);
+}
 
-// Calculates the average temperature by iterating over an array of SensorData_t.
-// It returns 0.0 if the data count is zero to avoid division by zero.
-float calculateAverageTemp(const SensorData_t* sensor_data, uint8_t data_count) {
-  if (data_count == 0) {
-    return 0.0;
+bool initDisplay(uint8_t id) {
+  if (!deviceConnected(&Wire, SCREEN_ADDRESS) || !display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
+    return false;
   }
+  display_shadow_valid.store(false);
+  return true;
+}
+
+bool probeSdCard(uint8_t id) {
+  return SD.readRAW(sd_card_probe_sector, 0);
+}
+
+// The buffered records and index entries of the log writer are written out first, since its open
+// files do not survive SD.end(). The writer reopens the day file with its next record.
+bool initSdCard(uint8_t id) {
+  sdLogWriterClose(&sd_log_writer, xTaskGetTickCount() * portTICK_PERIOD_MS);
+  SD.end();
+  return SD.begin(SD_CS);
+}
 
-  float avg_temp = 0.0;
-  for (int i = 0; i < data_count; i++) {
-    avg_temp += sensor_data[i].temperature;
+
+// Runs the check decided by deviceHealthCheck for one device and returns whether the device is OK.
+// A failed probe only marks the device as failed, it is re-initialized on a later check.
+bool runDeviceCheck(DeviceHealth_t* health, DeviceCheck_t check, bool (*probe)(uint8_t), bool (*init)(uint8_t), uint8_t id, uint32_t now_ms) {
+  if (check == DEVICE_CHECK_PROBE) {
+    uint32_t probe_start_us = micros();
+    bool ok = probe(id);
+    deviceHealthProbed(health, ok, micros() - probe_start_us, now_ms);
+    if (!ok) {
+      Serial.printf("System Monitor: %s probe failed.\n", health->name);
+    }
   }
-  return avg_temp / data_count;
+  else if (check == DEVICE_CHECK_REINIT) {
+    deviceHealthReinitialized(health, init(id), now_ms);
+  }
+  return health->ok;
 }
 
 
-// Calculates the average pressure by iterating over an array of SensorData_t.
-// It returns 0.0 if the data count is zero to avoid division by zero.
-float calculateAveragePressure(const SensorData_t* sensor_data, uint8_t data_count) {
-  if (data_count == 0) {
-    return 0.0;
+// Checks the hardware status of the BMP280 sensors, the SSD1306 display and the SD card
+// and updates the available_devices and available_sensors capability maps.
+// Devices that had error free transactions since the last check are not touched at all,
+// idle devices or devices that reported errors are probed, and failed devices are re-initialized
+// every HARDWARE_REINIT_INTERVAL_MS. An I2C bus is only reset when a device on it is re-initialized.
+// It uses the mutex of each I2C bus and the SPI mutex to ensure thread safety while accessing these devices.
+// When a device fails or recovers, it prints a message to the serial monitor.
+// It returns true if every sensor and device is OK, which the systemMonitor shows with the LED.
+// This function is called periodically to ensure the hardware is functioning correctly.
+bool checkHardware() {
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  DeviceCheck_t sensor_checks[SENSOR_COUNT];
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    sensor_checks[id] = deviceHealthCheck(&sensor_health[id], now_ms);
+  }
+  DeviceCheck_t display_check = deviceHealthCheck(&display_health, now_ms);
+  DeviceCheck_t sd_card_check = deviceHealthCheck(&sd_card_health, now_ms);
+
+  // Check the devices of each I2C bus with its mutex held. The display is on the first bus.
+  for (uint8_t bus = 0; bus < SENSOR_REGISTRY_BUSES; bus++) {
+    const I2cBus_t* i2c = &I2C_BUSES[bus];
+    bool check = bus == 0 && display_check != DEVICE_CHECK_NONE;
+    bool reinit = bus == 0 && display_check == DEVICE_CHECK_REINIT;
+    for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+      if (SENSORS[id].bus == bus) {
+        check |= sensor_checks[id] != DEVICE_CHECK_NONE;
+        reinit |= sensor_checks[id] == DEVICE_CHECK_REINIT;
+      }
+    }
+    if (!check || !mutexTake(i2c->mutex, I2C_MUTEX_WAIT_MS)) {
+      continue;
+    }
+
+    // Reset the I2C bus to ensure clean state before re-initializing a device.
+    if (reinit) {
+      i2c->wire->end();
+      i2c->wire->begin(i2c->sda, i2c->scl);
+    }
+
+    for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+      if (SENSORS[id].bus == bus) {
+        runDeviceCheck(&sensor_health[id], sensor_checks[id], probeSensor, initSensor, id, now_ms);
+      }
+    }
+    if (bus == 0) {
+      runDeviceCheck(&display_health, display_check, probeDisplay, initDisplay, 0, now_ms);
+    }
+
+    // Release the mutex of the bus after checking its devices.
+    mutexGive(i2c->mutex);
+  }
+
+  // Acquire the SPI mutex to safely access the SD card.
+  if (sd_card_check != DEVICE_CHECK_NONE && mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+    runDeviceCheck(&sd_card_health, sd_card_check, probeSdCard, initSdCard, 0, now_ms);
+
+    // Release the SPI mutex after checking the SD card.
+    mutexGive(&spi_mutex);
+  }
+
+  // Update the capability maps.
+  uint8_t sensors = 0;
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    sensors |= sensor_health[id].ok ? 1 << id : 0;
   }
+  uint8_t previous_sensors = available_sensors.exchange(sensors, std::memory_order_relaxed);
+  uint8_t devices = (display_health.ok ? DEVICE_DISPLAY : 0) | (sd_card_health.ok ? DEVICE_SD_CARD : 0);
+  uint8_t previous_devices = available_devices.exchange(devices, std::memory_order_relaxed);
+
+  // Print the changes of the hardware devices to the serial monitor.
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    if ((previous_sensors & ~sensors) & (1 << id)) {
+      Serial.printf("System Monitor: %s sensor lost. Its readings are paused.\n", SENSORS[id].name);
+    }
+    if ((sensors & ~previous_sensors) & (1 << id)) {
+      Serial.printf("System Monitor: %s sensor found.\n", SENSORS[id].name);
+    }
+  }
+  uint8_t lost = previous_devices & ~devices;
+  uint8_t found = devices & ~previous_devices;
+  if (lost & DEVICE_DISPLAY) {
+    Serial.println("System Monitor: SSD1306 display lost. Display paused.");
+  }
+  if (lost & DEVICE_SD_CARD) {
+    Serial.println("System Monitor: SD card lost. Logs are kept in RAM and Firebase uploads are not queued.");
+  }
+  if (found & DEVICE_DISPLAY) {
+    Serial.println("System Monitor: SSD1306 display found.");
+  }
+  if (found & DEVICE_SD_CARD) {
+    Serial.println("System Monitor: SD card found.");
+  }
+
+  return sensors == SENSOR_ALL && devices == DEVICE_ALL;
+}
+
+
+// Prints the health statistics of one device to the serial monitor.
+void printDeviceHealth(const DeviceHealth_t* health) {
+  uint32_t probes = health->probes;
+  Serial.printf("%-8s %-4s %8u tx %6u errors %6u probes (%u failed, %u us avg, %u us max) %4u reinits (%u failed)\n",
+                health->name, health->ok ? "OK" : "FAIL",
+                (unsigned)health->transactions.load(std::memory_order_relaxed),
+                (unsigned)health->transaction_errors.load(std::memory_order_relaxed),
+                (unsigned)probes, (unsigned)health->probe_failures,
+                (unsigned)(probes > 0 ? health->probe_time_us_total / probes : 0), (unsigned)health->probe_time_us_max,
+                (unsigned)health->reinits, (unsigned)health->reinit_failures);
+}
 
-  float avg_pres = 0.0;
-  for (int i = 0; i < data_count; i++) {
-    avg_pres += sensor_data[i].pressure;
+// Creates the task of 'handle' with the parameters of its TASKS entry.
+// With STATIC_ALLOCATION its stack and control block are the static buffers of the entry,
+// otherwise FreeRTOS allocates them from the heap.
+// Replace 'xTaskCreatePinnedToCore' with 'xTaskCreate' 
+// if using vanilla FreeRTOS and remove the core parameter.
+// Here I'm using a modifed version of FreeRTOS 
+// by ESP which allows pinning tasks to cores.
+// This is because ESP32 has 2 cores as opposed to 1 core in vanilla FreeRTOS.
+bool createTask(TaskHandle_t* handle) {
+  for (uint8_t i = 0; i < TASK_COUNT; i++) {
+    const TaskInfo_t* task = &TASKS[i];
+    if (task->handle != handle) {
+      continue;
+    }
+    if (task->stack != NULL) {
+      *handle = xTaskCreateStaticPinnedToCore(task->function, task->name, task->stack_size, NULL, task->priority,
+                                              task->stack, task->buffer, task->core);
+    }
+    else {
+      xTaskCreatePinnedToCore(task->function, task->name, task->stack_size, NULL, task->priority, handle, task->core);
+    }
+    return *handle != NULL;
   }
-  return avg_pres / data_count;
+  return false;
 }
 
 
-// Converts a month number (0-11) to its corresponding name.
-// And returns it as a string.
-// It returns "Unknown" if the month number is invalid.
-const char* getMonthName(int month) {
-  const char* months[] = {"January", "February", "March", "April", "May", "June", "July", "August", "September", "October", "November", "December"};
-  if (month >= 0 && month < 12) {
-    return months[month];
+// Prints the state and statistics of the Wi-Fi link to the serial monitor.
+void printWifiLink() {
+  static const char* const QUALITY_NAMES[] = {"OFFLINE", "POOR", "GOOD"};
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  Serial.printf("Wi-Fi    %-7s %4d dBm %5u attempts (%u failed) %4u connects %4u disconnects, reconnect %u ms last %u ms max, offline %u s total\n",
+                QUALITY_NAMES[wifiLinkQuality(&wifi_link)], (int)wifiLinkRssi(&wifi_link),
+                (unsigned)wifi_link.attempts, (unsigned)wifi_link.failed_attempts,
+                (unsigned)wifi_link.connects, (unsigned)wifi_link.disconnects,
+                (unsigned)wifi_link.reconnect_ms_last, (unsigned)wifi_link.reconnect_ms_max,
+                (unsigned)(wifiLinkOfflineMs(&wifi_link, now_ms) / 1000));
+}
+
+// Prints the statistics of the Firebase upload pipeline to the serial monitor.
+void printUploadStats() {
+  const UploadPipeline_t* pipeline = &firebase_pipeline;
+  Serial.printf("Requests: %u in flight (max %u of %u), %u sent, %u acked, %u failed, %u timed out, %u retries, %u given up, %u released, %u refused\n",
+                (unsigned)uploadPipelineInUse(pipeline), (unsigned)pipeline->in_use_max, (unsigned)pipeline->max_in_flight,
+                (unsigned)pipeline->sent, (unsigned)pipeline->acked, (unsigned)pipeline->failed, (unsigned)pipeline->timeouts,
+                (unsigned)pipeline->retries, (unsigned)pipeline->given_up, (unsigned)pipeline->released, (unsigned)pipeline->full);
+  Serial.printf("  ack ms:      mean %u, p50 %u, p99 %u, max %u\n", (unsigned)histogramMean(&pipeline->ack_ms),
+                (unsigned)histogramPercentile(&pipeline->ack_ms, 50.0), (unsigned)histogramPercentile(&pipeline->ack_ms, 99.0),
+                (unsigned)pipeline->ack_ms.max);
+  Serial.printf("  delivery ms: mean %u, p50 %u, p99 %u, max %u\n", (unsigned)histogramMean(&pipeline->delivery_ms),
+                (unsigned)histogramPercentile(&pipeline->delivery_ms, 50.0), (unsigned)histogramPercentile(&pipeline->delivery_ms, 99.0),
+                (unsigned)pipeline->delivery_ms.max);
+  Serial.printf("Queue: %u windows on SD card (%u in flight), %u enqueued, %u drained, %u dropped, %u migrated\n",
+                (unsigned)firebaseQueueDepth(&firebase_queue),
+                (unsigned)(firebaseQueueDepth(&firebase_queue) - firebaseQueueUnsent(&firebase_queue)), (unsigned)firebase_queue.enqueued, (unsigned)firebase_queue.drained, (unsigned)firebase_queue.dropped,
+                (unsigned)firebase_queue.migrated);
+}
+
+// Prints the heap usage to the serial monitor.
+void printHeapStats() {
+  Serial.printf("Heap: %u bytes free, %u min free, %u largest block", (unsigned)heap_watch.free, (unsigned)heap_watch.min_free,
+                (unsigned)heap_watch.largest_block);
+  if (heap_watch.started) {
+    Serial.printf(" (baseline %u free, %u min free; since then %u smallest largest block, %u bytes growth, %u growth events)",
+                  (unsigned)heap_watch.baseline_free, (unsigned)heap_watch.baseline_min_free, (unsigned)heap_watch.min_largest_block,
+                  (unsigned)heapWatchGrowth(&heap_watch), (unsigned)heap_watch.growth_events);
   }
-  return "Unknown";
+  Serial.println();
 }
 
-// Some libraries like Adafruit_SSD1306 might not give an error if the device is not connected.
-// This function checks if a device is connected by attempting to begin communication with it.
-// at the specified I2C address.
-bool deviceConnected(uint8_t address) {
-  Wire.beginTransmission(address);
-  return Wire.endTransmission() == 0;
+// Prints the configuration, read rate and latest reading of every sensor and the utilization of the I2C buses.
+// The statistics are written by readSensor and only read here.
+void printSensorStats() {
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    SensorData_t reading = sensorRegistryReading(&sensor_registry, id);
+    Serial.printf("%u %-8s bus %u 0x%02X every %4u ms: %.2f readings/s, %u readings, %u errors, %u late, last %.2f C %.2f hPa %u s ago\n",
+                  (unsigned)id, SENSORS[id].name, (unsigned)SENSORS[id].bus, (unsigned)SENSORS[id].address,
+                  (unsigned)SENSORS[id].read_interval_ms, sensorRegistryRate(&sensor_registry, id, now_ms),
+                  (unsigned)sensor_registry.readings[id], (unsigned)sensor_registry.errors[id], (unsigned)sensor_registry.late[id],
+                  reading.temperature, reading.pressure, (unsigned)((now_ms - sensor_registry.reading_ms[id]) / 1000));
+  }
+  uint32_t elapsed_s = (now_ms - sensor_registry.start_ms) / 1000;
+  for (uint8_t bus = 0; bus < SENSOR_REGISTRY_BUSES; bus++) {
+    if (i2cBusUsed(bus)) {
+      Serial.printf("I2C bus %u: %.3f%% held by the reads, %.2f holds/s\n", (unsigned)bus,
+                    sensorRegistryBusUtilization(&sensor_registry, bus, now_ms),
+                    elapsed_s > 0 ? (float)sensor_registry.bus_holds[bus] / elapsed_s : 0.0f);
+    }
+  }
 }
 
-// Checks the hardware status by verifying the presence of the BMP280 sensor and the SSD1306 display.
-// It uses the I2C mutex to ensure thread safety while accessing these devices.
-// If either device is not found, it prints an error message to the serial monitor and returns false.
-// If both devices are found, it returns true.
-// This function is called periodically to ensure the hardware is functioning correctly.
-bool checkHardware() {
-  // Flag to indicate if hardware is functioning correctly.
-  bool bmp_ok = false, display_ok = false, sd_card_ok = false;
 
-  // Acquire the I2C mutex to safely access the BMP280 sensor and SSD1306 display.
-  if (xSemaphoreTake(i2c_mutex, MS_TO_TICKS(I2C_MUTEX_WAIT_MS) == pdTRUE)) {
-    // Reset the I2C bus to ensure clean state
-    Wire.end();
-    Wire.begin(MY_SDA, MY_SCL);
+// Samples the heap and sets the heap_watch baseline once startup is over, i.e. HEAP_BASELINE_DELAY_MS after
+// Firebase was initialized. A heap that keeps growing after that is reported and counted in heap_watch,
+// and with HEAP_GROWTH_ASSERT (the default with STATIC_ALLOCATION) it trips an assertion.
+void checkHeap() {
+  static TickType_t check_start_time = 0;
+  static TickType_t network_ready_time = 0;
+  if (xTaskGetTickCount() - check_start_time < MS_TO_TICKS(HEAP_CHECK_INTERVAL_MS)) {
+    return;
+  }
+  check_start_time = xTaskGetTickCount();
+
+  uint32_t free = esp_get_free_heap_size();
+  uint32_t min_free = esp_get_minimum_free_heap_size();
+  uint32_t largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
 
-    // Check if the BMP280 sensor is connected.
-    if (deviceConnected(SENSOR_ADDRESS)) {
-      bmp_ok = bmp.begin(SENSOR_ADDRESS);
+  // The firebaseBackground task is created once Firebase is initialized.
+  if (!heap_watch.started && firebaseBackground_h != NULL) {
+    if (network_ready_time == 0) {
+      network_ready_time = xTaskGetTickCount();
     }
-    // Check if the SSD1306 display is connected.
-    if (deviceConnected(SCREEN_ADDRESS)) {
-      display_ok = display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS);
+    else if (xTaskGetTickCount() - network_ready_time >= MS_TO_TICKS(HEAP_BASELINE_DELAY_MS)) {
+      heapWatchStart(&heap_watch, free, min_free, largest_block);
+      Serial.print("System Monitor: Startup complete. ");
+      printHeapStats();
+      return;
     }
-      
-    // Release the I2C mutex after checking the devices.
-    xSemaphoreGive(i2c_mutex);
   }
 
-  // Acquire the SPI mutex to safely access the SD card.
-  if (xSemaphoreTake(spi_mutex, MS_TO_TICKS(SPI_MUTEX_WAIT_MS)) == pdTRUE) {
-    //
-    if (SD.begin(SD_CS)) {
-      sd_card_ok = true;
+  if (heapWatchSample(&heap_watch, free, min_free, largest_block)) {
+    Serial.print("System Monitor: Heap footprint grew after startup. ");
+    printHeapStats();
+#if HEAP_GROWTH_ASSERT
+    configASSERT(false);
+#endif
+  }
+}
+
+
+// Blinks the LED: on for LED_ON_MS, then off for 'off_interval_ms', starting at 'blink_start_time'.
+// Must be called regularly, it does not block.
+void updateLed(TickType_t* blink_start_time, int off_interval_ms) {
+  TickType_t elapsed = xTaskGetTickCount() - *blink_start_time;
+  if (elapsed >= MS_TO_TICKS(LED_ON_MS + off_interval_ms)) {
+    *blink_start_time = xTaskGetTickCount();
+    elapsed = 0;
+  }
+  digitalWrite(LED, elapsed < MS_TO_TICKS(LED_ON_MS) ? HIGH : LOW);
+}
+
+// Returns the share of one core the task used since boot in percent, or a negative value
+// if FreeRTOS was built without run time statistics.
+float taskCpuPercent(TaskHandle_t handle) {
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+  TaskStatus_t status[TASK_COUNT + 8];
+  uint32_t total_run_time = 0;
+  UBaseType_t count = uxTaskGetSystemState(status, sizeof(status) / sizeof(status[0]), &total_run_time);
+  for (UBaseType_t i = 0; i < count; i++) {
+    if (status[i].xHandle == handle && total_run_time > 0) {
+      return 100.0 * status[i].ulRunTimeCounter / total_run_time;
+    }
+  }
+#endif
+  return -1.0;
+}
+
+// Sleeps until the next release of a periodic task that runs every 'period_ms', counted from '*release_time'.
+// Unlike vTaskDelay the period does not stretch by the execution time of the loop and its mutex waits,
+// so the task does not drift. A missed deadline is counted in the task's profile and the next iteration
+// starts right away (see taskProfileSchedule).
+void waitForNextPeriod(TickType_t* release_time, uint32_t period_ms, TaskProfile_t* profile) {
+  uint32_t release = *release_time;
+  if (taskProfileSchedule(profile, &release, MS_TO_TICKS(period_ms), xTaskGetTickCount())) {
+    vTaskDelayUntil(release_time, MS_TO_TICKS(period_ms));
+  }
+  else {
+    *release_time = release;
+  }
+}
+
+// Prints the statistics of every task to the serial monitor: CPU share, stack usage,
+// the loop period and execution time (including waits) and the number of overruns.
+// The compact form prints one short line per task, the detailed one adds the period and percentiles.
+void printTaskStats(bool detailed) {
+  for (uint8_t i = 0; i < TASK_COUNT; i++) {
+    const TaskInfo_t* task = &TASKS[i];
+    if (*task->handle == NULL) {
+      continue;
     }
 
-    // Release the SPI mutex after checking the SD card.
-    xSemaphoreGive(spi_mutex);
+    // On the ESP32 the high water mark is in bytes.
+    uint32_t stack_free = uxTaskGetStackHighWaterMark(*task->handle);
+    const TaskProfile_t* profile = task->profile;
+    float cpu_percent = taskCpuPercent(*task->handle);
+
+    if (!detailed) {
+      Serial.printf("%-19s cpu %5.2f%% stack %5u/%5u exec p99 %7u us overruns %u misses %u\n", task->name, cpu_percent,
+                    (unsigned)(task->stack_size - stack_free), (unsigned)task->stack_size,
+                    (unsigned)histogramPercentile(&profile->exec_us, 99.0), (unsigned)profile->overruns,
+                    (unsigned)profile->deadline_misses);
+      continue;
+    }
+
+    Serial.printf("%s: cpu %.2f%%, stack %u of %u bytes used (%u free), %u iterations, %u overruns, %u deadline misses (%u periods skipped)\n",
+                  task->name, cpu_percent, (unsigned)(task->stack_size - stack_free), (unsigned)task->stack_size, (unsigned)stack_free,
+                  (unsigned)profile->exec_us.count, (unsigned)profile->overruns,
+                  (unsigned)profile->deadline_misses, (unsigned)profile->skipped_periods);
+    Serial.printf("  period us: target %u, mean %u, min %u, p50 %u, p99 %u, max %u\n", (unsigned)profile->target_period_us,
+                  (unsigned)histogramMean(&profile->period_us), (unsigned)profile->period_us.min,
+                  (unsigned)histogramPercentile(&profile->period_us, 50.0), (unsigned)histogramPercentile(&profile->period_us, 99.0),
+                  (unsigned)profile->period_us.max);
+    Serial.printf("  exec us:   mean %u, min %u, p50 %u, p99 %u, max %u\n",
+                  (unsigned)histogramMean(&profile->exec_us), (unsigned)profile->exec_us.min,
+                  (unsigned)histogramPercentile(&profile->exec_us, 50.0), (unsigned)histogramPercentile(&profile->exec_us, 99.0),
+                  (unsigned)profile->exec_us.max);
   }
+  Serial.printf("Free heap: %u bytes (minimum %u).\n", (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMinFreeHeap());
+}
+
+// Prints the contention statistics of a mutex to the serial monitor.
+void printMutexStats(const InstrumentedMutex_t* mutex) {
+  const MutexStats_t* stats = &mutex->stats;
+  const char* holder = stats->holder.load(std::memory_order_acquire);
+  const char* timeout_holder = stats->timeout_holder.load(std::memory_order_relaxed);
+
+  Serial.printf("%s: %u acquisitions, %u timeouts (last while held by %s), %u bad releases, held by %s\n", stats->name,
+                (unsigned)stats->wait_us.count, (unsigned)stats->timeouts.load(std::memory_order_relaxed),
+                timeout_holder != NULL ? timeout_holder : "-", (unsigned)stats->release_errors, holder != NULL ? holder : "-");
+  Serial.printf("  wait us: mean %u, p50 %u, p99 %u, max %u\n", (unsigned)histogramMean(&stats->wait_us),
+                (unsigned)histogramPercentile(&stats->wait_us, 50.0), (unsigned)histogramPercentile(&stats->wait_us, 99.0),
+                (unsigned)stats->wait_us.max);
+  Serial.printf("  hold us: mean %u, p50 %u, p99 %u, max %u\n", (unsigned)histogramMean(&stats->hold_us),
+                (unsigned)histogramPercentile(&stats->hold_us, 50.0), (unsigned)histogramPercentile(&stats->hold_us, 99.0),
+                (unsigned)stats->hold_us.max);
+}
 
-  // Print the status of the hardware devices to the serial monitor.
-  if (!bmp_ok) {
-    Serial.println("System Monitor: BMP280 sensor not found.");
+// Warns once per acquisition about a mutex that has been held for longer than MUTEX_LEAK_WARNING_MS.
+void checkMutexLeak(const InstrumentedMutex_t* mutex, uint32_t* reported_acquired_us) {
+  const MutexStats_t* stats = &mutex->stats;
+  if (mutexStatsLeaked(stats, micros(), MUTEX_LEAK_WARNING_MS * 1000) && stats->acquired_us != *reported_acquired_us) {
+    const char* holder = stats->holder.load(std::memory_order_acquire);
+    Serial.printf("System Monitor: %s held by %s for more than %u ms.\n", stats->name, holder != NULL ? holder : "-", (unsigned)MUTEX_LEAK_WARNING_MS);
+    *reported_acquired_us = stats->acquired_us;
   }
-  if (!display_ok) {
-    Serial.println("System Monitor: SSD1306 display not found.");
+}
+
+// Wakes up the tasks that consume the sample_ring after a new sample was pushed.
+// A notification sent to a suspended task is kept, so it drains the ring as soon as it is resumed.
+void notifySampleConsumers() {
+  if (sdCardLogger_h != NULL) {
+    xTaskNotifyGive(sdCardLogger_h);
   }
-  if (!sd_card_ok) {
-    Serial.println("System Monitor: SD card not found.");
+  if (firebaseUpload_h != NULL) {
+    xTaskNotifyGive(firebaseUpload_h);
   }
+}
 
-  return bmp_ok && display_ok && sd_card_ok;
+// Converts a monotonic time in milliseconds since boot (e.g. a sample timestamp) to wall clock time
+// in seconds since 1970. Only meaningful once wall_clock_synced is set, which is how windows completed
+// before the time was synchronized are stamped retroactively. The conversion is relative to the
+// current time, so it is not affected by the wrap around of the millisecond tick count.
+uint32_t wallClockTime(uint32_t monotonic_ms) {
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  return time(NULL) - (now_ms - monotonic_ms) / 1000;
 }
 
+
 // Lists the available commands for the user in the serial monitor.
 // This function is called when the user enters the "Help" command in the serial monitor.
 void listAvailableCommands() {
@@ -251,7 +1000,14 @@ void listAvailableCommands() {
   Serial.println("6. Start Display   - Resume display task."); 
   Serial.println("7. Start SD Card   - Resume sd card task."); 
   Serial.println("8. Start Firebase  - Resume firebase task.");
-  Serial.println("9. Help            - List available commands.");
+  Serial.println("9. Health          - Show device health, probe and Wi-Fi link statistics.");
+  Serial.println("10. Stats          - Show task CPU, stack and timing statistics.");
+  Serial.println("11. Locks          - Show mutex wait, hold and timeout statistics.");
+  Serial.println("12. History <1s|1m|1h> [n] - Show the last n rollups (mean, min, max) of a resolution.");
+  Serial.println("13. Query <from> <to> [res] - Show the SD card log between two local times (YYYY-MM-DD[THH:MM[:SS]]), averaged per res (e.g. 10m, 1h).");
+  Serial.println("14. Uploads        - Show Firebase request, retry and latency statistics.");
+  Serial.println("15. Sensors        - Show the read rate, errors and latest reading of every sensor and the I2C bus utilization.");
+  Serial.println("16. Help           - List available commands.");
 }
 
 // Suspends a task by its handle.
@@ -301,6 +1057,269 @@ void resumeAllTasks() {
   resumeTask(firebaseUpload_h, "Firebase Upload");
 }
 
+// Copies the rollup 'age' intervals back (0 is the newest) of a resolution from the rollup_store.
+// Returns false if there is no such rollup.
+bool readRollup(RollupLevel_t level, uint16_t age, RollupPoint_t* point) {
+  portENTER_CRITICAL(&rollup_lock);
+  bool found = rollupStoreGet(&rollup_store, level, age, point);
+  portEXIT_CRITICAL(&rollup_lock);
+  return found;
+}
+
+
+// Prints the rollups requested by the "History <1s|1m|1h> [n]" command, oldest first.
+// 'args' is the rest of the command line after "History". Without n every stored rollup is printed.
+// The rollups are stamped in seconds since boot and converted to local time for printing once the time is known.
+void printHistory(const char* args) {
+  char resolution[4] = {0};
+  unsigned requested = 0;
+  if (sscanf(args, " %3s %u", resolution, &requested) < 1) {
+    Serial.println("Serial Task: Usage 'History <1s|1m|1h> [n]'.");
+    return;
+  }
+
+  RollupLevel_t level;
+  if (strcasecmp(resolution, "1s") == 0) {
+    level = ROLLUP_SECONDS;
+  }
+  else if (strcasecmp(resolution, "1m") == 0) {
+    level = ROLLUP_MINUTES;
+  }
+  else if (strcasecmp(resolution, "1h") == 0) {
+    level = ROLLUP_HOURS;
+  }
+  else {
+    Serial.printf("Serial Task: Unknown resolution '%s', use 1s, 1m or 1h.\n", resolution);
+    return;
+  }
+
+  portENTER_CRITICAL(&rollup_lock);
+  uint16_t count = rollupStoreCount(&rollup_store, level);
+  portEXIT_CRITICAL(&rollup_lock);
+  if (requested > 0 && requested < count) {
+    count = requested;
+  }
+
+  Serial.printf("------------ History %s (%u rollups) ------------\n", resolution, (unsigned)count);
+  Serial.println("Time, Samples, Temperature_C (min..max), Pressure_hPa (min..max)");
+
+  uint32_t now_s = xTaskGetTickCount() * portTICK_PERIOD_MS / 1000;
+  time_t now = time(NULL);
+  bool synced = wall_clock_synced.load();
+  for (uint16_t age = count; age-- > 0;) {
+    RollupPoint_t point;
+    // The oldest rollups may have been overwritten since the count was taken.
+    if (!readRollup(level, age, &point)) {
+      continue;
+    }
+
+    // Before the time is synchronized the rollups are shown with their time since boot.
+    time_t timestamp = now - (time_t)(now_s - point.start_s);
+    struct tm time_info;
+    char time_text[20];
+    localtime_r(&timestamp, &time_info);
+    if (synced) {
+      strftime(time_text, sizeof(time_text), "%Y-%m-%d %H:%M:%S", &time_info);
+    }
+    else {
+      snprintf(time_text, sizeof(time_text), "+%u s", (unsigned)point.start_s);
+    }
+    Serial.printf("%s, %u, %.2f (%.2f..%.2f), %.2f (%.2f..%.2f)\n", time_text, (unsigned)point.count,
+                  point.temperature_mean, point.temperature_min, point.temperature_max,
+                  point.pressure_mean, point.pressure_min, point.pressure_max);
+  }
+}
+
+
+// Builds the folder and day file paths of the log of the day in 'time_info'.
+// The folder is named with the month and year, the file with the day, month and year.
+void buildSdCardPaths(const struct tm* time_info, char* folder_path, char* file_path) {
+  snprintf(folder_path, SD_CARD_FOLDER_PATH_SIZE, "/%s_%d", getMonthName(time_info->tm_mon), time_info->tm_year + 1900);
+  snprintf(file_path, SD_CARD_FILE_PATH_SIZE, "%s/%d_%s_%d.%s", folder_path, time_info->tm_mday, getMonthName(time_info->tm_mon), time_info->tm_year + 1900,
+           SD_LOG_FORMAT == SD_LOG_FORMAT_CSV ? "csv" : "bin");
+}
+
+
+// Parses a local time given as "YYYY-MM-DD" or "YYYY-MM-DDTHH:MM[:SS]" into seconds since 1970.
+bool parseQueryTime(const char* text, uint32_t* time) {
+  struct tm time_info;
+  memset(&time_info, 0, sizeof(time_info));
+  int fields = sscanf(text, "%d-%d-%dT%d:%d:%d", &time_info.tm_year, &time_info.tm_mon, &time_info.tm_mday,
+                      &time_info.tm_hour, &time_info.tm_min, &time_info.tm_sec);
+  if (fields != 3 && fields < 5) {
+    return false;
+  }
+  time_info.tm_year -= 1900;
+  time_info.tm_mon -= 1;
+  time_info.tm_isdst = -1;
+  time_t parsed = mktime(&time_info);
+  if (parsed < 0) {
+    return false;
+  }
+  *time = parsed;
+  return true;
+}
+
+
+// Prints one row of a query: a logged window of a sensor, or with a resolution the average of its windows in one interval.
+void printQueryRow(uint32_t time, uint8_t id, const SensorStats_t* stats) {
+  time_t timestamp = time;
+  struct tm time_info;
+  char time_text[20];
+  localtime_r(&timestamp, &time_info);
+  strftime(time_text, sizeof(time_text), "%Y-%m-%d %H:%M:%S", &time_info);
+  Serial.printf("%s, %u, %u, %.2f, %.2f\n", time_text, id, (unsigned)stats->temperature.count,
+                stats->temperature.mean, stats->pressure.mean);
+}
+
+
+// Streams the windows logged on the SD card between 'from' and 'to' to the serial monitor.
+// With a 'resolution_s' the windows of each sensor are averaged into one row per interval of that length.
+// In the binary formats every sensor has its own blocks, which are written when they are full or
+// SDCARD_FLUSH_INTERVAL_MS old, so the records of different sensors can be out of time order by up to
+// SD_LOG_SENSOR_REORDER_S. The range is then read that much wider on both ends.
+// Every day file of the range is opened at the indexed record just before 'from' (see sd_log_index.h),
+// so the time to find the start does not depend on how much was logged before it.
+// The spi_mutex is only held while reading from the card, one buffer at a time, so the
+// SD card logger keeps running during a long query. Records still buffered in RAM by the
+// sd_log_writer show up after its next flush.
+void querySdLog(uint32_t from, uint32_t to, uint32_t resolution_s) {
+  // Kept out of the task stack since it holds a read buffer and a decoded binary block.
+  static SdLogReader_t reader;
+
+  if (!deviceAvailable(DEVICE_SD_CARD)) {
+    Serial.println("Serial Task: SD card missing.");
+    return;
+  }
+
+  uint32_t start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  uint32_t first_row_ms = 0, rows = 0, records = 0, bytes_read = 0, index_reads = 0, files = 0;
+  SensorStats_t stats[SENSOR_COUNT];
+  uint32_t interval_start[SENSOR_COUNT];
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    sensorStatsReset(&stats[id]);
+  }
+  uint32_t slack_s = SD_LOG_FORMAT != SD_LOG_FORMAT_CSV && SENSOR_COUNT > 1 ? SD_LOG_SENSOR_REORDER_S : 0;
+
+  Serial.println("------------ Query ------------");
+  Serial.println("Time, Sensor, Windows, Temperature_C, Pressure_hPa");
+
+  // Start at midnight of the first day and visit every day file up to the end of the range.
+  time_t day_time = from;
+  struct tm day;
+  localtime_r(&day_time, &day);
+  day.tm_hour = day.tm_min = day.tm_sec = 0;
+  day.tm_isdst = -1;
+  for (time_t day_start = mktime(&day); day_start <= (time_t)to; day.tm_mday++, day.tm_isdst = -1, day_start = mktime(&day)) {
+    char folder_path[SD_CARD_FOLDER_PATH_SIZE];
+    char file_path[SD_CARD_FILE_PATH_SIZE];
+    buildSdCardPaths(&day, folder_path, file_path);
+
+    bool opened = false;
+    if (mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+      opened = sdLogReaderOpen(&reader, file_path, &day, from - slack_s);
+      mutexGive(&spi_mutex);
+    }
+    if (!opened) {
+      continue;
+    }
+    files++;
+    index_reads += reader.index_reads;
+
+    bool done = false;
+    while (!done) {
+      BinaryLogRecord_t record;
+      SdLogReadStatus_t status = sdLogReaderNext(&reader, &record);
+
+      if (status == SD_LOG_READ_NEED_DATA) {
+        if (mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+          sdLogReaderFill(&reader);
+          mutexGive(&spi_mutex);
+        }
+        else {
+          done = true;
+        }
+        continue;
+      }
+      if (status == SD_LOG_READ_END || record.time > to + slack_s) {
+        done = true;
+        continue;
+      }
+      // Records of sensors that are no longer configured are left out.
+      if (record.time < from || record.time > to || record.sensor_id >= SENSOR_COUNT) {
+        continue;
+      }
+      records++;
+
+      // Print the window as is, or close the interval of its sensor it does not belong to.
+      uint8_t id = record.sensor_id;
+      if (resolution_s > 0 && stats[id].temperature.count > 0 && record.time - interval_start[id] >= resolution_s) {
+        printQueryRow(interval_start[id], id, &stats[id]);
+        sensorStatsReset(&stats[id]);
+        rows++;
+      }
+      if (stats[id].temperature.count == 0) {
+        interval_start[id] = resolution_s > 0 ? record.time - (record.time - from) % resolution_s : record.time;
+      }
+      sensorStatsAdd(&stats[id], &record.data);
+      if (resolution_s == 0) {
+        printQueryRow(interval_start[id], id, &stats[id]);
+        sensorStatsReset(&stats[id]);
+        rows++;
+      }
+      if (rows == 1 && first_row_ms == 0) {
+        first_row_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+      }
+    }
+
+    bytes_read += reader.bytes_read;
+    if (mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+      sdLogReaderClose(&reader);
+      mutexGive(&spi_mutex);
+    }
+  }
+
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    if (stats[id].temperature.count > 0) {
+      printQueryRow(interval_start[id], id, &stats[id]);
+      rows++;
+    }
+  }
+
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  Serial.printf("Serial Task: %u rows from %u windows in %u files, %u bytes read, %u index reads, first row after %u ms, %u ms total.\n",
+                (unsigned)rows, (unsigned)records, (unsigned)files, (unsigned)bytes_read, (unsigned)index_reads,
+                (unsigned)(first_row_ms > 0 ? first_row_ms - start_ms : 0), (unsigned)(now_ms - start_ms));
+}
+
+
+// Handles "Query <from> <to> [resolution]", 'args' is the rest of the command line after "Query".
+// The times are local times as "YYYY-MM-DD" or "YYYY-MM-DDTHH:MM[:SS]", the resolution is
+// a number of seconds optionally followed by s, m or h.
+void processQueryCommand(const char* args) {
+  char from_text[20] = {0}, to_text[20] = {0}, resolution_text[8] = {0};
+  uint32_t from, to, resolution_s = 0;
+
+  int fields = sscanf(args, " %19s %19s %7s", from_text, to_text, resolution_text);
+  if (fields < 2 || !parseQueryTime(from_text, &from) || !parseQueryTime(to_text, &to) || to < from) {
+    Serial.println("Serial Task: Usage 'Query <from> <to> [resolution]', e.g. 'Query 2026-10-01 2026-10-17T12:00 1h'.");
+    return;
+  }
+
+  if (fields == 3) {
+    unsigned value = 0;
+    char unit = 's';
+    if (sscanf(resolution_text, "%u%c", &value, &unit) < 1 || value == 0) {
+      Serial.printf("Serial Task: Invalid resolution '%s'.\n", resolution_text);
+      return;
+    }
+    resolution_s = value * (unit == 'h' ? 3600 : unit == 'm' ? 60 : 1);
+  }
+
+  querySdLog(from, to, resolution_s);
+}
+
+
 // Processes the serial input command.
 // It checks the command against a list of known commands and performs the corresponding action.
 // If the entered command is not recognized, it prints an error message.
@@ -310,6 +1329,46 @@ void processSerialInput(char* input) {
   if (strcasecmp(input, "Help") == 0) {
     listAvailableCommands();
   }
+  else if (strcasecmp(input, "Health") == 0) {
+    Serial.println("------------ Device Health ------------");
+    for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+      printDeviceHealth(&sensor_health[id]);
+    }
+    printDeviceHealth(&display_health);
+    printDeviceHealth(&sd_card_health);
+    Serial.printf("Data lost per sink: SD card %u windows (%u backlogged), %u samples overrun; Firebase %u windows, %u samples overrun; display %u frames.\n",
+                  (unsigned)(sd_card_backlog.dropped + sd_log_writer.dropped_records), (unsigned)sd_card_backlog.count,
+                  (unsigned)sd_card_cursor.overruns, (unsigned)firebase_queue.dropped, (unsigned)firebase_cursor.overruns,
+                  (unsigned)display_frames_dropped);
+    printWifiLink();
+  }
+  else if (strcasecmp(input, "Stats") == 0) {
+    Serial.println("------------ Task Statistics ------------");
+    printTaskStats(true);
+    printHeapStats();
+  }
+  else if (strcasecmp(input, "Locks") == 0) {
+    Serial.println("------------ Mutex Statistics ------------");
+    printMutexStats(&i2c_mutex);
+    if (i2cBusUsed(1)) {
+      printMutexStats(&i2c1_mutex);
+    }
+    printMutexStats(&spi_mutex);
+  }
+  else if (strcasecmp(input, "Uploads") == 0) {
+    Serial.println("------------ Firebase Uploads ------------");
+    printUploadStats();
+  }
+  else if (strcasecmp(input, "Sensors") == 0) {
+    Serial.println("------------ Sensors ------------");
+    printSensorStats();
+  }
+  else if (strncasecmp(input, "Query", 5) == 0) {
+    processQueryCommand(input + 5);
+  }
+  else if (strncasecmp(input, "History", 7) == 0) {
+    printHistory(input + 7);
+  }
   else if (strcasecmp(input, "Start") == 0) {
     resumeAllTasks();
   }
@@ -357,318 +1416,1295 @@ void processSerialInput(char* input) {
 //===========================================================================================
 
 
-// When a i2c_mutex is acquired this task reads the temperature and pressure from the BMP280 sensor to a local SensorData_t.
-// It then updates the global sensor_data struct with the latest readings once it has acquired the sensor_mutex.
-// Both these mutexes ensure that the sensor data is read and updated safely without concurrent access issues.
-// This task runs at fixed intervals defined by SENSOR_READ_INTERVAL_MS.
-void readSensor(void* p) {
-  // Local variable to hold the latest sensor data.
-  SensorData_t fresh_sensor_data;
+// Triggers a forced measurement on every sensor in 'due' (a mask of sensor IDs) on one bus
+// with a single hold of the bus mutex. A sensor that fails to start is recorded as a failed read.
+// It returns the mask of the sensors whose measurement was started.
+uint8_t startSensorGroup(uint8_t bus, uint8_t due, uint32_t now_ms) {
+  const I2cBus_t* i2c = &I2C_BUSES[bus];
+  if (!mutexTake(i2c->mutex, I2C_MUTEX_WAIT_MS)) {
+    return 0;
+  }
+  uint32_t start_us = micros();
+  uint8_t started = 0;
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    if (due & (1 << id)) {
+      bool ok = bmp280StartMeasurement(&bmp[id]);
+      deviceHealthReport(&sensor_health[id], ok);
+      started |= ok ? 1 << id : 0;
+    }
+  }
+  sensorRegistryBusHold(&sensor_registry, bus, micros() - start_us);
+  mutexGive(i2c->mutex);
 
-  while(1) {
-    // Acquire the I2C mutex to safely read from the BMP280 sensor.
-    if (xSemaphoreTake(i2c_mutex, MS_TO_TICKS(I2C_MUTEX_WAIT_MS)) == pdTRUE) {
-      // Check if the hardware is functioning correctly.
-      if (!hardware_ok) {
-        continue;
-      }
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    if ((due & ~started) & (1 << id)) {
+      sensorRegistryRecord(&sensor_registry, id, NULL, now_ms);
+    }
+  }
+  return started;
+}
 
-      // Read the temperature and pressure from the BMP280 sensor.
-      fresh_sensor_data.temperature = bmp.readTemperature();
-      fresh_sensor_data.pressure = bmp.readPressure() / 100.0;
 
-      // Release the I2C mutex after reading the sensor data.
-      xSemaphoreGive(i2c_mutex);
+// Reads the latest measurement of every sensor in 'due' on one bus with one burst read each,
+// all within a single hold of the bus mutex, and records the readings in the sensor_registry.
+// It returns the mask of the sensors that were read.
+uint8_t readSensorGroup(uint8_t bus, uint8_t due, uint32_t now_ms) {
+  const I2cBus_t* i2c = &I2C_BUSES[bus];
+  if (!mutexTake(i2c->mutex, I2C_MUTEX_WAIT_MS)) {
+    return 0;
+  }
+  uint32_t start_us = micros();
+  uint8_t read = 0;
+  SensorData_t readings[SENSOR_COUNT];
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    if (due & (1 << id)) {
+      uint32_t errors = bmp[id].errors;
+      read |= bmp280ReadMeasurement(&bmp[id], &readings[id]) ? 1 << id : 0;
+      deviceHealthReport(&sensor_health[id], bmp[id].errors == errors);
     }
+  }
+  sensorRegistryBusHold(&sensor_registry, bus, micros() - start_us);
+  mutexGive(i2c->mutex);
 
-    // Acquire the sensor mutex to safely update the global sensor_data struct.
-    if (xSemaphoreTake(sensor_mutex, MS_TO_TICKS(SENSOR_MUTEX_WAIT_MS)) == pdTRUE) {
-      // Update the global sensor_data struct with the latest readings.
-      sensor_data.temperature = fresh_sensor_data.temperature;
-      sensor_data.pressure = fresh_sensor_data.pressure;
-      
-      // Release the sensor mutex after updating the global sensor_data struct.
-      xSemaphoreGive(sensor_mutex);
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    if (due & (1 << id)) {
+      sensorRegistryRecord(&sensor_registry, id, (read & (1 << id)) ? &readings[id] : NULL, now_ms);
     }
-
-    vTaskDelay(MS_TO_TICKS(SENSOR_READ_INTERVAL_MS));
   }
+  return read;
 }
 
 
-//===========================================================================================
-//                                      Display Task
-//===========================================================================================
+// This task takes the readings of every sensor in SENSORS in the configured SENSOR_MODE and turns them into published samples.
+// Every period the sensor_registry tells which sensors are due, and their transactions are grouped per bus:
+// in low power mode the forced measurements of all due sensors are started with one hold of each bus mutex,
+// the task waits for the conversion once outside of the mutexes so the bus is free for the display,
+// and then reads all results with one more hold per bus. In high rate mode the sensors run in normal mode
+// and only the read is needed. SENSOR_DECIMATION readings of a sensor are averaged into one sample by its decimator.
+// Each sample is published through the latest_samples seqlock of its sensor along with its sensor ID,
+// a per-sensor sequence number and a timestamp, and the samples of SENSOR_PRIMARY are folded into the rollup_store history.
+// Publishing never blocks, so a slow consumer can not delay the sensors and no reading is lost to a mutex timeout.
+// The task runs at absolute times SENSOR_SAMPLE_INTERVAL_MS apart (see waitForNextPeriod),
+// so the sample rate does not drift with the time spent waiting for the bus and the sensors
+// and a window of MAX_SDCARD_SAMPLES samples covers MAX_SDCARD_SAMPLES * SENSOR_READ_INTERVAL_MS of wall time.
+// It periodically reports the reading rate and the share of time it used the I2C buses and ran.
+void readSensor(void* p) {
+  // Local variables to hold the latest sample and the sequence number of every sensor.
+  Sample_t fresh_sample;
+  uint32_t sequences[SENSOR_COUNT] = {0};
+
+  // Average the high rate readings of each sensor down to the output rate.
+  Decimator_t decimators[SENSOR_COUNT];
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    decimatorInit(&decimators[id], SENSOR_DECIMATION);
+  }
 
+  // The conversion time only depends on the configuration.
+  const uint32_t measurement_time_ms = bmp280MeasurementTimeMs(SENSOR_CONFIG);
 
-// This task updates the SSD1306 display with the latest sensor data.
-// It first acquires the sensor_mutex to safely read the latest sensor_data to a local SensorData_t.
-// It then acquires the i2c_mutex to ensure safe access to the display
-// It then clears the display, sets the text color and size, and then prints the temperature and pressure readings.
-// It runs at fixed intervals defined by DISPLAY_UPDATE_INTERVAL_MS.
-void displayData(void* p) {
-  // Local variable to hold the latest sensor data.
-  SensorData_t local_sensor_data;
+  // Statistics of the current reporting interval, and the sensor_registry totals at its start.
+  uint32_t busy_us = 0, reported_readings = 0, reported_bus_us = 0, reported_bus_holds = 0;
+  uint32_t stats_start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
 
-  while(1) {
-    // Acquire the sensor mutex to safely read the latest sensor data.
-    if (xSemaphoreTake(sensor_mutex, MS_TO_TICKS(SENSOR_MUTEX_WAIT_MS)) == pdTRUE) {
-      // Copy the latest sensor data to a local variable.
-      local_sensor_data = sensor_data;
+  // Readings are scheduled at absolute times, SENSOR_SAMPLE_INTERVAL_MS apart.
+  TickType_t release_time = xTaskGetTickCount();
 
-      // Release the sensor mutex after reading the data.
-      xSemaphoreGive(sensor_mutex);
+  while(1) {
+    uint32_t iteration_start_us = micros();
+    taskProfileBegin(&readSensor_profile, iteration_start_us);
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    // Find the due sensors that are working, per bus.
+    uint8_t due[SENSOR_REGISTRY_BUSES];
+    uint8_t any_due = 0;
+    for (uint8_t bus = 0; bus < SENSOR_REGISTRY_BUSES; bus++) {
+      due[bus] = sensorRegistryDue(&sensor_registry, bus, now_ms) & available_sensors.load(std::memory_order_relaxed);
+      any_due |= due[bus];
     }
 
-    // Acquire the i2c mutex to safely access the display.
-    if (xSemaphoreTake(i2c_mutex, MS_TO_TICKS(I2C_MUTEX_WAIT_MS)) == pdTRUE) {
-      // Check if the hardware is functioning correctly.
-      if (!hardware_ok) {
-        xSemaphoreGive(i2c_mutex);
-        continue;
+    // Start the forced measurements of every bus, then wait for all of them at once.
+    if (SENSOR_MODE == SENSOR_MODE_LOW_POWER && any_due != 0) {
+      any_due = 0;
+      for (uint8_t bus = 0; bus < SENSOR_REGISTRY_BUSES; bus++) {
+        due[bus] = due[bus] != 0 ? startSensorGroup(bus, due[bus], now_ms) : 0;
+        any_due |= due[bus];
       }
+      if (any_due != 0) {
+        vTaskDelay(MS_TO_TICKS(measurement_time_ms));
+      }
+    }
 
-      // Clear the display and set the text color and size.
-      display.clearDisplay();
-      display.setTextColor(DISPLAY_TEXT_COLOR);
-      display.setTextSize(DISPLAY_TEXT_SIZE);
-      display.setCursor(DISPLAY_CURSOR_X, DISPLAY_CURSOR_Y);
-
-      display.println("  BMP280:");
-
-      // Print the temperature reading in Celsius
-      display.print(local_sensor_data.temperature); 
-      display.println(" C");
+    uint8_t read = 0;
+    for (uint8_t bus = 0; bus < SENSOR_REGISTRY_BUSES; bus++) {
+      read |= due[bus] != 0 ? readSensorGroup(bus, due[bus], now_ms) : 0;
+    }
 
-      // Print the temperature reading in Fahrenheit
-      display.print(toFahrenheit(local_sensor_data.temperature)); 
-      display.println(" F");
+    // Publish the samples to all consumers and wake up the ones waiting for them.
+    bool published = false;
+    for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+      if (!(read & (1 << id))) {
+        continue;
+      }
+      SensorData_t reading = sensorRegistryReading(&sensor_registry, id);
+      if (!decimatorAdd(&decimators[id], &reading, &fresh_sample.data)) {
+        continue;
+      }
 
-      // Print the pressure reading in hPa
-      display.print(local_sensor_data.pressure); 
-      display.println(" hPa");
+      fresh_sample.sensor_id = id;
+      fresh_sample.sequence = ++sequences[id];
+      fresh_sample.timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+      seqlockPublish(&latest_samples[id], &fresh_sample);
+      if (fresh_sample.sequence == 1) {
+        Serial.printf("Read Sensor: First sample of %s %u ms after boot.\n", SENSORS[id].name, (unsigned)millis());
+      }
+      sampleRingPush(&sample_ring, &fresh_sample);
+      if (id == SENSOR_PRIMARY) {
+        portENTER_CRITICAL(&rollup_lock);
+        rollupStoreAdd(&rollup_store, fresh_sample.timestamp_ms / 1000, &fresh_sample.data);
+        portEXIT_CRITICAL(&rollup_lock);
+      }
+      published = true;
 
-      display.display();
+      if (SENSOR_DECIMATION > 1 && decimators[id].pressure_range > PRESSURE_TRANSIENT_HPA) {
+        Serial.printf("Read Sensor: Pressure transient of %.2f hPa on %s.\n", decimators[id].pressure_range, SENSORS[id].name);
+      }
+    }
+    if (published) {
+      notifySampleConsumers();
+    }
 
-      // Release the i2c mutex after updating the display.
-      xSemaphoreGive(i2c_mutex);
+    // Report the reading rate and the bus and task utilization at fixed intervals.
+    // In low power mode the task time includes the wait for the conversion.
+    busy_us += micros() - iteration_start_us;
+    now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (now_ms - stats_start_ms >= SENSOR_STATS_INTERVAL_MS) {
+      uint32_t readings = 0, bus_us = 0, bus_holds = 0;
+      for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+        readings += sensor_registry.readings[id];
+      }
+      for (uint8_t bus = 0; bus < SENSOR_REGISTRY_BUSES; bus++) {
+        bus_us += sensor_registry.bus_us[bus];
+        bus_holds += sensor_registry.bus_holds[bus];
+      }
+      float elapsed_us = (now_ms - stats_start_ms) * 1000.0;
+      Serial.printf("Read Sensor: %.1f readings/s from %u sensors, %.1f bus holds/s, %.2f%% I2C bus, %.2f%% task time.\n",
+                    (readings - reported_readings) * 1000000.0 / elapsed_us, (unsigned)SENSOR_COUNT,
+                    (bus_holds - reported_bus_holds) * 1000000.0 / elapsed_us, (bus_us - reported_bus_us) * 100.0 / elapsed_us,
+                    busy_us * 100.0 / elapsed_us);
+      reported_readings = readings;
+      reported_bus_us = bus_us;
+      reported_bus_holds = bus_holds;
+      busy_us = 0;
+      stats_start_ms = now_ms;
     }
 
-    vTaskDelay(MS_TO_TICKS(DISPLAY_UPDATE_INTERVAL_MS));
+    taskProfileEnd(&readSensor_profile, micros());
+    waitForNextPeriod(&release_time, SENSOR_SAMPLE_INTERVAL_MS, &readSensor_profile);
   }
 }
 
 
 //===========================================================================================
-//                                     SD Card Task
+//                                      Display Task
 //===========================================================================================
 
 
-// This task logs sensor data to an SD card at fixed intervals.
-// It first acquires the sensor_mutex to safely read the latest sensor_data to a local array of SensorData_t.
-// Once the local array reaches the maximum number of samples defined by MAX_SDCARD_SAMPLES
-// it calculates the average temperature and pressure from the local array.
-// It then acquires the spi_mutex to ensure safe access to the SD card.
-// It then writes the average sensor data to the file in CSV format along with time
-// to a folder named with the current month and year, and a file named with the current day, month, and year.
-// If the folder or file does not exist, it creates them.
-void sdCardLogger(void* p) {
-  // Local array to hold sensor data samples for averaging.
-  SensorData_t local_sensor_data[MAX_SDCARD_SAMPLES];
-  uint8_t sensor_data_count = 0;
+// Sends the columns 'first_column' to 'last_column' of one page of the framebuffer to the display.
+// The SSD1306 is told to only accept writes to that window, then the data is sent in chunks.
+// It returns the number of bytes sent over I2C (excluding address bytes).
+// Must be called with the i2c_mutex held.
+uint16_t sendDisplayRegion(const uint8_t* frame, uint8_t page, uint8_t first_column, uint8_t last_column) {
+  // Each command is sent as a control byte followed by the command byte.
+  display.ssd1306_command(SSD1306_PAGEADDR);
+  display.ssd1306_command(page);
+  display.ssd1306_command(page);
+  display.ssd1306_command(SSD1306_COLUMNADDR);
+  display.ssd1306_command(first_column);
+  display.ssd1306_command(last_column);
+  uint16_t bytes = 6 * 2;
+
+  const uint8_t* data = frame + page * SCREEN_WIDTH + first_column;
+  uint16_t remaining = last_column - first_column + 1;
+
+  Wire.setClock(DISPLAY_I2C_CLOCK_HZ);
+  while (remaining > 0) {
+    uint8_t chunk = remaining < DISPLAY_I2C_CHUNK_SIZE ? remaining : DISPLAY_I2C_CHUNK_SIZE;
+    Wire.beginTransmission(SCREEN_ADDRESS);
+    Wire.write((uint8_t)0x40);  // Control byte: the following bytes are display data.
+    Wire.write(data, chunk);
+    deviceHealthReport(&display_health, Wire.endTransmission() == 0);
+    data += chunk;
+    remaining -= chunk;
+    bytes += chunk + 1;
+  }
+  Wire.setClock(I2C_CLOCK_HZ);
 
-  // Local variable to hold the average sensor data.
-  SensorData_t avg_sensor_data;
+  return bytes;
+}
 
-  while(1) {
-    // Acquire the sensor mutex to safely read the latest sensor data into local array.
-    if (xSemaphoreTake(sensor_mutex, MS_TO_TICKS(SENSOR_MUTEX_WAIT_MS)) == pdTRUE) {
-      // Copy the latest sensor data to the local array.
-      local_sensor_data[sensor_data_count++] = sensor_data;
 
-      xSemaphoreGive(sensor_mutex);
-    }
+// Sends the rendered framebuffer to the display.
+// If the display content is unknown (first frame or after re-initialization) the whole frame is sent.
+// Otherwise it is compared with the shadow copy and only the changed columns of the changed pages are sent.
+// It returns the number of bytes sent over I2C. Must be called with the i2c_mutex held.
+uint16_t transferDisplayFrame() {
+  uint8_t* frame = display.getBuffer();
 
-    if (sensor_data_count == MAX_SDCARD_SAMPLES) {
-      //  If we have collected enough samples calculate the averages.
-      avg_sensor_data.temperature = calculateAverageTemp(local_sensor_data, sensor_data_count);
-      avg_sensor_data.pressure = calculateAveragePressure(local_sensor_data, sensor_data_count);
-      sensor_data_count = 0;
+  if (!display_shadow_valid.load()) {
+    display.display();
+    memcpy(display_shadow, frame, DISPLAY_FRAME_SIZE);
+    display_shadow_valid.store(true);
+    return DISPLAY_FULL_FRAME_I2C_BYTES;
+  }
 
-      // Get the current time to use in file.
-      struct tm time_info;
-      if (!getLocalTime(&time_info)) {
-        Serial.println("SD Card Task: Failed to get time. Skipping log.");
-        continue;
-      }
-      
-      // Create the folder and file paths based on the current month and year.
-      char folder_path[SD_CARD_FOLDER_PATH_SIZE];
-      snprintf(folder_path, sizeof(folder_path), "/%s_%d", getMonthName(time_info.tm_mon), time_info.tm_year + 1900);
+  DisplayDirtyPage_t dirty[DISPLAY_PAGES];
+  if (displayDiff(frame, display_shadow, SCREEN_WIDTH, DISPLAY_PAGES, dirty) == 0) {
+    return 0;
+  }
 
-      // Create the file path with the current day, month, and year.
-      char file_path[SD_CARD_FILE_PATH_SIZE];
-      snprintf(file_path, sizeof(file_path), "%s/%d_%s_%d.csv", folder_path, time_info.tm_mday, getMonthName(time_info.tm_mon), time_info.tm_year + 1900);
+  uint16_t bytes = 0;
+  for (uint8_t page = 0; page < DISPLAY_PAGES; page++) {
+    if (!dirty[page].dirty) {
+      continue;
+    }
+    bytes += sendDisplayRegion(frame, page, dirty[page].first_column, dirty[page].last_column);
 
-      // Acquire the SPI mutex to safely access the SD card.
-      if (xSemaphoreTake(spi_mutex, MS_TO_TICKS(SPI_MUTEX_WAIT_MS)) == pdTRUE) {
-        // Check if the hardware is functioning correctly.
-        if (!hardware_ok) {
-          continue;
-        }
+    // Remember what the display now shows.
+    uint16_t offset = page * SCREEN_WIDTH + dirty[page].first_column;
+    memcpy(display_shadow + offset, frame + offset, dirty[page].last_column - dirty[page].first_column + 1);
+  }
+  return bytes;
+}
 
-        // Check if valid folder exists if not create it.
-        if (!SD.exists(folder_path)) {
-          // If folder still doesn't get created skig log.
-          if (!SD.mkdir(folder_path)) {
-            Serial.println("SD Card Task: Folder creation failed. Skipping log.");
-            xSemaphoreGive(spi_mutex);
-            continue;
-          }
-        }
 
-        // Check if valid file exists if not create it.
-        if (!SD.exists(file_path)) {
-          File file = SD.open(file_path, FILE_WRITE);
-          // If file is created successfully write header.
-          if (file) {
-            file.println("Time,Temperature_C,Temperature_F,Pressure_hPa");
-            file.close();
-          }
-          // If file creation fails skip log.
-          else {
-            Serial.println("SD Card Task: File creation failed. Skipping log.");
-            xSemaphoreGive(spi_mutex);
-            continue;
-          }
-        }
+// Computes the pressure trend in hPa per hour from the 1 minute rollups: the difference between the newest
+// rollup and the one up to PRESSURE_TREND_MAX_MINUTES older, scaled to one hour.
+// Returns false until PRESSURE_TREND_MIN_MINUTES rollups exist.
+bool pressureTrend(float* hpa_per_hour) {
+  RollupPoint_t newest, oldest;
 
-        // Open the file in append mode to write the average sensor data.
-        File file = SD.open(file_path, FILE_APPEND);
-        if (file) {
-          char time[SD_CARD_TIME_SIZE];
-          // Format the current time as HH:MM:SS.
-          strftime(time, sizeof(time), "%H:%M:%S", &time_info);
-
-          // Write the average sensor data to the file in CSV format.
-          Serial.println("SD Card Task: Writing data to SD card.");
-          file.printf("%s,%.2f,%.2f,%.2f\n", time, avg_sensor_data.temperature, toFahrenheit(avg_sensor_data.temperature), avg_sensor_data.pressure);
-          file.close();
-        }
-        // If file write fails print error and skip log.
-        else {
-          Serial.println("SD Card Task: File write failed. Skipping log.");
-          xSemaphoreGive(spi_mutex);
-          continue;
+  portENTER_CRITICAL(&rollup_lock);
+  uint16_t count = rollupStoreCount(&rollup_store, ROLLUP_MINUTES);
+  uint16_t age = count > PRESSURE_TREND_MAX_MINUTES ? PRESSURE_TREND_MAX_MINUTES : count - 1;
+  bool found = count >= PRESSURE_TREND_MIN_MINUTES &&
+               rollupStoreGet(&rollup_store, ROLLUP_MINUTES, 0, &newest) &&
+               rollupStoreGet(&rollup_store, ROLLUP_MINUTES, age, &oldest);
+  portEXIT_CRITICAL(&rollup_lock);
+
+  if (!found) {
+    return false;
+  }
+  *hpa_per_hour = (newest.pressure_mean - oldest.pressure_mean) * 60.0 / age;
+  return true;
+}
+
+
+// This task updates the SSD1306 display with the latest sensor data.
+// It first reads the latest published sample from the latest_samples seqlock and formats the values as text.
+// With several SENSORS it shows one sensor at a time, each for DISPLAY_SENSOR_FRAMES frames,
+// with its sensor ID in the title (and in front of the trend on the page of SENSOR_PRIMARY).
+// If the text is the same as what is already shown nothing is done at all.
+// Otherwise it acquires the i2c_mutex, clears the framebuffer, prints the pressure trend, temperature and pressure readings
+// and sends only the changed parts of the frame to the display (see transferDisplayFrame).
+// It periodically reports the I2C bytes per frame and how long it held the i2c_mutex.
+// It runs at fixed intervals defined by DISPLAY_UPDATE_INTERVAL_MS, scheduled at absolute times.
+void displayData(void* p) {
+  // Local variable to hold the latest sensor data, and the sensor shown and for how many frames so far.
+  Sample_t local_sample;
+  uint8_t shown_sensor = 0, sensor_frames = 0;
+
+  // The formatted readings of the new frame and of the frame on the display.
+  char lines[DISPLAY_LINES][DISPLAY_LINE_SIZE];
+  char shown_lines[DISPLAY_LINES][DISPLAY_LINE_SIZE];
+  memset(shown_lines, 0, sizeof(shown_lines));
+
+  // Statistics of the current reporting interval.
+  uint32_t frames_sent = 0, frames_skipped = 0, i2c_bytes = 0, hold_us_total = 0, hold_us_max = 0;
+  uint32_t stats_start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+  // Frames are scheduled at absolute times, DISPLAY_UPDATE_INTERVAL_MS apart.
+  TickType_t release_time = xTaskGetTickCount();
+
+  while(1) {
+    taskProfileBegin(&displayData_profile, micros());
+
+    // Move on to the next sensor once the current one has been shown long enough.
+    if (++sensor_frames > DISPLAY_SENSOR_FRAMES) {
+      shown_sensor = (shown_sensor + 1) % SENSOR_COUNT;
+      sensor_frames = 1;
+    }
+
+    // Copy the latest sensor data to a local variable.
+    // If nothing has been published yet a zeroed reading is shown.
+    if (!seqlockRead(&latest_samples[shown_sensor], &local_sample)) {
+      memset(&local_sample, 0, sizeof(local_sample));
+    }
+
+    // Format the readings the same way they are printed on the display.
+    // The title is replaced by the pressure trend once there is enough history.
+    memset(lines, 0, sizeof(lines));
+    float trend;
+    bool has_trend = shown_sensor == SENSOR_PRIMARY && pressureTrend(&trend);
+    if (has_trend && SENSOR_COUNT == 1) {
+      snprintf(lines[0], DISPLAY_LINE_SIZE, "dP %+.2f/h", trend);
+    }
+    else if (has_trend) {
+      snprintf(lines[0], DISPLAY_LINE_SIZE, "S%u %+.2f/h", shown_sensor, trend);
+    }
+    else if (SENSOR_COUNT == 1) {
+      snprintf(lines[0], DISPLAY_LINE_SIZE, "  BMP280:");
+    }
+    else {
+      snprintf(lines[0], DISPLAY_LINE_SIZE, "Sensor %u:", shown_sensor);
+    }
+    snprintf(lines[1], DISPLAY_LINE_SIZE, "%.2f C", local_sample.data.temperature);
+    snprintf(lines[2], DISPLAY_LINE_SIZE, "%.2f F", toFahrenheit(local_sample.data.temperature));
+    snprintf(lines[3], DISPLAY_LINE_SIZE, "%.2f hPa", local_sample.data.pressure);
+
+    // Skip the frame entirely if the display already shows these values.
+    if (display_shadow_valid.load() && memcmp(lines, shown_lines, sizeof(lines)) == 0) {
+      frames_skipped++;
+    }
+    // The frame is lost if the display is missing.
+    else if (!deviceAvailable(DEVICE_DISPLAY)) {
+      display_frames_dropped++;
+    }
+    // Acquire the i2c mutex to safely access the display.
+    else if (mutexTake(&i2c_mutex, I2C_MUTEX_WAIT_MS)) {
+      uint32_t hold_start_us = micros();
+
+      // Only draw if the display is still working.
+      if (deviceAvailable(DEVICE_DISPLAY)) {
+        // Clear the display and set the text color and size.
+        display.clearDisplay();
+        display.setTextColor(DISPLAY_TEXT_COLOR);
+        display.setTextSize(DISPLAY_TEXT_SIZE);
+        display.setCursor(DISPLAY_CURSOR_X, DISPLAY_CURSOR_Y);
+
+        // Print the title or trend, the temperature in Celsius and Fahrenheit and the pressure in hPa.
+        for (uint8_t i = 0; i < DISPLAY_LINES; i++) {
+          display.println(lines[i]);
         }
 
-        // Release the SPI mutex after writing to the SD card.
-        xSemaphoreGive(spi_mutex);
+        i2c_bytes += transferDisplayFrame();
+        frames_sent++;
+        memcpy(shown_lines, lines, sizeof(lines));
       }
+
+      uint32_t hold_us = micros() - hold_start_us;
+
+      // Release the i2c mutex after updating the display.
+      mutexGive(&i2c_mutex);
+
+      hold_us_total += hold_us;
+      if (hold_us > hold_us_max) {
+        hold_us_max = hold_us;
+      }
+    }
+
+    // Report the display statistics at fixed intervals.
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (now_ms - stats_start_ms >= DISPLAY_STATS_INTERVAL_MS) {
+      Serial.printf("Display Task: %u frames sent, %u skipped, %u I2C bytes per frame (full frame %u), %u us i2c_mutex hold per frame (max %u).\n",
+                    (unsigned)frames_sent, (unsigned)frames_skipped,
+                    (unsigned)(frames_sent > 0 ? i2c_bytes / frames_sent : 0), (unsigned)DISPLAY_FULL_FRAME_I2C_BYTES,
+                    (unsigned)(frames_sent > 0 ? hold_us_total / frames_sent : 0), (unsigned)hold_us_max);
+      frames_sent = frames_skipped = i2c_bytes = hold_us_total = hold_us_max = 0;
+      stats_start_ms = now_ms;
     }
 
-    vTaskDelay(MS_TO_TICKS(SDCARD_SAMPLE_INTERVAL_MS));
+    taskProfileEnd(&displayData_profile, micros());
+    waitForNextPeriod(&release_time, DISPLAY_UPDATE_INTERVAL_MS, &displayData_profile);
   }
 }
 
 
 //===========================================================================================
-//                                    Firebase Task
+//                                     SD Card Task
 //===========================================================================================
 
 
-// This task uploads sensor data to Firebase at fixed intervals.
-// It first acquires the sensor_mutex to safely read the latest sensor_data to a local array of SensorData_t.
-// Once the local array reaches the maximum number of samples defined by MAX_FIREBASE_SAMPLES
-// it calculates the average temperature and pressure from the local array.
-// It then uploads the average sensor data to Firebase under the defined FIREBASE_PATH.
-// It uses the FirebaseClient library's asynchronous API to perform the upload.
-// If Firebase is not ready, it skips the upload and prints a message to the serial monitor
-void firebaseUpload(void* p) {
-  // Local array to hold sensor data samples for averaging.
-  SensorData_t local_sensor_data[MAX_FIREBASE_SAMPLES];
-  uint8_t sensor_data_count = 0;
+// Appends 'length' bytes logged at 'time' to 'file_path' through the buffered sd_log_writer, which also indexes them.
+// The writer only accesses the card on a day rollover, a full sector or the flush interval,
+// otherwise the bytes are just copied into RAM and the spi_mutex is held only for the copy.
+// It is still held then since the System Monitor closes the writer before it re-initializes the card (see initSdCard).
+void appendToSdCard(const char* folder_path, const char* file_path, const char* header, uint32_t time, const uint8_t* data, size_t length) {
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  uint32_t flushes = sd_log_writer.flushes;
+  bool needs_card = sdLogWriterNeedsCard(&sd_log_writer, file_path, length, now_ms);
+
+  // Acquire the SPI mutex to safely access the SD card and the writer.
+  if (mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+    uint32_t hold_start_us = micros();
+    uint32_t write_errors = sd_log_writer.write_errors;
+
+    if (!sdLogWriterAppend(&sd_log_writer, folder_path, file_path, header, time, data, length, now_ms)) {
+      Serial.println("SD Card Task: SD card write failed. Skipping log.");
+    }
+    if (needs_card) {
+      deviceHealthReport(&sd_card_health, sd_log_writer.write_errors == write_errors);
+    }
+
+    uint32_t hold_us = micros() - hold_start_us;
+
+    // Release the SPI mutex after writing to the SD card.
+    mutexGive(&spi_mutex);
+
+    sd_spi_hold_us_total += hold_us;
+    if (hold_us > sd_spi_hold_us_max) {
+      sd_spi_hold_us_max = hold_us;
+    }
+  }
+
+  // Report the write statistics whenever a sector was written to the card.
+  if (sd_log_writer.flushes != flushes) {
+    Serial.printf("SD Card Task: Wrote data to SD card (%u bytes total, %u records, %u us spi_mutex hold per record, %u us max).\n",
+                  (unsigned)sd_log_writer.bytes_written, (unsigned)sd_log_writer.records,
+                  (unsigned)(sd_spi_hold_us_total / sd_log_writer.records), (unsigned)sd_spi_hold_us_max);
+  }
+}
+
+
+// Returns the number of records in a block of the configured binary SD_LOG_FORMAT.
+uint16_t binaryBlockCount(const SdBinaryBlock_t* block) {
+  return SD_LOG_FORMAT == SD_LOG_FORMAT_COMPRESSED ? block->compressed.count : block->binary.count;
+}
+
+
+// Adds a record to a block of the configured binary SD_LOG_FORMAT. Returns false if the block is full.
+bool addToBinaryBlock(SdBinaryBlock_t* block, uint32_t time, const SensorData_t* data) {
+  return SD_LOG_FORMAT == SD_LOG_FORMAT_COMPRESSED ? compressedLogAdd(&block->compressed, time, data)
+                                                   : binaryLogBlockAdd(&block->binary, time, data);
+}
+
+
+// Empties the block of sensor 'id'.
+void resetBinaryBlock(uint8_t id) {
+  SdBinaryBlock_t* block = &sd_binary_blocks[id];
+  binaryLogBlockReset(&block->binary);
+  compressedLogReset(&block->compressed);
+  block->binary.sensor_id = id;
+  block->compressed.sensor_id = id;
+}
+
+
+// Encodes the block of sensor 'id' collected so far and appends it to the day file it belongs to.
+void flushBinaryBlockToSdCard(uint8_t id) {
+  SdBinaryBlock_t* block = &sd_binary_blocks[id];
+  if (binaryBlockCount(block) == 0) {
+    return;
+  }
+
+  if (SD_LOG_FORMAT == SD_LOG_FORMAT_COMPRESSED) {
+    size_t length = compressedLogFinish(&block->compressed);
+    appendToSdCard(block->folder_path, block->file_path, "", block->compressed.base_time, block->compressed.data, length);
+  }
+  else {
+    uint8_t encoded[BINARY_LOG_MAX_BLOCK_SIZE];
+    size_t length = binaryLogBlockEncode(&block->binary, encoded);
+    appendToSdCard(block->folder_path, block->file_path, "", block->binary.base_time, encoded, length);
+  }
+  resetBinaryBlock(id);
+}
+
+
+// Adds the average of the window of sensor 'id' completed at 'window_time' to the binary block of that sensor.
+// The block is written out when it is full, when the day file changes
+// or when it is older than SDCARD_FLUSH_INTERVAL_MS so records don't wait in RAM for too long.
+// The age of the blocks of the other sensors is checked as well, so a missing sensor does not hold back its last records.
+void logBinaryToSdCard(const char* folder_path, const char* file_path, uint32_t window_time, uint8_t id, const SensorData_t* average) {
+  SdBinaryBlock_t* block = &sd_binary_blocks[id];
+
+  // On day rollover the block belongs to the previous day file.
+  if (binaryBlockCount(block) > 0 && strcmp(block->file_path, file_path) != 0) {
+    flushBinaryBlockToSdCard(id);
+  }
+
+  if (!addToBinaryBlock(block, window_time, average)) {
+    flushBinaryBlockToSdCard(id);
+    addToBinaryBlock(block, window_time, average);
+  }
+
+  // Remember where the block goes when it has just been started.
+  if (binaryBlockCount(block) == 1) {
+    strcpy(block->folder_path, folder_path);
+    strcpy(block->file_path, file_path);
+    block->start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  }
+
+  // A full compressed block is only detected by the next record not fitting.
+  if (SD_LOG_FORMAT == SD_LOG_FORMAT_BINARY && block->binary.count == BINARY_LOG_MAX_RECORDS) {
+    flushBinaryBlockToSdCard(id);
+  }
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  for (uint8_t other = 0; other < SENSOR_COUNT; other++) {
+    if (binaryBlockCount(&sd_binary_blocks[other]) > 0 && now_ms - sd_binary_blocks[other].start_ms >= SDCARD_FLUSH_INTERVAL_MS) {
+      flushBinaryBlockToSdCard(other);
+    }
+  }
+}
+
+
+// Writes the statistics of the window of sensor 'id' completed at 'window_time' to the SD card in the configured SD_LOG_FORMAT.
+// In CSV format the average sensor data followed by the minimum, maximum and standard deviation
+// of the window is formatted as a record along with time and the sensor ID.
+// In the binary formats only the averages are stored, in blocks of one sensor (see binary_log.h and compressed_log.h).
+// Records of all sensors are appended to the file of the window's day in a folder named with its month and year.
+void writeStatsToSdCard(const SensorStats_t* stats, uint8_t id, uint32_t window_time) {
+  // Convert the window time to use in file.
+  time_t timestamp = window_time;
+  struct tm time_info;
+  localtime_r(&timestamp, &time_info);
+
+  char folder_path[SD_CARD_FOLDER_PATH_SIZE];
+  char file_path[SD_CARD_FILE_PATH_SIZE];
+  buildSdCardPaths(&time_info, folder_path, file_path);
+
+  if (SD_LOG_FORMAT != SD_LOG_FORMAT_CSV) {
+    SensorData_t average = sensorStatsMean(stats);
+    logBinaryToSdCard(folder_path, file_path, window_time, id, &average);
+    return;
+  }
+
+  // Format the current time as HH:MM:SS.
+  char time[SD_CARD_TIME_SIZE];
+  strftime(time, sizeof(time), "%H:%M:%S", &time_info);
+
+  // Format the statistics as a CSV record.
+  char record[SD_CARD_RECORD_SIZE];
+  int length = snprintf(record, sizeof(record), "%s,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f,%.2f,%.2f,%.3f,%u\n", time,
+                        stats->temperature.mean, toFahrenheit(stats->temperature.mean), stats->pressure.mean,
+                        stats->temperature.min, stats->temperature.max, streamStatsStdDev(&stats->temperature),
+                        stats->pressure.min, stats->pressure.max, streamStatsStdDev(&stats->pressure), id);
+  if (length <= 0 || length >= (int)sizeof(record)) {
+    return;
+  }
+
+  appendToSdCard(folder_path, file_path, SD_CARD_CSV_HEADER, window_time, (const uint8_t*)record, length);
+}
+
+
+// Moves the windows of the full sd_card_backlog to the SD_CARD_UNSYNCED_PATH journal.
+// It returns false if the journal could not be written, the windows not written stay in the backlog.
+bool spillBacklogToSdCard() {
+  if (!mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+    return false;
+  }
+  uint8_t count = sd_card_backlog.count;
+  bool written = windowJournalSpill(&sd_unsynced_journal, &sd_card_backlog);
+  mutexGive(&spi_mutex);
+
+  Serial.printf("SD Card Task: Moved %u windows to %s.\n",
+                (unsigned)(count - sd_card_backlog.count), SD_CARD_UNSYNCED_PATH);
+  return written;
+}
+
+
+// Keeps a window that can not be written to the log yet in the sd_card_backlog.
+// A full backlog is moved to the journal if 'spill' (the card is there), otherwise its oldest window is dropped.
+void backlogSdCardWindow(const SensorStats_t* stats, uint8_t id, uint32_t window_ms, bool spill) {
+  if (sd_card_backlog.count == WINDOW_BACKLOG_SIZE && spill) {
+    spillBacklogToSdCard();
+  }
+  if (!windowBacklogPush(&sd_card_backlog, window_ms, id, stats)) {
+    Serial.printf("SD Card Task: SD card or time not available and backlog full, dropped the oldest window (%u dropped in total).\n",
+                  (unsigned)sd_card_backlog.dropped);
+  }
+}
+
+
+// Writes the windows of the SD_CARD_UNSYNCED_PATH journal to the log once the wall clock is known.
+// The journal is read SD_CARD_UNSYNCED_REPLAY_BATCH windows per spi_mutex hold, so other SD card
+// users are not blocked for the whole replay. It is removed once every window has been written.
+// It returns false if the spi_mutex could not be taken before the end, the replay goes on at the next call.
+bool replayUnsyncedJournal() {
+  while (windowJournalPending(&sd_unsynced_journal)) {
+    BackloggedWindow_t windows[SD_CARD_UNSYNCED_REPLAY_BATCH];
+    uint32_t pending = sd_unsynced_journal.windows - sd_unsynced_journal.replay_offset;
+
+    if (!mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+      return false;
+    }
+    size_t count = windowJournalRead(&sd_unsynced_journal, windows, SD_CARD_UNSYNCED_REPLAY_BATCH);
+    mutexGive(&spi_mutex);
+
+    // The journal is shorter than expected (e.g. the card was swapped), the rest is lost.
+    if (count == 0) {
+      Serial.printf("SD Card Task: Lost %u windows of %s.\n", (unsigned)pending, SD_CARD_UNSYNCED_PATH);
+      break;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      writeStatsToSdCard(&windows[i].stats, windows[i].sensor_id, wallClockTime(windows[i].time));
+    }
+  }
+
+  if (!mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+    return false;
+  }
+  uint32_t replayed = sd_unsynced_journal.replay_offset;
+  bool cleared = windowJournalClear(&sd_unsynced_journal);
+  mutexGive(&spi_mutex);
+  if (cleared) {
+    Serial.printf("SD Card Task: Wrote %u windows logged before the time was synchronized.\n", (unsigned)replayed);
+  }
+  return cleared;
+}
+
+
+// Logs the statistics of one window of sensor 'id', stamped with 'window_ms', the monotonic time of its last sample, to the SD card.
+// While the SD card is missing or the wall clock is not synchronized yet the window is kept in the
+// sd_card_backlog instead (spilled to SD_CARD_UNSYNCED_PATH if the card is there but the backlog is full).
+// Once both are available the journal and the backlog are replayed in order before the new window is written,
+// with their monotonic times converted to wall clock time. Until the journal has been written completely
+// new windows wait in the backlog (and go to the journal after it), so the log stays in time order.
+void logStatsToSdCard(const SensorStats_t* stats, uint8_t id, uint32_t window_ms) {
+  bool synced = wall_clock_synced.load();
+
+  if (!synced || !deviceAvailable(DEVICE_SD_CARD)) {
+    backlogSdCardWindow(stats, id, window_ms, !synced && deviceAvailable(DEVICE_SD_CARD));
+    return;
+  }
+
+  // Replay the windows logged while the card was missing or the time was unknown.
+  if (sd_unsynced_journal.windows > 0 && !replayUnsyncedJournal()) {
+    backlogSdCardWindow(stats, id, window_ms, true);
+    return;
+  }
+  if (sd_card_backlog.count > 0) {
+    Serial.printf("SD Card Task: Writing %u windows logged while the SD card or time was not available.\n", sd_card_backlog.count);
+    const BackloggedWindow_t* window;
+    while ((window = windowBacklogPeek(&sd_card_backlog)) != NULL) {
+      writeStatsToSdCard(&window->stats, window->sensor_id, wallClockTime(window->time));
+      windowBacklogPop(&sd_card_backlog);
+    }
+  }
+
+  writeStatsToSdCard(stats, id, wallClockTime(window_ms));
+}
 
-  // Local variable to hold the average sensor data.
-  SensorData_t avg_sensor_data;
+
+// This task logs sensor data to an SD card.
+// It sleeps until readSensor notifies it and then folds every new sample from the sample_ring
+// into the running statistics of the current window of its sensor, so every reading is used exactly once.
+// Once the window of a sensor reaches the number of samples defined by MAX_SDCARD_SAMPLES
+// the statistics are logged to the SD card with the sensor ID and a new window is started.
+void sdCardLogger(void* p) {
+  // Running statistics of the current window of every sensor.
+  SensorStats_t window_stats[SENSOR_COUNT];
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    sensorStatsReset(&window_stats[id]);
+    resetBinaryBlock(id);
+  }
+
+  // Local variables to hold a sample read from the ring and the overrun count last reported.
+  Sample_t sample;
+  uint32_t reported_overruns = 0;
+
+  sampleRingAttach(&sample_ring, &sd_card_cursor);
+  sdLogWriterInit(&sd_log_writer, SDCARD_FLUSH_INTERVAL_MS);
+  windowBacklogReset(&sd_card_backlog);
+  windowJournalInit(&sd_unsynced_journal, SD_CARD_UNSYNCED_PATH);
+
+  // A journal left by a previous boot has monotonic times of that boot, which can not be converted anymore.
+  if (deviceAvailable(DEVICE_SD_CARD) && mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+    if (SD.exists(SD_CARD_UNSYNCED_PATH)) {
+      SD.remove(SD_CARD_UNSYNCED_STALE_PATH);
+      SD.rename(SD_CARD_UNSYNCED_PATH, SD_CARD_UNSYNCED_STALE_PATH);
+      Serial.printf("SD Card Task: Moved the unsynchronized windows of the previous boot to %s.\n", SD_CARD_UNSYNCED_STALE_PATH);
+    }
+    mutexGive(&spi_mutex);
+  }
 
   while(1) {
-    // Check if the hardware is functioning correctly.
-    if (!hardware_ok) {
-      continue;
+    // Sleep until readSensor pushes a new sample.
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    taskProfileBegin(&sdCardLogger_profile, micros());
+
+    // Drain every sample pushed since the last wake up.
+    while (sampleRingPop(&sample_ring, &sd_card_cursor, &sample)) {
+      SensorStats_t* stats = &window_stats[sample.sensor_id];
+      sensorStatsAdd(stats, &sample.data);
+
+      // If we have collected enough samples log the window and start a new one.
+      if (stats->temperature.count == MAX_SDCARD_SAMPLES) {
+        logStatsToSdCard(stats, sample.sensor_id, sample.timestamp_ms);
+        sensorStatsReset(stats);
+      }
+    }
+
+    // Report samples lost because this task fell too far behind (e.g. while suspended).
+    if (sd_card_cursor.overruns != reported_overruns) {
+      Serial.printf("SD Card Task: %u samples overrun.\n", (unsigned)(sd_card_cursor.overruns - reported_overruns));
+      reported_overruns = sd_card_cursor.overruns;
     }
 
-    // Acquire the sensor mutex to safely read the latest sensor data into local array.
-    if (xSemaphoreTake(sensor_mutex, MS_TO_TICKS(SENSOR_MUTEX_WAIT_MS)) == pdTRUE) {
-      local_sensor_data[sensor_data_count++] = sensor_data;
+    taskProfileEnd(&sdCardLogger_profile, micros());
+  }
+}
 
-      // Release the sensor mutex after reading the data.
-      xSemaphoreGive(sensor_mutex);
+
+//===========================================================================================
+//                                    Firebase Task
+//===========================================================================================
+
+
+// Builds the Firebase path of a window from its sensor and the time it was completed.
+// Year/Month/Day/Hour_Minute_Second for the first sensor, which keeps the paths of the single sensor firmware
+// so its history stays in one place, and sensor<ID>/Year/Month/Day/Hour_Minute_Second for the others.
+void buildFirebasePath(uint32_t time, uint8_t sensor_id, char* path, size_t size) {
+  time_t timestamp = time;
+  struct tm time_info;
+  localtime_r(&timestamp, &time_info);
+
+  int prefix = sensor_id == 0 ? 0 : snprintf(path, size, "sensor%u/", sensor_id);
+  snprintf(path + prefix, size - prefix, 
+   "%d/%s/%d/%02d_%02d_%02d", 
+   time_info.tm_year + 1900,          // Year
+   getMonthName(time_info.tm_mon),    // Month name
+   time_info.tm_mday,                 // Day
+   time_info.tm_hour,                 // Hour
+   time_info.tm_min,                  // Minute
+   time_info.tm_sec);                 // Second
+}
+
+
+// Appends windows to the store and forward queue on the SD card.
+// It acquires the spi_mutex since the queue shares the SD card with the SD card task.
+// While the SD card is missing the windows can not be queued and are counted as dropped.
+void queueFirebaseWindows(const FirebaseQueueRecord_t* records, uint8_t count) {
+  bool queued = false;
+  if (!deviceAvailable(DEVICE_SD_CARD)) {
+    firebase_queue.dropped += count;
+  }
+  else if (mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+    queued = firebaseQueuePush(&firebase_queue, records, count);
+    mutexGive(&spi_mutex);
+  }
+  else {
+    firebase_queue.dropped += count;
+  }
+
+  if (queued) {
+    Serial.printf("Firebase Task: Queued %u windows on SD card (%u queued, oldest %u s).\n", count,
+                  (unsigned)firebaseQueueDepth(&firebase_queue), (unsigned)(time(NULL) - firebase_queue.oldest_time));
+  }
+  else {
+    Serial.printf("Firebase Task: Failed to queue %u windows on SD card (%u dropped in total).\n", count, (unsigned)firebase_queue.dropped);
+  }
+}
+
+
+// Reports the completion of an upload request to its firebase_pipeline slot.
+// It is called by the FirebaseClient library from firebase.loop() in the firebaseBackground task,
+// with the slot and attempt encoded in the uid of the request as "<slot>:<generation>".
+void firebaseUploadResult(AsyncResult& result) {
+  bool ok;
+  if (result.isError()) {
+    Serial.printf("Firebase Background: Upload %s failed: %s (%d).\n", result.uid().c_str(),
+                  result.error().message().c_str(), result.error().code());
+    ok = false;
+  }
+  else if (result.available()) {
+    ok = true;
+  }
+  else {
+    // Events and debug messages of the request.
+    return;
+  }
+
+  unsigned index, generation;
+  if (sscanf(result.uid().c_str(), "%u:%u", &index, &generation) == 2 &&
+      uploadPipelineComplete(&firebase_pipeline, index, generation, ok) && firebaseUpload_h != NULL) {
+    // Wake up the upload task so the result is handled (and its latency measured) right away.
+    xTaskNotifyGive(firebaseUpload_h);
+  }
+}
+
+
+// Sends the payload of a firebase_pipeline slot to Firebase as a single multi-path update of the database root,
+// so every value of every window is written with one request.
+// It uses the FirebaseClient library's asynchronous API, the result is reported to firebaseUploadResult.
+void sendUploadSlot(UploadSlot_t* slot) {
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  firebaseBatchReset(&firebase_send_batch);
+
+  if (slot->kind == FIREBASE_PAYLOAD_RECORDS) {
+    const FirebaseQueueRecord_t* records = (const FirebaseQueueRecord_t*)slot->payload;
+    for (uint8_t i = 0; i < slot->windows; i++) {
+      char base_path[FIREBASE_BATCH_PATH_SIZE];
+      buildFirebasePath(records[i].time, records[i].sensor_id, base_path, sizeof(base_path));
+      firebaseBatchAdd(&firebase_send_batch, base_path, &records[i].data, now_ms);
+    }
+  }
+  else {
+    // The block is stored under the time of its first window, and its sensor for all but the first one
+    // (see buildFirebasePath).
+    CompressedLogReader_t reader;
+    BinaryLogRecord_t first;
+    size_t block_size;
+    char path[FIREBASE_BATCH_PATH_SIZE];
+    compressedLogOpen(slot->payload, slot->size, &reader, &block_size);
+    compressedLogNext(&reader, &first);
+    if (first.sensor_id == 0) {
+      snprintf(path, sizeof(path), "compressed/%u", (unsigned)first.time);
     }
+    else {
+      snprintf(path, sizeof(path), "compressed/sensor%u/%u", first.sensor_id, (unsigned)first.time);
+    }
+    firebaseBatchAddBlock(&firebase_send_batch, path, slot->payload, slot->size, slot->windows, now_ms);
+  }
+
+  char uid[16];
+  uint32_t generation = uploadPipelineSent(&firebase_pipeline, slot, now_ms);
+  snprintf(uid, sizeof(uid), "%u:%u", (unsigned)uploadPipelineIndex(&firebase_pipeline, slot), (unsigned)generation);
+  object_t json(firebaseBatchFinish(&firebase_send_batch));
+  database.update<object_t>(async_client, "/", json, firebaseUploadResult, uid);
+
+  // Wake up the background task so the request is processed right away.
+  if (firebaseBackground_h != NULL) {
+    xTaskNotifyGive(firebaseBackground_h);
+  }
+}
+
+
+// Queues the windows of a slot that could not be delivered on the SD card, so they are uploaded later.
+// Windows read from the queue (a slot tagged with their range) are still in it and are only marked to be sent again.
+// A compressed block is decoded back into its windows.
+void requeueUploadSlot(const UploadSlot_t* slot) {
+  if (slot->tag != 0) {
+    firebaseQueueResend(&firebase_queue, slot->tag);
+    return;
+  }
+  if (slot->kind == FIREBASE_PAYLOAD_RECORDS) {
+    queueFirebaseWindows((const FirebaseQueueRecord_t*)slot->payload, slot->windows);
+    return;
+  }
+
+  CompressedLogReader_t reader;
+  size_t block_size;
+  if (compressedLogOpen(slot->payload, slot->size, &reader, &block_size) != BINARY_LOG_OK) {
+    return;
+  }
+  FirebaseQueueRecord_t records[FIREBASE_BATCH_MAX_WINDOWS];
+  uint8_t count = 0;
+  BinaryLogRecord_t record;
+  memset(records, 0, sizeof(records));
+  while (compressedLogNext(&reader, &record)) {
+    records[count].time = record.time;
+    records[count].data = record.data;
+    records[count].sensor_id = record.sensor_id;
+    if (++count == FIREBASE_BATCH_MAX_WINDOWS) {
+      queueFirebaseWindows(records, count);
+      count = 0;
+    }
+  }
+  if (count > 0) {
+    queueFirebaseWindows(records, count);
+  }
+}
+
+
+// Copies 'count' windows (at most FIREBASE_BATCH_MAX_WINDOWS) into a free firebase_pipeline slot and sends them.
+// 'range_id' is the firebase_queue range the windows were read from, 0 for windows that are not queued.
+// It returns false if FIREBASE_MAX_IN_FLIGHT requests are already waiting for their acknowledgement.
+bool sendFirebaseRecords(const FirebaseQueueRecord_t* records, uint8_t count, uint32_t range_id) {
+  UploadSlot_t* slot = uploadPipelineAcquire(&firebase_pipeline);
+  if (slot == NULL) {
+    return false;
+  }
+  slot->kind = FIREBASE_PAYLOAD_RECORDS;
+  slot->tag = range_id;
+  slot->windows = count;
+  slot->size = count * sizeof(FirebaseQueueRecord_t);
+  memcpy(slot->payload, records, slot->size);
+  sendUploadSlot(slot);
+  return true;
+}
+
+
+// Sends the windows collected in the firebase_batch to Firebase as one request.
+// If the Wi-Fi link is down, Firebase is not ready or too many requests are in flight,
+// the windows are queued on the SD card to be uploaded later.
+void sendFirebaseBatch() {
+  if (firebase_batch.windows == 0) {
+    return;
+  }
+
+  // Check if the link is up and Firebase is ready before proceeding with upload.
+  if (wifiLinkQuality(&wifi_link) == WIFI_QUALITY_OFFLINE) {
+    Serial.println("Firebase Task: Wi-Fi offline. Queueing upload.");
+    queueFirebaseWindows(firebase_batch_records, firebase_batch.windows);
+  }
+  else if (!firebase.ready()) {
+    Serial.println("Firebase Task: Firebase not ready. Queueing upload.");
+    queueFirebaseWindows(firebase_batch_records, firebase_batch.windows);
+  }
+  else if (sendFirebaseRecords(firebase_batch_records, firebase_batch.windows, 0)) {
+    Serial.printf("Firebase Task: Sending %u windows to Firebase.\n", firebase_batch.windows);
+  }
+  else {
+    Serial.printf("Firebase Task: %u requests in flight. Queueing upload.\n", (unsigned)uploadPipelineInUse(&firebase_pipeline));
+    queueFirebaseWindows(firebase_batch_records, firebase_batch.windows);
+  }
+
+  firebaseBatchReset(&firebase_batch);
+}
+
+
+// Adds one window to the firebase_batch. If the batch is full it is sent first.
+void addRecordToFirebaseBatch(const FirebaseQueueRecord_t* record) {
+  char base_path[FIREBASE_BATCH_PATH_SIZE];
+  buildFirebasePath(record->time, record->sensor_id, base_path, sizeof(base_path));
+
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  if (!firebaseBatchAdd(&firebase_batch, base_path, &record->data, now_ms)) {
+    sendFirebaseBatch();
+    firebaseBatchAdd(&firebase_batch, base_path, &record->data, now_ms);
+  }
+  firebase_batch_records[firebase_batch.windows - 1] = *record;
+}
+
+
+// Adds the averages of one window of sensor 'id', stamped with its wall clock 'window_time', to the upload path.
+// While older windows are still waiting in the queue the new window is queued behind them,
+// so the database always receives the windows in order. While the SD card is missing
+// the queue can not be used and the window goes straight to the batch.
+void addWindowToFirebaseBatch(const SensorData_t* avg_sensor_data, uint8_t id, uint32_t window_time) {
+  FirebaseQueueRecord_t record;
+  memset(&record, 0, sizeof(record));
+  record.time = window_time;
+  record.data = *avg_sensor_data;
+  record.sensor_id = id;
+
+  if (firebaseQueueDepth(&firebase_queue) > 0 && deviceAvailable(DEVICE_SD_CARD)) {
+    queueFirebaseWindows(&record, 1);
+    return;
+  }
+
+  addRecordToFirebaseBatch(&record);
+}
+
+
+// Sends up to FIREBASE_COMPRESSED_DRAIN_WINDOWS of the oldest queued windows as compressed log blocks, one per sensor,
+// each stored under "compressed/[sensor<ID>/]<time of its first window>". The caller makes sure 'max_blocks'
+// firebase_pipeline slots are free. Encoding stops at the first window whose block is full or whose sensor would
+// need one block more, so the windows sent are always the oldest unsent ones and form one range of the queue,
+// which is removed once every block is acknowledged.
+// It returns the number of windows sent and the number of requests used in 'blocks_sent'.
+uint8_t sendCompressedFirebaseWindows(uint8_t max_blocks, uint8_t* blocks_sent) {
+  // Kept out of the task stack, together they are over 2 KB.
+  static FirebaseQueueRecord_t records[FIREBASE_COMPRESSED_DRAIN_WINDOWS];
+  static CompressedLogBlock_t blocks[FIREBASE_COMPRESSED_BLOCKS];
+
+  *blocks_sent = 0;
+  uint8_t count = 0;
+  if (mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+    count = firebaseQueuePeek(&firebase_queue, records, FIREBASE_COMPRESSED_DRAIN_WINDOWS);
+    mutexGive(&spi_mutex);
+  }
+  if (max_blocks > FIREBASE_COMPRESSED_BLOCKS) {
+    max_blocks = FIREBASE_COMPRESSED_BLOCKS;
+  }
+
+  // Encode the windows into the block of their sensor.
+  uint8_t used = 0, encoded = 0;
+  for (; encoded < count; encoded++) {
+    uint8_t block = 0;
+    while (block < used && blocks[block].sensor_id != records[encoded].sensor_id) {
+      block++;
+    }
+    if (block == used) {
+      if (used == max_blocks) {
+        break;
+      }
+      compressedLogReset(&blocks[block]);
+      blocks[block].sensor_id = records[encoded].sensor_id;
+      used++;
+    }
+    if (!compressedLogAdd(&blocks[block], records[encoded].time, &records[encoded].data)) {
+      break;
+    }
+  }
+  if (encoded == 0) {
+    return 0;
+  }
+
+  // Take every slot and the range first, so either all blocks are sent or none.
+  UploadSlot_t* slots[FIREBASE_COMPRESSED_BLOCKS];
+  uint8_t acquired = 0;
+  while (acquired < used && (slots[acquired] = uploadPipelineAcquire(&firebase_pipeline)) != NULL) {
+    acquired++;
+  }
+  uint32_t range_id;
+  if (acquired < used || !firebaseQueueSent(&firebase_queue, encoded, used, &range_id)) {
+    while (acquired-- > 0) {
+      uploadPipelineRelease(&firebase_pipeline, slots[acquired]);
+    }
+    return 0;
+  }
+
+  for (uint8_t block = 0; block < used; block++) {
+    UploadSlot_t* slot = slots[block];
+    size_t size = compressedLogFinish(&blocks[block]);
+    slot->kind = FIREBASE_PAYLOAD_BLOCK;
+    slot->tag = range_id;
+    slot->windows = blocks[block].count;
+    slot->size = size;
+    memcpy(slot->payload, blocks[block].data, size);
+
+    Serial.printf("Firebase Task: Sending %u queued windows of sensor %u to Firebase as a %u byte compressed block.\n",
+                  slot->windows, blocks[block].sensor_id, (unsigned)size);
+    sendUploadSlot(slot);
+    (*blocks_sent)++;
+  }
+  return encoded;
+}
+
+
+// Uploads the oldest queued windows once Firebase is ready again.
+// Every drain sends one batch per free firebase_pipeline slot, so a long backlog keeps up to
+// FIREBASE_MAX_IN_FLIGHT requests going (one while the link is poor). Drains are rate limited by
+// FIREBASE_QUEUE_DRAIN_INTERVAL_MS so the backlog does not monopolize the connection.
+// Windows are only removed from the queue once their request is acknowledged (see serviceFirebasePipeline),
+// so a reboot while they are in flight sends them again. A request that is given up sends them again too.
+// In FIREBASE_UPLOAD_COMPRESSED a batch is one compressed block per sensor (see sendCompressedFirebaseWindows).
+void drainFirebaseQueue() {
+  static uint32_t last_drain_ms = 0;
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+  WifiLinkQuality_t quality = wifiLinkQuality(&wifi_link);
+  uint32_t interval_ms = quality == WIFI_QUALITY_POOR ? FIREBASE_QUEUE_DRAIN_POOR_INTERVAL_MS : FIREBASE_QUEUE_DRAIN_INTERVAL_MS;
+  if (firebaseQueueUnsent(&firebase_queue) == 0 || quality == WIFI_QUALITY_OFFLINE || !firebase.ready() ||
+      !deviceAvailable(DEVICE_SD_CARD) || now_ms - last_drain_ms < interval_ms) {
+    return;
+  }
+  last_drain_ms = now_ms;
+
+  // Send the windows still waiting in the batch first, they are older than the ones queued after them.
+  sendFirebaseBatch();
+
+  uint8_t batches = uploadPipelineAvailable(&firebase_pipeline);
+  if (quality == WIFI_QUALITY_POOR && batches > 1) {
+    batches = 1;
+  }
 
-    // If we have collected enough samples calculate the averages and upload to Firebase.
-    if (sensor_data_count == MAX_FIREBASE_SAMPLES) {
-      // Check if Firebase is ready before proceeding with upload.
-      if (firebase.ready()) {
-        // Get the current time to use in the upload.
-        struct tm time_info;
-        if (!getLocalTime(&time_info)) {
-          Serial.println("Firebase Task: Failed to get time. Skipping log.");
-          sensor_data_count = 0;
-          continue;
+  uint32_t drained = 0;
+  for (uint8_t batch = 0; batch < batches && firebaseQueueUnsent(&firebase_queue) > 0; batch++) {
+    uint8_t count = 0;
+    if (FIREBASE_UPLOAD_FORMAT == FIREBASE_UPLOAD_COMPRESSED) {
+      // A batch is one block per sensor, so even a poor link catches up every sensor with each drain.
+      uint8_t blocks;
+      count = sendCompressedFirebaseWindows(uploadPipelineAvailable(&firebase_pipeline), &blocks);
+      batch += blocks > 0 ? blocks - 1 : 0;
+    }
+    else {
+      // Read the oldest windows from the queue.
+      FirebaseQueueRecord_t records[FIREBASE_BATCH_MAX_WINDOWS];
+      if (mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+        count = firebaseQueuePeek(&firebase_queue, records, FIREBASE_BATCH_MAX_WINDOWS);
+        mutexGive(&spi_mutex);
+      }
+      uint32_t range_id;
+      if (count > 0 && !firebaseQueueSent(&firebase_queue, count, 1, &range_id)) {
+        count = 0;
+      }
+      else if (count > 0 && !sendFirebaseRecords(records, count, range_id)) {
+        firebaseQueueResend(&firebase_queue, range_id);
+        count = 0;
+      }
+    }
+    if (count == 0) {
+      break;
+    }
+    drained += count;
+  }
+  if (drained == 0) {
+    return;
+  }
+
+  uint32_t depth = firebaseQueueDepth(&firebase_queue);
+  Serial.printf("Firebase Task: Sent %u queued windows (%u queued including the ones in flight, oldest %u s, %u requests in flight).\n", (unsigned)drained, (unsigned)depth,
+                depth > 0 ? (unsigned)(time(NULL) - firebase_queue.oldest_time) : 0, (unsigned)uploadPipelineInUse(&firebase_pipeline));
+}
+
+
+// Handles the completions, timeouts and retries of the requests in the firebase_pipeline.
+// A due retry is sent again unless the link is down or Firebase is not ready, in which case its windows are
+// queued on the SD card and the slot is released (counted in the released statistic of the pipeline).
+// The windows of a request that is given up are queued on the SD card too.
+// Windows read from the queue are removed from it once every request carrying them is acknowledged.
+void serviceFirebasePipeline() {
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  UploadSlot_t* slot;
+  UploadEvent_t event;
+  // Set until the acknowledged windows could be removed from the queue on the SD card.
+  static bool queue_acked = false;
+
+  while ((event = uploadPipelinePoll(&firebase_pipeline, now_ms, &slot)) != UPLOAD_EVENT_NONE) {
+    switch (event) {
+      case UPLOAD_EVENT_DONE:
+        if (slot->tag != 0) {
+          firebaseQueueAcked(&firebase_queue, slot->tag);
+          queue_acked = true;
         }
+        break;
 
-        // Calculate the average temperature and pressure from the local sensor data.
-        avg_sensor_data.temperature = calculateAverageTemp(local_sensor_data, sensor_data_count);
-        avg_sensor_data.pressure = calculateAveragePressure(local_sensor_data, sensor_data_count);
-
-        // Create the log entry path based on the current time.
-        // Year/Month/Day/Hour_Minute_Second
-        char base_path[30];
-        snprintf(base_path, sizeof(base_path), 
-         "/%d/%s/%d/%02d_%02d_%02d", 
-         time_info.tm_year + 1900,          // Year
-         getMonthName(time_info.tm_mon),    // Month name
-         time_info.tm_mday,                 // Day
-         time_info.tm_hour,                 // Hour
-         time_info.tm_min,                  // Minute
-         time_info.tm_sec);                 // Second
-
-        char full_path[45];
-
-        Serial.println("Firebase Task: Sending data to Firebase.");
-
-        // Create the full path for temperature in Celsius and send to Firebase.
-        strcpy(full_path, base_path);
-        strcat(full_path, "/temperature_c");
-        database.set<float>(async_client, full_path, avg_sensor_data.temperature, dbResult);
-        
-        // Create the full path for temperature in Fahrenheit and send to Firebase.
-        strcpy(full_path, base_path);
-        strcat(full_path, "/temperature_f");
-        database.set<float>(async_client, full_path, toFahrenheit(avg_sensor_data.temperature), dbResult);
+      case UPLOAD_EVENT_RESEND:
+        if (wifiLinkQuality(&wifi_link) != WIFI_QUALITY_OFFLINE && firebase.ready()) {
+          Serial.printf("Firebase Task: Retrying upload of %u windows (attempt %u).\n", slot->windows, (unsigned)slot->attempts + 1);
+          sendUploadSlot(slot);
+        }
+        else {
+          // Queue the windows while the payload is still owned, then free the slot.
+          Serial.printf("Firebase Task: Wi-Fi offline or Firebase not ready for the retry of %u windows. Queueing upload.\n", slot->windows);
+          requeueUploadSlot(slot);
+          uploadPipelineRelease(&firebase_pipeline, slot);
+        }
+        break;
+
+      case UPLOAD_EVENT_GIVE_UP:
+        Serial.printf("Firebase Task: Upload of %u windows failed after %u attempts. Queueing upload.\n", slot->windows, (unsigned)slot->attempts);
+        requeueUploadSlot(slot);
+        break;
 
-        // Create the full path for pressure and send to Firebase.
-        strcpy(full_path, base_path);
-        strcat(full_path, "/pressure_hpa");
-        database.set<float>(async_client, full_path, avg_sensor_data.pressure, dbResult);
+      default:
+        break;
+    }
+  }
+
+  if (queue_acked && deviceAvailable(DEVICE_SD_CARD) && mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+    firebaseQueueRemoveAcked(&firebase_queue);
+    mutexGive(&spi_mutex);
+    queue_acked = false;
+  }
+}
+
+
+// This task uploads sensor data to Firebase.
+// It sleeps until readSensor notifies it and then folds every new sample from the sample_ring
+// into the running statistics of the current window, so every reading is used exactly once.
+// Once the window reaches the number of samples defined by MAX_FIREBASE_SAMPLES
+// the average temperature and pressure of the window are added to the firebase_batch,
+// which is uploaded once it holds FIREBASE_BATCH_WINDOWS windows or FIREBASE_BATCH_MAX_DELAY_MS has passed.
+// Windows that can not be uploaded are queued on the SD card and drained once Firebase is ready again.
+void firebaseUpload(void* p) {
+  // Running statistics of the current window of every sensor.
+  SensorStats_t window_stats[SENSOR_COUNT];
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    sensorStatsReset(&window_stats[id]);
+  }
+
+  // Local variable to hold the average sensor data.
+  SensorData_t avg_sensor_data;
+
+  // Local variables to hold a sample read from the ring and the overrun count last reported.
+  Sample_t sample;
+  uint32_t reported_overruns = 0;
+
+  sampleRingAttach(&sample_ring, &firebase_cursor);
+  firebaseBatchReset(&firebase_batch);
+  uploadPipelineInit(&firebase_pipeline, FIREBASE_MAX_IN_FLIGHT, FIREBASE_MAX_ATTEMPTS, FIREBASE_REQUEST_TIMEOUT_MS,
+                     FIREBASE_RETRY_MIN_MS, FIREBASE_RETRY_MAX_MS);
+  windowBacklogReset(&firebase_unsynced_backlog);
+
+  // Pick up the windows queued before the last reboot.
+  if (mutexTake(&spi_mutex, SPI_MUTEX_WAIT_MS)) {
+    if (firebaseQueueLoad(&firebase_queue) && firebaseQueueDepth(&firebase_queue) > 0) {
+      Serial.printf("Firebase Task: %u windows queued on SD card (%u moved from the queue of an older firmware).\n",
+                    (unsigned)firebaseQueueDepth(&firebase_queue), (unsigned)firebase_queue.migrated);
+    }
+    mutexGive(&spi_mutex);
+  }
+
+  while(1) {
+    // Sleep until readSensor pushes a new sample or it is time to check the queue.
+    ulTaskNotifyTake(pdTRUE, MS_TO_TICKS(FIREBASE_TASK_WAKE_INTERVAL_MS));
+    taskProfileBegin(&firebaseUpload_profile, micros());
+
+    // Drain every sample pushed since the last wake up, each sensor has its own windows.
+    while (sampleRingPop(&sample_ring, &firebase_cursor, &sample)) {
+      if (sample.sensor_id >= SENSOR_COUNT) {
+        continue;
       }
-      // If Firebase is not ready print a message to the serial monitor and skip the upload.
-      else {
-        Serial.println("Firebase Task: Firebase not ready. Skipping upload.");
+      SensorStats_t* stats = &window_stats[sample.sensor_id];
+      sensorStatsAdd(stats, &sample.data);
+
+      // If we have collected enough samples add the averages to the batch and start a new window.
+      // Until the time is synchronized the windows wait in the firebase_unsynced_backlog with their monotonic time.
+      if (stats->temperature.count == MAX_FIREBASE_SAMPLES) {
+        if (wall_clock_synced.load()) {
+          avg_sensor_data = sensorStatsMean(stats);
+          addWindowToFirebaseBatch(&avg_sensor_data, sample.sensor_id, wallClockTime(sample.timestamp_ms));
+        }
+        else if (!windowBacklogPush(&firebase_unsynced_backlog, sample.timestamp_ms, sample.sensor_id, stats)) {
+          Serial.printf("Firebase Task: Time not synchronized and backlog full, dropped the oldest window (%u dropped in total).\n",
+                        (unsigned)firebase_unsynced_backlog.dropped);
+        }
+        sensorStatsReset(stats);
       }
+    }
 
-      // Reset the sensor data count after uploading.
-      sensor_data_count = 0;
+    // Stamp the windows completed before the time was synchronized.
+    if (firebase_unsynced_backlog.count > 0 && wall_clock_synced.load()) {
+      Serial.printf("Firebase Task: Adding %u windows completed before the time was synchronized.\n", firebase_unsynced_backlog.count);
+      const BackloggedWindow_t* window;
+      while ((window = windowBacklogPeek(&firebase_unsynced_backlog)) != NULL) {
+        avg_sensor_data = sensorStatsMean(&window->stats);
+        addWindowToFirebaseBatch(&avg_sensor_data, window->sensor_id, wallClockTime(window->time));
+        windowBacklogPop(&firebase_unsynced_backlog);
+      }
     }
 
-    vTaskDelay(MS_TO_TICKS(FIREBASE_SAMPLE_INTERVAL_MS));
+    // Upload the batch if it is full or has waited long enough.
+    uint8_t batch_windows = wifiLinkQuality(&wifi_link) == WIFI_QUALITY_GOOD ? FIREBASE_BATCH_WINDOWS : FIREBASE_BATCH_MAX_WINDOWS;
+    if (firebaseBatchDue(&firebase_batch, batch_windows, FIREBASE_BATCH_MAX_DELAY_MS, xTaskGetTickCount() * portTICK_PERIOD_MS)) {
+      sendFirebaseBatch();
+    }
+
+    // Handle the results of the requests in flight, then upload the windows queued during an outage.
+    serviceFirebasePipeline();
+    drainFirebaseQueue();
+
+    // Report samples lost because this task fell too far behind (e.g. while suspended).
+    if (firebase_cursor.overruns != reported_overruns) {
+      Serial.printf("Firebase Task: %u samples overrun.\n", (unsigned)(firebase_cursor.overruns - reported_overruns));
+      reported_overruns = firebase_cursor.overruns;
+    }
+
+    taskProfileEnd(&firebaseUpload_profile, micros());
   }
 }
 
+// This task services the Firebase client by running firebase.loop(), which processes the
+// asynchronous requests and refreshes the auth token.
+// Instead of spinning it only runs often while there is work to do: requests in flight
+// or the app not being ready yet. Otherwise it blocks until the next token check or until
+// firebaseUpload notifies it of a new request, which leaves core 1 idle between uploads.
+// It measures the CPU time it spends in firebase.loop() and reports it periodically.
 void firebaseBackground(void * p) {
+  uint32_t busy_us = 0;
+  uint32_t report_start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
   while(1) {
+    uint32_t loop_start_us = micros();
+    taskProfileBegin(&firebaseBackground_profile, loop_start_us);
     firebase.loop();
+    busy_us += micros() - loop_start_us;
+
+    // Report the CPU share of the Firebase client at fixed intervals.
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (now_ms - report_start_ms >= FIREBASE_CPU_REPORT_INTERVAL_MS) {
+      firebase_cpu_percent = busy_us / (10.0 * (now_ms - report_start_ms));
+      Serial.printf("Firebase Background: %.2f%% CPU over the last %u s.\n", firebase_cpu_percent, (unsigned)((now_ms - report_start_ms) / 1000));
+      busy_us = 0;
+      report_start_ms = now_ms;
+    }
+
+    // Keep servicing the client quickly while it has work, otherwise sleep until notified.
+    bool active = async_client.taskCount() > 0 || !firebase.ready();
+    taskProfileEnd(&firebaseBackground_profile, micros());
+    ulTaskNotifyTake(pdTRUE, MS_TO_TICKS(active ? FIREBASE_ACTIVE_LOOP_INTERVAL_MS : FIREBASE_IDLE_LOOP_INTERVAL_MS));
   }
 }
 
@@ -693,7 +2729,12 @@ void readSerial(void* p) {
   // Initialize the buffer to be empty.
   memset(buffer, 0, SERIAL_BUFFER_SIZE); 
 
+  // The serial input is polled at absolute times, SERIAL_READ_INTERVAL_MS apart.
+  TickType_t release_time = xTaskGetTickCount();
+
   while(1) {
+    taskProfileBegin(&readSerial_profile, micros());
+
     // Check if there is data available in the serial buffer.
     // If there is store it in the character variable 'ch'.
     if (Serial.available()) {
@@ -732,7 +2773,8 @@ void readSerial(void* p) {
       }
     }
 
-    vTaskDelay(MS_TO_TICKS(SERIAL_READ_INTERVAL_MS));
+    taskProfileEnd(&readSerial_profile, micros());
+    waitForNextPeriod(&release_time, SERIAL_READ_INTERVAL_MS, &readSerial_profile);
   }
 }
 
@@ -742,15 +2784,93 @@ void readSerial(void* p) {
 //===========================================================================================
 
 
+// Brings up the network side of the system without blocking the systemMonitor.
+// The wifi_link manager decides when to (re)connect, with backoff, and publishes the link quality.
+// Once Wi-Fi is connected the time is requested from NTP, and once it is synchronized wall_clock_synced is set,
+// which lets the tasks stamp the windows they kept with monotonic time, and Firebase is initialized.
+// The firebaseBackground task is only created then, since it has nothing to service before.
+void updateConnectivity() {
+  typedef enum {WAITING_FOR_WIFI, SYNCHRONIZING_TIME, CONNECTED} ConnectivityState_t;
+  static ConnectivityState_t state = WAITING_FOR_WIFI;
+  static TickType_t check_start_time = 0;
+
+  if (xTaskGetTickCount() - check_start_time < MS_TO_TICKS(WIFI_STATUS_INTERVAL_MS)) {
+    return;
+  }
+  check_start_time = xTaskGetTickCount();
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+  // Follow the link and start a new connection attempt when the manager asks for one.
+  WifiLinkState_t link_state = wifi_link.state;
+  uint32_t failed_attempts = wifi_link.failed_attempts;
+  bool connected = WiFi.status() == WL_CONNECTED;
+  if (wifiLinkUpdate(&wifi_link, connected, connected ? WiFi.RSSI() : 0, now_ms) == WIFI_ACTION_CONNECT) {
+    WiFi.disconnect();
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  }
+
+  if (wifi_link.state == WIFI_LINK_UP && link_state != WIFI_LINK_UP) {
+    Serial.printf("System Monitor: Wi-Fi connected after %u ms offline (RSSI %d dBm).\n",
+                  (unsigned)wifi_link.reconnect_ms_last, (int)wifiLinkRssi(&wifi_link));
+  }
+  else if (link_state == WIFI_LINK_UP && wifi_link.state != WIFI_LINK_UP) {
+    Serial.println("System Monitor: Wi-Fi connection lost.");
+  }
+  else if (wifi_link.failed_attempts != failed_attempts) {
+    Serial.printf("System Monitor: Wi-Fi connection attempt failed, retrying in %u ms.\n",
+                  (unsigned)(wifi_link.next_attempt_ms - now_ms));
+  }
+
+  switch (state) {
+    case WAITING_FOR_WIFI:
+      if (wifi_link.state == WIFI_LINK_UP) {
+        // Synchronize the system time using NTP servers. SNTP keeps the time updated from then on.
+        // This is important for timestamping the Firebase and SD card logs.
+        Serial.printf("System Monitor: Wi-Fi connected %u ms after boot, synchronizing system time.\n", (unsigned)millis());
+        configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+        state = SYNCHRONIZING_TIME;
+      }
+      break;
+
+    case SYNCHRONIZING_TIME: {
+      // Don't wait for the time, it is checked again on the next call.
+      struct tm time_info;
+      if (!getLocalTime(&time_info, 0)) {
+        break;
+      }
+      wall_clock_synced.store(true);
+      Serial.printf("System Monitor: Time synchronized %u ms after boot.\n", (unsigned)millis());
+
+      // Configure SSL client for Firebase.
+      ssl_client.setInsecure();
+
+      // Initialize Firebase with the provided credentials and database URL.
+      Serial.println("System Monitor: Initializing Firebase.");
+      initializeApp(async_client, firebase, getAuth(user_auth), NULL, "authTask");
+      firebase.getApp<RealtimeDatabase>(database);
+      database.url(DATABASE_URL);
+      createTask(&firebaseBackground_h);
+      state = CONNECTED;
+      break;
+    }
+
+    case CONNECTED:
+      break;
+  }
+}
+
+
 // This is the main system monitor task that manages the overall system state.
 // It checks the hardware status, initializes tasks, and monitors the system state.
 // It uses a tate machine to handle different states: HARDWARE_INIT, HARDWARE_ERROR, and RUNNING.
-// In the HARDWARE_INIT state, it checks the hardware and initializes tasks if the hardware is OK.
-// In the HARDWARE_ERROR state, it blinks an LED at a specified rate to indicate an error and checks
-// the hardware status periodically to see if it has recovered.
+// In the HARDWARE_INIT state, it checks the hardware and initializes the tasks.
+// In the HARDWARE_ERROR state at least one device is missing. The tasks keep running and only pause the work
+// that needs a missing device (see available_devices). It blinks an LED at a specified rate to indicate an error
+// and checks the hardware status periodically to see if it has recovered.
 // In the RUNNING state, it blinks the LED at a different rate to indicate normal operation and checks
 // the hardware status periodically to ensure everything is functioning correctly.
-// It also connects to Wi-Fi and initializes Firebase.
+// The tasks are started right after boot. Wi-Fi, NTP and Firebase are brought up in parallel
+// by updateConnectivity, so sensing, the display and SD logging never wait for the network.
 void systemMonitor(void* p) {
   // Define the system states.
   // And initialize the system state to HARDWARE_INIT.
@@ -759,128 +2879,78 @@ void systemMonitor(void* p) {
 
   // Start the timer to track hardware check intervals.
   TickType_t hardware_check_start_time = xTaskGetTickCount();
+  TickType_t led_blink_start_time = xTaskGetTickCount();
+  TickType_t task_stats_start_time = xTaskGetTickCount();
+  TickType_t release_time = xTaskGetTickCount();
 
-  // Initialize the tasks running flag to false.
-  // This flag is used to track whether the tasks have been initialized or not
-  // so that they are not initialized multiple times.
-  bool tasks_running = false;
-
-  // Initialize Wi-Fi and connect to the network.
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-  Serial.print("\nSystem Monitor: Connecting to Wi-Fi");
-  // Wait for the Wi-Fi connection to be established.
-  while (WiFi.status() != WL_CONNECTED) {
-    Serial.print(".");
-    vTaskDelay(MS_TO_TICKS(WIFI_CONNECT_INTERVAL_MS));
-  }
-  Serial.println();
-
-  // Synchronize the system time using NTP servers.
-  // This is important for timestamping the Firebase and SD card logs.
-  Serial.print("System Monitor: Synchronizing system time.");
-  configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-  struct tm timeinfo;
-  while (!getLocalTime(&timeinfo)) {
-    Serial.print(".");
-    vTaskDelay(MS_TO_TICKS(WIFI_CONNECT_INTERVAL_MS));
-  }
-  Serial.println();
-
-  // Configure SSL client for Firebase.
-  ssl_client.setInsecure();
+  // Acquisition times of the mutexes that were already reported as held for too long.
+  uint32_t i2c_leak_reported_us = 0, i2c1_leak_reported_us = 0, spi_leak_reported_us = 0;
 
-  // Initialize Firebase with the provided credentials and database URL.
-  Serial.println("System Monitor: Initializing Firebase.");
-  initializeApp(async_client, firebase, getAuth(user_auth), NULL, "authTask");
-  firebase.getApp<RealtimeDatabase>(database);
-  database.url(DATABASE_URL);
+  // Reconnecting is left to the wifi_link manager, the first connection attempt is started by updateConnectivity.
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
+  wifiLinkInit(&wifi_link, WIFI_CONNECT_TIMEOUT_MS, WIFI_BACKOFF_MIN_MS, WIFI_BACKOFF_MAX_MS, esp_random(),
+               xTaskGetTickCount() * portTICK_PERIOD_MS);
+  Serial.println("\nSystem Monitor: Connecting to Wi-Fi.");
 
   while(1) {
     switch (system_state) {
       case HARDWARE_INIT:
-        // Check the hardware status.
-        if (checkHardware()) {
-          // If the hardware is OK and tasks are not already running initialize the tasks.
-          if (!tasks_running) {
-            Serial.println("System Monitor: Initializing system.");
-
-            // Replace 'xTaskCreatePinnedToCore' with 'xTaskCreate' 
-            // if using vanilla FreeRTOS and remove the core parameter.
-            // Here I'm using a modifed version of FreeRTOS 
-            // by ESP which allows pinning tasks to cores.
-            // This is because ESP32 has 2 cores as opposed to 1 core in vanilla FreeRTOS.
-            xTaskCreatePinnedToCore(readSensor, "Read Sensor", 2048, NULL, 4, &readSensor_h, 0);
-            xTaskCreatePinnedToCore(displayData, "Display Data", 2048, NULL, 3, &displayData_h, 0);
-            xTaskCreatePinnedToCore(sdCardLogger, "SD Card Logger", 4096, NULL, 2, &sdCardLogger_h, 0);
-            xTaskCreatePinnedToCore(readSerial, "Read Serial", 4096, NULL, 3, &readSerial_h, 1);
-            xTaskCreatePinnedToCore(firebaseUpload, "Firebase Upload", 8192, NULL, 2, &firebaseUpload_h, 1);
-            xTaskCreatePinnedToCore(firebaseBackground, "Firebase Background", 8192, NULL, 1, &firebaseBackground_h, 1);
-            tasks_running = true;
-            Serial.println("System Monitor: System running.");
-          }
-          // Otherwise resume the tasks if they were suspended.
-          else {
-            Serial.println("System Monitor: Hardware recovery successful.");
-            resumeAllTasks();
-            resumeTask(readSerial_h, "Read Serial");
-            Serial.println("System Monitor: System running.");
-          }
-
-          // Set the system state to RUNNING and reset the hardware check timer.
-          system_state = RUNNING;
-          hardware_ok = true;
-          hardware_check_start_time = xTaskGetTickCount();
-        }
-        // If the hardware is not OK set the system state to HARDWARE_ERROR and start the hardware check timer.
-        else {
-          system_state = HARDWARE_ERROR;
-          hardware_ok = false;
-          hardware_check_start_time = xTaskGetTickCount();
-        }
+        // Check the hardware status. Missing devices are retried later, the tasks start anyway
+        // and only pause the work that needs a missing device.
+        Serial.println("System Monitor: Initializing system.");
+        system_state = checkHardware() ? RUNNING : HARDWARE_ERROR;
+
+        createTask(&readSensor_h);
+        createTask(&displayData_h);
+        createTask(&sdCardLogger_h);
+        createTask(&readSerial_h);
+        createTask(&firebaseUpload_h);
+        Serial.println(system_state == RUNNING ? "System Monitor: System running." : "System Monitor: System running with missing hardware.");
+
+        // Start the hardware check timer.
+        hardware_check_start_time = xTaskGetTickCount();
         break;
 
       case HARDWARE_ERROR:
-        // Blink the LED at a defined interval to indicate hardware error.
-        digitalWrite(LED, HIGH);
-        vTaskDelay(MS_TO_TICKS(100));
-        digitalWrite(LED, LOW);
-        vTaskDelay(MS_TO_TICKS(HW_ERROR_LED_INTERVAL_MS));
+      case RUNNING:
+        // Blink the LED at a defined interval to indicate hardware error or normal operation.
+        updateLed(&led_blink_start_time, system_state == RUNNING ? NO_ERROR_LED_INTERVAL_MS : HW_ERROR_LED_INTERVAL_MS);
+        waitForNextPeriod(&release_time, SYSTEM_MONITOR_INTERVAL_MS, &systemMonitor_profile);
+        taskProfileBegin(&systemMonitor_profile, micros());
 
         // If the hardware check timer has run out check the hardware status again.
         if (xTaskGetTickCount() - hardware_check_start_time >= MS_TO_TICKS(HARDWARE_CHECK_INTERVAL_MS)) {
-          Serial.println("System Monitor: Checking hardware.");
-          // If the hardware is OK set system state to HARDWARE_INIT so that the tasks can be resumed.
-          if (checkHardware()) {
-            system_state = HARDWARE_INIT;
-          }
-          // Otherwise if the hardware is still not OK reset the hardware check timer.
-          else {
-            hardware_check_start_time = xTaskGetTickCount();
+          bool all_ok = checkHardware();
+          if (all_ok && system_state == HARDWARE_ERROR) {
+            Serial.println("System Monitor: Hardware recovery successful.");
           }
+          system_state = all_ok ? RUNNING : HARDWARE_ERROR;
+
+          // Reset the hardware check timer.
+          hardware_check_start_time = xTaskGetTickCount();
         }
-        break;
 
-      case RUNNING:
-        // Blink the LED at a defined interval to indicate normal operation.
-        digitalWrite(LED, HIGH);
-        vTaskDelay(MS_TO_TICKS(100));
-        digitalWrite(LED, LOW);
-        vTaskDelay(MS_TO_TICKS(NO_ERROR_LED_INTERVAL_MS));
+        // Bring up Wi-Fi, the time and Firebase in the background.
+        updateConnectivity();
 
-        // If the hardware check timer has run out check the hardware status again.
-        if (xTaskGetTickCount() - hardware_check_start_time >= MS_TO_TICKS(HARDWARE_CHECK_INTERVAL_MS)) {
-          // If the hardware is not OK set system state to HARDWARE_ERROR and suspend all tasks.
-          if (!checkHardware()) {
-            hardware_ok = false;
-            suspendAllTasks();
-            suspendTask(readSerial_h, "Read Serial");
+        // Watch the heap footprint.
+        checkHeap();
 
-            system_state = HARDWARE_ERROR;
-          }
+        // Look for a task that holds a bus for too long.
+        checkMutexLeak(&i2c_mutex, &i2c_leak_reported_us);
+        checkMutexLeak(&i2c1_mutex, &i2c1_leak_reported_us);
+        checkMutexLeak(&spi_mutex, &spi_leak_reported_us);
 
-          // Reset the hardware check timer.
-          hardware_check_start_time = xTaskGetTickCount();
+        // Print the compact task statistics at fixed intervals.
+        if (xTaskGetTickCount() - task_stats_start_time >= MS_TO_TICKS(TASK_STATS_INTERVAL_MS)) {
+          Serial.println("System Monitor: Task statistics.");
+          printTaskStats(false);
+          printHeapStats();
+          task_stats_start_time = xTaskGetTickCount();
         }
+
+        taskProfileEnd(&systemMonitor_profile, micros());
         break;
     }
   }
@@ -892,28 +2962,56 @@ void systemMonitor(void* p) {
 //===========================================================================================
 
 
-// The setup function initializes the serial monitor, I2C bus, and LED pin.
-// It also creates the necessary mutexes for sensor, I2C, and SPI access.
+// The setup function initializes the serial monitor, I2C buses, sensor registry and LED pin.
+// It also creates the necessary mutexes for I2C and SPI access.
 // It then creates the system monitor task which will manage the overall system state and tasks.
 void setup() {
   // Initialize serial monitor to the defined baud rate.
   Serial.begin(BAUD_RATE);
-  // Initialize I2C bus with the defined SDA and SCL pins.
+  // Initialize the I2C buses with the defined SDA and SCL pins, the second one only if a sensor is on it.
   Wire.begin(MY_SDA, MY_SCL);
+  if (i2cBusUsed(1)) {
+    Wire1.begin(MY_SDA1, MY_SCL1);
+  }
   // Initialize the LED pin as an output.
   pinMode(LED, OUTPUT);
 
-  // Wait for the serial monitor to be ready.
-  vTaskDelay(MS_TO_TICKS(1000));
-
   // Initializes all the mutexes used in the system.
-  sensor_mutex = xSemaphoreCreateMutex();
-  i2c_mutex = xSemaphoreCreateMutex();
-  spi_mutex = xSemaphoreCreateMutex();
+  mutexCreate(&i2c_mutex, "i2c_mutex");
+  mutexCreate(&i2c1_mutex, "i2c1_mutex");
+  mutexCreate(&spi_mutex, "spi_mutex");
+
+  // Initialize the task profiles with the period each task is meant to run at (0 for event driven tasks).
+  taskProfileInit(&systemMonitor_profile, SYSTEM_MONITOR_INTERVAL_MS * 1000);
+  taskProfileInit(&readSensor_profile, SENSOR_SAMPLE_INTERVAL_MS * 1000);
+  taskProfileInit(&displayData_profile, DISPLAY_UPDATE_INTERVAL_MS * 1000);
+  taskProfileInit(&sdCardLogger_profile, 0);
+  taskProfileInit(&readSerial_profile, SERIAL_READ_INTERVAL_MS * 1000);
+  taskProfileInit(&firebaseUpload_profile, 0);
+  taskProfileInit(&firebaseBackground_profile, 0);
+
+  // Register the sensors, their IDs are their indices in SENSORS.
+  sensorRegistryInit(&sensor_registry, 0);
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    sensorRegistryAdd(&sensor_registry, SENSORS[id].bus, SENSORS[id].address, SENSORS[id].read_interval_ms, 0);
+  }
+
+  rollupStoreInit(&rollup_store);
+  heapWatchInit(&heap_watch, HEAP_GROWTH_TOLERANCE_BYTES);
+
+  // Allocate the SSD1306 framebuffer now, even if the display is missing. begin() only allocates it
+  // the first time, so re-initializing the display later reuses it instead of allocating after startup.
+  display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS);
+
+  // Every device starts uninitialized, the first hardware check initializes it.
+  for (uint8_t id = 0; id < SENSOR_COUNT; id++) {
+    deviceHealthInit(&sensor_health[id], SENSORS[id].name, HARDWARE_CHECK_INTERVAL_MS, HARDWARE_REINIT_INTERVAL_MS);
+  }
+  deviceHealthInit(&display_health, "SSD1306", HARDWARE_CHECK_INTERVAL_MS, HARDWARE_REINIT_INTERVAL_MS);
+  deviceHealthInit(&sd_card_health, "SD card", SD_CARD_PROBE_INTERVAL_MS, HARDWARE_REINIT_INTERVAL_MS);
 
   // Create the system monitor task which will manage the overall system state and tasks.
-  // It has higher priority than other tasks to so that it can manage the system effectively.
-  xTaskCreatePinnedToCore(systemMonitor, "System Monitor", 16384, NULL, 5, &systemMonitor_h, 0);
+  createTask(&systemMonitor_h);
 }
 
 // Do nothing 
@@ -0,0 +1,48 @@
+#include "mutex_stats.h"
+
+
+// Initializes the statistics of a free mutex.
+void mutexStatsInit(MutexStats_t* stats, const char* name) {
+  stats->name = name;
+  histogramReset(&stats->wait_us);
+  histogramReset(&stats->hold_us);
+  stats->acquired_us = 0;
+  stats->release_errors = 0;
+  stats->holder.store(NULL, std::memory_order_relaxed);
+  stats->timeouts.store(0, std::memory_order_relaxed);
+  stats->timeout_holder.store(NULL, std::memory_order_relaxed);
+}
+
+
+// Records an acquisition.
+void mutexStatsAcquired(MutexStats_t* stats, const char* task, uint32_t wait_us, uint32_t now_us) {
+  histogramAdd(&stats->wait_us, wait_us);
+  stats->acquired_us = now_us;
+  stats->holder.store(task, std::memory_order_release);
+}
+
+
+// Records a timed out acquisition along with the task that was holding the mutex.
+void mutexStatsTimedOut(MutexStats_t* stats) {
+  stats->timeouts.fetch_add(1, std::memory_order_relaxed);
+  stats->timeout_holder.store(stats->holder.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+
+// Records a release.
+bool mutexStatsReleased(MutexStats_t* stats, uint32_t now_us) {
+  if (stats->holder.load(std::memory_order_relaxed) == NULL) {
+    stats->release_errors++;
+    return false;
+  }
+
+  histogramAdd(&stats->hold_us, now_us - stats->acquired_us);
+  stats->holder.store(NULL, std::memory_order_release);
+  return true;
+}
+
+
+// Checks if the current holder has held the mutex for too long.
+bool mutexStatsLeaked(const MutexStats_t* stats, uint32_t now_us, uint32_t max_hold_us) {
+  return stats->holder.load(std::memory_order_acquire) != NULL && now_us - stats->acquired_us > max_hold_us;
+}
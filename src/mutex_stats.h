@@ -0,0 +1,44 @@
+// Contention statistics of one mutex: how long tasks wait to acquire it, how long it is held,
+// how often an acquisition times out and which task holds it.
+// These functions only do the bookkeeping, the locking itself is done by the caller
+// (see instrumented_mutex.h), so the same code can be exercised on a host to check
+// that every acquisition is matched by exactly one release.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "histogram.h"
+
+typedef struct {
+  const char* name;
+
+  // Written only by the task holding the mutex.
+  Histogram_t wait_us;                    // Time from the request to the acquisition.
+  Histogram_t hold_us;                    // Time from the acquisition to the release.
+  uint32_t acquired_us;                   // When the current holder acquired the mutex.
+  uint32_t release_errors;                // Releases without a matching acquisition.
+
+  // Written by any task.
+  std::atomic<const char*> holder;        // Name of the task holding the mutex, NULL if it is free.
+  std::atomic<uint32_t> timeouts;         // Acquisitions that gave up.
+  std::atomic<const char*> timeout_holder;// Task that held the mutex at the last timeout.
+} MutexStats_t;
+
+// Initializes the statistics of a free mutex.
+void mutexStatsInit(MutexStats_t* stats, const char* name);
+
+// Records that 'task' acquired the mutex at 'now_us' after waiting 'wait_us'. Must be called with the mutex held.
+void mutexStatsAcquired(MutexStats_t* stats, const char* task, uint32_t wait_us, uint32_t now_us);
+
+// Records that an acquisition timed out.
+void mutexStatsTimedOut(MutexStats_t* stats);
+
+// Records that the mutex is released at 'now_us'. Must be called before the mutex is actually released.
+// Returns false if the mutex was not held, i.e. the release does not match an acquisition.
+bool mutexStatsReleased(MutexStats_t* stats, uint32_t now_us);
+
+// Returns true if the mutex has been held for more than 'max_hold_us' at 'now_us',
+// which usually means the holder forgot to release it or was suspended while holding it.
+bool mutexStatsLeaked(const MutexStats_t* stats, uint32_t now_us, uint32_t max_hold_us);
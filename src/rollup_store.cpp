@@ -0,0 +1,105 @@
+#include "rollup_store.h"
+
+
+// Sets up one ring over 'points'.
+static void initRing(RollupRing_t* ring, RollupPoint_t* points, uint16_t capacity, uint32_t resolution_s) {
+  ring->points = points;
+  ring->capacity = capacity;
+  ring->head = 0;
+  ring->count = 0;
+  ring->resolution_s = resolution_s;
+  ring->open.count = 0;
+}
+
+
+// Empties the store.
+void rollupStoreInit(RollupStore_t* store) {
+  initRing(&store->rings[ROLLUP_SECONDS], store->seconds, ROLLUP_SECONDS_SIZE, 1);
+  initRing(&store->rings[ROLLUP_MINUTES], store->minutes, ROLLUP_MINUTES_SIZE, 60);
+  initRing(&store->rings[ROLLUP_HOURS], store->hours, ROLLUP_HOURS_SIZE, 3600);
+}
+
+
+// Merges 'point' into 'target'. The means are weighted by the number of samples.
+static void mergePoint(RollupPoint_t* target, const RollupPoint_t* point) {
+  if (target->count == 0) {
+    uint32_t start_s = target->start_s;
+    *target = *point;
+    target->start_s = start_s;
+    return;
+  }
+
+  float weight = (float)point->count / (target->count + point->count);
+  target->temperature_mean += (point->temperature_mean - target->temperature_mean) * weight;
+  target->pressure_mean += (point->pressure_mean - target->pressure_mean) * weight;
+  if (point->temperature_min < target->temperature_min) {
+    target->temperature_min = point->temperature_min;
+  }
+  if (point->temperature_max > target->temperature_max) {
+    target->temperature_max = point->temperature_max;
+  }
+  if (point->pressure_min < target->pressure_min) {
+    target->pressure_min = point->pressure_min;
+  }
+  if (point->pressure_max > target->pressure_max) {
+    target->pressure_max = point->pressure_max;
+  }
+  target->count += point->count;
+}
+
+
+// Folds 'point' into the open point of 'level'. If the point belongs to a later interval
+// the open point is closed first: stored in the ring and folded into the next level.
+static void addToLevel(RollupStore_t* store, uint8_t level, const RollupPoint_t* point) {
+  RollupRing_t* ring = &store->rings[level];
+  uint32_t interval_start_s = point->start_s - point->start_s % ring->resolution_s;
+
+  if (ring->open.count > 0 && ring->open.start_s != interval_start_s) {
+    // Store the closed point, overwriting the oldest one if the ring is full.
+    ring->points[(ring->head + ring->count) % ring->capacity] = ring->open;
+    if (ring->count < ring->capacity) {
+      ring->count++;
+    }
+    else {
+      ring->head = (ring->head + 1) % ring->capacity;
+    }
+
+    if (level + 1 < ROLLUP_LEVELS) {
+      addToLevel(store, level + 1, &ring->open);
+    }
+    ring->open.count = 0;
+  }
+
+  if (ring->open.count == 0) {
+    ring->open.start_s = interval_start_s;
+  }
+  mergePoint(&ring->open, point);
+}
+
+
+// Adds a sample as a single sample point to the 1 second level.
+void rollupStoreAdd(RollupStore_t* store, uint32_t time_s, const SensorData_t* data) {
+  RollupPoint_t point;
+  point.start_s = time_s;
+  point.count = 1;
+  point.temperature_mean = point.temperature_min = point.temperature_max = data->temperature;
+  point.pressure_mean = point.pressure_min = point.pressure_max = data->pressure;
+  addToLevel(store, ROLLUP_SECONDS, &point);
+}
+
+
+// Returns the number of closed points of a resolution.
+uint16_t rollupStoreCount(const RollupStore_t* store, RollupLevel_t level) {
+  return store->rings[level].count;
+}
+
+
+// Copies a closed point.
+bool rollupStoreGet(const RollupStore_t* store, RollupLevel_t level, uint16_t age, RollupPoint_t* point) {
+  const RollupRing_t* ring = &store->rings[level];
+  if (age >= ring->count) {
+    return false;
+  }
+  *point = ring->points[(ring->head + ring->count - 1 - age) % ring->capacity];
+  return true;
+}
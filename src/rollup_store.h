@@ -0,0 +1,67 @@
+// Fixed memory time series of the sensor samples at several resolutions.
+// Every sample is folded into the open 1 second point. When a point closes it is stored in
+// the ring of its resolution and folded into the open point of the next coarser resolution,
+// so the 1 minute and 1 hour points are built incrementally without keeping the samples.
+// Each point keeps the mean, minimum and maximum of both values.
+//
+// Memory: sizeof(RollupStore_t) is fixed (about 9 KB with the sizes below).
+// Cost: adding a sample updates one point, and at most closes one point per resolution,
+// so the worst case is three ring stores and three merges, independent of the history length.
+// The caller has to serialize access.
+
+#pragma once
+
+#include <stdint.h>
+#include "sensor_utils.h"
+
+typedef enum {
+  ROLLUP_SECONDS,
+  ROLLUP_MINUTES,
+  ROLLUP_HOURS,
+  ROLLUP_LEVELS
+} RollupLevel_t;
+
+// Number of closed points kept per resolution.
+static const uint16_t ROLLUP_SECONDS_SIZE = 120;  // 2 minutes.
+static const uint16_t ROLLUP_MINUTES_SIZE = 120;  // 2 hours.
+static const uint16_t ROLLUP_HOURS_SIZE = 48;     // 2 days.
+
+typedef struct {
+  uint32_t start_s;           // Start of the interval, in seconds since boot.
+  uint32_t count;             // Samples in the interval.
+  float temperature_mean;
+  float temperature_min;
+  float temperature_max;
+  float pressure_mean;
+  float pressure_min;
+  float pressure_max;
+} RollupPoint_t;
+
+typedef struct {
+  RollupPoint_t* points;      // Closed points, oldest first starting at 'head'.
+  uint16_t capacity;
+  uint16_t head;
+  uint16_t count;
+  uint32_t resolution_s;
+  RollupPoint_t open;         // The point currently being built (count 0 if none).
+} RollupRing_t;
+
+typedef struct {
+  RollupPoint_t seconds[ROLLUP_SECONDS_SIZE];
+  RollupPoint_t minutes[ROLLUP_MINUTES_SIZE];
+  RollupPoint_t hours[ROLLUP_HOURS_SIZE];
+  RollupRing_t rings[ROLLUP_LEVELS];
+} RollupStore_t;
+
+// Empties the store.
+void rollupStoreInit(RollupStore_t* store);
+
+// Adds a sample taken at 'time_s' seconds since boot. Samples must be added in time order.
+void rollupStoreAdd(RollupStore_t* store, uint32_t time_s, const SensorData_t* data);
+
+// Returns the number of closed points of a resolution.
+uint16_t rollupStoreCount(const RollupStore_t* store, RollupLevel_t level);
+
+// Copies the closed point 'age' intervals back (0 is the newest) into 'point'.
+// Returns false if there is no such point.
+bool rollupStoreGet(const RollupStore_t* store, RollupLevel_t level, uint16_t age, RollupPoint_t* point);
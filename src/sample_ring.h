@@ -0,0 +1,79 @@
+// Single producer / multi consumer ring buffer of sensor samples.
+// The producer (readSensor) pushes every sample exactly once and never waits for a consumer.
+// Every consumer owns a SampleRingCursor_t and reads the stream independently at its own pace,
+// so each consumer sees every sample exactly once unless it falls more than SAMPLE_RING_SIZE samples behind.
+// Samples a consumer was too slow to read are counted in its cursor as overruns.
+// Each slot is a seqlock so a consumer can never copy a half written sample.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include "sensor_utils.h"
+#include "sample_seqlock.h"
+
+// Number of samples the ring can hold, shared by all sensors.
+// With four sensors at 1 Hz this is over half a minute of slack for a stalled consumer.
+static const uint8_t SAMPLE_RING_SIZE = 128;
+
+typedef struct {
+  SampleSeqlock_t slots[SAMPLE_RING_SIZE];
+  std::atomic<uint32_t> write_index;  // Total number of samples ever pushed.
+} SampleRing_t;
+
+// Per consumer read position and loss counter.
+typedef struct {
+  uint32_t read_index;  // Index of the next sample this consumer will read.
+  uint32_t overruns;    // Number of samples overwritten before this consumer could read them.
+} SampleRingCursor_t;
+
+// Appends a sample to the ring, overwriting the oldest one if the ring is full.
+// Must only be called from a single producer task.
+inline void sampleRingPush(SampleRing_t* ring, const Sample_t* sample) {
+  uint32_t index = ring->write_index.load(std::memory_order_relaxed);
+  seqlockPublish(&ring->slots[index % SAMPLE_RING_SIZE], sample);
+  ring->write_index.store(index + 1, std::memory_order_release);
+}
+
+// Attaches a cursor to the ring so that it starts reading from the next pushed sample.
+inline void sampleRingAttach(const SampleRing_t* ring, SampleRingCursor_t* cursor) {
+  cursor->read_index = ring->write_index.load(std::memory_order_acquire);
+  cursor->overruns = 0;
+}
+
+// Returns the number of samples waiting to be read by the given cursor.
+inline uint32_t sampleRingPending(const SampleRing_t* ring, const SampleRingCursor_t* cursor) {
+  return ring->write_index.load(std::memory_order_acquire) - cursor->read_index;
+}
+
+// Copies the next unread sample for the given cursor into 'sample'.
+// It returns false if the consumer has already read every pushed sample.
+// If the consumer has fallen too far behind, the lost samples are skipped and added to its overruns.
+inline bool sampleRingPop(const SampleRing_t* ring, SampleRingCursor_t* cursor, Sample_t* sample) {
+  while (1) {
+    uint32_t write_index = ring->write_index.load(std::memory_order_acquire);
+    if (write_index == cursor->read_index) {
+      return false;
+    }
+
+    // Skip the samples that have already been overwritten.
+    // The oldest slot is left alone since the producer may be rewriting it right now.
+    uint32_t behind = write_index - cursor->read_index;
+    if (behind >= SAMPLE_RING_SIZE) {
+      uint32_t lost = behind - (SAMPLE_RING_SIZE - 1);
+      cursor->overruns += lost;
+      cursor->read_index += lost;
+    }
+
+    seqlockRead(&ring->slots[cursor->read_index % SAMPLE_RING_SIZE], sample);
+
+    // If the producer wrapped around onto this slot while it was being copied, try again.
+    write_index = ring->write_index.load(std::memory_order_acquire);
+    if (write_index - cursor->read_index >= SAMPLE_RING_SIZE) {
+      continue;
+    }
+
+    cursor->read_index++;
+    return true;
+  }
+}
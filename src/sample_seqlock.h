@@ -0,0 +1,64 @@
+// Single writer / multi reader publication of the latest sensor sample.
+// The writer (readSensor) never blocks and never waits for a reader.
+// Readers copy the sample and retry only if the writer published while they were copying,
+// which at the sensor rate practically never happens more than once.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include "sensor_utils.h"
+
+// Number of 32-bit words needed to hold one Sample_t.
+static const uint8_t SAMPLE_SEQLOCK_WORDS = (sizeof(Sample_t) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+// The version counter is odd while a publish is in progress and even when the sample is stable.
+// The payload is stored as relaxed atomic words so that concurrent copies are well defined.
+typedef struct {
+  std::atomic<uint32_t> version;
+  std::atomic<uint32_t> words[SAMPLE_SEQLOCK_WORDS];
+} SampleSeqlock_t;
+
+// Publishes a new sample. Must only be called from a single writer task.
+inline void seqlockPublish(SampleSeqlock_t* lock, const Sample_t* sample) {
+  uint32_t words[SAMPLE_SEQLOCK_WORDS] = {0};
+  memcpy(words, sample, sizeof(Sample_t));
+
+  uint32_t version = lock->version.load(std::memory_order_relaxed);
+  lock->version.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (uint8_t i = 0; i < SAMPLE_SEQLOCK_WORDS; i++) {
+    lock->words[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  lock->version.store(version + 2, std::memory_order_release);
+}
+
+// Copies the latest published sample into 'sample'.
+// It returns false if nothing has been published yet.
+inline bool seqlockRead(const SampleSeqlock_t* lock, Sample_t* sample) {
+  uint32_t words[SAMPLE_SEQLOCK_WORDS];
+  uint32_t before, after;
+
+  do {
+    before = lock->version.load(std::memory_order_acquire);
+    // A publish is in progress, try again.
+    if (before & 1) {
+      continue;
+    }
+    for (uint8_t i = 0; i < SAMPLE_SEQLOCK_WORDS; i++) {
+      words[i] = lock->words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = lock->version.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+
+  if (before == 0) {
+    return false;
+  }
+
+  memcpy(sample, words, sizeof(Sample_t));
+  return true;
+}
@@ -0,0 +1,73 @@
+#include "sd_log_index.h"
+#include "byte_order.h"
+
+
+// Writes the path of the index of 'file_path' into 'index_path'.
+bool sdLogIndexPath(const char* file_path, char* index_path, size_t size) {
+  int length = snprintf(index_path, size, "%s.idx", file_path);
+  return length > 0 && (size_t)length < size;
+}
+
+
+// Appends the entries to the open index file in one write.
+bool sdLogIndexAppend(File* index_file, const SdLogIndexEntry_t* entries, uint8_t count) {
+  uint8_t bytes[SD_LOG_INDEX_PENDING * SD_LOG_INDEX_ENTRY_SIZE];
+  if (count > SD_LOG_INDEX_PENDING) {
+    count = SD_LOG_INDEX_PENDING;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    putU32(bytes + i * SD_LOG_INDEX_ENTRY_SIZE, entries[i].time);
+    putU32(bytes + i * SD_LOG_INDEX_ENTRY_SIZE + 4, entries[i].offset);
+  }
+  size_t length = count * SD_LOG_INDEX_ENTRY_SIZE;
+  bool written = index_file->write(bytes, length) == length;
+  index_file->flush();
+  return written;
+}
+
+
+// Reads entry 'index' of the index file.
+static bool readEntry(File* index_file, uint32_t index, SdLogIndexEntry_t* entry) {
+  uint8_t bytes[SD_LOG_INDEX_ENTRY_SIZE];
+  if (!index_file->seek(index * SD_LOG_INDEX_ENTRY_SIZE) || index_file->read(bytes, sizeof(bytes)) != sizeof(bytes)) {
+    return false;
+  }
+  entry->time = getU32(bytes);
+  entry->offset = getU32(bytes + 4);
+  return true;
+}
+
+
+// Binary search for the last entry at or before 'time'.
+uint32_t sdLogIndexFind(const char* file_path, uint32_t time, uint32_t* reads) {
+  char index_path[SD_LOG_INDEX_PATH_SIZE];
+  if (!sdLogIndexPath(file_path, index_path, sizeof(index_path)) || !SD.exists(index_path)) {
+    return 0;
+  }
+  File index_file = SD.open(index_path, FILE_READ);
+  if (!index_file) {
+    return 0;
+  }
+
+  // Invariant: entries before 'low' are at or before 'time', entries from 'high' on are after it.
+  uint32_t low = 0, high = index_file.size() / SD_LOG_INDEX_ENTRY_SIZE;
+  uint32_t offset = 0;
+  SdLogIndexEntry_t entry;
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    if (!readEntry(&index_file, middle, &entry)) {
+      break;
+    }
+    (*reads)++;
+    if (entry.time <= time) {
+      offset = entry.offset;
+      low = middle + 1;
+    }
+    else {
+      high = middle;
+    }
+  }
+
+  index_file.close();
+  return offset;
+}
@@ -0,0 +1,45 @@
+// Time index of the SD card log files, so a time range can be read without scanning the day file.
+// Next to every log file a "<log file>.idx" file holds one entry for the first record starting in
+// every SD_LOG_INDEX_STRIDE bytes of the log. An entry is the time of that record and its byte offset:
+//
+//   offset  size  field
+//   0       4     time of the record, seconds since 1970-01-01 UTC (little endian)
+//   4       4     byte offset of the record in the log file (little endian)
+//
+// Entries are appended by the sd_log_writer only after the records they point to are on the card,
+// so every entry is valid even after a power loss. Entries are in time order, which makes a lookup
+// a binary search of a few 8 byte reads. A log without index is simply read from the start.
+// None of these functions take the spi_mutex, the caller must hold it.
+
+#pragma once
+
+#include <Arduino.h>
+#include "FS.h"
+#include "SD.h"
+
+// One entry per this many bytes of log. A lookup lands at most this far before the wanted record.
+static const uint16_t SD_LOG_INDEX_STRIDE = 512;
+static const uint8_t SD_LOG_INDEX_ENTRY_SIZE = 8;
+
+// Maximum number of entries waiting for their records to be written, and appended at once.
+static const uint8_t SD_LOG_INDEX_PENDING = 4;
+
+// Maximum length of an index file path: the log file path followed by ".idx".
+static const uint8_t SD_LOG_INDEX_PATH_SIZE = 52;
+
+typedef struct {
+  uint32_t time;
+  uint32_t offset;
+} SdLogIndexEntry_t;
+
+// Writes the path of the index of 'file_path' into 'index_path'. Returns false if it does not fit.
+bool sdLogIndexPath(const char* file_path, char* index_path, size_t size);
+
+// Appends 'count' (at most SD_LOG_INDEX_PENDING) entries to an open index file. Returns false if they could not be written.
+bool sdLogIndexAppend(File* index_file, const SdLogIndexEntry_t* entries, uint8_t count);
+
+// Returns the offset in 'file_path' of the last indexed record logged at or before 'time',
+// i.e. where reading has to start to find every record from 'time' on.
+// It returns 0 (the start of the file) if the file has no index or 'time' is before the first entry.
+// 'reads' is incremented by the number of index entries read.
+uint32_t sdLogIndexFind(const char* file_path, uint32_t time, uint32_t* reads);
@@ -0,0 +1,161 @@
+#include "sd_log_reader.h"
+#include "sd_log_index.h"
+
+
+// Opens the file and seeks to the indexed start.
+bool sdLogReaderOpen(SdLogReader_t* reader, const char* file_path, const struct tm* day, uint32_t from) {
+  if (!SD.exists(file_path)) {
+    return false;
+  }
+
+  reader->index_reads = 0;
+  reader->start_offset = sdLogIndexFind(file_path, from, &reader->index_reads);
+
+  reader->file = SD.open(file_path, FILE_READ);
+  if (!reader->file) {
+    return false;
+  }
+  if (!reader->file.seek(reader->start_offset)) {
+    reader->start_offset = 0;
+    reader->file.seek(0);
+  }
+
+  size_t path_length = strlen(file_path);
+  reader->csv = path_length > 4 && strcmp(file_path + path_length - 4, ".csv") == 0;
+  reader->eof = false;
+  reader->day = *day;
+  reader->length = 0;
+  reader->position = 0;
+  reader->in_binary_block = false;
+  reader->in_compressed_block = false;
+  reader->bytes_read = 0;
+  return true;
+}
+
+
+// Moves the unparsed bytes to the front of the buffer and reads as many bytes as fit after them.
+bool sdLogReaderFill(SdLogReader_t* reader) {
+  if (reader->eof) {
+    return false;
+  }
+
+  reader->length -= reader->position;
+  memmove(reader->buffer, reader->buffer + reader->position, reader->length);
+  reader->position = 0;
+
+  int read = reader->file.read(reader->buffer + reader->length, sizeof(reader->buffer) - reader->length);
+  if (read <= 0) {
+    reader->eof = true;
+    return false;
+  }
+  reader->length += read;
+  reader->bytes_read += read;
+  return true;
+}
+
+
+// Parses a CSV line "HH:MM:SS,temperature_c,temperature_f,pressure_hpa,<6 statistics>,sensor" of the day of the file.
+// Lines logged before the sensor column existed are taken as sensor 0.
+static bool parseCsvLine(SdLogReader_t* reader, const char* line, BinaryLogRecord_t* record) {
+  int hour, minute, second;
+  float temperature_f;
+  unsigned sensor_id = 0;
+  if (sscanf(line, "%d:%d:%d,%f,%f,%f,%*f,%*f,%*f,%*f,%*f,%*f,%u", &hour, &minute, &second,
+             &record->data.temperature, &temperature_f, &record->data.pressure, &sensor_id) < 6) {
+    return false;
+  }
+  record->sensor_id = sensor_id;
+
+  struct tm time_info = reader->day;
+  time_info.tm_hour = hour;
+  time_info.tm_min = minute;
+  time_info.tm_sec = second;
+  time_info.tm_isdst = -1;
+  record->time = mktime(&time_info);
+  return true;
+}
+
+
+// Returns the next CSV record, skipping the header and incomplete lines.
+static SdLogReadStatus_t nextCsvRecord(SdLogReader_t* reader, BinaryLogRecord_t* record) {
+  while (true) {
+    char* start = (char*)reader->buffer + reader->position;
+    char* end = (char*)memchr(start, '\n', reader->length - reader->position);
+    if (end == NULL) {
+      // A line longer than the buffer can not be parsed, drop it.
+      if (reader->position == 0 && reader->length == sizeof(reader->buffer)) {
+        reader->position = reader->length;
+      }
+      return reader->eof ? SD_LOG_READ_END : SD_LOG_READ_NEED_DATA;
+    }
+
+    *end = '\0';
+    reader->position = (uint8_t*)end + 1 - reader->buffer;
+    if (parseCsvLine(reader, start, record)) {
+      return SD_LOG_READ_RECORD;
+    }
+  }
+}
+
+
+// Returns the next record of the binary or compressed blocks, resynchronizing on the next byte after a bad block.
+static SdLogReadStatus_t nextBlockRecord(SdLogReader_t* reader, BinaryLogRecord_t* record) {
+  while (true) {
+    // Return the remaining records of the current block first.
+    if (reader->in_binary_block) {
+      if (reader->binary_index < reader->binary_block.count) {
+        *record = binaryLogBlockRecord(&reader->binary_block, reader->binary_index++);
+        return SD_LOG_READ_RECORD;
+      }
+      reader->in_binary_block = false;
+      reader->position += reader->block_size;
+    }
+    if (reader->in_compressed_block) {
+      if (compressedLogNext(&reader->compressed_block, record)) {
+        return SD_LOG_READ_RECORD;
+      }
+      reader->in_compressed_block = false;
+      reader->position += reader->block_size;
+    }
+
+    const uint8_t* in = reader->buffer + reader->position;
+    size_t length = reader->length - reader->position;
+    if (length == 0) {
+      return reader->eof ? SD_LOG_READ_END : SD_LOG_READ_NEED_DATA;
+    }
+
+    // The magic tells which format the block is in.
+    BinaryLogStatus_t status;
+    if (length >= 4 && memcmp(in, "WSLC", 4) == 0) {
+      status = compressedLogOpen(in, length, &reader->compressed_block, &reader->block_size);
+      reader->in_compressed_block = status == BINARY_LOG_OK;
+    }
+    else {
+      status = binaryLogBlockDecode(in, length, &reader->binary_block, &reader->block_size);
+      reader->in_binary_block = status == BINARY_LOG_OK;
+      reader->binary_index = 0;
+    }
+
+    if (status == BINARY_LOG_TRUNCATED) {
+      if (!reader->eof) {
+        return SD_LOG_READ_NEED_DATA;
+      }
+      reader->position = reader->length;
+    }
+    else if (status != BINARY_LOG_OK) {
+      reader->position++;
+    }
+  }
+}
+
+
+// Returns the next record from the buffer.
+SdLogReadStatus_t sdLogReaderNext(SdLogReader_t* reader, BinaryLogRecord_t* record) {
+  return reader->csv ? nextCsvRecord(reader, record) : nextBlockRecord(reader, record);
+}
+
+
+// Closes the file.
+void sdLogReaderClose(SdLogReader_t* reader) {
+  reader->file.close();
+}
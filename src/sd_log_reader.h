@@ -0,0 +1,62 @@
+// Sequential reader of the SD card day log files in any SD_LOG_FORMAT (CSV, binary or compressed),
+// used to stream a time range back over the serial console.
+// Reading starts at the indexed record just before the wanted time (see sd_log_index.h),
+// so a query only reads the part of the file it returns plus at most SD_LOG_INDEX_STRIDE bytes.
+// The card is only accessed by sdLogReaderOpen, sdLogReaderFill and sdLogReaderClose, which must be
+// called with the spi_mutex held. sdLogReaderNext only parses what is already in RAM, so the mutex can be
+// released while the records are processed.
+
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+#include "FS.h"
+#include "SD.h"
+#include "binary_log.h"
+#include "compressed_log.h"
+
+// Bytes read from the card at once. Holds at least one whole binary block.
+static const uint16_t SD_LOG_READER_BUFFER_SIZE = 1024;
+
+typedef enum {
+  SD_LOG_READ_RECORD,     // A record was returned.
+  SD_LOG_READ_NEED_DATA,  // The buffer holds no complete record, call sdLogReaderFill.
+  SD_LOG_READ_END         // The end of the file was reached.
+} SdLogReadStatus_t;
+
+typedef struct {
+  File file;
+  bool csv;                       // CSV file, otherwise binary or compressed blocks.
+  bool eof;
+  struct tm day;                  // Day of the file, CSV records only store the time of day.
+
+  uint8_t buffer[SD_LOG_READER_BUFFER_SIZE];
+  uint16_t length;                // Bytes in the buffer.
+  uint16_t position;              // Bytes of the buffer already parsed.
+
+  // Block whose records are being returned.
+  bool in_binary_block;
+  bool in_compressed_block;
+  uint8_t binary_index;
+  size_t block_size;
+  BinaryLogBlock_t binary_block;
+  CompressedLogReader_t compressed_block;
+
+  // Statistics.
+  uint32_t bytes_read;
+  uint32_t index_reads;           // Index entries read to find the start.
+  uint32_t start_offset;          // Where reading started in the file.
+} SdLogReader_t;
+
+// Opens 'file_path' (the log of the day in 'day') and positions it at the last indexed record at or
+// before 'from'. It returns false if the file does not exist or can not be opened.
+bool sdLogReaderOpen(SdLogReader_t* reader, const char* file_path, const struct tm* day, uint32_t from);
+
+// Reads more bytes from the file into the buffer. It returns false once the end of the file is reached.
+bool sdLogReaderFill(SdLogReader_t* reader);
+
+// Returns the next record from the buffer. Lines and blocks that can not be parsed are skipped.
+SdLogReadStatus_t sdLogReaderNext(SdLogReader_t* reader, BinaryLogRecord_t* record);
+
+// Closes the file.
+void sdLogReaderClose(SdLogReader_t* reader);
@@ -0,0 +1,256 @@
+#include "sd_log_writer.h"
+
+
+// Number of bytes left in the buffer before the next sector boundary of the file.
+static uint16_t sectorCapacity(size_t file_size) {
+  return SD_LOG_SECTOR_SIZE - (file_size % SD_LOG_SECTOR_SIZE);
+}
+
+
+// Initializes the writer. Records are flushed at least every 'flush_interval_ms'.
+void sdLogWriterInit(SdLogWriter_t* writer, uint32_t flush_interval_ms) {
+  writer->file_open = false;
+  writer->file_path[0] = '\0';
+  writer->file_size = 0;
+  writer->index_open = false;
+  writer->next_index_offset = 0;
+  writer->index_pending_count = 0;
+  writer->buffered = 0;
+  writer->capacity = SD_LOG_SECTOR_SIZE;
+  writer->buffered_records = 0;
+  writer->flush_interval_ms = flush_interval_ms;
+  writer->last_flush_ms = 0;
+  writer->records = 0;
+  writer->bytes_written = 0;
+  writer->flushes = 0;
+  writer->write_errors = 0;
+  writer->dropped_records = 0;
+  writer->index_entries = 0;
+}
+
+
+// Returns true if appending a record has to access the card.
+// This is the case if the day file is not open yet or changed (day rollover),
+// if the record fills the buffer up to the next sector boundary
+// or if the records in the buffer have waited longer than the flush interval.
+bool sdLogWriterNeedsCard(const SdLogWriter_t* writer, const char* file_path, size_t length, uint32_t now_ms) {
+  if (!writer->file_open || strcmp(writer->file_path, file_path) != 0) {
+    return true;
+  }
+  if (writer->buffered + length >= writer->capacity || writer->buffered_records == SD_LOG_MAX_BUFFERED_RECORDS) {
+    return true;
+  }
+  return writer->buffered > 0 && now_ms - writer->last_flush_ms >= writer->flush_interval_ms;
+}
+
+
+// Opens the index of the day file in append mode. An index whose last entry was torn
+// by a power loss is started over, the records before its new first entry are then found by reading from the start.
+// Without an index the log is still written, queries just have to read it from the start.
+static void openIndexFile(SdLogWriter_t* writer) {
+  char index_path[SD_LOG_INDEX_PATH_SIZE];
+  writer->index_open = false;
+  if (!sdLogIndexPath(writer->file_path, index_path, sizeof(index_path))) {
+    return;
+  }
+
+  writer->index_file = SD.open(index_path, FILE_APPEND);
+  if (writer->index_file && writer->index_file.size() % SD_LOG_INDEX_ENTRY_SIZE != 0) {
+    writer->index_file.close();
+    SD.remove(index_path);
+    writer->index_file = SD.open(index_path, FILE_APPEND);
+  }
+  writer->index_open = (bool)writer->index_file;
+}
+
+
+// Appends the pending index entries whose records are now on the card.
+static void writeIndexEntries(SdLogWriter_t* writer) {
+  uint8_t ready = 0;
+  while (ready < writer->index_pending_count && writer->index_pending[ready].offset < writer->file_size) {
+    ready++;
+  }
+  if (ready == 0) {
+    return;
+  }
+
+  if (writer->index_open && sdLogIndexAppend(&writer->index_file, writer->index_pending, ready)) {
+    writer->index_entries += ready;
+  }
+  writer->index_pending_count -= ready;
+  memmove(writer->index_pending, writer->index_pending + ready, writer->index_pending_count * sizeof(SdLogIndexEntry_t));
+}
+
+
+// Closes the day file and its index. Index entries of records that were not written are discarded.
+static void closeDayFile(SdLogWriter_t* writer) {
+  writer->file.close();
+  writer->file_open = false;
+  if (writer->index_open) {
+    writer->index_file.close();
+    writer->index_open = false;
+  }
+  writer->index_pending_count = 0;
+}
+
+
+// Opens the day file 'file_path' of the writer in append mode, creating the folder and the file with its header if they don't exist.
+// The folder and file are only looked up here, i.e. once per day and not once per record.
+static bool openDayFile(SdLogWriter_t* writer, const char* folder_path, const char* header) {
+  const char* file_path = writer->file_path;
+  // Check if valid folder exists if not create it.
+  if (!SD.exists(folder_path) && !SD.mkdir(folder_path)) {
+    Serial.println("SD Card Task: Folder creation failed.");
+    return false;
+  }
+
+  bool new_file = !SD.exists(file_path);
+  writer->file = SD.open(file_path, FILE_APPEND);
+  if (!writer->file) {
+    Serial.println("SD Card Task: File open failed.");
+    return false;
+  }
+
+  // If the file was just created write the header.
+  if (new_file) {
+    writer->file.print(header);
+  }
+
+  writer->file_open = true;
+  writer->file_size = writer->file.size();
+  writer->capacity = sectorCapacity(writer->file_size);
+
+  // The first record appended after opening is always indexed.
+  openIndexFile(writer);
+  writer->next_index_offset = 0;
+  writer->index_pending_count = 0;
+  return true;
+}
+
+
+// Removes the records that were completely written with the first 'length' bytes of the buffer
+// and moves the ends of the others to the front with the buffer.
+static void forgetWrittenRecords(SdLogWriter_t* writer, uint16_t length) {
+  uint8_t written = 0;
+  while (written < writer->buffered_records && writer->record_ends[written] <= length) {
+    written++;
+  }
+  writer->buffered_records -= written;
+  for (uint8_t i = 0; i < writer->buffered_records; i++) {
+    writer->record_ends[i] = writer->record_ends[written + i] - length;
+  }
+}
+
+
+// Empties the buffer and counts its records as dropped.
+static void dropBuffer(SdLogWriter_t* writer) {
+  writer->dropped_records += writer->buffered_records;
+  writer->buffered = 0;
+  writer->buffered_records = 0;
+}
+
+
+// Writes the first 'length' bytes of the buffer to the card and moves the rest to the front.
+// On a write error the file is closed so that it is reopened on the next append
+// and the records stay in the buffer to be retried.
+static bool writeBuffer(SdLogWriter_t* writer, uint16_t length, uint32_t now_ms) {
+  writer->last_flush_ms = now_ms;
+  if (length == 0) {
+    return true;
+  }
+  if (!writer->file_open) {
+    return false;
+  }
+
+  size_t written = writer->file.write(writer->buffer, length);
+  writer->file.flush();
+  if (written != length) {
+    writer->write_errors++;
+    closeDayFile(writer);
+    return false;
+  }
+
+  writer->bytes_written += written;
+  writer->flushes++;
+  writer->buffered -= length;
+  memmove(writer->buffer, writer->buffer + length, writer->buffered);
+  forgetWrittenRecords(writer, length);
+  writer->file_size += written;
+  writer->capacity = sectorCapacity(writer->file_size);
+  writeIndexEntries(writer);
+  return true;
+}
+
+
+// Writes all buffered records to the card.
+bool sdLogWriterFlush(SdLogWriter_t* writer, uint32_t now_ms) {
+  return writeBuffer(writer, writer->buffered, now_ms);
+}
+
+
+// Flushes and closes the day file.
+void sdLogWriterClose(SdLogWriter_t* writer, uint32_t now_ms) {
+  if (!writer->file_open) {
+    return;
+  }
+  sdLogWriterFlush(writer, now_ms);
+  if (writer->file_open) {
+    closeDayFile(writer);
+  }
+}
+
+
+// Appends a record to the day file.
+// The first record starting in every SD_LOG_INDEX_STRIDE bytes of the file gets an index entry,
+// which is written once the record itself is on the card. The record is copied into the buffer. Whenever the buffer reaches the next sector boundary
+// of the file exactly the bytes up to that boundary are written out, so the card only sees
+// whole sector writes. A time based flush may end mid sector, the next write realigns.
+bool sdLogWriterAppend(SdLogWriter_t* writer, const char* folder_path, const char* file_path, const char* header,
+                       uint32_t time, const uint8_t* record, size_t length, uint32_t now_ms) {
+  // On day rollover flush the records of the previous day into its own file first.
+  // The ones that can not be written are dropped, they must not be written into the new day file.
+  if (strcmp(writer->file_path, file_path) != 0) {
+    sdLogWriterClose(writer, now_ms);
+    if (writer->buffered > 0) {
+      dropBuffer(writer);
+    }
+    strncpy(writer->file_path, file_path, sizeof(writer->file_path) - 1);
+    writer->file_path[sizeof(writer->file_path) - 1] = '\0';
+  }
+
+  if (!writer->file_open && !openDayFile(writer, folder_path, header)) {
+    writer->write_errors++;
+  }
+
+  // Make room for the record. If the card can not take the buffered records drop the new one.
+  if (writer->buffered + length > sizeof(writer->buffer) || writer->buffered_records == SD_LOG_MAX_BUFFERED_RECORDS) {
+    sdLogWriterFlush(writer, now_ms);
+    if (writer->buffered + length > sizeof(writer->buffer) || writer->buffered_records == SD_LOG_MAX_BUFFERED_RECORDS) {
+      writer->dropped_records++;
+      return false;
+    }
+  }
+
+  // The offset of a record is only known while the day file is open.
+  uint32_t offset = writer->file_size + writer->buffered;
+  if (writer->file_open && offset >= writer->next_index_offset && writer->index_pending_count < SD_LOG_INDEX_PENDING) {
+    writer->index_pending[writer->index_pending_count].time = time;
+    writer->index_pending[writer->index_pending_count].offset = offset;
+    writer->index_pending_count++;
+    writer->next_index_offset = (offset / SD_LOG_INDEX_STRIDE + 1) * SD_LOG_INDEX_STRIDE;
+  }
+
+  memcpy(writer->buffer + writer->buffered, record, length);
+  writer->buffered += length;
+  writer->record_ends[writer->buffered_records++] = writer->buffered;
+  writer->records++;
+
+  // Write out the full sector, or everything if the records have waited too long.
+  if (writer->buffered >= writer->capacity) {
+    writeBuffer(writer, writer->capacity, now_ms);
+  }
+  else if (now_ms - writer->last_flush_ms >= writer->flush_interval_ms) {
+    sdLogWriterFlush(writer, now_ms);
+  }
+  return true;
+}
@@ -0,0 +1,74 @@
+// Buffered append writer for the SD card log files.
+// The day file is kept open between records and records are collected in a RAM buffer
+// that is written to the card one 512 byte sector at a time, instead of looking up,
+// opening and closing the file for every ~70 byte record.
+// Every day file gets a time index next to it that is kept up to date as records are written (see sd_log_index.h).
+// None of these functions take the spi_mutex, the caller must hold it around every
+// function that can touch the card (see sdLogWriterNeedsCard).
+
+#pragma once
+
+#include <Arduino.h>
+#include "FS.h"
+#include "SD.h"
+#include "sd_log_index.h"
+
+// Size of an SD card sector. The buffer is flushed so that writes end on sector boundaries.
+static const uint16_t SD_LOG_SECTOR_SIZE = 512;
+
+// Maximum number of records in the buffer, enough for a full buffer of 8 byte binary records.
+static const uint8_t SD_LOG_MAX_BUFFERED_RECORDS = 2 * SD_LOG_SECTOR_SIZE / 8;
+
+// Maximum length of a log file path.
+static const uint8_t SD_LOG_PATH_SIZE = SD_LOG_INDEX_PATH_SIZE - 4;
+
+typedef struct {
+  File file;                              // The currently open day file.
+  bool file_open;
+  char file_path[SD_LOG_PATH_SIZE];       // Path of the currently open day file.
+  uint32_t file_size;                     // Bytes of the day file on the card.
+
+  File index_file;                        // Time index of the open day file.
+  bool index_open;
+  uint32_t next_index_offset;             // The next record starting at or after this offset gets an index entry.
+  SdLogIndexEntry_t index_pending[SD_LOG_INDEX_PENDING];  // Entries of records that are still in the buffer.
+  uint8_t index_pending_count;
+
+  uint8_t buffer[2 * SD_LOG_SECTOR_SIZE]; // Records waiting to be written to the card, with room for a record crossing the sector boundary.
+  uint16_t buffered;                      // Number of bytes in the buffer.
+  uint16_t capacity;                      // Number of bytes that fit before the next sector boundary of the file.
+  uint16_t record_ends[SD_LOG_MAX_BUFFERED_RECORDS];  // End of every record that is at least partly in the buffer.
+  uint8_t buffered_records;
+
+  uint32_t flush_interval_ms;             // Maximum time records may wait in the buffer.
+  uint32_t last_flush_ms;
+
+  // Statistics.
+  uint32_t records;                       // Records appended.
+  uint32_t bytes_written;                 // Bytes written to the card.
+  uint32_t flushes;                       // Number of buffer flushes.
+  uint32_t write_errors;                  // Failed opens or writes.
+  uint32_t dropped_records;               // Records lost because the buffer could not be flushed, or not before the day changed.
+  uint32_t index_entries;                 // Index entries written.
+} SdLogWriter_t;
+
+// Initializes the writer. Records are flushed at least every 'flush_interval_ms'.
+void sdLogWriterInit(SdLogWriter_t* writer, uint32_t flush_interval_ms);
+
+// Returns true if appending a record of 'length' bytes to 'file_path' at 'now_ms' has to access the card,
+// because the day file changed, the buffer is full or the flush interval has passed.
+// If it returns false the append only copies into RAM and does not touch the card.
+bool sdLogWriterNeedsCard(const SdLogWriter_t* writer, const char* file_path, size_t length, uint32_t now_ms);
+
+// Appends a record logged at 'time' (seconds since 1970-01-01 UTC) to 'file_path', which is created inside
+// 'folder_path' with 'header' as first line if needed. If the day file changed the previous one is flushed and closed first,
+// and records of the previous day that can not be written then are dropped instead of ending up in the new day file.
+// It returns false and counts the record as dropped if it could not be stored.
+bool sdLogWriterAppend(SdLogWriter_t* writer, const char* folder_path, const char* file_path, const char* header,
+                       uint32_t time, const uint8_t* record, size_t length, uint32_t now_ms);
+
+// Writes the buffered records to the card.
+bool sdLogWriterFlush(SdLogWriter_t* writer, uint32_t now_ms);
+
+// Flushes and closes the day file (e.g. before the card is removed or re-initialized).
+void sdLogWriterClose(SdLogWriter_t* writer, uint32_t now_ms);
@@ -0,0 +1,97 @@
+#include <stddef.h>
+#include "sensor_registry.h"
+
+
+// Empties the registry.
+void sensorRegistryInit(SensorRegistry_t* registry, uint32_t now_ms) {
+  registry->count = 0;
+  registry->start_ms = now_ms;
+  for (uint8_t bus = 0; bus < SENSOR_REGISTRY_BUSES; bus++) {
+    registry->bus_us[bus] = 0;
+    registry->bus_holds[bus] = 0;
+  }
+}
+
+
+// Adds a sensor with empty statistics.
+uint8_t sensorRegistryAdd(SensorRegistry_t* registry, uint8_t bus, uint8_t address, uint32_t interval_ms, uint32_t now_ms) {
+  if (registry->count == SENSOR_REGISTRY_SIZE || bus >= SENSOR_REGISTRY_BUSES) {
+    return SENSOR_REGISTRY_SIZE;
+  }
+
+  uint8_t id = registry->count++;
+  registry->bus[id] = bus;
+  registry->address[id] = address;
+  registry->interval_ms[id] = interval_ms;
+  registry->next_read_ms[id] = now_ms;
+  registry->temperature[id] = 0.0f;
+  registry->pressure[id] = 0.0f;
+  registry->reading_ms[id] = 0;
+  registry->readings[id] = 0;
+  registry->errors[id] = 0;
+  registry->late[id] = 0;
+  return id;
+}
+
+
+// Returns the mask of the due sensors of one bus.
+uint8_t sensorRegistryDue(const SensorRegistry_t* registry, uint8_t bus, uint32_t now_ms) {
+  uint8_t due = 0;
+  for (uint8_t id = 0; id < registry->count; id++) {
+    if (registry->bus[id] == bus && (int32_t)(now_ms - registry->next_read_ms[id]) >= 0) {
+      due |= 1 << id;
+    }
+  }
+  return due;
+}
+
+
+// Reads stay on their grid of absolute times. A read that is a whole interval late (e.g. after the sensor
+// was missing) starts a new grid from now instead of catching up with a burst of reads.
+void sensorRegistryRecord(SensorRegistry_t* registry, uint8_t id, const SensorData_t* reading, uint32_t now_ms) {
+  if (reading != NULL) {
+    registry->temperature[id] = reading->temperature;
+    registry->pressure[id] = reading->pressure;
+    registry->reading_ms[id] = now_ms;
+    registry->readings[id]++;
+  }
+  else {
+    registry->errors[id]++;
+  }
+
+  registry->next_read_ms[id] += registry->interval_ms[id];
+  if ((int32_t)(now_ms - registry->next_read_ms[id]) >= 0) {
+    registry->late[id]++;
+    registry->next_read_ms[id] = now_ms + registry->interval_ms[id];
+  }
+}
+
+
+// Adds one bus mutex hold to the statistics.
+void sensorRegistryBusHold(SensorRegistry_t* registry, uint8_t bus, uint32_t hold_us) {
+  registry->bus_us[bus] += hold_us;
+  registry->bus_holds[bus]++;
+}
+
+
+// Returns the latest reading of a sensor.
+SensorData_t sensorRegistryReading(const SensorRegistry_t* registry, uint8_t id) {
+  SensorData_t reading;
+  reading.temperature = registry->temperature[id];
+  reading.pressure = registry->pressure[id];
+  return reading;
+}
+
+
+// Returns the read rate of a sensor in readings per second.
+float sensorRegistryRate(const SensorRegistry_t* registry, uint8_t id, uint32_t now_ms) {
+  uint32_t elapsed_ms = now_ms - registry->start_ms;
+  return elapsed_ms > 0 ? registry->readings[id] * 1000.0f / elapsed_ms : 0.0f;
+}
+
+
+// Returns the bus utilization of the reads in percent.
+float sensorRegistryBusUtilization(const SensorRegistry_t* registry, uint8_t bus, uint32_t now_ms) {
+  uint32_t elapsed_ms = now_ms - registry->start_ms;
+  return elapsed_ms > 0 ? registry->bus_us[bus] / (elapsed_ms * 10.0f) : 0.0f;
+}
@@ -0,0 +1,68 @@
+// Registry of the sensors read by the readSensor task and the schedule of their reads.
+// Every sensor is identified by its ID, the index it was added at, which is carried by every sample,
+// log record and upload of that sensor. A BMP280 answers on 0x76 or 0x77, so two sensors share one
+// I2C bus and further sensors go on a second bus.
+//
+// The state of the sensors is kept as a structure of arrays indexed by the sensor ID, so the scheduler
+// only scans the next read times and the per-sensor statistics are dense arrays of counters.
+// Reads are grouped per bus: sensorRegistryDue returns the sensors of one bus that are due as a bit mask,
+// so the owner can serve all of them with one bus mutex hold instead of one hold per sensor.
+// Only the owner (readSensor) writes the registry, the statistics may be read by other tasks.
+
+#pragma once
+
+#include <stdint.h>
+#include "sensor_utils.h"
+
+// Maximum number of sensors, two addresses on each of two buses. Sensor masks are one bit per ID.
+static const uint8_t SENSOR_REGISTRY_SIZE = 4;
+static const uint8_t SENSOR_REGISTRY_BUSES = 2;
+
+typedef struct {
+  uint8_t count;
+
+  // Configuration.
+  uint8_t bus[SENSOR_REGISTRY_SIZE];
+  uint8_t address[SENSOR_REGISTRY_SIZE];
+  uint32_t interval_ms[SENSOR_REGISTRY_SIZE];      // Time between two reads of the sensor.
+
+  // Schedule and latest reading.
+  uint32_t next_read_ms[SENSOR_REGISTRY_SIZE];
+  float temperature[SENSOR_REGISTRY_SIZE];
+  float pressure[SENSOR_REGISTRY_SIZE];
+  uint32_t reading_ms[SENSOR_REGISTRY_SIZE];       // Time of the latest reading.
+
+  // Statistics since sensorRegistryInit.
+  uint32_t start_ms;
+  uint32_t readings[SENSOR_REGISTRY_SIZE];
+  uint32_t errors[SENSOR_REGISTRY_SIZE];           // Reads that failed.
+  uint32_t late[SENSOR_REGISTRY_SIZE];             // Reads taken a whole interval or more after they were due.
+  uint32_t bus_us[SENSOR_REGISTRY_BUSES];          // Time the bus mutex was held for the reads.
+  uint32_t bus_holds[SENSOR_REGISTRY_BUSES];       // Number of bus mutex holds for the reads.
+} SensorRegistry_t;
+
+// Empties the registry and starts its statistics at 'now_ms'.
+void sensorRegistryInit(SensorRegistry_t* registry, uint32_t now_ms);
+
+// Adds a sensor on 'bus' (below SENSOR_REGISTRY_BUSES) read every 'interval_ms', first at 'now_ms'.
+// It returns the ID of the sensor, or SENSOR_REGISTRY_SIZE if the registry is full or the bus is invalid.
+uint8_t sensorRegistryAdd(SensorRegistry_t* registry, uint8_t bus, uint8_t address, uint32_t interval_ms, uint32_t now_ms);
+
+// Returns the mask of the sensors on 'bus' whose read is due at 'now_ms'.
+uint8_t sensorRegistryDue(const SensorRegistry_t* registry, uint8_t bus, uint32_t now_ms);
+
+// Records the outcome of a read of sensor 'id' at 'now_ms', 'reading' is NULL if it failed,
+// and schedules the next read one interval after the previous one.
+void sensorRegistryRecord(SensorRegistry_t* registry, uint8_t id, const SensorData_t* reading, uint32_t now_ms);
+
+// Adds one hold of the mutex of 'bus' that lasted 'hold_us' to the bus statistics.
+void sensorRegistryBusHold(SensorRegistry_t* registry, uint8_t bus, uint32_t hold_us);
+
+// Returns the latest reading of sensor 'id'.
+SensorData_t sensorRegistryReading(const SensorRegistry_t* registry, uint8_t id);
+
+// Returns the average read rate of sensor 'id' in readings per second since sensorRegistryInit.
+float sensorRegistryRate(const SensorRegistry_t* registry, uint8_t id, uint32_t now_ms);
+
+// Returns the share of time the reads held the mutex of 'bus' since sensorRegistryInit, in percent.
+float sensorRegistryBusUtilization(const SensorRegistry_t* registry, uint8_t bus, uint32_t now_ms);
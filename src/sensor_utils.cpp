@@ -0,0 +1,20 @@
+#include "sensor_utils.h"
+
+
+// Converts Celsius to Fahrenheit.
+// This is a simple conversion formula: F = C * 9/5 + 32
+float toFahrenheit(float celsius) {
+  return celsius * 9.0 / 5.0 + 32.0;
+}
+
+
+// Converts a month number (0-11) to its corresponding name.
+// And returns it as a string.
+// It returns "Unknown" if the month number is invalid.
+const char* getMonthName(int month) {
+  const char* months[] = {"January", "February", "March", "April", "May", "June", "July", "August", "September", "October", "November", "December"};
+  if (month >= 0 && month < 12) {
+    return months[month];
+  }
+  return "Unknown";
+}
@@ -0,0 +1,28 @@
+// Hardware independent helpers and data types shared by the tasks in main.cpp.
+
+#pragma once
+
+#include <stdint.h>
+
+// This struct defines the format for a single sensor reading.
+typedef struct {
+  float temperature;
+  float pressure;
+} SensorData_t;
+
+// A sensor reading as published by the readSensor task.
+// 'sequence' increments by one for every published reading of the sensor so consumers can detect
+// duplicated or skipped samples, 'timestamp_ms' is the time since boot the reading was taken
+// and 'sensor_id' the sensor it was taken from (see sensor_registry.h).
+typedef struct {
+  SensorData_t data;
+  uint32_t sequence;
+  uint32_t timestamp_ms;
+  uint8_t sensor_id;
+} Sample_t;
+
+// Converts Celsius to Fahrenheit.
+float toFahrenheit(float celsius);
+
+// Converts a month number (0-11) to its corresponding name.
+const char* getMonthName(int month);
@@ -0,0 +1,83 @@
+#include <math.h>
+#include "stream_stats.h"
+
+
+// Clears the statistics so that a new window can be started.
+void streamStatsReset(StreamStats_t* stats) {
+  stats->count = 0;
+  stats->mean = 0.0;
+  stats->shift = 0.0;
+  stats->shifted_mean = 0.0;
+  stats->m2 = 0.0;
+  stats->min = 0.0;
+  stats->max = 0.0;
+}
+
+
+// Folds one value into the statistics using Welford's algorithm.
+// The mean is updated incrementally which avoids the precision loss of summing
+// a large window of similar values (e.g. ~1000 hPa) before dividing. The values are shifted by the
+// first one so that the running mean is a small number whose rounding does not add up over a long
+// window (a float at 1000 hPa only resolves 0.00006 hPa, less than the increments late in a window).
+void streamStatsAdd(StreamStats_t* stats, float value) {
+  stats->count++;
+
+  if (stats->count == 1) {
+    stats->min = value;
+    stats->max = value;
+    stats->shift = value;
+  }
+  else {
+    if (value < stats->min) {
+      stats->min = value;
+    }
+    if (value > stats->max) {
+      stats->max = value;
+    }
+  }
+
+  float shifted = value - stats->shift;
+  float delta = shifted - stats->shifted_mean;
+  stats->shifted_mean += delta / stats->count;
+  stats->m2 += delta * (shifted - stats->shifted_mean);
+  stats->mean = stats->shift + stats->shifted_mean;
+}
+
+
+// Returns the sample variance of the values added so far.
+// It returns 0.0 if fewer than two values were added to avoid division by zero.
+float streamStatsVariance(const StreamStats_t* stats) {
+  if (stats->count < 2) {
+    return 0.0;
+  }
+  return stats->m2 / (stats->count - 1);
+}
+
+
+// Returns the sample standard deviation of the values added so far.
+float streamStatsStdDev(const StreamStats_t* stats) {
+  return sqrtf(streamStatsVariance(stats));
+}
+
+
+// Clears the statistics of both sensor values.
+void sensorStatsReset(SensorStats_t* stats) {
+  streamStatsReset(&stats->temperature);
+  streamStatsReset(&stats->pressure);
+}
+
+
+// Folds one sensor reading into the statistics.
+void sensorStatsAdd(SensorStats_t* stats, const SensorData_t* data) {
+  streamStatsAdd(&stats->temperature, data->temperature);
+  streamStatsAdd(&stats->pressure, data->pressure);
+}
+
+
+// Returns the mean temperature and pressure of the window.
+SensorData_t sensorStatsMean(const SensorStats_t* stats) {
+  SensorData_t mean;
+  mean.temperature = stats->temperature.mean;
+  mean.pressure = stats->pressure.mean;
+  return mean;
+}
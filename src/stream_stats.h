@@ -0,0 +1,46 @@
+// Constant memory, single pass statistics over a window of sensor samples.
+// Each sample is folded in as it arrives using Welford's algorithm, so a window of any length
+// costs the same few bytes and no second pass is needed to compute the results.
+
+#pragma once
+
+#include <stdint.h>
+#include "sensor_utils.h"
+
+// Running statistics of a single value.
+typedef struct {
+  uint32_t count;
+  float mean;
+  float shift;          // First value of the window, subtracted from every value to keep the sums small.
+  float shifted_mean;   // Mean of the shifted values.
+  float m2;             // Sum of squared differences from the mean, used for the variance.
+  float min;
+  float max;
+} StreamStats_t;
+
+// Running statistics of both values of a sensor reading.
+typedef struct {
+  StreamStats_t temperature;
+  StreamStats_t pressure;
+} SensorStats_t;
+
+// Clears the statistics so that a new window can be started.
+void streamStatsReset(StreamStats_t* stats);
+
+// Folds one value into the statistics.
+void streamStatsAdd(StreamStats_t* stats, float value);
+
+// Returns the sample variance of the values added so far (0.0 for fewer than two values).
+float streamStatsVariance(const StreamStats_t* stats);
+
+// Returns the sample standard deviation of the values added so far.
+float streamStatsStdDev(const StreamStats_t* stats);
+
+// Clears the statistics of both sensor values.
+void sensorStatsReset(SensorStats_t* stats);
+
+// Folds one sensor reading into the statistics.
+void sensorStatsAdd(SensorStats_t* stats, const SensorData_t* data);
+
+// Returns the mean temperature and pressure of the window.
+SensorData_t sensorStatsMean(const SensorStats_t* stats);
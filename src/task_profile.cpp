@@ -0,0 +1,49 @@
+#include "task_profile.h"
+
+
+// Initializes the profile.
+void taskProfileInit(TaskProfile_t* profile, uint32_t target_period_us) {
+  histogramReset(&profile->period_us);
+  histogramReset(&profile->exec_us);
+  profile->target_period_us = target_period_us;
+  profile->overruns = 0;
+  profile->deadline_misses = 0;
+  profile->skipped_periods = 0;
+  profile->iteration_start_us = 0;
+  profile->started = false;
+}
+
+
+// Records the period since the start of the previous iteration.
+void taskProfileBegin(TaskProfile_t* profile, uint32_t now_us) {
+  if (profile->started) {
+    histogramAdd(&profile->period_us, now_us - profile->iteration_start_us);
+  }
+  profile->iteration_start_us = now_us;
+  profile->started = true;
+}
+
+
+// Records the execution time of the iteration.
+void taskProfileEnd(TaskProfile_t* profile, uint32_t now_us) {
+  uint32_t exec_us = now_us - profile->iteration_start_us;
+  histogramAdd(&profile->exec_us, exec_us);
+  if (profile->target_period_us > 0 && exec_us > profile->target_period_us) {
+    profile->overruns++;
+  }
+}
+
+
+// Checks if the next release time of a periodic task is still ahead.
+bool taskProfileSchedule(TaskProfile_t* profile, uint32_t* release, uint32_t period, uint32_t now) {
+  uint32_t elapsed = now - *release;
+  if (elapsed < period) {
+    return true;
+  }
+
+  uint32_t periods = elapsed / period;
+  profile->deadline_misses++;
+  profile->skipped_periods += periods - 1;
+  *release += periods * period;
+  return false;
+}
@@ -0,0 +1,39 @@
+// Per task loop profiling: how long each iteration of a task loop runs (execution time)
+// and how much time passes between the starts of two iterations (period).
+// A task calls taskProfileBegin at the top of its loop and taskProfileEnd once the work
+// of the iteration is done, before it sleeps. An iteration that takes longer than the
+// target period of the task is counted as an overrun. Periodic tasks also count the
+// deadlines they missed, i.e. iterations that could not start at their scheduled time.
+
+#pragma once
+
+#include <stdint.h>
+#include "histogram.h"
+
+typedef struct {
+  Histogram_t period_us;        // Time between the starts of two iterations.
+  Histogram_t exec_us;          // Time from the start to the end of an iteration.
+  uint32_t target_period_us;    // Intended period, 0 for tasks that wait for events.
+  uint32_t overruns;            // Iterations that ran longer than the target period.
+  uint32_t deadline_misses;     // Iterations that started late because the previous one finished after their release time.
+  uint32_t skipped_periods;     // Periods skipped entirely to get back on schedule.
+  uint32_t iteration_start_us;
+  bool started;
+} TaskProfile_t;
+
+// Initializes the profile of a task that runs every 'target_period_us' (0 if it is event driven).
+void taskProfileInit(TaskProfile_t* profile, uint32_t target_period_us);
+
+// Marks the start of an iteration at 'now_us'.
+void taskProfileBegin(TaskProfile_t* profile, uint32_t now_us);
+
+// Marks the end of the iteration started by the last taskProfileBegin.
+void taskProfileEnd(TaskProfile_t* profile, uint32_t now_us);
+
+// Computes the schedule of a periodic task that runs every 'period' ticks (or milliseconds).
+// '*release' is the time the current iteration was scheduled to start and 'now' the time it finished.
+// If the next release time is still ahead it returns true, the task sleeps until '*release' + 'period'.
+// Otherwise the deadline was missed: it counts the miss and the periods that passed entirely,
+// moves '*release' to the last release time not after 'now' (keeping the phase of the schedule)
+// and returns false, so the task starts its next iteration right away instead of bursting to catch up.
+bool taskProfileSchedule(TaskProfile_t* profile, uint32_t* release, uint32_t period, uint32_t now);
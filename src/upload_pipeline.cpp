@@ -0,0 +1,167 @@
+#include "upload_pipeline.h"
+
+
+// Initializes the pipeline with every slot free.
+void uploadPipelineInit(UploadPipeline_t* pipeline, uint8_t max_in_flight, uint8_t max_attempts, uint32_t timeout_ms,
+                        uint32_t retry_min_ms, uint32_t retry_max_ms) {
+  for (uint8_t i = 0; i < UPLOAD_PIPELINE_SLOTS; i++) {
+    pipeline->slots[i].state = UPLOAD_SLOT_FREE;
+    pipeline->slots[i].status.store(0, std::memory_order_relaxed);
+    pipeline->slots[i].attempts = 0;
+  }
+  pipeline->max_in_flight = max_in_flight < UPLOAD_PIPELINE_SLOTS ? max_in_flight : UPLOAD_PIPELINE_SLOTS;
+  pipeline->max_attempts = max_attempts;
+  pipeline->timeout_ms = timeout_ms;
+  pipeline->retry_min_ms = retry_min_ms;
+  pipeline->retry_max_ms = retry_max_ms;
+  pipeline->sent = 0;
+  pipeline->acked = 0;
+  pipeline->failed = 0;
+  pipeline->timeouts = 0;
+  pipeline->retries = 0;
+  pipeline->given_up = 0;
+  pipeline->released = 0;
+  pipeline->full = 0;
+  pipeline->in_use_max = 0;
+  histogramReset(&pipeline->ack_ms);
+  histogramReset(&pipeline->delivery_ms);
+}
+
+
+// Returns the number of slots in use.
+uint8_t uploadPipelineInUse(const UploadPipeline_t* pipeline) {
+  uint8_t in_use = 0;
+  for (uint8_t i = 0; i < UPLOAD_PIPELINE_SLOTS; i++) {
+    if (pipeline->slots[i].state != UPLOAD_SLOT_FREE) {
+      in_use++;
+    }
+  }
+  return in_use;
+}
+
+
+// Returns the number of slots that can still be acquired.
+uint8_t uploadPipelineAvailable(const UploadPipeline_t* pipeline) {
+  uint8_t in_use = uploadPipelineInUse(pipeline);
+  return in_use < pipeline->max_in_flight ? pipeline->max_in_flight - in_use : 0;
+}
+
+
+// Returns a free slot for the owner to fill in.
+UploadSlot_t* uploadPipelineAcquire(UploadPipeline_t* pipeline) {
+  uint8_t in_use = uploadPipelineInUse(pipeline);
+  if (in_use >= pipeline->max_in_flight) {
+    pipeline->full++;
+    return NULL;
+  }
+
+  for (uint8_t i = 0; i < UPLOAD_PIPELINE_SLOTS; i++) {
+    UploadSlot_t* slot = &pipeline->slots[i];
+    if (slot->state == UPLOAD_SLOT_FREE) {
+      slot->state = UPLOAD_SLOT_READY;
+      slot->attempts = 0;
+      if (in_use + 1 > pipeline->in_use_max) {
+        pipeline->in_use_max = in_use + 1;
+      }
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+
+// The generation is bumped for every attempt, so a completion of an earlier attempt no longer matches.
+uint32_t uploadPipelineSent(UploadPipeline_t* pipeline, UploadSlot_t* slot, uint32_t now_ms) {
+  uint32_t generation = (slot->status.load(std::memory_order_relaxed) >> 2) + 1;
+  slot->status.store(generation << 2 | UPLOAD_RESULT_PENDING, std::memory_order_release);
+  if (slot->attempts == 0) {
+    slot->first_send_ms = now_ms;
+  }
+  slot->attempts++;
+  slot->send_ms = now_ms;
+  slot->state = UPLOAD_SLOT_IN_FLIGHT;
+  pipeline->sent++;
+  return generation & 0x3FFFFFFF;
+}
+
+
+// Frees a READY slot without sending it.
+void uploadPipelineRelease(UploadPipeline_t* pipeline, UploadSlot_t* slot) {
+  slot->state = UPLOAD_SLOT_FREE;
+  pipeline->released++;
+}
+
+
+// Reports the completion of an attempt. Only the first completion of the attempt in flight is taken.
+bool uploadPipelineComplete(UploadPipeline_t* pipeline, uint8_t index, uint32_t generation, bool ok) {
+  if (index >= UPLOAD_PIPELINE_SLOTS) {
+    return false;
+  }
+  uint32_t expected = generation << 2 | UPLOAD_RESULT_PENDING;
+  uint32_t result = generation << 2 | (ok ? UPLOAD_RESULT_OK : UPLOAD_RESULT_FAILED);
+  return pipeline->slots[index].status.compare_exchange_strong(expected, result, std::memory_order_acq_rel);
+}
+
+
+// Schedules the next attempt of a failed slot, or gives it up after max_attempts.
+static UploadEvent_t retryLater(UploadPipeline_t* pipeline, UploadSlot_t* slot, uint32_t now_ms) {
+  if (slot->attempts >= pipeline->max_attempts) {
+    pipeline->given_up++;
+    slot->state = UPLOAD_SLOT_FREE;
+    return UPLOAD_EVENT_GIVE_UP;
+  }
+
+  uint32_t delay_ms = pipeline->retry_min_ms;
+  for (uint8_t i = 1; i < slot->attempts && delay_ms < pipeline->retry_max_ms; i++) {
+    delay_ms *= 2;
+  }
+  slot->retry_at_ms = now_ms + (delay_ms < pipeline->retry_max_ms ? delay_ms : pipeline->retry_max_ms);
+  slot->state = UPLOAD_SLOT_RETRY_WAIT;
+  return UPLOAD_EVENT_NONE;
+}
+
+
+// Latencies are taken when the owner polls the slot, which it does as soon as it is notified of the completion.
+UploadEvent_t uploadPipelinePoll(UploadPipeline_t* pipeline, uint32_t now_ms, UploadSlot_t** slot) {
+  for (uint8_t i = 0; i < UPLOAD_PIPELINE_SLOTS; i++) {
+    UploadSlot_t* current = &pipeline->slots[i];
+    *slot = current;
+
+    if (current->state == UPLOAD_SLOT_IN_FLIGHT) {
+      UploadResult_t result = (UploadResult_t)(current->status.load(std::memory_order_acquire) & 3);
+      if (result == UPLOAD_RESULT_OK) {
+        pipeline->acked++;
+        histogramAdd(&pipeline->ack_ms, now_ms - current->send_ms);
+        histogramAdd(&pipeline->delivery_ms, now_ms - current->first_send_ms);
+        current->state = UPLOAD_SLOT_FREE;
+        return UPLOAD_EVENT_DONE;
+      }
+      if (result == UPLOAD_RESULT_FAILED) {
+        pipeline->failed++;
+      }
+      else if (now_ms - current->send_ms >= pipeline->timeout_ms) {
+        // Close the attempt so a late completion is refused. If one landed just now it is taken on the next poll.
+        uint32_t pending = current->status.load(std::memory_order_relaxed);
+        if (!current->status.compare_exchange_strong(pending, (pending & ~3u) | UPLOAD_RESULT_FAILED, std::memory_order_acq_rel)) {
+          continue;
+        }
+        pipeline->timeouts++;
+      }
+      else {
+        continue;
+      }
+      UploadEvent_t event = retryLater(pipeline, current, now_ms);
+      if (event != UPLOAD_EVENT_NONE) {
+        return event;
+      }
+    }
+    else if (current->state == UPLOAD_SLOT_RETRY_WAIT && (int32_t)(now_ms - current->retry_at_ms) >= 0) {
+      pipeline->retries++;
+      current->state = UPLOAD_SLOT_READY;
+      return UPLOAD_EVENT_RESEND;
+    }
+  }
+
+  *slot = NULL;
+  return UPLOAD_EVENT_NONE;
+}
@@ -0,0 +1,118 @@
+// Pipeline of asynchronous upload requests with one result slot per request.
+// Every request owns a slot holding its payload until the server acknowledged it, so completions
+// can not overwrite each other and a failed or timed out request can be sent again with the same payload.
+// At most 'max_in_flight' slots are used at a time, which bounds the memory the requests hold in the
+// network client, and failed requests are retried with an exponential backoff before they are given up
+// (the owner then stores the payload elsewhere, e.g. the SD card queue).
+//
+// The slots are owned by a single task (acquire, send, poll). The completion of a request is reported
+// from whatever task runs the network client (uploadPipelineComplete), identified by the slot and the
+// generation it was sent with, so a late completion of an attempt that already timed out is ignored.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "histogram.h"
+
+// Number of slots, the upper limit of max_in_flight.
+static const uint8_t UPLOAD_PIPELINE_SLOTS = 4;
+
+// Payload bytes per slot, enough for a compressed log block (see compressed_log.h).
+static const uint16_t UPLOAD_PIPELINE_PAYLOAD_SIZE = 512;
+
+typedef enum {
+  UPLOAD_SLOT_FREE,
+  UPLOAD_SLOT_READY,        // Acquired or due for a retry, the owner has to send or release it.
+  UPLOAD_SLOT_IN_FLIGHT,    // Sent, waiting for the completion.
+  UPLOAD_SLOT_RETRY_WAIT    // Failed, waiting for the backoff delay to pass.
+} UploadSlotState_t;
+
+// Result of the attempt in flight, reported by uploadPipelineComplete.
+typedef enum {
+  UPLOAD_RESULT_PENDING,
+  UPLOAD_RESULT_OK,
+  UPLOAD_RESULT_FAILED
+} UploadResult_t;
+
+// What the owner has to do with the slot returned by uploadPipelinePoll.
+typedef enum {
+  UPLOAD_EVENT_NONE,
+  UPLOAD_EVENT_DONE,        // Acknowledged, the slot is free again.
+  UPLOAD_EVENT_RESEND,      // The backoff delay passed, send the payload again (or release the slot).
+  UPLOAD_EVENT_GIVE_UP      // Failed 'max_attempts' times, the slot is free again but the payload is still intact.
+} UploadEvent_t;
+
+typedef struct {
+  UploadSlotState_t state;
+  // Generation of the attempt in flight (upper bits) and its UploadResult_t (lowest 2 bits),
+  // updated in one step so a completion can only ever land on the attempt it belongs to.
+  std::atomic<uint32_t> status;
+  uint8_t attempts;
+  uint32_t first_send_ms;
+  uint32_t send_ms;
+  uint32_t retry_at_ms;
+
+  // Payload, filled in and interpreted by the owner. Aligned so it can hold an array of records.
+  uint8_t kind;
+  uint8_t windows;
+  uint16_t size;
+  uint32_t tag;             // Where the payload came from, e.g. the queue range it was read from.
+  alignas(4) uint8_t payload[UPLOAD_PIPELINE_PAYLOAD_SIZE];
+} UploadSlot_t;
+
+typedef struct {
+  UploadSlot_t slots[UPLOAD_PIPELINE_SLOTS];
+  uint8_t max_in_flight;
+  uint8_t max_attempts;
+  uint32_t timeout_ms;          // An attempt without completion for this long counts as failed.
+  uint32_t retry_min_ms;        // Delay before the first retry, doubled for every further one
+  uint32_t retry_max_ms;        // up to this delay.
+
+  // Statistics.
+  uint32_t sent;                // Attempts, including retries.
+  uint32_t acked;
+  uint32_t failed;              // Attempts that reported an error.
+  uint32_t timeouts;            // Attempts without completion within timeout_ms.
+  uint32_t retries;
+  uint32_t given_up;
+  uint32_t released;            // READY slots freed without being sent, e.g. a retry while the link is down.
+  uint32_t full;                // Acquires refused because max_in_flight slots were in use.
+  uint8_t in_use_max;
+  Histogram_t ack_ms;           // Send to acknowledgement of the successful attempt.
+  Histogram_t delivery_ms;      // First send to acknowledgement, including retries.
+} UploadPipeline_t;
+
+// Initializes the pipeline with every slot free. 'max_in_flight' is limited to UPLOAD_PIPELINE_SLOTS.
+void uploadPipelineInit(UploadPipeline_t* pipeline, uint8_t max_in_flight, uint8_t max_attempts, uint32_t timeout_ms,
+                        uint32_t retry_min_ms, uint32_t retry_max_ms);
+
+// Returns a free slot in the READY state for the owner to fill in, or NULL if 'max_in_flight' slots are in use.
+UploadSlot_t* uploadPipelineAcquire(UploadPipeline_t* pipeline);
+
+// Returns the number of slots that can still be acquired.
+uint8_t uploadPipelineAvailable(const UploadPipeline_t* pipeline);
+
+// Returns the number of slots in use.
+uint8_t uploadPipelineInUse(const UploadPipeline_t* pipeline);
+
+// Marks a READY slot as sent at 'now_ms' and returns the generation the completion has to be reported with.
+// Must be called right before the request is handed to the network client.
+uint32_t uploadPipelineSent(UploadPipeline_t* pipeline, UploadSlot_t* slot, uint32_t now_ms);
+
+// Frees a READY slot without sending it. The payload stays intact for the owner to store elsewhere.
+void uploadPipelineRelease(UploadPipeline_t* pipeline, UploadSlot_t* slot);
+
+// Reports the completion of the attempt 'generation' of slot 'index'. Can be called from any task.
+// It returns false if the slot is no longer waiting for that attempt (e.g. it already timed out).
+bool uploadPipelineComplete(UploadPipeline_t* pipeline, uint8_t index, uint32_t generation, bool ok);
+
+// Returns the index of a slot.
+inline uint8_t uploadPipelineIndex(const UploadPipeline_t* pipeline, const UploadSlot_t* slot) {
+  return slot - pipeline->slots;
+}
+
+// Processes the completions, timeouts and due retries at 'now_ms'. It returns one event at a time with
+// its slot in 'slot', so the owner calls it until it returns UPLOAD_EVENT_NONE.
+UploadEvent_t uploadPipelinePoll(UploadPipeline_t* pipeline, uint32_t now_ms, UploadSlot_t** slot);
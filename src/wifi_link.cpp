@@ -0,0 +1,139 @@
+#include "wifi_link.h"
+
+
+// Returns the next number of a xorshift32 generator, good enough to spread the retries.
+static uint32_t nextRandom(WifiLink_t* link) {
+  uint32_t x = link->random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  link->random_state = x;
+  return x;
+}
+
+
+// Schedules the next attempt after the current backoff delay, half of it fixed and half random.
+static void scheduleAttempt(WifiLink_t* link, uint32_t now_ms) {
+  uint32_t half = link->backoff_ms / 2;
+  link->next_attempt_ms = now_ms + half + nextRandom(link) % (link->backoff_ms - half + 1);
+  link->state = WIFI_LINK_DOWN;
+}
+
+
+// Publishes the quality of the link from the smoothed RSSI, with hysteresis between poor and good.
+static void publishQuality(WifiLink_t* link) {
+  int8_t rssi = link->rssi_avg_x16 / 16;
+  WifiLinkQuality_t quality = wifiLinkQuality(link);
+
+  if (quality != WIFI_QUALITY_POOR && rssi < WIFI_LINK_POOR_RSSI_DBM) {
+    quality = WIFI_QUALITY_POOR;
+  }
+  else if (quality != WIFI_QUALITY_GOOD && rssi >= WIFI_LINK_GOOD_RSSI_DBM) {
+    quality = WIFI_QUALITY_GOOD;
+  }
+  else if (quality == WIFI_QUALITY_OFFLINE) {
+    quality = rssi < WIFI_LINK_GOOD_RSSI_DBM ? WIFI_QUALITY_POOR : WIFI_QUALITY_GOOD;
+  }
+
+  link->rssi_dbm.store(rssi, std::memory_order_relaxed);
+  link->quality.store(quality, std::memory_order_relaxed);
+}
+
+
+// Records a new connection and the outage it ended.
+static void linkUp(WifiLink_t* link, int32_t rssi_dbm, uint32_t now_ms) {
+  uint32_t outage_ms = now_ms - link->down_since_ms;
+  link->state = WIFI_LINK_UP;
+  link->connects++;
+  link->reconnect_ms_last = outage_ms;
+  if (outage_ms > link->reconnect_ms_max) {
+    link->reconnect_ms_max = outage_ms;
+  }
+  link->offline_ms_total += outage_ms;
+  link->backoff_ms = link->backoff_min_ms;
+
+  // Start the average from the first reading instead of the RSSI of the previous connection.
+  link->rssi_avg_x16 = rssi_dbm * 16;
+  publishQuality(link);
+}
+
+
+// Initializes the manager with the link down.
+void wifiLinkInit(WifiLink_t* link, uint32_t connect_timeout_ms, uint32_t backoff_min_ms, uint32_t backoff_max_ms,
+                  uint32_t seed, uint32_t now_ms) {
+  link->state = WIFI_LINK_DOWN;
+  link->connect_timeout_ms = connect_timeout_ms;
+  link->backoff_min_ms = backoff_min_ms;
+  link->backoff_max_ms = backoff_max_ms;
+  link->backoff_ms = backoff_min_ms;
+  link->next_attempt_ms = now_ms;
+  link->attempt_start_ms = now_ms;
+  link->down_since_ms = now_ms;
+  link->rssi_avg_x16 = 0;
+  // xorshift gets stuck at 0.
+  link->random_state = seed != 0 ? seed : 0x9E3779B9;
+  link->quality.store(WIFI_QUALITY_OFFLINE, std::memory_order_relaxed);
+  link->rssi_dbm.store(0, std::memory_order_relaxed);
+  link->attempts = 0;
+  link->failed_attempts = 0;
+  link->connects = 0;
+  link->disconnects = 0;
+  link->reconnect_ms_last = 0;
+  link->reconnect_ms_max = 0;
+  link->offline_ms_total = 0;
+}
+
+
+// While up the RSSI is smoothed with a moving average over about 4 updates.
+// A lost link is retried after the minimum backoff, a failed attempt doubles the backoff.
+// If the driver reconnects on its own while waiting, the link is simply taken as up.
+WifiAction_t wifiLinkUpdate(WifiLink_t* link, bool connected, int32_t rssi_dbm, uint32_t now_ms) {
+  switch (link->state) {
+    case WIFI_LINK_UP:
+      if (connected) {
+        link->rssi_avg_x16 += (rssi_dbm * 16 - link->rssi_avg_x16) / 4;
+        publishQuality(link);
+        return WIFI_ACTION_NONE;
+      }
+      link->disconnects++;
+      link->down_since_ms = now_ms;
+      link->quality.store(WIFI_QUALITY_OFFLINE, std::memory_order_relaxed);
+      link->rssi_dbm.store(0, std::memory_order_relaxed);
+      scheduleAttempt(link, now_ms);
+      return WIFI_ACTION_NONE;
+
+    case WIFI_LINK_CONNECTING:
+      if (connected) {
+        linkUp(link, rssi_dbm, now_ms);
+      }
+      else if (now_ms - link->attempt_start_ms >= link->connect_timeout_ms) {
+        link->failed_attempts++;
+        link->backoff_ms = link->backoff_ms > link->backoff_max_ms / 2 ? link->backoff_max_ms : link->backoff_ms * 2;
+        scheduleAttempt(link, now_ms);
+      }
+      return WIFI_ACTION_NONE;
+
+    case WIFI_LINK_DOWN:
+      if (connected) {
+        linkUp(link, rssi_dbm, now_ms);
+        return WIFI_ACTION_NONE;
+      }
+      if ((int32_t)(now_ms - link->next_attempt_ms) >= 0) {
+        link->state = WIFI_LINK_CONNECTING;
+        link->attempt_start_ms = now_ms;
+        link->attempts++;
+        return WIFI_ACTION_CONNECT;
+      }
+      return WIFI_ACTION_NONE;
+  }
+  return WIFI_ACTION_NONE;
+}
+
+
+// Returns the total time spent offline since init, including the current outage.
+uint32_t wifiLinkOfflineMs(const WifiLink_t* link, uint32_t now_ms) {
+  if (link->state == WIFI_LINK_UP) {
+    return link->offline_ms_total;
+  }
+  return link->offline_ms_total + (now_ms - link->down_since_ms);
+}
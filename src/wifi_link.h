@@ -0,0 +1,86 @@
+// Non-blocking Wi-Fi connection manager.
+// The systemMonitor feeds it the driver's link status and RSSI at a fixed interval and it decides when a
+// connection attempt has to be started. Failed attempts and lost links are retried with an exponential
+// backoff with jitter (half of the delay is random), so a device that lost its access point does not keep
+// the radio busy and a fleet of devices does not reconnect in lockstep after an outage.
+// The link state and a smoothed RSSI are published to the other tasks, which use them to defer or batch
+// uploads while the link is down or poor, and the reconnect latency and time offline are kept as statistics.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Smoothed RSSI below which the link is considered poor, and above which it is good again.
+// The gap keeps the quality from flapping around a single threshold.
+static const int8_t WIFI_LINK_POOR_RSSI_DBM = -80;
+static const int8_t WIFI_LINK_GOOD_RSSI_DBM = -72;
+
+typedef enum {
+  WIFI_LINK_DOWN,         // Not connected, waiting for the backoff delay to pass.
+  WIFI_LINK_CONNECTING,   // A connection attempt is in progress.
+  WIFI_LINK_UP
+} WifiLinkState_t;
+
+// Link quality as seen by the other tasks.
+typedef enum {
+  WIFI_QUALITY_OFFLINE,
+  WIFI_QUALITY_POOR,
+  WIFI_QUALITY_GOOD
+} WifiLinkQuality_t;
+
+// What the monitor has to do after an update.
+typedef enum {
+  WIFI_ACTION_NONE,
+  WIFI_ACTION_CONNECT     // Drop whatever the driver is doing and start a new connection attempt.
+} WifiAction_t;
+
+typedef struct {
+  // Written by the monitor only (wifiLinkUpdate).
+  WifiLinkState_t state;
+  uint32_t connect_timeout_ms;  // How long an attempt may take before it counts as failed.
+  uint32_t backoff_min_ms;
+  uint32_t backoff_max_ms;
+  uint32_t backoff_ms;          // Delay before the next attempt, doubled after every failed attempt.
+  uint32_t next_attempt_ms;
+  uint32_t attempt_start_ms;
+  uint32_t down_since_ms;       // Start of the current outage (boot for the first connection).
+  int32_t rssi_avg_x16;         // Smoothed RSSI in 1/16 dBm.
+  uint32_t random_state;        // Jitter generator.
+
+  // Published to the other tasks.
+  std::atomic<uint8_t> quality;     // WifiLinkQuality_t.
+  std::atomic<int8_t> rssi_dbm;     // Smoothed RSSI, 0 while offline.
+
+  // Statistics.
+  uint32_t attempts;
+  uint32_t failed_attempts;
+  uint32_t connects;
+  uint32_t disconnects;
+  uint32_t reconnect_ms_last;   // Time from losing the link (or boot) to being connected again.
+  uint32_t reconnect_ms_max;
+  uint32_t offline_ms_total;    // Time offline in completed outages, see wifiLinkOfflineMs.
+} WifiLink_t;
+
+// Initializes the manager at 'now_ms' with the link down. The first update asks for a connection attempt.
+// Attempts are retried after 'backoff_min_ms', doubling up to 'backoff_max_ms'. 'seed' seeds the jitter
+// and should differ between devices (e.g. a hardware random number).
+void wifiLinkInit(WifiLink_t* link, uint32_t connect_timeout_ms, uint32_t backoff_min_ms, uint32_t backoff_max_ms,
+                  uint32_t seed, uint32_t now_ms);
+
+// Updates the manager with the link status reported by the driver at 'now_ms' and returns what to do.
+// 'rssi_dbm' is only used while connected.
+WifiAction_t wifiLinkUpdate(WifiLink_t* link, bool connected, int32_t rssi_dbm, uint32_t now_ms);
+
+// Returns the total time spent offline since init, including the current outage.
+uint32_t wifiLinkOfflineMs(const WifiLink_t* link, uint32_t now_ms);
+
+// Returns the link quality. Can be called from any task.
+inline WifiLinkQuality_t wifiLinkQuality(const WifiLink_t* link) {
+  return (WifiLinkQuality_t)link->quality.load(std::memory_order_relaxed);
+}
+
+// Returns the smoothed RSSI in dBm, 0 while offline. Can be called from any task.
+inline int8_t wifiLinkRssi(const WifiLink_t* link) {
+  return link->rssi_dbm.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,45 @@
+#include "window_backlog.h"
+
+
+// Empties the backlog.
+void windowBacklogReset(WindowBacklog_t* backlog) {
+  backlog->head = 0;
+  backlog->count = 0;
+  backlog->dropped = 0;
+}
+
+
+// Appends a window, dropping the oldest one if the backlog is full.
+bool windowBacklogPush(WindowBacklog_t* backlog, uint32_t time, uint8_t sensor_id, const SensorStats_t* stats) {
+  bool full = backlog->count == WINDOW_BACKLOG_SIZE;
+  if (full) {
+    windowBacklogPop(backlog);
+    backlog->dropped++;
+  }
+
+  BackloggedWindow_t* window = &backlog->windows[(backlog->head + backlog->count) % WINDOW_BACKLOG_SIZE];
+  window->time = time;
+  window->sensor_id = sensor_id;
+  window->stats = *stats;
+  backlog->count++;
+  return !full;
+}
+
+
+// Returns the oldest window.
+const BackloggedWindow_t* windowBacklogPeek(const WindowBacklog_t* backlog) {
+  if (backlog->count == 0) {
+    return NULL;
+  }
+  return &backlog->windows[backlog->head];
+}
+
+
+// Removes the oldest window.
+void windowBacklogPop(WindowBacklog_t* backlog) {
+  if (backlog->count == 0) {
+    return;
+  }
+  backlog->head = (backlog->head + 1) % WINDOW_BACKLOG_SIZE;
+  backlog->count--;
+}
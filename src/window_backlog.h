@@ -0,0 +1,37 @@
+// RAM backlog of logged windows that could not be written yet (e.g. while the SD card is missing
+// or the time is not synchronized). Windows are kept with the time they were completed, so they can
+// be replayed later with their original timestamps. When the backlog is full the oldest window is dropped.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "stream_stats.h"
+
+// Number of windows the backlog holds, shared by all sensors.
+static const uint8_t WINDOW_BACKLOG_SIZE = 64;
+
+typedef struct {
+  uint32_t time;          // Time the window was completed, Unix time or milliseconds since boot depending on the user.
+  uint8_t sensor_id;      // Sensor the window was taken from.
+  SensorStats_t stats;
+} BackloggedWindow_t;
+
+typedef struct {
+  BackloggedWindow_t windows[WINDOW_BACKLOG_SIZE];
+  uint8_t head;           // Index of the oldest window.
+  uint8_t count;
+  uint32_t dropped;       // Windows overwritten because the backlog was full.
+} WindowBacklog_t;
+
+// Empties the backlog and clears the dropped count.
+void windowBacklogReset(WindowBacklog_t* backlog);
+
+// Appends a window of a sensor. If the backlog is full the oldest window is dropped and false is returned.
+bool windowBacklogPush(WindowBacklog_t* backlog, uint32_t time, uint8_t sensor_id, const SensorStats_t* stats);
+
+// Returns the oldest window, or NULL if the backlog is empty.
+const BackloggedWindow_t* windowBacklogPeek(const WindowBacklog_t* backlog);
+
+// Removes the oldest window.
+void windowBacklogPop(WindowBacklog_t* backlog);
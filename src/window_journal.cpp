@@ -0,0 +1,68 @@
+#include "window_journal.h"
+
+
+// Starts an empty journal.
+void windowJournalInit(WindowJournal_t* journal, const char* path) {
+  journal->path = path;
+  journal->windows = 0;
+  journal->replay_offset = 0;
+}
+
+
+// Appends the backlog to the journal file.
+bool windowJournalSpill(WindowJournal_t* journal, WindowBacklog_t* backlog) {
+  File file = SD.open(journal->path, FILE_APPEND);
+  if (!file) {
+    return false;
+  }
+
+  bool written = true;
+  const BackloggedWindow_t* window;
+  while (written && (window = windowBacklogPeek(backlog)) != NULL) {
+    written = file.write((const uint8_t*)window, sizeof(BackloggedWindow_t)) == sizeof(BackloggedWindow_t);
+    if (written) {
+      windowBacklogPop(backlog);
+      journal->windows++;
+    }
+  }
+  file.close();
+  return written;
+}
+
+
+// Reads the next windows of the journal file.
+size_t windowJournalRead(WindowJournal_t* journal, BackloggedWindow_t* windows, size_t max_count) {
+  uint32_t pending = journal->windows - journal->replay_offset;
+  if (max_count > pending) {
+    max_count = pending;
+  }
+
+  size_t count = 0;
+  File file = SD.open(journal->path, FILE_READ);
+  if (file && file.seek(journal->replay_offset * sizeof(BackloggedWindow_t))) {
+    count = file.read((uint8_t*)windows, max_count * sizeof(BackloggedWindow_t)) / sizeof(BackloggedWindow_t);
+  }
+  if (file) {
+    file.close();
+  }
+
+  // Whatever was not read can not be read later either.
+  journal->replay_offset = count > 0 ? journal->replay_offset + count : journal->windows;
+  return count;
+}
+
+
+bool windowJournalPending(const WindowJournal_t* journal) {
+  return journal->replay_offset < journal->windows;
+}
+
+
+// Removes the journal file.
+bool windowJournalClear(WindowJournal_t* journal) {
+  if (SD.exists(journal->path) && !SD.remove(journal->path)) {
+    return false;
+  }
+  journal->windows = 0;
+  journal->replay_offset = 0;
+  return true;
+}
@@ -0,0 +1,37 @@
+// Journal on the SD card that a full window_backlog is moved to while the wall clock is still unknown,
+// so a slow NTP sync does not cost any windows. Windows are appended in order and read back oldest
+// first, so every window read from the journal is older than the windows still in the backlog:
+// the backlog must only be written to the log once the journal has been read back completely.
+// The journal keeps monotonic times of the current boot, it can not be replayed after a reboot.
+// None of these functions take the spi_mutex, the caller must hold it.
+
+#pragma once
+
+#include <Arduino.h>
+#include "FS.h"
+#include "SD.h"
+#include "window_backlog.h"
+
+typedef struct {
+  const char* path;
+  uint32_t windows;        // Windows appended to the journal file.
+  uint32_t replay_offset;  // Windows already read back.
+} WindowJournal_t;
+
+// Starts an empty journal in 'path'. The file is not touched.
+void windowJournalInit(WindowJournal_t* journal, const char* path);
+
+// Moves the windows of the backlog to the end of the journal, oldest first.
+// It returns false if not every window could be written, the windows not written stay in the backlog.
+bool windowJournalSpill(WindowJournal_t* journal, WindowBacklog_t* backlog);
+
+// Reads up to 'max_count' of the windows not read back yet, oldest first, and returns how many were read.
+// It returns 0 if the file is shorter than expected (e.g. the card was swapped), the rest is lost then.
+size_t windowJournalRead(WindowJournal_t* journal, BackloggedWindow_t* windows, size_t max_count);
+
+// Returns true while windows of the journal have not been read back.
+bool windowJournalPending(const WindowJournal_t* journal);
+
+// Removes the file and empties the journal. It returns false if the file could not be removed,
+// the journal then stays read back but not empty and the removal has to be retried.
+bool windowJournalClear(WindowJournal_t* journal);
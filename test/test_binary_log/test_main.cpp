@@ -0,0 +1,190 @@
+// Checks the binary log format: the CRC-32 check value, encode and decode round trips of full and partial
+// blocks, the clamping of values to their fixed point fields, the rejection of times that do not fit in
+// 16 bits past the base time, and the truncated, bad header and bad CRC results of a damaged block.
+
+#include <unity.h>
+#include <math.h>
+#include "binary_log.h"
+#include "byte_order.h"
+
+static const uint32_t START_TIME = 1792108800;     // 2026-10-16 00:00 UTC.
+
+static BinaryLogBlock_t block;
+static BinaryLogBlock_t decoded;
+static uint8_t encoded[BINARY_LOG_MAX_BLOCK_SIZE];
+
+
+// Encodes the block, decodes it again and returns the decoded record 'index'.
+static BinaryLogRecord_t roundTrip(uint8_t index) {
+  size_t length = binaryLogBlockEncode(&block, encoded);
+  size_t block_size = 0;
+  TEST_ASSERT_EQUAL(BINARY_LOG_OK, binaryLogBlockDecode(encoded, length, &decoded, &block_size));
+  TEST_ASSERT_EQUAL_UINT32(length, block_size);
+  return binaryLogBlockRecord(&decoded, index);
+}
+
+// Encodes three records and returns the length of the block.
+static size_t encodeSample(void) {
+  for (uint32_t i = 0; i < 3; i++) {
+    SensorData_t data = {21.5f + i, 1013.25f + i};
+    binaryLogBlockAdd(&block, START_TIME + i * 30, &data);
+  }
+  return binaryLogBlockEncode(&block, encoded);
+}
+
+
+void setUp(void) {
+  binaryLogBlockReset(&block);
+  memset(encoded, 0, sizeof(encoded));
+}
+
+void tearDown(void) {}
+
+
+// The standard check value of CRC-32 (IEEE 802.3), also computed in two parts.
+void test_crc32_check_value(void) {
+  const uint8_t* digits = (const uint8_t*)"123456789";
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926, binaryLogCrc32(0, digits, 9));
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926, binaryLogCrc32(binaryLogCrc32(0, digits, 4), digits + 4, 5));
+  TEST_ASSERT_EQUAL_HEX32(0, binaryLogCrc32(0, digits, 0));
+}
+
+
+// A full block is exactly 512 bytes, and every record decodes to its time and values to 1/100.
+void test_full_block_round_trip(void) {
+  block.sensor_id = 5;
+  for (uint32_t i = 0; i < BINARY_LOG_MAX_RECORDS; i++) {
+    SensorData_t data = {-10.0f + i * 0.37f, 950.0f + i * 1.13f};
+    TEST_ASSERT_TRUE(binaryLogBlockAdd(&block, START_TIME + i * 30, &data));
+  }
+  SensorData_t data = {20.0f, 1000.0f};
+  TEST_ASSERT_FALSE(binaryLogBlockAdd(&block, START_TIME + 10000, &data));
+  TEST_ASSERT_EQUAL_UINT32(512, binaryLogBlockEncode(&block, encoded));
+
+  for (uint8_t i = 0; i < BINARY_LOG_MAX_RECORDS; i++) {
+    BinaryLogRecord_t record = roundTrip(i);
+    TEST_ASSERT_EQUAL_UINT32(START_TIME + i * 30, record.time);
+    TEST_ASSERT_EQUAL_UINT8(5, record.sensor_id);
+    TEST_ASSERT_FLOAT_WITHIN(0.0051, -10.0f + i * 0.37f, record.data.temperature);
+    TEST_ASSERT_FLOAT_WITHIN(0.0051, 950.0f + i * 1.13f, record.data.pressure);
+  }
+  TEST_ASSERT_EQUAL_UINT8(BINARY_LOG_MAX_RECORDS, decoded.count);
+}
+
+
+// The fields are little endian at the offsets of the format description in binary_log.h.
+void test_layout(void) {
+  block.sensor_id = 2;
+  SensorData_t data = {-1.5f, 1013.25f};
+  binaryLogBlockAdd(&block, START_TIME, &data);
+  binaryLogBlockAdd(&block, START_TIME + 300, &data);
+  TEST_ASSERT_EQUAL_UINT32(BINARY_LOG_HEADER_SIZE + 2 * BINARY_LOG_RECORD_SIZE, binaryLogBlockEncode(&block, encoded));
+  TEST_ASSERT_EQUAL_MEMORY("WSLB", encoded, 4);
+  TEST_ASSERT_EQUAL_UINT8(BINARY_LOG_VERSION, encoded[4]);
+  TEST_ASSERT_EQUAL_UINT8(2, encoded[5]);
+  TEST_ASSERT_EQUAL_UINT8(BINARY_LOG_RECORD_SIZE, encoded[6]);
+  TEST_ASSERT_EQUAL_UINT8(2, encoded[7]);
+  TEST_ASSERT_EQUAL_UINT32(START_TIME, getU32(encoded + 8));
+  uint8_t* second = encoded + BINARY_LOG_HEADER_SIZE + BINARY_LOG_RECORD_SIZE;
+  TEST_ASSERT_EQUAL_UINT16(300, getU16(second));
+  TEST_ASSERT_EQUAL_INT16(-150, (int16_t)getU16(second + 2));
+  TEST_ASSERT_EQUAL_UINT32(101325, getU32(second + 4));
+}
+
+
+// Values outside the fixed point fields are stored as the nearest value that fits.
+void test_values_are_clamped(void) {
+  SensorData_t values[] = {
+    {400.0f, -5.0f},
+    {-400.0f, 1e12f},
+    {327.67f, 1100.0f},
+    {-327.68f, 0.0f},
+  };
+  for (uint32_t i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(binaryLogBlockAdd(&block, START_TIME + i, &values[i]));
+  }
+  TEST_ASSERT_EQUAL_INT16(INT16_MAX, block.temperature[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, block.pressure[0]);
+  TEST_ASSERT_EQUAL_INT16(INT16_MIN, block.temperature[1]);
+  TEST_ASSERT_EQUAL_UINT32(4294967040u, block.pressure[1]);
+  TEST_ASSERT_EQUAL_INT16(32767, block.temperature[2]);
+  TEST_ASSERT_EQUAL_UINT32(110000, block.pressure[2]);
+  TEST_ASSERT_EQUAL_INT16(-32768, block.temperature[3]);
+
+  BinaryLogRecord_t record = roundTrip(1);
+  TEST_ASSERT_EQUAL_FLOAT(-327.68f, record.data.temperature);
+}
+
+
+// The first record sets the base time, later ones must be at most 65535 s after it and not before it.
+void test_times_must_fit_in_16_bits(void) {
+  SensorData_t data = {20.0f, 1000.0f};
+  TEST_ASSERT_TRUE(binaryLogBlockAdd(&block, START_TIME, &data));
+  TEST_ASSERT_FALSE(binaryLogBlockAdd(&block, START_TIME - 1, &data));
+  TEST_ASSERT_FALSE(binaryLogBlockAdd(&block, START_TIME + UINT16_MAX + 1, &data));
+  TEST_ASSERT_EQUAL_UINT8(1, block.count);
+  TEST_ASSERT_TRUE(binaryLogBlockAdd(&block, START_TIME + UINT16_MAX, &data));
+  TEST_ASSERT_TRUE(binaryLogBlockAdd(&block, START_TIME, &data));
+  TEST_ASSERT_EQUAL_UINT32(START_TIME + UINT16_MAX, roundTrip(1).time);
+
+  // A rejected record leaves the block as it was, and a reset block takes a new base time.
+  binaryLogBlockReset(&block);
+  TEST_ASSERT_TRUE(binaryLogBlockAdd(&block, START_TIME - 100000, &data));
+  TEST_ASSERT_EQUAL_UINT32(START_TIME - 100000, block.base_time);
+}
+
+
+// Every length short of the whole block is truncated.
+void test_truncated_block(void) {
+  size_t length = encodeSample();
+  size_t block_size;
+  for (size_t cut = 0; cut < length; cut++) {
+    TEST_ASSERT_EQUAL(BINARY_LOG_TRUNCATED, binaryLogBlockDecode(encoded, cut, &decoded, &block_size));
+  }
+  TEST_ASSERT_EQUAL(BINARY_LOG_OK, binaryLogBlockDecode(encoded, length + 7, &decoded, &block_size));
+  TEST_ASSERT_EQUAL_UINT32(length, block_size);
+}
+
+
+// A wrong magic, version, record size or record count is a bad header, checked before the CRC.
+void test_bad_header(void) {
+  size_t length = encodeSample();
+  size_t block_size;
+  static const uint8_t FIELDS[][2] = {{0, 'X'}, {3, 'b'}, {4, BINARY_LOG_VERSION + 1}, {5, 0},
+                                      {5, BINARY_LOG_MAX_RECORDS + 1}, {6, BINARY_LOG_RECORD_SIZE + 4}};
+  for (auto& field : FIELDS) {
+    uint8_t corrupted[BINARY_LOG_MAX_BLOCK_SIZE];
+    memcpy(corrupted, encoded, length);
+    corrupted[field[0]] = field[1];
+    TEST_ASSERT_EQUAL(BINARY_LOG_BAD_HEADER, binaryLogBlockDecode(corrupted, sizeof(corrupted), &decoded, &block_size));
+  }
+}
+
+
+// A flipped bit in the base time, the CRC or any record fails the CRC.
+void test_bad_crc(void) {
+  size_t length = encodeSample();
+  size_t block_size;
+  for (size_t bit = 7 * 8; bit < length * 8; bit++) {
+    uint8_t corrupted[BINARY_LOG_MAX_BLOCK_SIZE];
+    memcpy(corrupted, encoded, length);
+    corrupted[bit / 8] ^= 1 << (bit % 8);
+    TEST_ASSERT_EQUAL(BINARY_LOG_BAD_CRC, binaryLogBlockDecode(corrupted, length, &decoded, &block_size));
+  }
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_crc32_check_value);
+  RUN_TEST(test_full_block_round_trip);
+  RUN_TEST(test_layout);
+  RUN_TEST(test_values_are_clamped);
+  RUN_TEST(test_times_must_fit_in_16_bits);
+  RUN_TEST(test_truncated_block);
+  RUN_TEST(test_bad_header);
+  RUN_TEST(test_bad_crc);
+  return UNITY_END();
+}
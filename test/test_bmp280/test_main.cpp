@@ -0,0 +1,254 @@
+// Checks the integer compensation against the example of section 3.12 of the BMP280 datasheet and the
+// floating point formulas of section 8.1, and the driver on the simulated sensor: one burst read per sample,
+// forced measurements, the probe and errors of a sensor that came loose.
+
+#include <unity.h>
+#include <stdio.h>
+#include "bmp280_driver.h"
+#include "fake_bmp280.h"
+
+static const uint8_t ADDRESS = 0x76;
+
+static TwoWire bus(2);
+static FakeBmp280 fake;
+static Bmp280_t sensor;
+
+static const Bmp280Config_t FORCED = {BMP280_OVERSAMPLING_X2, BMP280_OVERSAMPLING_X16, BMP280_FILTER_X4,
+                                      BMP280_STANDBY_0_5_MS, BMP280_MODE_FORCED};
+
+// Calibration of the datasheet example.
+static const Bmp280Calibration_t EXAMPLE = {27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000};
+
+
+// Floating point compensation of datasheet section 8.1, returning Celsius and Pa.
+static double referenceTemperature(int32_t adc_T, double* t_fine) {
+  const Bmp280Calibration_t* c = &EXAMPLE;
+  double var1 = (adc_T / 16384.0 - c->dig_T1 / 1024.0) * c->dig_T2;
+  double var2 = (adc_T / 131072.0 - c->dig_T1 / 8192.0) * (adc_T / 131072.0 - c->dig_T1 / 8192.0) * c->dig_T3;
+  *t_fine = var1 + var2;
+  return (var1 + var2) / 5120.0;
+}
+
+static double referencePressure(int32_t adc_P, double t_fine) {
+  const Bmp280Calibration_t* c = &EXAMPLE;
+  double var1 = t_fine / 2.0 - 64000.0;
+  double var2 = var1 * var1 * c->dig_P6 / 32768.0;
+  var2 = var2 + var1 * c->dig_P5 * 2.0;
+  var2 = var2 / 4.0 + c->dig_P4 * 65536.0;
+  var1 = (c->dig_P3 * var1 * var1 / 524288.0 + c->dig_P2 * var1) / 524288.0;
+  var1 = (1.0 + var1 / 32768.0) * c->dig_P1;
+  double p = 1048576.0 - adc_P;
+  p = (p - var2 / 4096.0) * 6250.0 / var1;
+  var1 = c->dig_P9 * p * p / 2147483648.0;
+  var2 = p * c->dig_P8 / 32768.0;
+  return p + (var1 + var2 + c->dig_P7) / 16.0;
+}
+
+
+// Reads both values the way Adafruit_BMP280 does: readTemperature, then readPressure, which reads
+// the temperature again for t_fine. Each value is a register address write and a 3 byte read.
+static void adafruitStyleRead() {
+  const uint8_t registers[] = {0xFA, 0xFA, 0xF7};
+  for (uint8_t reg : registers) {
+    bus.beginTransmission(ADDRESS);
+    bus.write(reg);
+    bus.endTransmission();
+    bus.requestFrom(ADDRESS, (size_t)3);
+    while (bus.available()) {
+      bus.read();
+    }
+  }
+}
+
+
+void setUp(void) {
+  fakeClockSet(0);
+  fake = FakeBmp280();
+  bus.detach(ADDRESS);
+  bus.attach(ADDRESS, &fake);
+  bus.setClock(100000);
+  bus.resetStats();
+  memset(&sensor, 0, sizeof(sensor));
+}
+
+void tearDown(void) {}
+
+
+void test_calibration_and_raw_values_are_parsed(void) {
+  uint8_t bytes[BMP280_CALIBRATION_SIZE];
+  memcpy(bytes, &fake.registers[0x88], sizeof(bytes));
+  Bmp280Calibration_t calibration;
+  bmp280ParseCalibration(bytes, &calibration);
+  TEST_ASSERT_EQUAL_MEMORY(&EXAMPLE, &calibration, sizeof(calibration));
+
+  int32_t adc_P, adc_T;
+  bmp280ParseRaw(&fake.registers[0xF7], &adc_P, &adc_T);
+  TEST_ASSERT_EQUAL_INT32(FAKE_BMP280_EXAMPLE_ADC_P, adc_P);
+  TEST_ASSERT_EQUAL_INT32(FAKE_BMP280_EXAMPLE_ADC_T, adc_T);
+}
+
+
+// The example of datasheet section 3.12: 25.08 C, t_fine 128422 and 100653.27 Pa.
+// The pressure of the example comes from the floating point formulas,
+// the 64-bit integer formula gives 25767233 / 256 = 100653.25 Pa.
+void test_datasheet_example(void) {
+  int32_t t_fine;
+  TEST_ASSERT_EQUAL_INT32(2508, bmp280CompensateTemperature(&EXAMPLE, FAKE_BMP280_EXAMPLE_ADC_T, &t_fine));
+  TEST_ASSERT_EQUAL_INT32(128422, t_fine);
+  uint32_t pressure = bmp280CompensatePressure(&EXAMPLE, FAKE_BMP280_EXAMPLE_ADC_P, t_fine);
+  TEST_ASSERT_EQUAL_UINT32(25767233, pressure);
+  TEST_ASSERT_FLOAT_WITHIN(0.02, 100653.27, pressure / 256.0);
+}
+
+
+// Across the measurement range the integer results stay within the resolution of the floating point formulas.
+void test_integer_compensation_matches_the_floating_point_formulas(void) {
+  for (int32_t adc_T = 400000; adc_T <= 650000; adc_T += 12500) {
+    for (int32_t adc_P = 250000; adc_P <= 600000; adc_P += 17500) {
+      int32_t t_fine;
+      double reference_t_fine;
+      double temperature = bmp280CompensateTemperature(&EXAMPLE, adc_T, &t_fine) / 100.0;
+      double pressure = bmp280CompensatePressure(&EXAMPLE, adc_P, t_fine) / 256.0;
+      TEST_ASSERT_FLOAT_WITHIN(0.01, referenceTemperature(adc_T, &reference_t_fine), temperature);
+      TEST_ASSERT_FLOAT_WITHIN(1.0, referencePressure(adc_P, reference_t_fine), pressure);
+    }
+  }
+}
+
+
+void test_invalid_calibration_gives_zero_pressure(void) {
+  Bmp280Calibration_t calibration = EXAMPLE;
+  calibration.dig_P1 = 0;
+  int32_t t_fine;
+  bmp280CompensateTemperature(&calibration, FAKE_BMP280_EXAMPLE_ADC_T, &t_fine);
+  TEST_ASSERT_EQUAL_UINT32(0, bmp280CompensatePressure(&calibration, FAKE_BMP280_EXAMPLE_ADC_P, t_fine));
+}
+
+
+void test_begin_reads_the_calibration_and_leaves_forced_mode_asleep(void) {
+  TEST_ASSERT_TRUE(bmp280Begin(&sensor, &bus, ADDRESS, &FORCED));
+  TEST_ASSERT_EQUAL_MEMORY(&EXAMPLE, &sensor.calibration, sizeof(EXAMPLE));
+  TEST_ASSERT_EQUAL_HEX8((BMP280_OVERSAMPLING_X2 << 5) | (BMP280_OVERSAMPLING_X16 << 2), fake.registers[0xF4]);
+  TEST_ASSERT_EQUAL_HEX8((BMP280_FILTER_X4 << 2), fake.registers[0xF5]);
+  TEST_ASSERT_EQUAL_UINT32(0, fake.forced_measurements);
+  TEST_ASSERT_EQUAL_UINT32(0, sensor.errors);
+}
+
+
+// Every sample is one forced measurement and one 6 byte burst read.
+void test_sample_is_one_burst_read(void) {
+  TEST_ASSERT_TRUE(bmp280Begin(&sensor, &bus, ADDRESS, &FORCED));
+  uint32_t transactions = sensor.transactions;
+  uint32_t bytes = sensor.bus_bytes;
+  bus.resetStats();
+
+  SensorData_t data;
+  TEST_ASSERT_TRUE(bmp280StartMeasurement(&sensor));
+  TEST_ASSERT_TRUE(bmp280ReadMeasurement(&sensor, &data));
+  TEST_ASSERT_EQUAL_UINT32(1, fake.forced_measurements);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 25.08, data.temperature);
+  TEST_ASSERT_FLOAT_WITHIN(0.0005, 1006.5327, data.pressure);
+
+  TEST_ASSERT_EQUAL_UINT32(transactions + 2, sensor.transactions);
+  TEST_ASSERT_EQUAL_UINT32(bytes + 2 + 7, sensor.bus_bytes);
+  TEST_ASSERT_EQUAL_UINT32(2 + 1, bus.stats.transactions);   // The read is a write and a read with repeated start.
+  TEST_ASSERT_EQUAL_UINT32(6, bus.stats.bytes_read);
+  TEST_ASSERT_EQUAL_UINT32(sensor.bus_bytes - bytes, bus.stats.bytes_written + bus.stats.bytes_read);
+}
+
+
+void test_normal_mode_does_not_trigger_measurements(void) {
+  Bmp280Config_t normal = FORCED;
+  normal.mode = BMP280_MODE_NORMAL;
+  TEST_ASSERT_TRUE(bmp280Begin(&sensor, &bus, ADDRESS, &normal));
+  uint32_t transactions = sensor.transactions;
+  TEST_ASSERT_TRUE(bmp280StartMeasurement(&sensor));
+  TEST_ASSERT_EQUAL_UINT32(transactions, sensor.transactions);
+  TEST_ASSERT_EQUAL_UINT32(0, fake.forced_measurements);
+}
+
+
+void test_skipped_temperature_is_not_a_sample(void) {
+  TEST_ASSERT_TRUE(bmp280Begin(&sensor, &bus, ADDRESS, &FORCED));
+  fake.setRaw(BMP280_ADC_SKIPPED, BMP280_ADC_SKIPPED);
+  SensorData_t data;
+  TEST_ASSERT_FALSE(bmp280ReadMeasurement(&sensor, &data));
+  TEST_ASSERT_EQUAL_UINT32(0, sensor.errors);
+}
+
+
+void test_probe_and_errors_of_a_disconnected_sensor(void) {
+  TEST_ASSERT_TRUE(bmp280Begin(&sensor, &bus, ADDRESS, &FORCED));
+  TEST_ASSERT_TRUE(bmp280Probe(&sensor));
+
+  fake.connected = false;
+  SensorData_t data;
+  TEST_ASSERT_FALSE(bmp280Probe(&sensor));
+  TEST_ASSERT_FALSE(bmp280StartMeasurement(&sensor));
+  TEST_ASSERT_FALSE(bmp280ReadMeasurement(&sensor, &data));
+  TEST_ASSERT_EQUAL_UINT32(3, sensor.errors);
+
+  // A different chip at the address is not a BMP280.
+  fake.connected = true;
+  fake.registers[0xD0] = 0x55;
+  TEST_ASSERT_FALSE(bmp280Probe(&sensor));
+  TEST_ASSERT_FALSE(bmp280Begin(&sensor, &bus, ADDRESS, &FORCED));
+}
+
+
+void test_measurement_time(void) {
+  // 1.25 + 2 * 2.3 + 16 * 2.3 + 0.575 = 43.225 ms.
+  TEST_ASSERT_EQUAL_UINT32(44, bmp280MeasurementTimeMs(&FORCED));
+  Bmp280Config_t fast = {BMP280_OVERSAMPLING_X1, BMP280_OVERSAMPLING_SKIP, BMP280_FILTER_OFF, BMP280_STANDBY_0_5_MS,
+                         BMP280_MODE_FORCED};
+  TEST_ASSERT_EQUAL_UINT32(4, bmp280MeasurementTimeMs(&fast));
+}
+
+
+// Bus bytes, transactions and bus time per sample against the register reads of Adafruit_BMP280.
+void test_benchmark_burst_read_against_adafruit_reads(void) {
+  const uint32_t samples = 100;
+  TEST_ASSERT_TRUE(bmp280Begin(&sensor, &bus, ADDRESS, &FORCED));
+
+  bus.resetStats();
+  for (uint32_t i = 0; i < samples; i++) {
+    adafruitStyleRead();
+  }
+  FakeI2cStats_t adafruit = bus.stats;
+
+  bus.resetStats();
+  SensorData_t data;
+  for (uint32_t i = 0; i < samples; i++) {
+    bmp280ReadMeasurement(&sensor, &data);
+  }
+  FakeI2cStats_t burst = bus.stats;
+
+  printf("\nper sample at 100 kHz\n");
+  printf("Adafruit  %2u transactions  %2u bytes  %4u us\n", (unsigned)(adafruit.transactions / samples),
+         (unsigned)((adafruit.bytes_written + adafruit.bytes_read) / samples), (unsigned)(adafruit.busy_us / samples));
+  printf("burst     %2u transactions  %2u bytes  %4u us\n", (unsigned)(burst.transactions / samples),
+         (unsigned)((burst.bytes_written + burst.bytes_read) / samples), (unsigned)(burst.busy_us / samples));
+
+  TEST_ASSERT_EQUAL_UINT32(6 * samples, adafruit.transactions);
+  TEST_ASSERT_EQUAL_UINT32(2 * samples, burst.transactions);
+  TEST_ASSERT_TRUE(burst.busy_us < adafruit.busy_us * 2 / 3);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_calibration_and_raw_values_are_parsed);
+  RUN_TEST(test_datasheet_example);
+  RUN_TEST(test_integer_compensation_matches_the_floating_point_formulas);
+  RUN_TEST(test_invalid_calibration_gives_zero_pressure);
+  RUN_TEST(test_begin_reads_the_calibration_and_leaves_forced_mode_asleep);
+  RUN_TEST(test_sample_is_one_burst_read);
+  RUN_TEST(test_normal_mode_does_not_trigger_measurements);
+  RUN_TEST(test_skipped_temperature_is_not_a_sample);
+  RUN_TEST(test_probe_and_errors_of_a_disconnected_sensor);
+  RUN_TEST(test_measurement_time);
+  RUN_TEST(test_benchmark_burst_read_against_adafruit_reads);
+  return UNITY_END();
+}
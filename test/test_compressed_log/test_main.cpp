@@ -0,0 +1,192 @@
+// Checks the compressed log format: round trips with a fixed interval, jitter and clock jumps in either
+// direction, the size of every bucket at its boundaries, a full block, and the CRC check of a block.
+
+#include <unity.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "compressed_log.h"
+
+static const uint32_t START_TIME = 1792108800;     // 2026-10-16 00:00 UTC.
+
+static CompressedLogBlock_t block;
+
+
+typedef struct {
+  uint32_t time;
+  SensorData_t data;
+} Window_t;
+
+// Adds every window to a block and checks that they decode to the same times and values.
+static void roundTrip(const std::vector<Window_t>& windows) {
+  compressedLogReset(&block);
+  block.sensor_id = 3;
+  for (const Window_t& window : windows) {
+    TEST_ASSERT_TRUE(compressedLogAdd(&block, window.time, &window.data));
+  }
+  size_t length = compressedLogFinish(&block);
+
+  CompressedLogReader_t reader;
+  size_t block_size;
+  TEST_ASSERT_EQUAL(BINARY_LOG_OK, compressedLogOpen(block.data, length, &reader, &block_size));
+  TEST_ASSERT_EQUAL_UINT32(length, block_size);
+  BinaryLogRecord_t record;
+  for (const Window_t& window : windows) {
+    TEST_ASSERT_TRUE(compressedLogNext(&reader, &record));
+    TEST_ASSERT_EQUAL_UINT32(window.time, record.time);
+    TEST_ASSERT_EQUAL_UINT8(3, record.sensor_id);
+    TEST_ASSERT_FLOAT_WITHIN(0.006 + fabsf(window.data.temperature) * 1e-7, window.data.temperature, record.data.temperature);
+    TEST_ASSERT_FLOAT_WITHIN(0.006 + fabsf(window.data.pressure) * 1e-7, window.data.pressure, record.data.pressure);
+  }
+  TEST_ASSERT_FALSE(compressedLogNext(&reader, &record));
+}
+
+// Bits the second record of a block takes when its time delta or one of its values differ from the first record.
+static uint16_t secondRecordBits(uint32_t time_delta, int32_t pressure_delta) {
+  compressedLogReset(&block);
+  SensorData_t first = {20.0f, 1000.0f};
+  SensorData_t second = {20.0f, 1000.0f + pressure_delta / 100.0f};
+  compressedLogAdd(&block, START_TIME, &first);
+  uint16_t bits = block.bits;
+  TEST_ASSERT_TRUE(compressedLogAdd(&block, START_TIME + time_delta, &second));
+  return block.bits - bits;
+}
+
+
+void setUp(void) {
+  compressedLogReset(&block);
+}
+
+void tearDown(void) {}
+
+
+// Windows every 30 s take 3 bits each once the values settle.
+void test_fixed_interval_round_trip(void) {
+  std::vector<Window_t> windows;
+  for (uint32_t i = 0; i < 100; i++) {
+    windows.push_back({START_TIME + i * 30, {21.5f, 1013.25f}});
+  }
+  roundTrip(windows);
+  TEST_ASSERT_TRUE(block.bits < 100 * 3 + 64);
+}
+
+
+void test_jitter_round_trip(void) {
+  srand(7);
+  std::vector<Window_t> windows;
+  uint32_t time = START_TIME;
+  float pressure = 1013.0f;
+  for (uint32_t i = 0; i < 150; i++) {
+    time += 30 + rand() % 5 - 2;
+    pressure += (rand() % 21 - 10) / 100.0f;
+    windows.push_back({time, {20.0f + (rand() % 11 - 5) / 100.0f, pressure}});
+  }
+  roundTrip(windows);
+}
+
+
+// A clock set years forward or back, to 0 or to the largest time, and extreme values decode exactly.
+// The differences exceed the range of int32_t, which must wrap instead of overflowing.
+void test_large_jumps_round_trip(void) {
+  std::vector<Window_t> windows = {
+    {START_TIME, {20.0f, 1000.0f}},
+    {0xFFFFFFF0, {20.0f, 1000.0f}},
+    {0, {-40.0f, 300.0f}},
+    {0x7FFFFFFF, {85.0f, 1100.0f}},
+    {0x80000001, {-40.0f, 300.0f}},
+    {START_TIME, {20.0f, 1000.0f}},
+    {START_TIME + 30, {20.0f, 1000.0f}},
+    {1, {20000000.0f, 20000000.0f}},
+    {0xFFFFFFFF, {-20000000.0f, -20000000.0f}},
+  };
+  roundTrip(windows);
+}
+
+
+// Each bucket holds the zigzag values up to 2^bits - 1: delta of delta up to 2^(bits-1) - 1 and down to -2^(bits-1).
+void test_bucket_boundaries(void) {
+  // Two 1 bit value fields follow the time field.
+  TEST_ASSERT_EQUAL_UINT16(1 + 2, secondRecordBits(0, 0));
+  TEST_ASSERT_EQUAL_UINT16(2 + 7 + 2, secondRecordBits(1, 0));
+  TEST_ASSERT_EQUAL_UINT16(2 + 7 + 2, secondRecordBits(63, 0));
+  TEST_ASSERT_EQUAL_UINT16(2 + 7 + 2, secondRecordBits((uint32_t)-64, 0));
+  TEST_ASSERT_EQUAL_UINT16(3 + 12 + 2, secondRecordBits(64, 0));
+  TEST_ASSERT_EQUAL_UINT16(3 + 12 + 2, secondRecordBits(2047, 0));
+  TEST_ASSERT_EQUAL_UINT16(3 + 12 + 2, secondRecordBits((uint32_t)-2048, 0));
+  TEST_ASSERT_EQUAL_UINT16(4 + 20 + 2, secondRecordBits(2048, 0));
+  TEST_ASSERT_EQUAL_UINT16(4 + 20 + 2, secondRecordBits(524287, 0));
+  TEST_ASSERT_EQUAL_UINT16(4 + 20 + 2, secondRecordBits((uint32_t)-524288, 0));
+  TEST_ASSERT_EQUAL_UINT16(4 + 32 + 2, secondRecordBits(524288, 0));
+
+  // The time and temperature fields take 1 bit each.
+  TEST_ASSERT_EQUAL_UINT16(2 + 2 + 4, secondRecordBits(0, 1));
+  TEST_ASSERT_EQUAL_UINT16(2 + 2 + 4, secondRecordBits(0, 7));
+  TEST_ASSERT_EQUAL_UINT16(2 + 2 + 4, secondRecordBits(0, -8));
+  TEST_ASSERT_EQUAL_UINT16(2 + 3 + 8, secondRecordBits(0, 8));
+  TEST_ASSERT_EQUAL_UINT16(2 + 3 + 8, secondRecordBits(0, -128));
+  TEST_ASSERT_EQUAL_UINT16(2 + 4 + 16, secondRecordBits(0, 128));
+  TEST_ASSERT_EQUAL_UINT16(2 + 4 + 16, secondRecordBits(0, -32768));
+  TEST_ASSERT_EQUAL_UINT16(2 + 4 + 32, secondRecordBits(0, 32768));
+}
+
+
+// A record that does not fit leaves the block unchanged, and the block still decodes.
+void test_full_block_rejects_the_record(void) {
+  std::vector<Window_t> windows;
+  uint32_t time = START_TIME;
+  SensorData_t data = {20.0f, 1000.0f};
+  while (true) {
+    // Alternating large jumps take 3 full width fields per record.
+    time += windows.size() % 2 ? 1000000 : 7;
+    data.pressure = windows.size() % 2 ? 1000.0f : 1100.0f;
+    uint16_t bits = block.bits;
+    if (!compressedLogAdd(&block, time, &data)) {
+      TEST_ASSERT_EQUAL_UINT16(bits, block.bits);
+      break;
+    }
+    windows.push_back({time, data});
+  }
+  TEST_ASSERT_TRUE(block.bits <= COMPRESSED_LOG_MAX_PAYLOAD_SIZE * 8);
+  TEST_ASSERT_TRUE(compressedLogFinish(&block) <= COMPRESSED_LOG_MAX_BLOCK_SIZE);
+  roundTrip(windows);
+}
+
+
+// A flipped bit anywhere in the header or the stream fails the CRC or the header check, a cut block is truncated.
+void test_corrupted_block_is_rejected(void) {
+  std::vector<Window_t> windows;
+  for (uint32_t i = 0; i < 20; i++) {
+    windows.push_back({START_TIME + i * 30, {20.0f + i * 0.01f, 1000.0f + i * 0.03f}});
+  }
+  roundTrip(windows);
+  size_t length = compressedLogFinish(&block);
+
+  CompressedLogReader_t reader;
+  size_t block_size;
+  for (size_t bit = 0; bit < length * 8; bit++) {
+    uint8_t corrupted[COMPRESSED_LOG_MAX_BLOCK_SIZE];
+    memcpy(corrupted, block.data, length);
+    corrupted[bit / 8] ^= 1 << (bit % 8);
+    BinaryLogStatus_t status = compressedLogOpen(corrupted, length, &reader, &block_size);
+    TEST_ASSERT_NOT_EQUAL(BINARY_LOG_OK, status);
+    if (bit >= COMPRESSED_LOG_HEADER_SIZE * 8) {
+      TEST_ASSERT_EQUAL(BINARY_LOG_BAD_CRC, status);
+    }
+  }
+  TEST_ASSERT_EQUAL(BINARY_LOG_TRUNCATED, compressedLogOpen(block.data, length - 1, &reader, &block_size));
+  TEST_ASSERT_EQUAL(BINARY_LOG_TRUNCATED, compressedLogOpen(block.data, COMPRESSED_LOG_HEADER_SIZE - 1, &reader, &block_size));
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_fixed_interval_round_trip);
+  RUN_TEST(test_jitter_round_trip);
+  RUN_TEST(test_large_jumps_round_trip);
+  RUN_TEST(test_bucket_boundaries);
+  RUN_TEST(test_full_block_rejects_the_record);
+  RUN_TEST(test_corrupted_block_is_rejected);
+  return UNITY_END();
+}
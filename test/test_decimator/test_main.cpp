@@ -0,0 +1,163 @@
+// Checks the decimation stage of the high rate mode and measures the acquisition at 25, 50 and 100 Hz
+// on the simulated BMP280: I2C bus share at the bus clock of main.cpp and the CPU time per second.
+// The bus time is simulated, the CPU time is measured on the host (including the simulated bus) and only printed.
+
+#include <unity.h>
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include "decimator.h"
+#include "bmp280_driver.h"
+#include "fake_bmp280.h"
+
+static const uint8_t ADDRESS = 0x76;
+static const uint32_t I2C_CLOCK_HZ = 100000;
+
+// SENSOR_HIGH_RATE_CONFIG of main.cpp.
+static const Bmp280Config_t HIGH_RATE = {BMP280_OVERSAMPLING_X1, BMP280_OVERSAMPLING_X4, BMP280_FILTER_OFF,
+                                         BMP280_STANDBY_0_5_MS, BMP280_MODE_NORMAL};
+
+static Decimator_t decimator;
+static TwoWire bus(2);
+static FakeBmp280 fake;
+
+
+// A reading of 1013 hPa with +-0.12 hPa of deterministic noise.
+static SensorData_t noisyReading(uint32_t i) {
+  SensorData_t reading = {21.5f, 1013.0f + 0.12f * sinf(i * 2.1f) * cosf(i * 0.77f)};
+  return reading;
+}
+
+
+void setUp(void) {
+  fakeClockSet(0);
+  decimatorInit(&decimator, 50);
+  fake = FakeBmp280();
+  bus.detach(ADDRESS);
+  bus.attach(ADDRESS, &fake);
+  bus.setClock(I2C_CLOCK_HZ);
+  bus.resetStats();
+}
+
+void tearDown(void) {}
+
+
+void test_one_output_per_factor_readings(void) {
+  SensorData_t output;
+  uint32_t outputs = 0;
+  for (uint32_t i = 0; i < 500; i++) {
+    SensorData_t reading = {(float)(i % 50), 1000.0f + i % 50};
+    if (decimatorAdd(&decimator, &reading, &output)) {
+      outputs++;
+      TEST_ASSERT_EQUAL_UINT32(49, i % 50);
+      TEST_ASSERT_FLOAT_WITHIN(0.001, 24.5, output.temperature);
+      TEST_ASSERT_FLOAT_WITHIN(0.001, 1024.5, output.pressure);
+      TEST_ASSERT_FLOAT_WITHIN(0.001, 49.0, decimator.pressure_range);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(10, outputs);
+}
+
+
+void test_factor_one_passes_readings_through(void) {
+  decimatorInit(&decimator, 0);
+  TEST_ASSERT_EQUAL_UINT16(1, decimator.factor);
+  SensorData_t reading = {20.0f, 1001.0f}, output;
+  TEST_ASSERT_TRUE(decimatorAdd(&decimator, &reading, &output));
+  TEST_ASSERT_EQUAL_FLOAT(1001.0f, output.pressure);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, decimator.pressure_range);
+}
+
+
+// Averaging 50 readings cuts the noise by about sqrt(50).
+void test_average_suppresses_noise(void) {
+  double raw_square_sum = 0, output_square_sum = 0;
+  uint32_t outputs = 0;
+  SensorData_t output;
+  for (uint32_t i = 0; i < 50 * 200; i++) {
+    SensorData_t reading = noisyReading(i);
+    raw_square_sum += (reading.pressure - 1013.0) * (reading.pressure - 1013.0);
+    if (decimatorAdd(&decimator, &reading, &output)) {
+      output_square_sum += (output.pressure - 1013.0) * (output.pressure - 1013.0);
+      outputs++;
+    }
+  }
+  double raw_rms = sqrt(raw_square_sum / (50 * 200));
+  double output_rms = sqrt(output_square_sum / outputs);
+  printf("\nnoise %.4f hPa rms at the input, %.4f hPa rms at the output\n", raw_rms, output_rms);
+  TEST_ASSERT_TRUE(output_rms < raw_rms / 4);
+}
+
+
+// A door slam: +0.5 hPa for 60 ms. The average hides it, the range of its window shows it.
+void test_short_transient_shows_in_the_range(void) {
+  SensorData_t output;
+  float ranges[4];
+  float outputs[4];
+  uint8_t window = 0;
+  for (uint32_t i = 0; i < 4 * 50; i++) {
+    SensorData_t reading = noisyReading(i);
+    if (i >= 120 && i < 123) {
+      reading.pressure += 0.5f;
+    }
+    if (decimatorAdd(&decimator, &reading, &output)) {
+      outputs[window] = output.pressure;
+      ranges[window++] = decimator.pressure_range;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT8(4, window);
+  TEST_ASSERT_TRUE(ranges[0] < 0.3f && ranges[1] < 0.3f && ranges[3] < 0.3f);
+  TEST_ASSERT_TRUE(ranges[2] > 0.3f);
+  TEST_ASSERT_FLOAT_WITHIN(0.05, 1013.0, outputs[2]);
+}
+
+
+// A minute of readSensor in high rate mode at 'rate_hz': a burst read per reading, decimated to 1 Hz.
+void test_benchmark_bus_and_processing_time_per_rate(void) {
+  static const uint16_t RATES[] = {25, 50, 100};
+  const uint32_t seconds = 60;
+  Bmp280_t sensor;
+  memset(&sensor, 0, sizeof(sensor));
+  TEST_ASSERT_TRUE(bmp280Begin(&sensor, &bus, ADDRESS, &HIGH_RATE));
+
+  uint32_t max_rate_hz = 1000 / bmp280MeasurementTimeMs(&HIGH_RATE);
+  printf("\nBMP280 normal mode with x1/x4 oversampling: a new result at most every %u ms (%u Hz)\n",
+         (unsigned)bmp280MeasurementTimeMs(&HIGH_RATE), (unsigned)max_rate_hz);
+
+  for (uint16_t rate_hz : RATES) {
+    decimatorInit(&decimator, rate_hz);
+    bus.resetStats();
+    uint32_t outputs = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < rate_hz * seconds; i++) {
+      SensorData_t reading, output;
+      TEST_ASSERT_TRUE(bmp280ReadMeasurement(&sensor, &reading));
+      if (decimatorAdd(&decimator, &reading, &output)) {
+        outputs++;
+      }
+    }
+    double host_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    double bus_share = 100.0 * bus.stats.busy_us / (seconds * 1000000.0);
+    printf("%3u Hz  %3u outputs/s  %5.2f %% I2C bus at %u kHz  %6.1f us host CPU per second for driver, compensation and decimation%s\n",
+           (unsigned)rate_hz, (unsigned)(outputs / seconds), bus_share, (unsigned)(I2C_CLOCK_HZ / 1000),
+           host_us / seconds, rate_hz > max_rate_hz ? "  (faster than the sensor, readings repeat)" : "");
+
+    TEST_ASSERT_EQUAL_UINT32(seconds, outputs);
+    TEST_ASSERT_EQUAL_UINT32(rate_hz * seconds * 2, bus.stats.transactions);
+    TEST_ASSERT_TRUE(bus_share < 10.0);
+  }
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_one_output_per_factor_readings);
+  RUN_TEST(test_factor_one_passes_readings_through);
+  RUN_TEST(test_average_suppresses_noise);
+  RUN_TEST(test_short_transient_shows_in_the_range);
+  RUN_TEST(test_benchmark_bus_and_processing_time_per_rate);
+  return UNITY_END();
+}
@@ -0,0 +1,230 @@
+// Checks the decisions of device_health and measures the I2C bus time of the hardware checks on the
+// simulated bus: passive counters and cheap probes against re-initializing every device on every check.
+
+#include <unity.h>
+#include <stdio.h>
+#include "device_health.h"
+#include "bmp280_driver.h"
+#include "fake_bmp280.h"
+#include "fake_ssd1306.h"
+
+static const uint32_t PROBE_INTERVAL_MS = 30000;
+static const uint32_t REINIT_INTERVAL_MS = 10000;
+static const uint32_t CHECK_INTERVAL_MS = 5000;
+static const uint8_t SENSOR_ADDRESS = 0x76;
+static const uint8_t SCREEN_ADDRESS = 0x3C;
+
+static const Bmp280Config_t CONFIG = {BMP280_OVERSAMPLING_X2, BMP280_OVERSAMPLING_X16, BMP280_FILTER_X4,
+                                      BMP280_STANDBY_0_5_MS, BMP280_MODE_FORCED};
+
+static DeviceHealth_t health;
+static TwoWire bus(2);
+static FakeBmp280 fake_sensor;
+static FakeSsd1306 fake_screen;
+static Bmp280_t sensor;
+static DeviceHealth_t sensor_health;
+static DeviceHealth_t display_health;
+
+
+void setUp(void) {
+  fakeClockSet(0);
+  deviceHealthInit(&health, "Test", PROBE_INTERVAL_MS, REINIT_INTERVAL_MS);
+  fake_sensor = FakeBmp280();
+  fake_screen = FakeSsd1306();
+  bus.detach(SENSOR_ADDRESS);
+  bus.detach(SCREEN_ADDRESS);
+  bus.attach(SENSOR_ADDRESS, &fake_sensor);
+  bus.attach(SCREEN_ADDRESS, &fake_screen);
+  bus.setClock(100000);
+  bus.resetStats();
+  memset(&sensor, 0, sizeof(sensor));
+}
+
+void tearDown(void) {}
+
+
+void test_new_device_is_initialized_first(void) {
+  TEST_ASSERT_FALSE(health.ok);
+  TEST_ASSERT_EQUAL(DEVICE_CHECK_REINIT, deviceHealthCheck(&health, 0));
+  deviceHealthReinitialized(&health, true, 0);
+  TEST_ASSERT_TRUE(health.ok);
+  TEST_ASSERT_EQUAL(DEVICE_CHECK_NONE, deviceHealthCheck(&health, CHECK_INTERVAL_MS));
+}
+
+
+void test_failed_device_is_reinitialized_at_the_reinit_interval(void) {
+  deviceHealthReinitialized(&health, false, 0);
+  TEST_ASSERT_FALSE(health.ok);
+  TEST_ASSERT_EQUAL(DEVICE_CHECK_NONE, deviceHealthCheck(&health, REINIT_INTERVAL_MS - 1));
+  TEST_ASSERT_EQUAL(DEVICE_CHECK_REINIT, deviceHealthCheck(&health, REINIT_INTERVAL_MS));
+  deviceHealthReinitialized(&health, true, REINIT_INTERVAL_MS);
+  TEST_ASSERT_EQUAL_UINT32(2, health.reinits);
+  TEST_ASSERT_EQUAL_UINT32(1, health.reinit_failures);
+}
+
+
+// Error free traffic keeps the device from being touched, however long it runs.
+void test_busy_device_is_not_probed(void) {
+  deviceHealthReinitialized(&health, true, 0);
+  for (uint32_t now_ms = CHECK_INTERVAL_MS; now_ms < 10 * PROBE_INTERVAL_MS; now_ms += CHECK_INTERVAL_MS) {
+    deviceHealthReport(&health, true);
+    TEST_ASSERT_EQUAL(DEVICE_CHECK_NONE, deviceHealthCheck(&health, now_ms));
+  }
+}
+
+
+void test_idle_device_is_probed_at_the_probe_interval(void) {
+  deviceHealthReinitialized(&health, true, 0);
+  TEST_ASSERT_EQUAL(DEVICE_CHECK_NONE, deviceHealthCheck(&health, PROBE_INTERVAL_MS - 1));
+  TEST_ASSERT_EQUAL(DEVICE_CHECK_PROBE, deviceHealthCheck(&health, PROBE_INTERVAL_MS));
+  deviceHealthProbed(&health, true, 250, PROBE_INTERVAL_MS);
+  TEST_ASSERT_EQUAL(DEVICE_CHECK_NONE, deviceHealthCheck(&health, PROBE_INTERVAL_MS + CHECK_INTERVAL_MS));
+  TEST_ASSERT_EQUAL_UINT32(1, health.probes);
+  TEST_ASSERT_EQUAL_UINT32(250, health.probe_time_us_max);
+}
+
+
+// An error leads to a probe on the next check, and only a failed probe to a re-initialization.
+void test_errors_lead_to_a_probe_and_a_failed_probe_to_a_reinit(void) {
+  deviceHealthReinitialized(&health, true, 0);
+  deviceHealthReport(&health, true);
+  deviceHealthReport(&health, false);
+  TEST_ASSERT_EQUAL(DEVICE_CHECK_PROBE, deviceHealthCheck(&health, CHECK_INTERVAL_MS));
+  deviceHealthProbed(&health, true, 100, CHECK_INTERVAL_MS);
+  TEST_ASSERT_TRUE(health.ok);
+
+  deviceHealthReport(&health, false);
+  TEST_ASSERT_EQUAL(DEVICE_CHECK_PROBE, deviceHealthCheck(&health, 2 * CHECK_INTERVAL_MS));
+  deviceHealthProbed(&health, false, 100, 2 * CHECK_INTERVAL_MS);
+  TEST_ASSERT_FALSE(health.ok);
+  TEST_ASSERT_EQUAL_UINT32(1, health.probe_failures);
+  TEST_ASSERT_EQUAL(DEVICE_CHECK_REINIT, deviceHealthCheck(&health, 3 * CHECK_INTERVAL_MS));
+
+  // Errors from while the device was failing do not count after it is back.
+  deviceHealthReinitialized(&health, true, 3 * CHECK_INTERVAL_MS);
+  TEST_ASSERT_EQUAL(DEVICE_CHECK_NONE, deviceHealthCheck(&health, 4 * CHECK_INTERVAL_MS));
+}
+
+
+static bool addressAcked(uint8_t address) {
+  bus.beginTransmission(address);
+  return bus.endTransmission() == 0;
+}
+
+// The checks of main.cpp for the sensor and the display, with the decisions of device_health.
+static void checkDevices(uint32_t now_ms) {
+  DeviceCheck_t sensor_check = deviceHealthCheck(&sensor_health, now_ms);
+  DeviceCheck_t display_check = deviceHealthCheck(&display_health, now_ms);
+  if (sensor_check == DEVICE_CHECK_REINIT || display_check == DEVICE_CHECK_REINIT) {
+    bus.end();
+    bus.begin();
+  }
+
+  uint64_t start_us = fakeClockMicros();
+  if (sensor_check == DEVICE_CHECK_PROBE) {
+    deviceHealthProbed(&sensor_health, bmp280Probe(&sensor), fakeClockMicros() - start_us, now_ms);
+  }
+  else if (sensor_check == DEVICE_CHECK_REINIT) {
+    deviceHealthReinitialized(&sensor_health, addressAcked(SENSOR_ADDRESS) &&
+                              bmp280Begin(&sensor, &bus, SENSOR_ADDRESS, &CONFIG), now_ms);
+  }
+  start_us = fakeClockMicros();
+  if (display_check == DEVICE_CHECK_PROBE) {
+    deviceHealthProbed(&display_health, addressAcked(SCREEN_ADDRESS), fakeClockMicros() - start_us, now_ms);
+  }
+  else if (display_check == DEVICE_CHECK_REINIT) {
+    deviceHealthReinitialized(&display_health, addressAcked(SCREEN_ADDRESS), now_ms);
+  }
+}
+
+// What checkHardware did before: reset the bus and begin every device on every check.
+// The display initialization is the command list of Adafruit_SSD1306::begin, about 25 command bytes.
+static void checkDevicesByReinit() {
+  static const uint8_t SSD1306_INIT[26] = {0x00, 0xAE, 0xD5, 0x80, 0xA8, 0x3F, 0xD3, 0x00, 0x40, 0x8D, 0x14, 0x20, 0x00,
+                                           0xA1, 0xC8, 0xDA, 0x12, 0x81, 0xCF, 0xD9, 0xF1, 0xDB, 0x40, 0xA4, 0xA6, 0xAF};
+  bus.end();
+  bus.begin();
+  if (addressAcked(SENSOR_ADDRESS)) {
+    bmp280Begin(&sensor, &bus, SENSOR_ADDRESS, &CONFIG);
+  }
+  if (addressAcked(SCREEN_ADDRESS)) {
+    bus.beginTransmission(SCREEN_ADDRESS);
+    bus.write(SSD1306_INIT, sizeof(SSD1306_INIT));
+    bus.endTransmission();
+  }
+}
+
+// A sample of readSensor, reported to the health of the sensor.
+static void readSample() {
+  SensorData_t data;
+  bool ok = bmp280StartMeasurement(&sensor) && bmp280ReadMeasurement(&sensor, &data);
+  deviceHealthReport(&sensor_health, ok);
+}
+
+
+// Ten minutes with a sample every second and an idle display. The sensor comes loose for a minute.
+// Only the bus time of the checks is counted.
+void test_benchmark_probes_against_reinit_on_every_check(void) {
+  const uint32_t duration_ms = 600000;
+  const uint32_t loose_from_ms = 200000;
+  const uint32_t loose_to_ms = 260000;
+
+  uint64_t reinit_us = 0;
+  bmp280Begin(&sensor, &bus, SENSOR_ADDRESS, &CONFIG);
+  for (uint32_t now_ms = CHECK_INTERVAL_MS; now_ms <= duration_ms; now_ms += CHECK_INTERVAL_MS) {
+    uint64_t busy_us = bus.stats.busy_us;
+    checkDevicesByReinit();
+    reinit_us += bus.stats.busy_us - busy_us;
+  }
+
+  deviceHealthInit(&sensor_health, "BMP280", PROBE_INTERVAL_MS, REINIT_INTERVAL_MS);
+  deviceHealthInit(&display_health, "SSD1306", PROBE_INTERVAL_MS, REINIT_INTERVAL_MS);
+  checkDevices(0);
+  uint64_t probe_us = 0;
+  uint32_t detected_ms = 0, recovered_ms = 0;
+  for (uint32_t now_ms = 1000; now_ms <= duration_ms; now_ms += 1000) {
+    fake_sensor.connected = now_ms < loose_from_ms || now_ms >= loose_to_ms;
+    if (sensor_health.ok) {
+      readSample();
+    }
+    if (now_ms % CHECK_INTERVAL_MS == 0) {
+      uint64_t busy_us = bus.stats.busy_us;
+      checkDevices(now_ms);
+      probe_us += bus.stats.busy_us - busy_us;
+      if (!sensor_health.ok && detected_ms == 0) {
+        detected_ms = now_ms;
+      }
+      if (sensor_health.ok && detected_ms != 0 && recovered_ms == 0) {
+        recovered_ms = now_ms;
+      }
+    }
+  }
+
+  uint32_t checks = duration_ms / CHECK_INTERVAL_MS;
+  printf("\n%u checks in %u s\n", (unsigned)checks, (unsigned)(duration_ms / 1000));
+  printf("reinit every check  %6u us bus time per check\n", (unsigned)(reinit_us / checks));
+  printf("passive and probes  %6u us bus time per check, %u sensor probes, %u display probes, %u reinits\n",
+         (unsigned)(probe_us / checks), (unsigned)sensor_health.probes, (unsigned)display_health.probes,
+         (unsigned)(sensor_health.reinits + display_health.reinits));
+  printf("sensor loose at %u ms, failed at %u ms, back at %u ms\n", (unsigned)loose_from_ms, (unsigned)detected_ms,
+         (unsigned)recovered_ms);
+
+  TEST_ASSERT_TRUE(probe_us * 10 < reinit_us);
+  TEST_ASSERT_TRUE(detected_ms >= loose_from_ms && detected_ms <= loose_from_ms + CHECK_INTERVAL_MS);
+  TEST_ASSERT_TRUE(recovered_ms >= loose_to_ms && recovered_ms <= loose_to_ms + REINIT_INTERVAL_MS);
+  TEST_ASSERT_EQUAL_UINT32(duration_ms / PROBE_INTERVAL_MS, display_health.probes);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_new_device_is_initialized_first);
+  RUN_TEST(test_failed_device_is_reinitialized_at_the_reinit_interval);
+  RUN_TEST(test_busy_device_is_not_probed);
+  RUN_TEST(test_idle_device_is_probed_at_the_probe_interval);
+  RUN_TEST(test_errors_lead_to_a_probe_and_a_failed_probe_to_a_reinit);
+  RUN_TEST(test_benchmark_probes_against_reinit_on_every_check);
+  return UNITY_END();
+}
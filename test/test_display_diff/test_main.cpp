@@ -0,0 +1,198 @@
+// Checks displayDiff and measures partial refreshes on the simulated SSD1306: the display RAM
+// must always end up equal to the framebuffer, with far fewer I2C bytes than a full frame.
+// The senders follow sendDisplayRegion in main.cpp and display() of Adafruit_SSD1306.
+
+#include <unity.h>
+#include <stdio.h>
+#include "display_diff.h"
+#include "fake_ssd1306.h"
+
+static const uint8_t WIDTH = FAKE_SSD1306_WIDTH;
+static const uint8_t PAGES = FAKE_SSD1306_PAGES;
+static const uint16_t FRAME_SIZE = WIDTH * PAGES;
+static const uint8_t ADDRESS = 0x3C;
+static const uint8_t CHUNK_SIZE = 127;
+
+static TwoWire bus(2);
+static FakeSsd1306 screen;
+static uint8_t frame[FRAME_SIZE];
+static uint8_t shadow[FRAME_SIZE];
+
+
+static void command(uint8_t byte) {
+  bus.beginTransmission(ADDRESS);
+  bus.write((uint8_t)0x00);
+  bus.write(byte);
+  bus.endTransmission();
+}
+
+static void sendData(const uint8_t* data, uint16_t length) {
+  while (length > 0) {
+    uint8_t chunk = length < CHUNK_SIZE ? length : CHUNK_SIZE;
+    bus.beginTransmission(ADDRESS);
+    bus.write((uint8_t)0x40);
+    bus.write(data, chunk);
+    bus.endTransmission();
+    data += chunk;
+    length -= chunk;
+  }
+}
+
+// The whole frame, as display.display() sends it.
+static void sendFullFrame() {
+  const uint8_t addressing[] = {0x00, 0x22, 0, 0xFF, 0x21, 0};
+  bus.beginTransmission(ADDRESS);
+  bus.write(addressing, sizeof(addressing));
+  bus.endTransmission();
+  command(WIDTH - 1);
+  sendData(frame, FRAME_SIZE);
+  memcpy(shadow, frame, FRAME_SIZE);
+}
+
+// Only the changed columns of the changed pages, as transferDisplayFrame does.
+static uint16_t sendChanges() {
+  DisplayDirtyPage_t dirty[PAGES];
+  uint16_t bytes = displayDiff(frame, shadow, WIDTH, PAGES, dirty);
+  for (uint8_t page = 0; page < PAGES; page++) {
+    if (!dirty[page].dirty) {
+      continue;
+    }
+    command(0x22);
+    command(page);
+    command(page);
+    command(0x21);
+    command(dirty[page].first_column);
+    command(dirty[page].last_column);
+    uint16_t offset = page * WIDTH + dirty[page].first_column;
+    uint16_t length = dirty[page].last_column - dirty[page].first_column + 1;
+    sendData(frame + offset, length);
+    memcpy(shadow + offset, frame + offset, length);
+  }
+  return bytes;
+}
+
+static void assertScreenShowsFrame() {
+  TEST_ASSERT_EQUAL_MEMORY(frame, screen.ram, FRAME_SIZE);
+}
+
+// A static layout of labels and the changing digits of a reading and the clock.
+static void render(uint32_t second) {
+  for (uint16_t i = 0; i < FRAME_SIZE; i++) {
+    frame[i] = (uint8_t)(i * 37 + 11);
+  }
+  for (uint8_t column = 40; column < 64; column++) {
+    frame[2 * WIDTH + column] = (uint8_t)(second / 10 * 13 + column);
+    frame[3 * WIDTH + column] = (uint8_t)(second / 10 * 29 + column);
+  }
+  for (uint8_t column = 0; column < 21; column++) {
+    frame[7 * WIDTH + column] = (uint8_t)(second * 7 + column);
+  }
+}
+
+
+void setUp(void) {
+  fakeClockSet(0);
+  screen = FakeSsd1306();
+  bus.detach(ADDRESS);
+  bus.attach(ADDRESS, &screen);
+  bus.setClock(400000);
+  bus.resetStats();
+  memset(frame, 0, sizeof(frame));
+  memset(shadow, 0, sizeof(shadow));
+}
+
+void tearDown(void) {}
+
+
+void test_diff_finds_the_changed_column_range_of_every_page(void) {
+  DisplayDirtyPage_t dirty[PAGES];
+  frame[1 * WIDTH + 5] = 1;
+  frame[1 * WIDTH + 9] = 1;
+  frame[6 * WIDTH + WIDTH - 1] = 1;
+
+  TEST_ASSERT_EQUAL_UINT16(5 + 1, displayDiff(frame, shadow, WIDTH, PAGES, dirty));
+  TEST_ASSERT_FALSE(dirty[0].dirty);
+  TEST_ASSERT_TRUE(dirty[1].dirty);
+  TEST_ASSERT_EQUAL_UINT8(5, dirty[1].first_column);
+  TEST_ASSERT_EQUAL_UINT8(9, dirty[1].last_column);
+  TEST_ASSERT_TRUE(dirty[6].dirty);
+  TEST_ASSERT_EQUAL_UINT8(WIDTH - 1, dirty[6].first_column);
+  TEST_ASSERT_EQUAL_UINT8(WIDTH - 1, dirty[6].last_column);
+}
+
+
+void test_unchanged_frame_sends_nothing(void) {
+  render(0);
+  sendFullFrame();
+  bus.resetStats();
+
+  TEST_ASSERT_EQUAL_UINT16(0, sendChanges());
+  TEST_ASSERT_EQUAL_UINT32(0, bus.stats.transactions);
+  assertScreenShowsFrame();
+}
+
+
+void test_partial_refresh_leaves_the_display_equal_to_the_frame(void) {
+  render(0);
+  sendFullFrame();
+  assertScreenShowsFrame();
+
+  for (uint32_t second = 1; second < 30; second++) {
+    render(second);
+    sendChanges();
+    assertScreenShowsFrame();
+  }
+
+  // A change in every page and at both ends of a page.
+  for (uint16_t i = 0; i < FRAME_SIZE; i += WIDTH - 1) {
+    frame[i] ^= 0xFF;
+  }
+  sendChanges();
+  assertScreenShowsFrame();
+}
+
+
+// A minute of frames at 1 Hz, full frames against partial refreshes.
+void test_benchmark_partial_against_full_refresh(void) {
+  const uint32_t frames = 60;
+
+  render(0);
+  sendFullFrame();
+  bus.resetStats();
+  for (uint32_t second = 1; second <= frames; second++) {
+    render(second);
+    sendFullFrame();
+  }
+  FakeI2cStats_t full = bus.stats;
+
+  render(0);
+  sendFullFrame();
+  bus.resetStats();
+  for (uint32_t second = 1; second <= frames; second++) {
+    render(second);
+    sendChanges();
+    assertScreenShowsFrame();
+  }
+  FakeI2cStats_t partial = bus.stats;
+
+  printf("\n%u frames at 400 kHz\n", (unsigned)frames);
+  printf("full     %5u I2C bytes  %3u transactions  %6u us bus time per frame\n", (unsigned)(full.bytes_written / frames),
+         (unsigned)(full.transactions / frames), (unsigned)(full.busy_us / frames));
+  printf("partial  %5u I2C bytes  %3u transactions  %6u us bus time per frame\n", (unsigned)(partial.bytes_written / frames),
+         (unsigned)(partial.transactions / frames), (unsigned)(partial.busy_us / frames));
+
+  TEST_ASSERT_LESS_THAN_UINT32(full.bytes_written / 5, partial.bytes_written);
+  TEST_ASSERT_TRUE(partial.busy_us < full.busy_us / 5);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_diff_finds_the_changed_column_range_of_every_page);
+  RUN_TEST(test_unchanged_frame_sends_nothing);
+  RUN_TEST(test_partial_refresh_leaves_the_display_equal_to_the_frame);
+  RUN_TEST(test_benchmark_partial_against_full_refresh);
+  return UNITY_END();
+}
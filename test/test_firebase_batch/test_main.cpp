@@ -0,0 +1,313 @@
+// Checks the multi-path update bodies of firebase_batch against a local HTTP stand-in for the
+// Realtime Database REST API, and counts the requests and bytes of one PATCH per batch against the
+// three PUT requests per window (one per value) that were sent before.
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "firebase_batch.h"
+
+static const char* HOST = "weather-station.firebaseio.com";
+
+
+// A minimal HTTP/1.1 server on 127.0.0.1 that applies PUT and PATCH requests to a flat map of
+// database paths to values, like the database does with "<path>.json" targets, and counts them.
+class HttpStandIn {
+public:
+  bool start() {
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 8) != 0 ||
+        getsockname(listener, (sockaddr*)&address, &length) != 0) {
+      return false;
+    }
+    port = ntohs(address.sin_port);
+    thread = std::thread([this]() { serve(); });
+    return true;
+  }
+
+  void stop() {
+    shutdown(listener, SHUT_RDWR);
+    close(listener);
+    thread.join();
+  }
+
+  uint16_t port = 0;
+  std::mutex mutex;
+  std::map<std::string, double> values;
+  uint32_t requests = 0;
+  uint32_t request_bytes = 0;
+  uint32_t bad_requests = 0;
+
+private:
+  void serve() {
+    while (1) {
+      int connection = accept(listener, NULL, NULL);
+      if (connection < 0) {
+        return;
+      }
+      std::string request;
+      char buffer[1024];
+      ssize_t received;
+      size_t header_end = std::string::npos;
+      size_t content_length = 0;
+      while ((received = recv(connection, buffer, sizeof(buffer), 0)) > 0) {
+        request.append(buffer, received);
+        if (header_end == std::string::npos && (header_end = request.find("\r\n\r\n")) != std::string::npos) {
+          size_t field = request.find("Content-Length: ");
+          content_length = field < header_end ? strtoul(request.c_str() + field + 16, NULL, 10) : 0;
+        }
+        if (header_end != std::string::npos && request.size() >= header_end + 4 + content_length) {
+          break;
+        }
+      }
+
+      bool ok = header_end != std::string::npos && apply(request, header_end, content_length);
+      const char* response = ok ? "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n"
+                                : "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+      send(connection, response, strlen(response), 0);
+      close(connection);
+    }
+  }
+
+  bool apply(const std::string& request, size_t header_end, size_t content_length) {
+    std::string method = request.substr(0, request.find(' '));
+    size_t target_start = method.size() + 2;
+    std::string target = request.substr(target_start, request.find(".json", target_start) - target_start);
+    std::string body = request.substr(header_end + 4, content_length);
+
+    std::lock_guard<std::mutex> guard(mutex);
+    requests++;
+    request_bytes += request.size();
+    if (method == "PUT") {
+      values[target] = atof(body.c_str());
+      return true;
+    }
+    // A multi-path update to the root: {"path":value,...}.
+    if (method != "PATCH" || !target.empty() || body.empty() || body[0] != '{') {
+      bad_requests++;
+      return false;
+    }
+    size_t position = 1;
+    while (position < body.size() && body[position] == '"') {
+      size_t key_end = body.find('"', position + 1);
+      if (key_end == std::string::npos || body[key_end + 1] != ':') {
+        bad_requests++;
+        return false;
+      }
+      std::string key = body.substr(position + 1, key_end - position - 1);
+      char* value_end;
+      values[key] = strtod(body.c_str() + key_end + 2, &value_end);
+      position = value_end - body.c_str();
+      if (body[position] == ',') {
+        position++;
+      }
+    }
+    if (position != body.size() - 1 || body[position] != '}') {
+      bad_requests++;
+      return false;
+    }
+    return true;
+  }
+
+  int listener = -1;
+  std::thread thread;
+};
+
+static HttpStandIn server;
+
+
+// Sends one request to the stand-in and returns whether it was answered with 200.
+static bool httpRequest(const char* method, const std::string& target, const std::string& body) {
+  int connection = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(server.port);
+  if (connect(connection, (sockaddr*)&address, sizeof(address)) != 0) {
+    close(connection);
+    return false;
+  }
+
+  char header[256];
+  snprintf(header, sizeof(header), "%s /%s.json?auth=token HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\nContent-Length: %u\r\n\r\n",
+           method, target.c_str(), HOST, (unsigned)body.size());
+  std::string request = header + body;
+  send(connection, request.data(), request.size(), 0);
+
+  char response[64] = {0};
+  recv(connection, response, sizeof(response) - 1, 0);
+  close(connection);
+  return strncmp(response, "HTTP/1.1 200", 12) == 0;
+}
+
+static std::string windowPath(uint32_t window) {
+  char path[FIREBASE_BATCH_PATH_SIZE];
+  snprintf(path, sizeof(path), "2026/October/17/%02u_%02u_%02u", (unsigned)(window / 3600 % 24),
+           (unsigned)(window / 60 % 60), (unsigned)(window % 60));
+  return path;
+}
+
+static SensorData_t windowAverage(uint32_t window) {
+  SensorData_t average = {20.0f + window % 50 * 0.25f, 1000.0f + window % 30 * 0.5f};
+  return average;
+}
+
+static void assertWindowStored(uint32_t window) {
+  std::string path = windowPath(window);
+  SensorData_t average = windowAverage(window);
+  std::lock_guard<std::mutex> guard(server.mutex);
+  TEST_ASSERT_EQUAL(1, server.values.count(path + "/temperature_c"));
+  TEST_ASSERT_FLOAT_WITHIN(0.005, average.temperature, server.values[path + "/temperature_c"]);
+  TEST_ASSERT_FLOAT_WITHIN(0.005, toFahrenheit(average.temperature), server.values[path + "/temperature_f"]);
+  TEST_ASSERT_FLOAT_WITHIN(0.005, average.pressure, server.values[path + "/pressure_hpa"]);
+}
+
+
+void setUp(void) {
+  std::lock_guard<std::mutex> guard(server.mutex);
+  server.values.clear();
+  server.requests = server.request_bytes = server.bad_requests = 0;
+}
+
+void tearDown(void) {}
+
+
+void test_batch_of_windows_is_one_multi_path_update(void) {
+  FirebaseBatch_t batch;
+  firebaseBatchReset(&batch);
+  for (uint32_t window = 0; window < 3; window++) {
+    SensorData_t average = windowAverage(window);
+    TEST_ASSERT_TRUE(firebaseBatchAdd(&batch, windowPath(window).c_str(), &average, 1000));
+  }
+  TEST_ASSERT_EQUAL_UINT8(3, batch.windows);
+
+  TEST_ASSERT_TRUE(httpRequest("PATCH", "", firebaseBatchFinish(&batch)));
+  TEST_ASSERT_EQUAL_UINT32(1, server.requests);
+  TEST_ASSERT_EQUAL_UINT32(0, server.bad_requests);
+  TEST_ASSERT_EQUAL(9, server.values.size());
+  for (uint32_t window = 0; window < 3; window++) {
+    assertWindowStored(window);
+  }
+}
+
+
+// The longest path of every window fits FIREBASE_BATCH_MAX_WINDOWS times, one more is refused.
+void test_full_batch_holds_the_maximum_number_of_windows(void) {
+  const char* longest = "sensor3/2026/September/30/23_59_59";
+  SensorData_t average = {-40.25f, 1100.75f};
+  FirebaseBatch_t batch;
+  firebaseBatchReset(&batch);
+  for (uint8_t i = 0; i < FIREBASE_BATCH_MAX_WINDOWS; i++) {
+    TEST_ASSERT_TRUE(firebaseBatchAdd(&batch, longest, &average, 0));
+  }
+  TEST_ASSERT_FALSE(firebaseBatchAdd(&batch, longest, &average, 0));
+
+  TEST_ASSERT_TRUE(httpRequest("PATCH", "", firebaseBatchFinish(&batch)));
+  TEST_ASSERT_EQUAL_UINT32(0, server.bad_requests);
+  TEST_ASSERT_EQUAL(3, server.values.size());
+}
+
+
+void test_batch_is_due_when_full_or_after_the_delay(void) {
+  FirebaseBatch_t batch;
+  SensorData_t average = windowAverage(0);
+  firebaseBatchReset(&batch);
+  TEST_ASSERT_FALSE(firebaseBatchDue(&batch, 2, 5000, 100000));
+
+  firebaseBatchAdd(&batch, windowPath(0).c_str(), &average, 1000);
+  TEST_ASSERT_FALSE(firebaseBatchDue(&batch, 2, 5000, 5999));
+  TEST_ASSERT_TRUE(firebaseBatchDue(&batch, 2, 5000, 6000));
+
+  firebaseBatchAdd(&batch, windowPath(1).c_str(), &average, 2000);
+  TEST_ASSERT_TRUE(firebaseBatchDue(&batch, 2, 5000, 2000));
+}
+
+
+void test_block_is_sent_as_one_base64_string(void) {
+  const uint8_t block[] = {0x00, 0x10, 0x83, 0x10, 0x51, 0x87, 0x20, 0x92, 0x8B, 0x30};
+  FirebaseBatch_t batch;
+  firebaseBatchReset(&batch);
+  TEST_ASSERT_TRUE(firebaseBatchAddBlock(&batch, "compressed/1792238400", block, sizeof(block), 7, 0));
+  TEST_ASSERT_EQUAL_UINT8(7, batch.windows);
+  TEST_ASSERT_EQUAL_STRING("{\"compressed/1792238400\":\"ABCDEFGHIJKLMA==\"}", firebaseBatchFinish(&batch));
+
+  // A block can not be added to a batch of windows.
+  SensorData_t average = windowAverage(0);
+  firebaseBatchReset(&batch);
+  firebaseBatchAdd(&batch, windowPath(0).c_str(), &average, 0);
+  TEST_ASSERT_FALSE(firebaseBatchAddBlock(&batch, "compressed/1792238400", block, sizeof(block), 7, 0));
+}
+
+
+// Uploads an hour of 1 minute windows both ways and compares requests and bytes on the wire.
+void test_benchmark_batched_against_one_request_per_value(void) {
+  const uint32_t windows = 60;
+
+  for (uint32_t window = 0; window < windows; window++) {
+    std::string path = windowPath(window * 60);
+    SensorData_t average = windowAverage(window * 60);
+    char value[16];
+    snprintf(value, sizeof(value), "%.2f", average.temperature);
+    TEST_ASSERT_TRUE(httpRequest("PUT", path + "/temperature_c", value));
+    snprintf(value, sizeof(value), "%.2f", toFahrenheit(average.temperature));
+    TEST_ASSERT_TRUE(httpRequest("PUT", path + "/temperature_f", value));
+    snprintf(value, sizeof(value), "%.2f", average.pressure);
+    TEST_ASSERT_TRUE(httpRequest("PUT", path + "/pressure_hpa", value));
+  }
+  uint32_t single_requests = server.requests;
+  uint32_t single_bytes = server.request_bytes;
+  std::map<std::string, double> single_values = server.values;
+  setUp();
+
+  FirebaseBatch_t batch;
+  firebaseBatchReset(&batch);
+  for (uint32_t window = 0; window < windows; window++) {
+    SensorData_t average = windowAverage(window * 60);
+    firebaseBatchAdd(&batch, windowPath(window * 60).c_str(), &average, window * 60000);
+    if (firebaseBatchDue(&batch, FIREBASE_BATCH_MAX_WINDOWS, 600000, window * 60000)) {
+      TEST_ASSERT_TRUE(httpRequest("PATCH", "", firebaseBatchFinish(&batch)));
+      firebaseBatchReset(&batch);
+    }
+  }
+
+  printf("\n%u windows\n", (unsigned)windows);
+  printf("one request per value  %4u requests  %6u bytes\n", (unsigned)single_requests, (unsigned)single_bytes);
+  printf("batched                %4u requests  %6u bytes\n", (unsigned)server.requests, (unsigned)server.request_bytes);
+
+  TEST_ASSERT_EQUAL_UINT32(3 * windows, single_requests);
+  TEST_ASSERT_EQUAL_UINT32(windows / FIREBASE_BATCH_MAX_WINDOWS, server.requests);
+  TEST_ASSERT_EQUAL_UINT32(0, server.bad_requests);
+  TEST_ASSERT_TRUE(server.values == single_values);
+  TEST_ASSERT_LESS_THAN_UINT32(single_bytes / 2, server.request_bytes);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  if (!server.start()) {
+    printf("Could not start the HTTP stand-in on 127.0.0.1\n");
+    return 1;
+  }
+  UNITY_BEGIN();
+  RUN_TEST(test_batch_of_windows_is_one_multi_path_update);
+  RUN_TEST(test_full_batch_holds_the_maximum_number_of_windows);
+  RUN_TEST(test_batch_is_due_when_full_or_after_the_delay);
+  RUN_TEST(test_block_is_sent_as_one_base64_string);
+  RUN_TEST(test_benchmark_batched_against_one_request_per_value);
+  int failures = UNITY_END();
+  server.stop();
+  return failures;
+}
@@ -0,0 +1,273 @@
+// Checks the store and forward queue of firebase_queue on the simulated SD card: order and persistence
+// across reloads (reboots), records that stay queued until their requests are acknowledged, the cleanup
+// of an empty queue, and the migration of a queue left by a firmware that wrote the older 12 byte records.
+
+#include <unity.h>
+#include <SD.h>
+#include "firebase_queue.h"
+
+static FirebaseQueue_t queue;
+
+// Record of the queue before the sensor ID was added.
+typedef struct {
+  uint32_t time;
+  SensorData_t data;
+} LegacyRecord_t;
+
+
+static FirebaseQueueRecord_t record(uint32_t time, uint8_t sensor_id) {
+  FirebaseQueueRecord_t record = {};
+  record.time = time;
+  record.data.temperature = 20.0f;
+  record.data.pressure = 1000.0f + time % 100;
+  record.sensor_id = sensor_id;
+  return record;
+}
+
+// Writes a queue of the older firmware with 'count' records starting at 'first_time', read up to 'head'.
+static void writeLegacyQueue(uint32_t first_time, uint8_t count, uint32_t head) {
+  File data = SD.open(FIREBASE_QUEUE_LEGACY_DATA_PATH, FILE_WRITE);
+  for (uint8_t i = 0; i < count; i++) {
+    LegacyRecord_t legacy = {first_time + i, {19.0f, 990.0f + i}};
+    data.write((const uint8_t*)&legacy, sizeof(legacy));
+  }
+  data.close();
+  File pos = SD.open(FIREBASE_QUEUE_LEGACY_POS_PATH, FILE_WRITE);
+  pos.write((const uint8_t*)&head, sizeof(head));
+  pos.close();
+}
+
+// Pushes 'count' records of sensor 0 starting at 'first_time'.
+static void pushRecords(uint32_t first_time, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    FirebaseQueueRecord_t one = record(first_time + i, 0);
+    TEST_ASSERT_TRUE(firebaseQueuePush(&queue, &one, 1));
+  }
+}
+
+// Sends the next 'count' records in one request and returns its range.
+static uint32_t send(uint8_t count) {
+  FirebaseQueueRecord_t records[16];
+  uint32_t range_id = 0;
+  TEST_ASSERT_EQUAL_UINT8(count, firebaseQueuePeek(&queue, records, count));
+  TEST_ASSERT_TRUE(firebaseQueueSent(&queue, count, 1, &range_id));
+  return range_id;
+}
+
+// "Reboots": forgets the RAM state and loads the queue from the card.
+static bool reload() {
+  queue = FirebaseQueue_t();
+  return firebaseQueueLoad(&queue);
+}
+
+
+void setUp(void) {
+  fakeClockSet(0);
+  SD.format();
+  SD.present = true;
+  SD.space = -1;
+  SD.resetStats();
+  queue = FirebaseQueue_t();
+}
+
+void tearDown(void) {}
+
+
+void test_records_come_out_in_order_across_reboots(void) {
+  TEST_ASSERT_TRUE(reload());
+  FirebaseQueueRecord_t records[5];
+  for (uint8_t i = 0; i < 5; i++) {
+    records[i] = record(1000 + i, i % 2);
+  }
+  TEST_ASSERT_TRUE(firebaseQueuePush(&queue, records, 5));
+  firebaseQueueAcked(&queue, send(2));
+  TEST_ASSERT_TRUE(firebaseQueueRemoveAcked(&queue));
+
+  TEST_ASSERT_TRUE(reload());
+  TEST_ASSERT_EQUAL_UINT32(3, firebaseQueueDepth(&queue));
+  TEST_ASSERT_EQUAL_UINT32(1002, queue.oldest_time);
+  FirebaseQueueRecord_t read[10];
+  TEST_ASSERT_EQUAL_UINT8(3, firebaseQueuePeek(&queue, read, 10));
+  for (uint8_t i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_UINT32(1002 + i, read[i].time);
+    TEST_ASSERT_EQUAL_UINT8((2 + i) % 2, read[i].sensor_id);
+  }
+}
+
+
+void test_empty_queue_deletes_its_files(void) {
+  TEST_ASSERT_TRUE(reload());
+  pushRecords(1000, 1);
+  firebaseQueueAcked(&queue, send(1));
+  TEST_ASSERT_TRUE(firebaseQueueRemoveAcked(&queue));
+  TEST_ASSERT_FALSE(SD.exists(FIREBASE_QUEUE_DATA_PATH));
+  TEST_ASSERT_FALSE(SD.exists(FIREBASE_QUEUE_POS_PATH));
+  TEST_ASSERT_EQUAL_UINT32(0, firebaseQueueDepth(&queue));
+}
+
+
+// Sent records stay queued until their request is acknowledged, and only leave in order:
+// a range acknowledged before an older one waits for it.
+void test_records_are_removed_once_acknowledged_in_order(void) {
+  TEST_ASSERT_TRUE(reload());
+  pushRecords(1000, 10);
+  uint32_t first = send(3);
+  uint32_t second = send(4);
+  TEST_ASSERT_EQUAL_UINT32(10, firebaseQueueDepth(&queue));
+  TEST_ASSERT_EQUAL_UINT32(3, firebaseQueueUnsent(&queue));
+
+  firebaseQueueAcked(&queue, second);
+  TEST_ASSERT_TRUE(firebaseQueueRemoveAcked(&queue));
+  TEST_ASSERT_EQUAL_UINT32(10, firebaseQueueDepth(&queue));
+  TEST_ASSERT_EQUAL_UINT32(1000, queue.oldest_time);
+
+  firebaseQueueAcked(&queue, first);
+  TEST_ASSERT_TRUE(firebaseQueueRemoveAcked(&queue));
+  TEST_ASSERT_EQUAL_UINT32(3, firebaseQueueDepth(&queue));
+  TEST_ASSERT_EQUAL_UINT32(1007, queue.oldest_time);
+  TEST_ASSERT_EQUAL_UINT32(7, queue.drained);
+
+  // An acknowledgement of a range that is gone is ignored.
+  firebaseQueueAcked(&queue, first);
+  TEST_ASSERT_TRUE(firebaseQueueRemoveAcked(&queue));
+  TEST_ASSERT_EQUAL_UINT32(3, firebaseQueueDepth(&queue));
+}
+
+
+// A range split over several requests (compressed blocks) is only removed once all of them are acknowledged.
+void test_range_of_several_requests_waits_for_all(void) {
+  TEST_ASSERT_TRUE(reload());
+  pushRecords(1000, 6);
+  FirebaseQueueRecord_t records[6];
+  uint32_t range_id;
+  TEST_ASSERT_EQUAL_UINT8(6, firebaseQueuePeek(&queue, records, 6));
+  TEST_ASSERT_TRUE(firebaseQueueSent(&queue, 6, 2, &range_id));
+  firebaseQueueAcked(&queue, range_id);
+  firebaseQueueRemoveAcked(&queue);
+  TEST_ASSERT_EQUAL_UINT32(6, firebaseQueueDepth(&queue));
+  firebaseQueueAcked(&queue, range_id);
+  firebaseQueueRemoveAcked(&queue);
+  TEST_ASSERT_EQUAL_UINT32(0, firebaseQueueDepth(&queue));
+}
+
+
+// A failed request takes back its range and every later one, their records are returned again.
+void test_failed_request_sends_its_records_again(void) {
+  TEST_ASSERT_TRUE(reload());
+  pushRecords(1000, 10);
+  uint32_t first = send(3);
+  uint32_t second = send(3);
+  uint32_t third = send(3);
+  firebaseQueueAcked(&queue, first);
+
+  firebaseQueueResend(&queue, second);
+  TEST_ASSERT_EQUAL_UINT32(7, firebaseQueueUnsent(&queue));
+  FirebaseQueueRecord_t read[1];
+  TEST_ASSERT_EQUAL_UINT8(1, firebaseQueuePeek(&queue, read, 1));
+  TEST_ASSERT_EQUAL_UINT32(1003, read[0].time);
+
+  // The late acknowledgement of the third request does not remove its records, which are sent again.
+  firebaseQueueAcked(&queue, third);
+  firebaseQueueRemoveAcked(&queue);
+  TEST_ASSERT_EQUAL_UINT32(7, firebaseQueueDepth(&queue));
+  TEST_ASSERT_EQUAL_UINT32(1003, queue.oldest_time);
+}
+
+
+// Records in flight during a reboot are neither lost nor removed, they are sent again.
+void test_records_in_flight_survive_a_reboot(void) {
+  TEST_ASSERT_TRUE(reload());
+  pushRecords(1000, 8);
+  firebaseQueueAcked(&queue, send(2));
+  firebaseQueueRemoveAcked(&queue);
+  send(4);
+
+  TEST_ASSERT_TRUE(reload());
+  TEST_ASSERT_EQUAL_UINT32(6, firebaseQueueDepth(&queue));
+  TEST_ASSERT_EQUAL_UINT32(6, firebaseQueueUnsent(&queue));
+  FirebaseQueueRecord_t read[1];
+  TEST_ASSERT_EQUAL_UINT8(1, firebaseQueuePeek(&queue, read, 1));
+  TEST_ASSERT_EQUAL_UINT32(1002, read[0].time);
+}
+
+
+// No more ranges than FIREBASE_QUEUE_MAX_RANGES are in flight.
+void test_ranges_in_flight_are_limited(void) {
+  TEST_ASSERT_TRUE(reload());
+  pushRecords(1000, FIREBASE_QUEUE_MAX_RANGES + 1);
+  for (uint8_t i = 0; i < FIREBASE_QUEUE_MAX_RANGES; i++) {
+    send(1);
+  }
+  uint32_t range_id;
+  TEST_ASSERT_FALSE(firebaseQueueSent(&queue, 1, 1, &range_id));
+  TEST_ASSERT_EQUAL_UINT32(1, firebaseQueueUnsent(&queue));
+}
+
+
+// The records of the old queue that were not uploaded yet follow the records of the new queue,
+// as windows of the first sensor, and the old files are gone.
+void test_older_queue_is_migrated_on_load(void) {
+  TEST_ASSERT_TRUE(reload());
+  FirebaseQueueRecord_t current = record(500, 1);
+  TEST_ASSERT_TRUE(firebaseQueuePush(&queue, &current, 1));
+  writeLegacyQueue(1000, 5, 2 * sizeof(LegacyRecord_t));
+
+  TEST_ASSERT_TRUE(reload());
+  TEST_ASSERT_EQUAL_UINT32(3, queue.migrated);
+  TEST_ASSERT_EQUAL_UINT32(4, firebaseQueueDepth(&queue));
+  TEST_ASSERT_FALSE(SD.exists(FIREBASE_QUEUE_LEGACY_DATA_PATH));
+  TEST_ASSERT_FALSE(SD.exists(FIREBASE_QUEUE_LEGACY_POS_PATH));
+
+  FirebaseQueueRecord_t read[4];
+  TEST_ASSERT_EQUAL_UINT8(4, firebaseQueuePeek(&queue, read, 4));
+  TEST_ASSERT_EQUAL_UINT32(500, read[0].time);
+  TEST_ASSERT_EQUAL_UINT8(1, read[0].sensor_id);
+  for (uint8_t i = 1; i < 4; i++) {
+    TEST_ASSERT_EQUAL_UINT32(1001 + i, read[i].time);
+    TEST_ASSERT_EQUAL_UINT8(0, read[i].sensor_id);
+    TEST_ASSERT_EQUAL_FLOAT(991.0f + i, read[i].data.pressure);
+    TEST_ASSERT_EQUAL_UINT8(0, read[i].reserved[0]);
+  }
+
+  // Nothing is migrated twice.
+  TEST_ASSERT_TRUE(reload());
+  TEST_ASSERT_EQUAL_UINT32(0, queue.migrated);
+  TEST_ASSERT_EQUAL_UINT32(4, firebaseQueueDepth(&queue));
+}
+
+
+// A card that fills up during the migration fails the load. The next load picks up where it stopped,
+// without losing or repeating records.
+void test_interrupted_migration_resumes(void) {
+  writeLegacyQueue(1000, 40, 0);
+  SD.space = 32 * sizeof(FirebaseQueueRecord_t) + sizeof(uint32_t);
+  TEST_ASSERT_FALSE(reload());
+  TEST_ASSERT_TRUE(SD.exists(FIREBASE_QUEUE_LEGACY_DATA_PATH));
+
+  SD.space = -1;
+  TEST_ASSERT_TRUE(reload());
+  TEST_ASSERT_EQUAL_UINT32(8, queue.migrated);
+  TEST_ASSERT_EQUAL_UINT32(40, firebaseQueueDepth(&queue));
+  FirebaseQueueRecord_t read[40];
+  TEST_ASSERT_EQUAL_UINT8(40, firebaseQueuePeek(&queue, read, 40));
+  for (uint8_t i = 0; i < 40; i++) {
+    TEST_ASSERT_EQUAL_UINT32(1000 + i, read[i].time);
+  }
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_records_come_out_in_order_across_reboots);
+  RUN_TEST(test_empty_queue_deletes_its_files);
+  RUN_TEST(test_records_are_removed_once_acknowledged_in_order);
+  RUN_TEST(test_range_of_several_requests_waits_for_all);
+  RUN_TEST(test_failed_request_sends_its_records_again);
+  RUN_TEST(test_records_in_flight_survive_a_reboot);
+  RUN_TEST(test_ranges_in_flight_are_limited);
+  RUN_TEST(test_older_queue_is_migrated_on_load);
+  RUN_TEST(test_interrupted_migration_resumes);
+  return UNITY_END();
+}
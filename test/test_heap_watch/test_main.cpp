@@ -0,0 +1,86 @@
+// Checks the baseline and growth detection of heap_watch, with the tolerance of the STATIC_ALLOCATION
+// build (none) and of the heap allocated build (4 KB), as checkHeap in main.cpp uses them.
+
+#include <unity.h>
+#include "heap_watch.h"
+
+static const uint32_t FREE = 150000;
+static const uint32_t MIN_FREE = 140000;
+static const uint32_t LARGEST_BLOCK = 110000;
+
+static HeapWatch_t watch;
+
+
+void setUp(void) {
+  heapWatchInit(&watch, 0);
+}
+
+void tearDown(void) {}
+
+
+// Before the baseline the samples are only recorded, whatever the startup allocates.
+void test_samples_before_the_baseline_are_not_growth(void) {
+  TEST_ASSERT_FALSE(heapWatchSample(&watch, FREE, 20000, 5000));
+  TEST_ASSERT_EQUAL_UINT32(20000, watch.min_free);
+  TEST_ASSERT_EQUAL_UINT32(0, watch.samples);
+  TEST_ASSERT_EQUAL_UINT32(0, heapWatchGrowth(&watch));
+}
+
+
+// A flat footprint stays silent, while the free heap itself may go up and down above the low water mark.
+void test_flat_footprint_is_not_growth(void) {
+  heapWatchStart(&watch, FREE, MIN_FREE, LARGEST_BLOCK);
+  for (uint32_t i = 0; i < 100; i++) {
+    TEST_ASSERT_FALSE(heapWatchSample(&watch, FREE - (i % 10) * 100, MIN_FREE, LARGEST_BLOCK));
+  }
+  TEST_ASSERT_EQUAL_UINT32(100, watch.samples);
+  TEST_ASSERT_EQUAL_UINT32(0, watch.growth_events);
+  TEST_ASSERT_EQUAL_UINT32(0, heapWatchGrowth(&watch));
+}
+
+
+// Without tolerance every new low of the low water mark is growth, and it is reported once per new low.
+void test_every_new_low_is_growth_without_tolerance(void) {
+  heapWatchStart(&watch, FREE, MIN_FREE, LARGEST_BLOCK);
+  TEST_ASSERT_TRUE(heapWatchSample(&watch, FREE - 16, MIN_FREE - 16, LARGEST_BLOCK));
+  TEST_ASSERT_FALSE(heapWatchSample(&watch, FREE, MIN_FREE - 16, LARGEST_BLOCK));
+  TEST_ASSERT_TRUE(heapWatchSample(&watch, FREE, MIN_FREE - 32, LARGEST_BLOCK));
+  TEST_ASSERT_EQUAL_UINT32(2, watch.growth_events);
+  TEST_ASSERT_EQUAL_UINT32(32, heapWatchGrowth(&watch));
+}
+
+
+// With a tolerance only lows beyond it count.
+void test_growth_within_the_tolerance_is_accepted(void) {
+  heapWatchInit(&watch, 4096);
+  heapWatchStart(&watch, FREE, MIN_FREE, LARGEST_BLOCK);
+  TEST_ASSERT_FALSE(heapWatchSample(&watch, FREE, MIN_FREE - 4096, LARGEST_BLOCK));
+  TEST_ASSERT_EQUAL_UINT32(4096, heapWatchGrowth(&watch));
+  TEST_ASSERT_TRUE(heapWatchSample(&watch, FREE, MIN_FREE - 4097, LARGEST_BLOCK));
+  TEST_ASSERT_FALSE(heapWatchSample(&watch, FREE, MIN_FREE - 4097, LARGEST_BLOCK));
+  TEST_ASSERT_EQUAL_UINT32(1, watch.growth_events);
+}
+
+
+// The smallest largest free block since the baseline shows fragmentation even without growth.
+void test_fragmentation_is_tracked(void) {
+  heapWatchStart(&watch, FREE, MIN_FREE, LARGEST_BLOCK);
+  heapWatchSample(&watch, FREE, MIN_FREE, 60000);
+  heapWatchSample(&watch, FREE, MIN_FREE, 90000);
+  TEST_ASSERT_EQUAL_UINT32(60000, watch.min_largest_block);
+  TEST_ASSERT_EQUAL_UINT32(90000, watch.largest_block);
+  TEST_ASSERT_EQUAL_UINT32(0, watch.growth_events);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_samples_before_the_baseline_are_not_growth);
+  RUN_TEST(test_flat_footprint_is_not_growth);
+  RUN_TEST(test_every_new_low_is_growth_without_tolerance);
+  RUN_TEST(test_growth_within_the_tolerance_is_accepted);
+  RUN_TEST(test_fragmentation_is_tracked);
+  return UNITY_END();
+}
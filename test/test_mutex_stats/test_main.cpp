@@ -0,0 +1,183 @@
+// Checks the mutex bookkeeping of mutex_stats and its histograms. The concurrent test wraps a
+// std::timed_mutex the way instrumented_mutex.cpp wraps the FreeRTOS mutex, and checks that under
+// contention every acquisition is matched by exactly one release and every timeout names the holder.
+
+#include <unity.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mutex_stats.h"
+
+static MutexStats_t stats;
+
+
+void setUp(void) {
+  mutexStatsInit(&stats, "i2c_mutex");
+}
+
+void tearDown(void) {}
+
+
+void test_histogram_buckets_and_percentiles(void) {
+  Histogram_t histogram;
+  histogramReset(&histogram);
+  TEST_ASSERT_EQUAL_UINT32(0, histogramPercentile(&histogram, 99.0f));
+  TEST_ASSERT_EQUAL_UINT32(0, histogramMean(&histogram));
+
+  // 90 values of 10 us (bucket 3) and 10 of 1000 us (bucket 9).
+  for (uint8_t i = 0; i < 90; i++) {
+    histogramAdd(&histogram, 10);
+  }
+  for (uint8_t i = 0; i < 10; i++) {
+    histogramAdd(&histogram, 1000);
+  }
+  TEST_ASSERT_EQUAL_UINT32(90, histogram.buckets[3]);
+  TEST_ASSERT_EQUAL_UINT32(10, histogram.buckets[9]);
+  TEST_ASSERT_EQUAL_UINT32(10, histogram.min);
+  TEST_ASSERT_EQUAL_UINT32(1000, histogram.max);
+  TEST_ASSERT_EQUAL_UINT32(109, histogramMean(&histogram));
+  TEST_ASSERT_EQUAL_UINT32(15, histogramPercentile(&histogram, 50.0f));
+  TEST_ASSERT_EQUAL_UINT32(15, histogramPercentile(&histogram, 90.0f));
+  TEST_ASSERT_EQUAL_UINT32(1000, histogramPercentile(&histogram, 99.0f));
+}
+
+
+void test_histogram_counts_large_values_in_the_last_bucket(void) {
+  Histogram_t histogram;
+  histogramReset(&histogram);
+  histogramAdd(&histogram, 0);
+  histogramAdd(&histogram, 0xFFFFFFFF);
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[HISTOGRAM_BUCKETS - 1]);
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, histogramPercentile(&histogram, 100.0f));
+}
+
+
+void test_acquire_and_release_record_wait_hold_and_holder(void) {
+  mutexStatsAcquired(&stats, "Read Sensor", 40, 1000);
+  TEST_ASSERT_EQUAL_STRING("Read Sensor", stats.holder.load());
+  TEST_ASSERT_TRUE(mutexStatsReleased(&stats, 1850));
+  TEST_ASSERT_NULL(stats.holder.load());
+
+  TEST_ASSERT_EQUAL_UINT32(1, stats.wait_us.count);
+  TEST_ASSERT_EQUAL_UINT32(40, stats.wait_us.max);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.hold_us.count);
+  TEST_ASSERT_EQUAL_UINT32(850, stats.hold_us.max);
+}
+
+
+void test_unmatched_release_is_counted(void) {
+  TEST_ASSERT_FALSE(mutexStatsReleased(&stats, 100));
+  mutexStatsAcquired(&stats, "Display Data", 0, 200);
+  TEST_ASSERT_TRUE(mutexStatsReleased(&stats, 300));
+  TEST_ASSERT_FALSE(mutexStatsReleased(&stats, 400));
+  TEST_ASSERT_EQUAL_UINT32(2, stats.release_errors);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.hold_us.count);
+}
+
+
+void test_timeout_names_the_holder(void) {
+  mutexStatsTimedOut(&stats);
+  TEST_ASSERT_NULL(stats.timeout_holder.load());
+  mutexStatsAcquired(&stats, "System Monitor", 0, 0);
+  mutexStatsTimedOut(&stats);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.timeouts.load());
+  TEST_ASSERT_EQUAL_STRING("System Monitor", stats.timeout_holder.load());
+}
+
+
+void test_leak_is_reported_after_the_maximum_hold_time(void) {
+  TEST_ASSERT_FALSE(mutexStatsLeaked(&stats, 1000000, 500000));
+  mutexStatsAcquired(&stats, "SD Card Logger", 0, 0xFFFFFF00);
+  // The microsecond clock wraps around while the mutex is held.
+  TEST_ASSERT_FALSE(mutexStatsLeaked(&stats, 0xFFFFFF00 + 500000, 500000));
+  TEST_ASSERT_TRUE(mutexStatsLeaked(&stats, 0xFFFFFF00 + 500001, 500000));
+  mutexStatsReleased(&stats, 0);
+  TEST_ASSERT_FALSE(mutexStatsLeaked(&stats, 0xFFFFFF00 + 500001, 500000));
+}
+
+
+static uint32_t hostMicros() {
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// mutexTake / mutexGive of instrumented_mutex.cpp on a host mutex.
+static bool take(std::timed_mutex* mutex, const char* task, uint32_t timeout_ms) {
+  uint32_t request_us = hostMicros();
+  if (!mutex->try_lock_for(std::chrono::milliseconds(timeout_ms))) {
+    mutexStatsTimedOut(&stats);
+    return false;
+  }
+  uint32_t now_us = hostMicros();
+  mutexStatsAcquired(&stats, task, now_us - request_us, now_us);
+  return true;
+}
+
+static void give(std::timed_mutex* mutex) {
+  mutexStatsReleased(&stats, hostMicros());
+  mutex->unlock();
+}
+
+
+// Four tasks share a bus mutex with short holds while one task sometimes holds it past their timeout.
+void test_contended_mutex_keeps_consistent_statistics(void) {
+  static const char* TASKS[] = {"Read Sensor", "Display Data", "SD Card Logger", "Read Serial"};
+  const uint32_t iterations = 300;
+  std::timed_mutex mutex;
+  std::atomic<uint32_t> acquisitions(0), timeouts(0);
+
+  std::vector<std::thread> threads;
+  for (uint8_t t = 0; t < 4; t++) {
+    threads.emplace_back([&, t]() {
+      for (uint32_t i = 0; i < iterations; i++) {
+        if (!take(&mutex, TASKS[t], 5)) {
+          timeouts++;
+          continue;
+        }
+        acquisitions++;
+        // A slow holder every now and then, the others hold for a bus transaction.
+        std::this_thread::sleep_for(std::chrono::microseconds(t == 0 && i % 50 == 0 ? 8000 : 50));
+        give(&mutex);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  printf("\n%u acquisitions, %u timeouts, wait p50 %u us p99 %u us max %u us, hold p50 %u us p99 %u us max %u us\n",
+         (unsigned)acquisitions.load(), (unsigned)timeouts.load(), (unsigned)histogramPercentile(&stats.wait_us, 50.0f),
+         (unsigned)histogramPercentile(&stats.wait_us, 99.0f), (unsigned)stats.wait_us.max,
+         (unsigned)histogramPercentile(&stats.hold_us, 50.0f), (unsigned)histogramPercentile(&stats.hold_us, 99.0f),
+         (unsigned)stats.hold_us.max);
+
+  TEST_ASSERT_EQUAL_UINT32(4 * iterations, acquisitions.load() + timeouts.load());
+  TEST_ASSERT_EQUAL_UINT32(acquisitions.load(), stats.wait_us.count);
+  TEST_ASSERT_EQUAL_UINT32(acquisitions.load(), stats.hold_us.count);
+  TEST_ASSERT_EQUAL_UINT32(timeouts.load(), stats.timeouts.load());
+  TEST_ASSERT_EQUAL_UINT32(0, stats.release_errors);
+  TEST_ASSERT_NULL(stats.holder.load());
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(8000, stats.hold_us.max);
+  if (timeouts.load() > 0) {
+    TEST_ASSERT_NOT_NULL(stats.timeout_holder.load());
+  }
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_histogram_buckets_and_percentiles);
+  RUN_TEST(test_histogram_counts_large_values_in_the_last_bucket);
+  RUN_TEST(test_acquire_and_release_record_wait_hold_and_holder);
+  RUN_TEST(test_unmatched_release_is_counted);
+  RUN_TEST(test_timeout_names_the_holder);
+  RUN_TEST(test_leak_is_reported_after_the_maximum_hold_time);
+  RUN_TEST(test_contended_mutex_keeps_consistent_statistics);
+  return UNITY_END();
+}
@@ -0,0 +1,191 @@
+// Checks the simulated devices of the native environment that the other tests measure with:
+// bus bytes, errors and transfer times of the fake I2C bus and the costs counted by the fake SD card.
+
+#include <unity.h>
+#include <Wire.h>
+#include <SD.h>
+#include "fake_bmp280.h"
+#include "fake_ssd1306.h"
+
+static TwoWire bus(2);
+static FakeBmp280 sensor;
+static FakeSsd1306 screen;
+
+
+void setUp(void) {
+  fakeClockSet(0);
+  sensor = FakeBmp280();
+  screen = FakeSsd1306();
+  bus.detach(0x76);
+  bus.detach(0x3C);
+  bus.attach(0x76, &sensor);
+  bus.attach(0x3C, &screen);
+  bus.setClock(100000);
+  bus.resetStats();
+  SD.format();
+  SD.present = true;
+  SD.space = -1;
+  SD.resetStats();
+}
+
+void tearDown(void) {}
+
+
+// A register read is a write of the register address and a read of the data,
+// each taking 9 clocks per byte plus the address byte and start/stop.
+void test_register_read_counts_bytes_and_bus_time(void) {
+  bus.beginTransmission(0x76);
+  bus.write(0xD0);
+  TEST_ASSERT_EQUAL(0, bus.endTransmission(false));
+  TEST_ASSERT_EQUAL(1, bus.requestFrom(0x76, (size_t)1));
+  TEST_ASSERT_EQUAL_HEX8(0x58, bus.read());
+
+  TEST_ASSERT_EQUAL_UINT32(2, bus.stats.transactions);
+  TEST_ASSERT_EQUAL_UINT32(1, bus.stats.bytes_written);
+  TEST_ASSERT_EQUAL_UINT32(1, bus.stats.bytes_read);
+  TEST_ASSERT_EQUAL_UINT32(0, bus.stats.errors);
+  TEST_ASSERT_EQUAL_UINT64(2 * 200, bus.stats.busy_us);
+  TEST_ASSERT_EQUAL_UINT64(bus.stats.busy_us, fakeClockMicros());
+}
+
+
+// An address probe is 11 clocks, 27.5 us at 400 kHz rounded up.
+void test_bus_time_scales_with_the_clock(void) {
+  bus.setClock(400000);
+  bus.beginTransmission(0x3C);
+  TEST_ASSERT_EQUAL(0, bus.endTransmission());
+  TEST_ASSERT_EQUAL_UINT64(28, bus.stats.busy_us);
+}
+
+
+void test_missing_or_disconnected_device_is_nacked(void) {
+  bus.beginTransmission(0x77);
+  TEST_ASSERT_EQUAL(2, bus.endTransmission());
+  TEST_ASSERT_EQUAL(0, bus.requestFrom(0x77, (size_t)6));
+
+  sensor.connected = false;
+  bus.beginTransmission(0x76);
+  bus.write(0xD0);
+  TEST_ASSERT_NOT_EQUAL(0, bus.endTransmission());
+  TEST_ASSERT_EQUAL_UINT32(3, bus.stats.errors);
+}
+
+
+void test_writes_beyond_the_buffer_are_cut_off(void) {
+  uint8_t data[FAKE_I2C_BUFFER_LENGTH + 8] = {0x40};
+  bus.beginTransmission(0x3C);
+  TEST_ASSERT_EQUAL(FAKE_I2C_BUFFER_LENGTH, bus.write(data, sizeof(data)));
+  TEST_ASSERT_EQUAL(0, bus.endTransmission());
+  TEST_ASSERT_EQUAL_UINT32(FAKE_I2C_BUFFER_LENGTH, bus.stats.bytes_written);
+}
+
+
+void test_bmp280_counts_forced_measurements_and_returns_to_sleep(void) {
+  const uint8_t forced[] = {0xF4, 0x25};
+  bus.beginTransmission(0x76);
+  bus.write(forced, sizeof(forced));
+  TEST_ASSERT_EQUAL(0, bus.endTransmission());
+  TEST_ASSERT_EQUAL_UINT32(1, sensor.forced_measurements);
+  TEST_ASSERT_EQUAL_HEX8(0x24, sensor.registers[0xF4]);
+}
+
+
+void test_ssd1306_writes_data_into_the_addressed_window(void) {
+  const uint8_t window[] = {0x00, 0x22, 2, 3, 0x21, 10, 11};
+  const uint8_t data[] = {0x40, 1, 2, 3, 4};
+  bus.beginTransmission(0x3C);
+  bus.write(window, sizeof(window));
+  bus.endTransmission();
+  bus.beginTransmission(0x3C);
+  bus.write(data, sizeof(data));
+  bus.endTransmission();
+
+  TEST_ASSERT_EQUAL_UINT8(1, screen.ram[2][10]);
+  TEST_ASSERT_EQUAL_UINT8(2, screen.ram[2][11]);
+  TEST_ASSERT_EQUAL_UINT8(3, screen.ram[3][10]);
+  TEST_ASSERT_EQUAL_UINT8(4, screen.ram[3][11]);
+  TEST_ASSERT_EQUAL_UINT32(sizeof(window), screen.command_bytes);
+  TEST_ASSERT_EQUAL_UINT32(sizeof(data), screen.data_bytes);
+}
+
+
+void test_sd_files_need_their_folder_and_keep_their_contents(void) {
+  TEST_ASSERT_FALSE(SD.open("/day/log.csv", FILE_APPEND));
+  TEST_ASSERT_TRUE(SD.mkdir("/day"));
+
+  File file = SD.open("/day/log.csv", FILE_APPEND);
+  TEST_ASSERT_TRUE(file);
+  TEST_ASSERT_EQUAL(5, file.print("hello"));
+  file.close();
+  file = SD.open("/day/log.csv", FILE_APPEND);
+  file.print(" card");
+  file.close();
+
+  char text[16] = {0};
+  file = SD.open("/day/log.csv");
+  TEST_ASSERT_EQUAL(10, file.read((uint8_t*)text, sizeof(text)));
+  file.close();
+  TEST_ASSERT_EQUAL_STRING("hello card", text);
+}
+
+
+// Appending to a partly written sector costs a read of that sector, a sector aligned write does not.
+void test_sd_counts_sector_accesses_and_time(void) {
+  SD.mkdir("/day");
+  File file = SD.open("/day/log.bin", FILE_APPEND);
+  uint8_t sector[FAKE_SD_SECTOR_SIZE] = {0};
+  SD.resetStats();
+  uint64_t start_us = fakeClockMicros();
+
+  file.write(sector, 100);
+  TEST_ASSERT_EQUAL_UINT32(1, SD.stats.sector_writes);
+  TEST_ASSERT_EQUAL_UINT32(0, SD.stats.sector_reads);
+  file.write(sector, FAKE_SD_SECTOR_SIZE - 100);
+  TEST_ASSERT_EQUAL_UINT32(2, SD.stats.sector_writes);
+  TEST_ASSERT_EQUAL_UINT32(1, SD.stats.sector_reads);
+  file.write(sector, FAKE_SD_SECTOR_SIZE);
+  TEST_ASSERT_EQUAL_UINT32(3, SD.stats.sector_writes);
+  TEST_ASSERT_EQUAL_UINT32(1, SD.stats.sector_reads);
+  file.close();
+
+  TEST_ASSERT_EQUAL_UINT32(4, SD.stats.sector_writes);
+  TEST_ASSERT_EQUAL_UINT32(2 * FAKE_SD_SECTOR_SIZE, SD.stats.bytes_written);
+  TEST_ASSERT_EQUAL_UINT64(4 * SD.sector_write_us + SD.sector_read_us, SD.stats.busy_us);
+  TEST_ASSERT_EQUAL_UINT64(SD.stats.busy_us, fakeClockMicros() - start_us);
+}
+
+
+void test_sd_full_card_takes_part_of_a_write(void) {
+  SD.space = 3;
+  File file = SD.open("/log.csv", FILE_WRITE);
+  TEST_ASSERT_EQUAL(3, file.print("hello"));
+  TEST_ASSERT_EQUAL(0, file.print("!"));
+  TEST_ASSERT_EQUAL_UINT32(2, SD.stats.errors);
+}
+
+
+void test_sd_removed_card_fails_every_access(void) {
+  SD.present = false;
+  TEST_ASSERT_FALSE(SD.begin());
+  TEST_ASSERT_FALSE(SD.exists("/"));
+  TEST_ASSERT_FALSE(SD.open("/log.csv", FILE_WRITE));
+  TEST_ASSERT_EQUAL_UINT32(0, SD.stats.lookups);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_register_read_counts_bytes_and_bus_time);
+  RUN_TEST(test_bus_time_scales_with_the_clock);
+  RUN_TEST(test_missing_or_disconnected_device_is_nacked);
+  RUN_TEST(test_writes_beyond_the_buffer_are_cut_off);
+  RUN_TEST(test_bmp280_counts_forced_measurements_and_returns_to_sleep);
+  RUN_TEST(test_ssd1306_writes_data_into_the_addressed_window);
+  RUN_TEST(test_sd_files_need_their_folder_and_keep_their_contents);
+  RUN_TEST(test_sd_counts_sector_accesses_and_time);
+  RUN_TEST(test_sd_full_card_takes_part_of_a_write);
+  RUN_TEST(test_sd_removed_card_fails_every_access);
+  return UNITY_END();
+}
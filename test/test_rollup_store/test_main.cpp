@@ -0,0 +1,123 @@
+// Checks the rollup_store: the cascade of the 1 second points into 1 minute and 1 hour points with
+// their means, minimums and maximums, the order of rollupStoreGet once a ring has wrapped, and gaps.
+
+#include <unity.h>
+#include "rollup_store.h"
+
+static RollupStore_t store;
+
+
+// Sample at 't' seconds: the pressure follows the second of the minute, the temperature the minute of the hour.
+static SensorData_t sample(uint32_t t) {
+  SensorData_t data = {20.0f + (t / 60 % 60) * 0.1f, 1000.0f + t % 60};
+  return data;
+}
+
+// Adds one sample per second for 'seconds' seconds starting at 'start_s'.
+static void addSamples(uint32_t start_s, uint32_t seconds) {
+  for (uint32_t t = start_s; t < start_s + seconds; t++) {
+    SensorData_t data = sample(t);
+    rollupStoreAdd(&store, t, &data);
+  }
+}
+
+
+void setUp(void) {
+  rollupStoreInit(&store);
+}
+
+void tearDown(void) {}
+
+
+void test_empty_store(void) {
+  RollupPoint_t point;
+  for (uint8_t level = 0; level < ROLLUP_LEVELS; level++) {
+    TEST_ASSERT_EQUAL_UINT16(0, rollupStoreCount(&store, (RollupLevel_t)level));
+    TEST_ASSERT_FALSE(rollupStoreGet(&store, (RollupLevel_t)level, 0, &point));
+  }
+}
+
+
+// A point closes when the first sample of the next interval arrives, so a coarser point closes
+// with the first closed point of its next interval.
+void test_point_closes_with_the_next_interval(void) {
+  addSamples(0, 1);
+  TEST_ASSERT_EQUAL_UINT16(0, rollupStoreCount(&store, ROLLUP_SECONDS));
+  addSamples(1, 1);
+  TEST_ASSERT_EQUAL_UINT16(1, rollupStoreCount(&store, ROLLUP_SECONDS));
+  RollupPoint_t point;
+  TEST_ASSERT_TRUE(rollupStoreGet(&store, ROLLUP_SECONDS, 0, &point));
+  TEST_ASSERT_EQUAL_UINT32(0, point.start_s);
+  TEST_ASSERT_EQUAL_UINT32(1, point.count);
+  TEST_ASSERT_EQUAL_FLOAT(1000.0f, point.pressure_mean);
+}
+
+
+// Three hours of samples build 1 minute points of 60 samples and 1 hour points of 3600 samples.
+void test_cascade_into_minutes_and_hours(void) {
+  addSamples(0, 3 * 3600 + 62);
+  TEST_ASSERT_EQUAL_UINT16(ROLLUP_MINUTES_SIZE, rollupStoreCount(&store, ROLLUP_MINUTES));
+  TEST_ASSERT_EQUAL_UINT16(3, rollupStoreCount(&store, ROLLUP_HOURS));
+
+  RollupPoint_t minute;
+  TEST_ASSERT_TRUE(rollupStoreGet(&store, ROLLUP_MINUTES, 1, &minute));
+  TEST_ASSERT_EQUAL_UINT32(3 * 3600 - 60, minute.start_s);
+  TEST_ASSERT_EQUAL_UINT32(60, minute.count);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 1029.5, minute.pressure_mean);
+  TEST_ASSERT_EQUAL_FLOAT(1000.0f, minute.pressure_min);
+  TEST_ASSERT_EQUAL_FLOAT(1059.0f, minute.pressure_max);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 25.9, minute.temperature_mean);
+
+  for (uint16_t age = 0; age < 3; age++) {
+    RollupPoint_t hour;
+    TEST_ASSERT_TRUE(rollupStoreGet(&store, ROLLUP_HOURS, age, &hour));
+    TEST_ASSERT_EQUAL_UINT32((2 - age) * 3600, hour.start_s);
+    TEST_ASSERT_EQUAL_UINT32(3600, hour.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 1029.5, hour.pressure_mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 22.95, hour.temperature_mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 20.0, hour.temperature_min);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 25.9, hour.temperature_max);
+  }
+}
+
+
+// A full ring drops its oldest points, and the ages keep counting back from the newest one.
+void test_ring_wraps_around(void) {
+  addSamples(0, 5 * ROLLUP_SECONDS_SIZE + 17);
+  TEST_ASSERT_EQUAL_UINT16(ROLLUP_SECONDS_SIZE, rollupStoreCount(&store, ROLLUP_SECONDS));
+
+  uint32_t newest = 5 * ROLLUP_SECONDS_SIZE + 15;
+  RollupPoint_t point;
+  for (uint16_t age = 0; age < ROLLUP_SECONDS_SIZE; age++) {
+    TEST_ASSERT_TRUE(rollupStoreGet(&store, ROLLUP_SECONDS, age, &point));
+    TEST_ASSERT_EQUAL_UINT32(newest - age, point.start_s);
+    TEST_ASSERT_EQUAL_FLOAT(sample(newest - age).pressure, point.pressure_mean);
+  }
+  TEST_ASSERT_FALSE(rollupStoreGet(&store, ROLLUP_SECONDS, ROLLUP_SECONDS_SIZE, &point));
+}
+
+
+// Intervals without samples (e.g. the sensor was missing) leave no points, the ages skip them.
+void test_gaps_leave_no_points(void) {
+  addSamples(0, 120);
+  addSamples(600, 62);
+  TEST_ASSERT_EQUAL_UINT16(3, rollupStoreCount(&store, ROLLUP_MINUTES));
+  RollupPoint_t minute;
+  TEST_ASSERT_TRUE(rollupStoreGet(&store, ROLLUP_MINUTES, 0, &minute));
+  TEST_ASSERT_EQUAL_UINT32(600, minute.start_s);
+  TEST_ASSERT_TRUE(rollupStoreGet(&store, ROLLUP_MINUTES, 1, &minute));
+  TEST_ASSERT_EQUAL_UINT32(60, minute.start_s);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_store);
+  RUN_TEST(test_point_closes_with_the_next_interval);
+  RUN_TEST(test_cascade_into_minutes_and_hours);
+  RUN_TEST(test_ring_wraps_around);
+  RUN_TEST(test_gaps_leave_no_points);
+  return UNITY_END();
+}
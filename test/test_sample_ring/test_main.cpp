@@ -0,0 +1,197 @@
+// Checks the sample_ring: consumers that read at their own pace, a consumer that falls behind and
+// counts the samples it lost as overruns, the write index wrapping around 2^32, and one producer
+// with two consumer threads, one of them regularly stalled, never losing count of a sample.
+
+#include <unity.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "sample_ring.h"
+
+static SampleRing_t ring;
+
+
+// A sample whose fields can all be derived from its sequence, so a torn copy shows up.
+static Sample_t makeSample(uint32_t sequence) {
+  Sample_t sample;
+  memset(&sample, 0, sizeof(sample));
+  sample.sequence = sequence;
+  sample.timestamp_ms = sequence * 7;
+  sample.sensor_id = sequence % 4;
+  sample.data.temperature = (float)(sequence % 1000);
+  sample.data.pressure = (float)(sequence % 1000) * 2;
+  return sample;
+}
+
+static bool consistent(const Sample_t* sample) {
+  Sample_t expected = makeSample(sample->sequence);
+  return memcmp(&expected, sample, sizeof(Sample_t)) == 0;
+}
+
+// Pushes 'count' samples, pausing for 'pause_us' after every 16 of them.
+static void push(uint32_t first, uint32_t count, uint32_t pause_us = 0) {
+  for (uint32_t sequence = first; sequence < first + count; sequence++) {
+    Sample_t sample = makeSample(sequence);
+    sampleRingPush(&ring, &sample);
+    if (pause_us > 0 && sequence % 16 == 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(pause_us));
+    }
+  }
+}
+
+
+void setUp(void) {
+  ring.write_index.store(0);
+}
+
+void tearDown(void) {}
+
+
+// Two consumers read the same stream independently, each sample exactly once.
+void test_consumers_read_independently(void) {
+  SampleRingCursor_t fast, slow;
+  sampleRingAttach(&ring, &fast);
+  sampleRingAttach(&ring, &slow);
+  Sample_t sample = {};
+  TEST_ASSERT_FALSE(sampleRingPop(&ring, &fast, &sample));
+
+  push(1, 10);
+  for (uint32_t sequence = 1; sequence <= 10; sequence++) {
+    TEST_ASSERT_TRUE(sampleRingPop(&ring, &fast, &sample));
+    TEST_ASSERT_EQUAL_UINT32(sequence, sample.sequence);
+  }
+  TEST_ASSERT_FALSE(sampleRingPop(&ring, &fast, &sample));
+  TEST_ASSERT_EQUAL_UINT32(10, sampleRingPending(&ring, &slow));
+  TEST_ASSERT_TRUE(sampleRingPop(&ring, &slow, &sample));
+  TEST_ASSERT_EQUAL_UINT32(1, sample.sequence);
+  TEST_ASSERT_EQUAL_UINT32(0, fast.overruns + slow.overruns);
+}
+
+
+// A consumer attached late only sees the samples pushed after it attached.
+void test_attach_starts_at_the_next_sample(void) {
+  push(1, 5);
+  SampleRingCursor_t cursor;
+  sampleRingAttach(&ring, &cursor);
+  push(6, 1);
+  Sample_t sample = {};
+  TEST_ASSERT_TRUE(sampleRingPop(&ring, &cursor, &sample));
+  TEST_ASSERT_EQUAL_UINT32(6, sample.sequence);
+}
+
+
+// A consumer that falls behind loses the overwritten samples, counts them, and resumes with the oldest
+// sample still in the ring (the slot the producer writes next is left alone).
+void test_overrun_is_counted(void) {
+  SampleRingCursor_t cursor;
+  sampleRingAttach(&ring, &cursor);
+  const uint32_t pushed = 3 * SAMPLE_RING_SIZE + 5;
+  push(1, pushed);
+
+  Sample_t sample = {};
+  TEST_ASSERT_TRUE(sampleRingPop(&ring, &cursor, &sample));
+  uint32_t lost = pushed - (SAMPLE_RING_SIZE - 1);
+  TEST_ASSERT_EQUAL_UINT32(lost, cursor.overruns);
+  TEST_ASSERT_EQUAL_UINT32(lost + 1, sample.sequence);
+
+  uint32_t read = 1;
+  while (sampleRingPop(&ring, &cursor, &sample)) {
+    read++;
+    TEST_ASSERT_EQUAL_UINT32(lost + read, sample.sequence);
+  }
+  TEST_ASSERT_EQUAL_UINT32(pushed, read + cursor.overruns);
+}
+
+
+// The write index wraps from 2^32 - 1 to 0, which the slot index (a divisor of 2^32) and the differences follow.
+void test_write_index_wraps_around(void) {
+  ring.write_index.store(0xFFFFFFFF - 20);
+  SampleRingCursor_t reader, laggard;
+  sampleRingAttach(&ring, &reader);
+  sampleRingAttach(&ring, &laggard);
+
+  push(1, 50);
+  TEST_ASSERT_EQUAL_UINT32(50, sampleRingPending(&ring, &reader));
+  Sample_t sample = {};
+  for (uint32_t sequence = 1; sequence <= 50; sequence++) {
+    TEST_ASSERT_TRUE(sampleRingPop(&ring, &reader, &sample));
+    TEST_ASSERT_EQUAL_UINT32(sequence, sample.sequence);
+  }
+  TEST_ASSERT_FALSE(sampleRingPop(&ring, &reader, &sample));
+  TEST_ASSERT_TRUE(ring.write_index.load() < 50);
+
+  push(51, SAMPLE_RING_SIZE);
+  TEST_ASSERT_TRUE(sampleRingPop(&ring, &laggard, &sample));
+  TEST_ASSERT_EQUAL_UINT32(50 + SAMPLE_RING_SIZE - (SAMPLE_RING_SIZE - 1), laggard.overruns);
+  TEST_ASSERT_EQUAL_UINT32(laggard.overruns + 1, sample.sequence);
+}
+
+
+// One producer and two consumer threads, the second one stalled regularly for longer than the ring lasts.
+// Every consumer sees every sample once or counts it as lost, in order and never torn.
+void test_one_producer_two_consumers(void) {
+  static const uint32_t SAMPLES = 100000;
+  std::atomic<bool> started[2] = {{false}, {false}};
+  std::atomic<bool> done(false);
+  uint32_t received[2] = {0, 0}, overruns[2] = {0, 0}, torn[2] = {0, 0}, backwards[2] = {0, 0};
+
+  std::vector<std::thread> consumers;
+  for (uint8_t c = 0; c < 2; c++) {
+    consumers.emplace_back([&, c]() {
+      SampleRingCursor_t cursor;
+      sampleRingAttach(&ring, &cursor);
+      started[c].store(true);
+      uint32_t last = 0;
+      Sample_t sample = {};
+      // Keep reading until the producer is done and the ring is drained.
+      while (!done.load() || sampleRingPending(&ring, &cursor) > 0) {
+        if (!sampleRingPop(&ring, &cursor, &sample)) {
+          std::this_thread::yield();
+          continue;
+        }
+        received[c]++;
+        torn[c] += !consistent(&sample);
+        backwards[c] += sample.sequence <= last;
+        last = sample.sequence;
+        if (c == 1 && received[c] % 1000 == 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+      }
+      overruns[c] = cursor.overruns;
+    });
+  }
+  while (!started[0].load() || !started[1].load()) {
+    std::this_thread::yield();
+  }
+
+  push(1, SAMPLES, 20);
+  done.store(true);
+  for (auto& consumer : consumers) {
+    consumer.join();
+  }
+
+  printf("\n%u samples  consumer 1: %u read, %u lost  consumer 2 (stalled): %u read, %u lost\n", (unsigned)SAMPLES,
+         (unsigned)received[0], (unsigned)overruns[0], (unsigned)received[1], (unsigned)overruns[1]);
+  for (uint8_t c = 0; c < 2; c++) {
+    TEST_ASSERT_EQUAL_UINT32(SAMPLES, received[c] + overruns[c]);
+    TEST_ASSERT_EQUAL_UINT32(0, torn[c]);
+    TEST_ASSERT_EQUAL_UINT32(0, backwards[c]);
+  }
+  TEST_ASSERT_TRUE(received[0] > SAMPLES / 2);
+  TEST_ASSERT_TRUE(overruns[1] > 0);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_consumers_read_independently);
+  RUN_TEST(test_attach_starts_at_the_next_sample);
+  RUN_TEST(test_overrun_is_counted);
+  RUN_TEST(test_write_index_wraps_around);
+  RUN_TEST(test_one_producer_two_consumers);
+  return UNITY_END();
+}
@@ -0,0 +1,247 @@
+// Checks the seqlock that publishes the latest sample of readSensor, and compares it with the
+// mutex it replaced: readSensor and every consumer took sensor_mutex with a 10 ms timeout and
+// silently dropped the tick's sample when the take timed out.
+// The comparison runs on host threads, so its latencies are host times and only printed;
+// the assertions are on behaviour that does not depend on the host.
+
+#include <unity.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "sample_seqlock.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint8_t READERS = 3;               // The display, SD and Firebase consumers.
+static const uint32_t SAMPLES = 400;
+static const uint32_t WRITE_PERIOD_US = 1000;
+static const uint32_t MUTEX_WAIT_MS = 10;       // SENSOR_MUTEX_WAIT_MS of the mutex version.
+static const uint32_t STALL_EVERY = 40;         // Every 40th read of the first reader is preempted
+static const uint32_t STALL_US = 12000;         // for longer than the mutex timeout.
+
+static SampleSeqlock_t lock;
+
+
+// A sample whose fields can all be derived from its sequence, so a torn copy shows up.
+static Sample_t makeSample(uint32_t sequence) {
+  Sample_t sample;
+  memset(&sample, 0, sizeof(sample));
+  sample.sequence = sequence;
+  sample.timestamp_ms = sequence * 7;
+  sample.sensor_id = sequence % 4;
+  sample.data.temperature = (float)(sequence % 1000);
+  sample.data.pressure = (float)(sequence % 1000) * 2;
+  return sample;
+}
+
+static bool consistent(const Sample_t* sample) {
+  Sample_t expected = makeSample(sample->sequence);
+  return memcmp(&expected, sample, sizeof(Sample_t)) == 0;
+}
+
+
+void setUp(void) {
+  lock.version.store(0);
+  for (uint8_t i = 0; i < SAMPLE_SEQLOCK_WORDS; i++) {
+    lock.words[i].store(0);
+  }
+}
+
+void tearDown(void) {}
+
+
+void test_read_before_the_first_publish_fails(void) {
+  Sample_t sample;
+  TEST_ASSERT_FALSE(seqlockRead(&lock, &sample));
+}
+
+
+void test_read_returns_the_latest_publish(void) {
+  Sample_t first = makeSample(1);
+  Sample_t second = makeSample(2);
+  Sample_t sample;
+  seqlockPublish(&lock, &first);
+  seqlockPublish(&lock, &second);
+  TEST_ASSERT_TRUE(seqlockRead(&lock, &sample));
+  TEST_ASSERT_EQUAL_MEMORY(&second, &sample, sizeof(Sample_t));
+}
+
+
+// A writer publishing as fast as it can must never let a reader copy a half written sample,
+// and a reader must never see the sequence go backwards.
+void test_concurrent_readers_never_see_a_torn_sample(void) {
+  std::atomic<bool> done(false);
+  std::atomic<uint32_t> torn(0), backwards(0), reads(0);
+
+  std::vector<std::thread> readers;
+  for (uint8_t r = 0; r < READERS; r++) {
+    readers.emplace_back([&]() {
+      uint32_t last = 0, own_reads = 0;
+      Sample_t sample;
+      // Reads at least once after the writer is done, in case it finished before this thread ran.
+      while (!done.load() || own_reads == 0) {
+        if (!seqlockRead(&lock, &sample)) {
+          continue;
+        }
+        reads++;
+        own_reads++;
+        if (!consistent(&sample)) {
+          torn++;
+        }
+        if (sample.sequence < last) {
+          backwards++;
+        }
+        last = sample.sequence;
+      }
+    });
+  }
+
+  for (uint32_t sequence = 1; sequence <= 200000; sequence++) {
+    Sample_t sample = makeSample(sequence);
+    seqlockPublish(&lock, &sample);
+  }
+  done.store(true);
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  TEST_ASSERT_GREATER_THAN_UINT32(0, reads.load());
+  TEST_ASSERT_EQUAL_UINT32(0, torn.load());
+  TEST_ASSERT_EQUAL_UINT32(0, backwards.load());
+}
+
+
+typedef struct {
+  uint32_t writer_drops;                        // Samples readSensor could not publish.
+  uint32_t reader_drops;                        // Reads that gave up on a timeout.
+  std::vector<double> latencies_us;             // Time from asking for the sample to having it.
+} BenchResult_t;
+
+static double percentile(std::vector<double>& values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[(size_t)(p * (values.size() - 1))];
+}
+
+static void printResult(const char* name, BenchResult_t* result) {
+  printf("%-8s writer drops %3u  reader drops %3u  read latency p50 %8.2f us  p99 %8.2f us  max %8.2f us\n",
+         name, result->writer_drops, result->reader_drops, percentile(result->latencies_us, 0.5),
+         percentile(result->latencies_us, 0.99), percentile(result->latencies_us, 1.0));
+}
+
+// Runs the writer at WRITE_PERIOD_US and READERS readers that poll for every new sample.
+// The first reader is preempted every STALL_EVERY reads, inside the critical section when there is one.
+// 'read' returns false when it gave up.
+template <typename Publish, typename Read>
+static void runBench(BenchResult_t* result, Publish publish, Read read) {
+  std::atomic<bool> done(false);
+  std::atomic<uint32_t> writer_drops(0), reader_drops(0);
+  std::mutex results_mutex;
+
+  std::vector<std::thread> readers;
+  for (uint8_t r = 0; r < READERS; r++) {
+    readers.emplace_back([&, r]() {
+      std::vector<double> latencies;
+      uint32_t count = 0;
+      while (!done.load()) {
+        bool stall = r == 0 && ++count % STALL_EVERY == 0;
+        Clock::time_point start = Clock::now();
+        if (!read(stall)) {
+          reader_drops++;
+        }
+        if (!stall) {
+          latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(WRITE_PERIOD_US / 2));
+      }
+      std::lock_guard<std::mutex> guard(results_mutex);
+      result->latencies_us.insert(result->latencies_us.end(), latencies.begin(), latencies.end());
+    });
+  }
+
+  Clock::time_point release = Clock::now();
+  for (uint32_t sequence = 1; sequence <= SAMPLES; sequence++) {
+    Sample_t sample = makeSample(sequence);
+    if (!publish(&sample)) {
+      writer_drops++;
+    }
+    release += std::chrono::microseconds(WRITE_PERIOD_US);
+    std::this_thread::sleep_until(release);
+  }
+  done.store(true);
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  result->writer_drops = writer_drops.load();
+  result->reader_drops = reader_drops.load();
+}
+
+
+// The same preemption that makes the mutex version drop samples costs the seqlock version nothing:
+// a preempted reader holds no lock, so neither the writer nor the other readers ever wait for it.
+void test_benchmark_seqlock_against_the_mutex(void) {
+  BenchResult_t seqlock_result;
+  runBench(&seqlock_result,
+           [](const Sample_t* sample) {
+             seqlockPublish(&lock, sample);
+             return true;
+           },
+           [](bool stall) {
+             Sample_t sample;
+             bool read = seqlockRead(&lock, &sample);
+             if (stall) {
+               std::this_thread::sleep_for(std::chrono::microseconds(STALL_US));
+             }
+             return !read || consistent(&sample);
+           });
+
+  std::timed_mutex sensor_mutex;
+  Sample_t shared = makeSample(0);
+  BenchResult_t mutex_result;
+  runBench(&mutex_result,
+           [&](const Sample_t* sample) {
+             if (!sensor_mutex.try_lock_for(std::chrono::milliseconds(MUTEX_WAIT_MS))) {
+               return false;
+             }
+             shared = *sample;
+             sensor_mutex.unlock();
+             return true;
+           },
+           [&](bool stall) {
+             if (!sensor_mutex.try_lock_for(std::chrono::milliseconds(MUTEX_WAIT_MS))) {
+               return false;
+             }
+             Sample_t sample = shared;
+             if (stall) {
+               std::this_thread::sleep_for(std::chrono::microseconds(STALL_US));
+             }
+             sensor_mutex.unlock();
+             return consistent(&sample);
+           });
+
+  printf("\n%u samples every %u us, %u readers, one preempted for %u us every %u reads\n",
+         SAMPLES, WRITE_PERIOD_US, READERS, STALL_US, STALL_EVERY);
+  printResult("seqlock", &seqlock_result);
+  printResult("mutex", &mutex_result);
+
+  TEST_ASSERT_EQUAL_UINT32(0, seqlock_result.writer_drops);
+  TEST_ASSERT_EQUAL_UINT32(0, seqlock_result.reader_drops);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_read_before_the_first_publish_fails);
+  RUN_TEST(test_read_returns_the_latest_publish);
+  RUN_TEST(test_concurrent_readers_never_see_a_torn_sample);
+  RUN_TEST(test_benchmark_seqlock_against_the_mutex);
+  return UNITY_END();
+}
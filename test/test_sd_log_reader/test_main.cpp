@@ -0,0 +1,369 @@
+// Checks the time index lookup (sd_log_index.h) and the sd_log_reader on the fake card: the boundaries
+// of the search, torn and stale index files, the CSV, binary and compressed formats, resynchronization
+// after a corrupted block, and the SD_LOG_SENSOR_REORDER_S slack of querySdLog with several sensors
+// whose blocks are written when full or SDCARD_FLUSH_INTERVAL_MS old. It also measures what a query
+// reads before its first row in a log of 1 day against a log 30 times larger.
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "sd_log_writer.h"
+#include "sd_log_index.h"
+#include "sd_log_reader.h"
+
+static const char* FOLDER = "/2026";
+static const char* CSV_PATH = "/2026/16_October_2026.csv";
+static const char* LOG_PATH = "/2026/16_October_2026.bin";
+static const char* INDEX_PATH = "/2026/16_October_2026.bin.idx";
+static const uint32_t DAY_TIME = 1792108800;      // 2026-10-16 00:00 UTC.
+
+// Logging constants of main.cpp: a window every MAX_SDCARD_SAMPLES samples of SENSOR_READ_INTERVAL_MS.
+static const uint32_t FLUSH_INTERVAL_MS = 300000;  // SDCARD_FLUSH_INTERVAL_MS.
+static const uint32_t WINDOW_S = 30;
+static const uint32_t REORDER_S = (FLUSH_INTERVAL_MS + WINDOW_S * 1000) / 1000;  // SD_LOG_SENSOR_REORDER_S.
+
+static SdLogWriter_t writer;
+static SdLogReader_t reader;
+
+// Block being built for each sensor, as the sd_binary_blocks of main.cpp.
+typedef struct {
+  BinaryLogBlock_t binary;
+  CompressedLogBlock_t compressed;
+  uint32_t start_ms;
+} SensorBlock_t;
+
+static const uint8_t SENSORS = 2;
+static SensorBlock_t blocks[SENSORS];
+static bool compressed_format;
+
+
+// The average logged by sensor 'id' at 'time', distinct for every window.
+static SensorData_t average(uint8_t id, uint32_t time) {
+  SensorData_t data = {20.0f + id, 1000.0f + id * 10 + (time % 1000) * 0.01f};
+  return data;
+}
+
+static uint16_t blockCount(uint8_t id) {
+  return compressed_format ? blocks[id].compressed.count : blocks[id].binary.count;
+}
+
+static void resetBlock(uint8_t id) {
+  binaryLogBlockReset(&blocks[id].binary);
+  compressedLogReset(&blocks[id].compressed);
+  blocks[id].binary.sensor_id = blocks[id].compressed.sensor_id = id;
+}
+
+// flushBinaryBlockToSdCard of main.cpp.
+static void flushBlock(uint8_t id, uint32_t now_ms) {
+  if (blockCount(id) == 0) {
+    return;
+  }
+  uint8_t encoded[BINARY_LOG_MAX_BLOCK_SIZE];
+  const uint8_t* data = encoded;
+  size_t length;
+  uint32_t base_time;
+  if (compressed_format) {
+    length = compressedLogFinish(&blocks[id].compressed);
+    data = blocks[id].compressed.data;
+    base_time = blocks[id].compressed.base_time;
+  }
+  else {
+    length = binaryLogBlockEncode(&blocks[id].binary, encoded);
+    base_time = blocks[id].binary.base_time;
+  }
+  TEST_ASSERT_TRUE(sdLogWriterAppend(&writer, FOLDER, LOG_PATH, "", base_time, data, length, now_ms));
+  resetBlock(id);
+}
+
+static bool addToBlock(uint8_t id, uint32_t time, const SensorData_t* data) {
+  return compressed_format ? compressedLogAdd(&blocks[id].compressed, time, data)
+                           : binaryLogBlockAdd(&blocks[id].binary, time, data);
+}
+
+// logBinaryToSdCard of main.cpp, with the monotonic time following the log time.
+static void logWindow(uint8_t id, uint32_t time) {
+  uint32_t now_ms = (time - DAY_TIME) * 1000;
+  SensorData_t data = average(id, time);
+  if (!addToBlock(id, time, &data)) {
+    flushBlock(id, now_ms);
+    addToBlock(id, time, &data);
+  }
+  if (blockCount(id) == 1) {
+    blocks[id].start_ms = now_ms;
+  }
+  if (!compressed_format && blocks[id].binary.count == BINARY_LOG_MAX_RECORDS) {
+    flushBlock(id, now_ms);
+  }
+  for (uint8_t other = 0; other < SENSORS; other++) {
+    if (blockCount(other) > 0 && now_ms - blocks[other].start_ms >= FLUSH_INTERVAL_MS) {
+      flushBlock(other, now_ms);
+    }
+  }
+}
+
+// Logs a window of sensor 0 every WINDOW_S and of sensor 1 every 'sensor1_window_s' (0 for none)
+// for 'seconds' from the start of the day, then writes out everything.
+static void logDay(uint32_t seconds, uint32_t sensor1_window_s) {
+  for (uint32_t t = WINDOW_S; t <= seconds; t++) {
+    if (t % WINDOW_S == 0) {
+      logWindow(0, DAY_TIME + t);
+    }
+    if (sensor1_window_s > 0 && t % sensor1_window_s == 0) {
+      logWindow(1, DAY_TIME + t);
+    }
+  }
+  for (uint8_t id = 0; id < SENSORS; id++) {
+    flushBlock(id, seconds * 1000);
+  }
+  sdLogWriterClose(&writer, seconds * 1000);
+}
+
+// Reads the records of 'path' between 'from' and 'to' as querySdLog does, the range widened by 'slack_s'.
+static std::vector<BinaryLogRecord_t> readRange(const char* path, uint32_t from, uint32_t to, uint32_t slack_s) {
+  std::vector<BinaryLogRecord_t> records;
+  time_t day_time = DAY_TIME;
+  struct tm day;
+  gmtime_r(&day_time, &day);
+  TEST_ASSERT_TRUE(sdLogReaderOpen(&reader, path, &day, from - slack_s));
+  while (true) {
+    BinaryLogRecord_t record;
+    SdLogReadStatus_t status = sdLogReaderNext(&reader, &record);
+    if (status == SD_LOG_READ_NEED_DATA) {
+      sdLogReaderFill(&reader);
+      continue;
+    }
+    if (status == SD_LOG_READ_END || record.time > to + slack_s) {
+      break;
+    }
+    if (record.time >= from && record.time <= to) {
+      records.push_back(record);
+    }
+  }
+  sdLogReaderClose(&reader);
+  return records;
+}
+
+static void writeIndex(const SdLogIndexEntry_t* entries, uint8_t count) {
+  File index_file = SD.open(INDEX_PATH, FILE_APPEND);
+  TEST_ASSERT_TRUE(sdLogIndexAppend(&index_file, entries, count));
+  index_file.close();
+}
+
+
+void setUp(void) {
+  // The CSV records store the local time of day, the tests run in UTC.
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  fakeClockSet(0);
+  SD.format();
+  SD.present = true;
+  SD.space = -1;
+  SD.mkdir(FOLDER);
+  Serial.quiet = true;
+  sdLogWriterInit(&writer, FLUSH_INTERVAL_MS);
+  compressed_format = false;
+  for (uint8_t id = 0; id < SENSORS; id++) {
+    resetBlock(id);
+  }
+}
+
+void tearDown(void) {
+  Serial.quiet = false;
+}
+
+
+// The search returns the last entry at or before the time, the start of the file before the first entry.
+void test_index_search_boundaries(void) {
+  uint32_t reads = 0;
+  TEST_ASSERT_EQUAL_UINT32(0, sdLogIndexFind(LOG_PATH, 5000, &reads));
+  TEST_ASSERT_EQUAL_UINT32(0, reads);
+
+  const SdLogIndexEntry_t entries[] = {{1000, 16}, {2000, 512}, {3000, 1024}, {3000, 1536}};
+  writeIndex(entries, 4);
+  TEST_ASSERT_EQUAL_UINT32(0, sdLogIndexFind(LOG_PATH, 999, &reads));
+  TEST_ASSERT_EQUAL_UINT32(16, sdLogIndexFind(LOG_PATH, 1000, &reads));
+  TEST_ASSERT_EQUAL_UINT32(16, sdLogIndexFind(LOG_PATH, 1999, &reads));
+  TEST_ASSERT_EQUAL_UINT32(512, sdLogIndexFind(LOG_PATH, 2000, &reads));
+  TEST_ASSERT_EQUAL_UINT32(1536, sdLogIndexFind(LOG_PATH, 3000, &reads));
+  TEST_ASSERT_EQUAL_UINT32(1536, sdLogIndexFind(LOG_PATH, 0xFFFFFFFF, &reads));
+  TEST_ASSERT_TRUE(reads > 0);
+}
+
+
+// An entry cut short by a power loss is ignored, the complete entries before it are still used.
+void test_torn_index_entry_is_ignored(void) {
+  const SdLogIndexEntry_t entries[] = {{1000, 0}, {2000, 512}, {3000, 1024}};
+  writeIndex(entries, 3);
+  File index_file = SD.open(INDEX_PATH, FILE_APPEND);
+  const uint8_t torn[5] = {0xA0, 0x0F, 0x00, 0x00, 0x00};
+  index_file.write(torn, sizeof(torn));
+  index_file.close();
+
+  uint32_t reads = 0;
+  TEST_ASSERT_EQUAL_UINT32(1024, sdLogIndexFind(LOG_PATH, 4000, &reads));
+  TEST_ASSERT_EQUAL_UINT32(512, sdLogIndexFind(LOG_PATH, 2500, &reads));
+}
+
+
+// An index pointing past the end of its log (e.g. the log was replaced) makes the reader start from the beginning.
+void test_index_past_the_end_reads_from_the_start(void) {
+  logDay(3600, 0);
+  SD.remove(INDEX_PATH);
+  const SdLogIndexEntry_t entries[] = {{DAY_TIME, 1000000}};
+  writeIndex(entries, 1);
+
+  std::vector<BinaryLogRecord_t> records = readRange(LOG_PATH, DAY_TIME, DAY_TIME + 3600, 0);
+  TEST_ASSERT_EQUAL_UINT32(0, reader.start_offset);
+  TEST_ASSERT_EQUAL_UINT32(3600 / WINDOW_S, records.size());
+}
+
+
+void test_csv_records_are_read_from_the_indexed_line(void) {
+  for (uint32_t t = 0; t < 86400; t += 60) {
+    char line[96];
+    int length = snprintf(line, sizeof(line), "%02u:%02u:%02u,%.2f,%.2f,%.2f,1,2,3,4,5,6,%u\n", (unsigned)(t / 3600),
+                          (unsigned)(t / 60 % 60), (unsigned)(t % 60), 20.5, 68.9, 1000.0 + t % 1000 * 0.01, (unsigned)(t / 60 % 2));
+    TEST_ASSERT_TRUE(sdLogWriterAppend(&writer, FOLDER, CSV_PATH, "Time,Sensor\n", DAY_TIME + t, (const uint8_t*)line, length, t * 1000));
+  }
+  sdLogWriterClose(&writer, 86400000);
+
+  std::vector<BinaryLogRecord_t> records = readRange(CSV_PATH, DAY_TIME + 43200, DAY_TIME + 43200 + 600, 0);
+  TEST_ASSERT_EQUAL_UINT32(11, records.size());
+  TEST_ASSERT_EQUAL_UINT32(DAY_TIME + 43200, records[0].time);
+  TEST_ASSERT_EQUAL_UINT8(0, records[0].sensor_id);
+  TEST_ASSERT_EQUAL_UINT8(1, records[1].sensor_id);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 20.5, records[0].data.temperature);
+  TEST_ASSERT_TRUE(reader.start_offset > 0);
+  TEST_ASSERT_TRUE(reader.bytes_read < 3 * SD_LOG_READER_BUFFER_SIZE);
+}
+
+
+// Every record of a day comes back with its sensor and values, in both block formats.
+void test_binary_and_compressed_logs_read_back(void) {
+  for (uint8_t format = 0; format < 2; format++) {
+    setUp();
+    compressed_format = format == 1;
+    logDay(6 * 3600, 0);
+
+    std::vector<BinaryLogRecord_t> records = readRange(LOG_PATH, DAY_TIME, DAY_TIME + 86400, 0);
+    TEST_ASSERT_EQUAL_UINT32(6 * 3600 / WINDOW_S, records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+      uint32_t time = DAY_TIME + (i + 1) * WINDOW_S;
+      SensorData_t expected = average(0, time);
+      TEST_ASSERT_EQUAL_UINT32(time, records[i].time);
+      TEST_ASSERT_EQUAL_UINT8(0, records[i].sensor_id);
+      TEST_ASSERT_FLOAT_WITHIN(0.006, expected.pressure, records[i].data.pressure);
+    }
+  }
+}
+
+
+// A block corrupted in the middle of the file only loses its own records, the reader resynchronizes on the next block.
+void test_corrupted_block_is_skipped(void) {
+  for (uint8_t format = 0; format < 2; format++) {
+    setUp();
+    compressed_format = format == 1;
+    logDay(6 * 3600, 0);
+    std::vector<BinaryLogRecord_t> intact = readRange(LOG_PATH, DAY_TIME, DAY_TIME + 86400, 0);
+
+    std::vector<uint8_t>* data = SD.contents(LOG_PATH);
+    (*data)[data->size() / 2] ^= 0x10;
+    std::vector<BinaryLogRecord_t> records = readRange(LOG_PATH, DAY_TIME, DAY_TIME + 86400, 0);
+
+    TEST_ASSERT_TRUE(records.size() < intact.size());
+    TEST_ASSERT_TRUE(records.size() >= intact.size() - BINARY_LOG_MAX_RECORDS);
+    TEST_ASSERT_EQUAL_UINT32(intact.back().time, records.back().time);
+    for (size_t i = 1; i < records.size(); i++) {
+      TEST_ASSERT_TRUE(records[i].time > records[i - 1].time);
+    }
+  }
+}
+
+
+// With two sensors the blocks of one sensor are written up to SD_LOG_SENSOR_REORDER_S after records of the
+// other one. Any range read with that slack returns every record of both sensors that a full scan finds.
+void test_interleaved_sensors_are_found_with_the_reorder_slack(void) {
+  for (uint8_t format = 0; format < 2; format++) {
+    setUp();
+    compressed_format = format == 1;
+    logDay(12 * 3600, 45);
+    std::vector<BinaryLogRecord_t> all = readRange(LOG_PATH, DAY_TIME, DAY_TIME + 86400, 0);
+
+    uint32_t missed_without_slack = 0;
+    for (uint32_t from = DAY_TIME + 600; from < DAY_TIME + 11 * 3600; from += 1217) {
+      uint32_t to = from + 900;
+      uint32_t expected[SENSORS] = {0, 0};
+      for (const BinaryLogRecord_t& record : all) {
+        if (record.time >= from && record.time <= to) {
+          expected[record.sensor_id]++;
+        }
+      }
+      std::vector<BinaryLogRecord_t> records = readRange(LOG_PATH, from, to, REORDER_S);
+      uint32_t found[SENSORS] = {0, 0};
+      for (const BinaryLogRecord_t& record : records) {
+        found[record.sensor_id]++;
+      }
+      TEST_ASSERT_EQUAL_UINT32(expected[0], found[0]);
+      TEST_ASSERT_EQUAL_UINT32(expected[1], found[1]);
+      missed_without_slack += expected[0] + expected[1] - readRange(LOG_PATH, from, to, 0).size();
+    }
+    // Without the slack records of the block written later are missed.
+    TEST_ASSERT_TRUE(missed_without_slack > 0);
+  }
+}
+
+
+// Time to the first row: the index reads and the bytes read before the first record of a range at the end
+// of the log, for a day of logging and a log 30 times larger (30 days worth of windows in one file).
+void test_benchmark_first_row_of_1_day_and_30_day_logs(void) {
+  static const uint32_t DAYS[] = {1, 30};
+  uint32_t bytes_before_first[2];
+  printf("\nreading a range at the end of the log\n");
+  for (uint8_t i = 0; i < 2; i++) {
+    setUp();
+    uint32_t seconds = DAYS[i] * 86400;
+    logDay(seconds, 0);
+
+    uint32_t from = DAY_TIME + seconds - 3600;
+    time_t day_time = DAY_TIME;
+    struct tm day;
+    gmtime_r(&day_time, &day);
+    TEST_ASSERT_TRUE(sdLogReaderOpen(&reader, LOG_PATH, &day, from));
+    BinaryLogRecord_t record;
+    SdLogReadStatus_t status;
+    while ((status = sdLogReaderNext(&reader, &record)) == SD_LOG_READ_NEED_DATA ||
+           (status == SD_LOG_READ_RECORD && record.time < from)) {
+      if (status == SD_LOG_READ_NEED_DATA) {
+        sdLogReaderFill(&reader);
+      }
+    }
+    TEST_ASSERT_EQUAL(SD_LOG_READ_RECORD, status);
+    TEST_ASSERT_EQUAL_UINT32(from, record.time);
+    bytes_before_first[i] = reader.bytes_read;
+    printf("%2u day log  %7u bytes  %2u index reads  %4u bytes read to the first row\n", (unsigned)DAYS[i],
+           (unsigned)SD.contents(LOG_PATH)->size(), (unsigned)reader.index_reads, (unsigned)reader.bytes_read);
+    sdLogReaderClose(&reader);
+
+    TEST_ASSERT_TRUE(reader.index_reads <= 32);
+    TEST_ASSERT_TRUE(bytes_before_first[i] <= SD_LOG_READER_BUFFER_SIZE);
+  }
+  TEST_ASSERT_EQUAL_UINT32(bytes_before_first[0], bytes_before_first[1]);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_index_search_boundaries);
+  RUN_TEST(test_torn_index_entry_is_ignored);
+  RUN_TEST(test_index_past_the_end_reads_from_the_start);
+  RUN_TEST(test_csv_records_are_read_from_the_indexed_line);
+  RUN_TEST(test_binary_and_compressed_logs_read_back);
+  RUN_TEST(test_corrupted_block_is_skipped);
+  RUN_TEST(test_interleaved_sensors_are_found_with_the_reorder_slack);
+  RUN_TEST(test_benchmark_first_row_of_1_day_and_30_day_logs);
+  return UNITY_END();
+}
@@ -0,0 +1,256 @@
+// Checks the buffered SD log writer on the fake card and measures it against the per record
+// exists/open/printf/close sequence it replaced. The card time of both is the simulated time the
+// spi_mutex would be held for.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string>
+#include "sd_log_writer.h"
+#include "sd_log_index.h"
+
+static const char* FOLDER = "/2026";
+static const char* DAY1 = "/2026/16_October_2026.csv";
+static const char* DAY2 = "/2026/17_October_2026.csv";
+static const char* HEADER = "Time,Temperature,Pressure\n";
+static const uint32_t DAY1_TIME = 1792108800;     // 2026-10-16 00:00 UTC.
+static const uint32_t FLUSH_INTERVAL_MS = 300000;
+
+static SdLogWriter_t writer;
+
+
+// A CSV record of about the size the SD card task logs.
+static std::string makeRecord(uint32_t n) {
+  char record[64];
+  snprintf(record, sizeof(record), "%02u:%02u:%02u,%.2f,%.2f\n", (unsigned)(n / 3600 % 24), (unsigned)(n / 60 % 60),
+           (unsigned)(n % 60), 20 + (n % 100) * 0.01, 100000 + (n % 500) * 0.5);
+  return record;
+}
+
+static bool append(const char* file_path, uint32_t n, uint32_t now_ms) {
+  std::string record = makeRecord(n);
+  return sdLogWriterAppend(&writer, FOLDER, file_path, HEADER, DAY1_TIME + n, (const uint8_t*)record.data(),
+                           record.size(), now_ms);
+}
+
+static std::string contents(const char* path) {
+  std::vector<uint8_t>* data = SD.contents(path);
+  return data ? std::string(data->begin(), data->end()) : std::string();
+}
+
+
+// The sequence sdCardLogger ran for every record before the writer.
+static void appendUnbuffered(const char* file_path, uint32_t n) {
+  if (!SD.exists(FOLDER)) {
+    SD.mkdir(FOLDER);
+  }
+  bool new_file = !SD.exists(file_path);
+  File file = SD.open(file_path, FILE_APPEND);
+  if (new_file) {
+    file.print(HEADER);
+  }
+  file.print(makeRecord(n).c_str());
+  file.close();
+}
+
+
+void setUp(void) {
+  fakeClockSet(0);
+  SD.format();
+  SD.present = true;
+  SD.space = -1;
+  SD.resetStats();
+  Serial.quiet = true;
+  sdLogWriterInit(&writer, FLUSH_INTERVAL_MS);
+}
+
+void tearDown(void) {
+  Serial.quiet = false;
+}
+
+
+void test_records_stay_in_ram_until_a_sector_is_full(void) {
+  TEST_ASSERT_TRUE(append(DAY1, 0, 0));
+  SdLogWriter_t before = writer;
+  uint32_t sector_writes = SD.stats.sector_writes;
+
+  TEST_ASSERT_FALSE(sdLogWriterNeedsCard(&writer, DAY1, 30, 1000));
+  TEST_ASSERT_TRUE(append(DAY1, 1, 1000));
+  TEST_ASSERT_EQUAL_UINT32(sector_writes, SD.stats.sector_writes);
+  TEST_ASSERT_EQUAL_UINT32(before.records + 1, writer.records);
+
+  // Another day, a full sector or the flush interval need the card.
+  TEST_ASSERT_TRUE(sdLogWriterNeedsCard(&writer, DAY2, 30, 1000));
+  TEST_ASSERT_TRUE(sdLogWriterNeedsCard(&writer, DAY1, SD_LOG_SECTOR_SIZE, 1000));
+  TEST_ASSERT_TRUE(sdLogWriterNeedsCard(&writer, DAY1, 30, FLUSH_INTERVAL_MS));
+}
+
+
+// Every write of a full buffer ends on a sector boundary, and the folder and file are only looked up once.
+void test_full_sectors_are_written_aligned(void) {
+  std::string expected = HEADER;
+  append(DAY1, 0, 0);
+  expected += makeRecord(0);
+  SD.resetStats();
+  for (uint32_t n = 1; n < 200; n++) {
+    uint32_t flushes = writer.flushes;
+    append(DAY1, n, n);
+    expected += makeRecord(n);
+    if (writer.flushes != flushes) {
+      TEST_ASSERT_EQUAL_UINT32(0, SD.contents(DAY1)->size() % SD_LOG_SECTOR_SIZE);
+    }
+  }
+
+  TEST_ASSERT_GREATER_THAN_UINT32(1, writer.flushes);
+  TEST_ASSERT_EQUAL_UINT32(0, SD.stats.lookups);
+
+  sdLogWriterClose(&writer, 200);
+  TEST_ASSERT_EQUAL_STRING(expected.c_str(), contents(DAY1).c_str());
+  TEST_ASSERT_EQUAL_UINT32(expected.size(), writer.bytes_written + strlen(HEADER));
+}
+
+
+void test_records_are_flushed_after_the_flush_interval(void) {
+  append(DAY1, 0, 0);
+  append(DAY1, 1, 1000);
+  TEST_ASSERT_EQUAL_UINT32(strlen(HEADER), contents(DAY1).size());
+
+  append(DAY1, 2, FLUSH_INTERVAL_MS);
+  TEST_ASSERT_EQUAL_STRING((HEADER + makeRecord(0) + makeRecord(1) + makeRecord(2)).c_str(), contents(DAY1).c_str());
+}
+
+
+void test_each_day_gets_its_own_file(void) {
+  append(DAY1, 0, 0);
+  append(DAY1, 1, 1);
+  append(DAY2, 86400, 2);
+  sdLogWriterClose(&writer, 3);
+
+  TEST_ASSERT_EQUAL_STRING((HEADER + makeRecord(0) + makeRecord(1)).c_str(), contents(DAY1).c_str());
+  TEST_ASSERT_EQUAL_STRING((HEADER + makeRecord(86400)).c_str(), contents(DAY2).c_str());
+  TEST_ASSERT_EQUAL_UINT32(0, writer.dropped_records);
+}
+
+
+// Records of the previous day that can not be flushed at the rollover are dropped and counted,
+// they must not end up in the new day file. Records of the new day are kept until its file can be opened.
+void test_records_of_a_day_that_can_not_be_flushed_are_dropped(void) {
+  append(DAY1, 0, 0);
+  append(DAY1, 1, 1);
+  append(DAY1, 2, 2);
+  SD.present = false;
+  append(DAY2, 86400, 3);
+  SD.present = true;
+  append(DAY2, 86401, 4);
+  sdLogWriterClose(&writer, 5);
+
+  TEST_ASSERT_EQUAL_UINT32(3, writer.dropped_records);
+  TEST_ASSERT_EQUAL_STRING(HEADER, contents(DAY1).c_str());
+  TEST_ASSERT_EQUAL_STRING((HEADER + makeRecord(86400) + makeRecord(86401)).c_str(), contents(DAY2).c_str());
+}
+
+
+// A record cut in two by a sector write is dropped as a whole if its rest can not be written.
+void test_partly_written_records_count_as_dropped(void) {
+  uint32_t n = 0;
+  while (writer.flushes == 0) {
+    append(DAY1, n, n);
+    n++;
+  }
+  uint32_t unwritten = writer.records - (contents(DAY1).size() - strlen(HEADER)) / makeRecord(0).size();
+  TEST_ASSERT_GREATER_THAN_UINT32(0, unwritten);
+  TEST_ASSERT_EQUAL_UINT32(unwritten, writer.buffered_records);
+
+  SD.present = false;
+  append(DAY2, 86400, n);
+  TEST_ASSERT_EQUAL_UINT32(unwritten, writer.dropped_records);
+}
+
+
+// A write error keeps the records buffered, they are written with the next append to the same day.
+void test_records_survive_a_failed_write_of_the_same_day(void) {
+  append(DAY1, 0, 0);
+  SD.space = 0;
+  TEST_ASSERT_FALSE(sdLogWriterFlush(&writer, 1));
+  TEST_ASSERT_EQUAL_UINT32(1, writer.write_errors);
+  SD.space = -1;
+  append(DAY1, 1, 2);
+  sdLogWriterClose(&writer, 3);
+
+  TEST_ASSERT_EQUAL_UINT32(0, writer.dropped_records);
+  TEST_ASSERT_EQUAL_STRING((HEADER + makeRecord(0) + makeRecord(1)).c_str(), contents(DAY1).c_str());
+}
+
+
+// Closing the writer, as initSdCard does before SD.end(), writes the buffered records and their index entries.
+void test_close_writes_buffered_records_and_index_entries(void) {
+  append(DAY1, 0, 0);
+  append(DAY1, 1, 1);
+  sdLogWriterClose(&writer, 2);
+
+  TEST_ASSERT_FALSE(writer.file_open);
+  TEST_ASSERT_EQUAL_STRING((HEADER + makeRecord(0) + makeRecord(1)).c_str(), contents(DAY1).c_str());
+  char index_path[SD_LOG_INDEX_PATH_SIZE];
+  TEST_ASSERT_TRUE(sdLogIndexPath(DAY1, index_path, sizeof(index_path)));
+  TEST_ASSERT_EQUAL_UINT32(1, writer.index_entries);
+  TEST_ASSERT_EQUAL_UINT32(SD_LOG_INDEX_ENTRY_SIZE, contents(index_path).size());
+
+  // The next record reopens the day file and appends to it.
+  append(DAY1, 2, 3);
+  sdLogWriterClose(&writer, 4);
+  TEST_ASSERT_EQUAL_STRING((HEADER + makeRecord(0) + makeRecord(1) + makeRecord(2)).c_str(), contents(DAY1).c_str());
+}
+
+
+// Logs a day of records at 1 Hz both ways and compares the card time per record,
+// i.e. the spi_mutex hold time, and the sectors written per record.
+void test_benchmark_buffered_against_unbuffered(void) {
+  const uint32_t records = 86400;
+
+  uint64_t start_us = fakeClockMicros();
+  for (uint32_t n = 0; n < records; n++) {
+    appendUnbuffered(DAY1, n);
+  }
+  FakeSdStats_t unbuffered = SD.stats;
+  TEST_ASSERT_EQUAL_UINT32(unbuffered.bytes_written, contents(DAY1).size());
+  unbuffered.busy_us = fakeClockMicros() - start_us;
+
+  SD.format();
+  SD.resetStats();
+  start_us = fakeClockMicros();
+  for (uint32_t n = 0; n < records; n++) {
+    append(DAY1, n, n * 1000);
+  }
+  sdLogWriterClose(&writer, records * 1000);
+  FakeSdStats_t buffered = SD.stats;
+  buffered.busy_us = fakeClockMicros() - start_us;
+
+  printf("\n%u records of %u bytes\n", (unsigned)records, (unsigned)makeRecord(0).size());
+  printf("unbuffered  %6.2f sector writes  %5.2f sector reads  %5.2f lookups  %6.1f bytes written  %7.1f us card time per record\n",
+         (double)unbuffered.sector_writes / records, (double)unbuffered.sector_reads / records,
+         (double)unbuffered.lookups / records, (double)unbuffered.bytes_written / records, (double)unbuffered.busy_us / records);
+  printf("buffered    %6.2f sector writes  %5.2f sector reads  %5.2f lookups  %6.1f bytes written  %7.1f us card time per record\n",
+         (double)buffered.sector_writes / records, (double)buffered.sector_reads / records,
+         (double)buffered.lookups / records, (double)buffered.bytes_written / records, (double)buffered.busy_us / records);
+
+  // Same log, at least an order of magnitude less card time and sector writes, even with the index.
+  TEST_ASSERT_EQUAL_UINT32(unbuffered.bytes_written, contents(DAY1).size());
+  TEST_ASSERT_TRUE(buffered.busy_us < unbuffered.busy_us / 10);
+  TEST_ASSERT_LESS_THAN_UINT32(unbuffered.sector_writes / 10, buffered.sector_writes);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_records_stay_in_ram_until_a_sector_is_full);
+  RUN_TEST(test_full_sectors_are_written_aligned);
+  RUN_TEST(test_records_are_flushed_after_the_flush_interval);
+  RUN_TEST(test_each_day_gets_its_own_file);
+  RUN_TEST(test_records_of_a_day_that_can_not_be_flushed_are_dropped);
+  RUN_TEST(test_partly_written_records_count_as_dropped);
+  RUN_TEST(test_records_survive_a_failed_write_of_the_same_day);
+  RUN_TEST(test_close_writes_buffered_records_and_index_entries);
+  RUN_TEST(test_benchmark_buffered_against_unbuffered);
+  return UNITY_END();
+}
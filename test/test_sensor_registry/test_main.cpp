@@ -0,0 +1,156 @@
+// Checks the sensor_registry: IDs and the limits of the table, the per-bus due masks, reads that stay on
+// the grid of their own interval, late reads that start a new grid instead of catching up, the grid
+// across the wrap of the millisecond counter, and the rate and bus utilization statistics.
+
+#include <unity.h>
+#include <stddef.h>
+#include "sensor_registry.h"
+
+static SensorRegistry_t registry;
+
+static const SensorData_t READING = {21.5f, 1013.25f};
+
+
+// Runs the schedule from 'start_ms' to 'end_ms' in 'step_ms' steps as readSensor does, reading every due
+// sensor on both buses at the step it became due, and returns the number of reads.
+static uint32_t runSchedule(uint32_t start_ms, uint32_t end_ms, uint32_t step_ms) {
+  uint32_t reads = 0;
+  for (uint32_t now_ms = start_ms; now_ms != end_ms; now_ms += step_ms) {
+    for (uint8_t bus = 0; bus < SENSOR_REGISTRY_BUSES; bus++) {
+      uint8_t due = sensorRegistryDue(&registry, bus, now_ms);
+      for (uint8_t id = 0; id < registry.count; id++) {
+        if (due & (1 << id)) {
+          sensorRegistryRecord(&registry, id, &READING, now_ms);
+          reads++;
+        }
+      }
+    }
+  }
+  return reads;
+}
+
+
+void setUp(void) {
+  sensorRegistryInit(&registry, 0);
+}
+
+void tearDown(void) {}
+
+
+// IDs are given in order, two sensors on each bus, and an invalid bus or a full table is refused.
+void test_ids_and_limits(void) {
+  TEST_ASSERT_EQUAL_UINT8(SENSOR_REGISTRY_SIZE, sensorRegistryAdd(&registry, SENSOR_REGISTRY_BUSES, 0x76, 1000, 0));
+  TEST_ASSERT_EQUAL_UINT8(0, sensorRegistryAdd(&registry, 0, 0x76, 1000, 0));
+  TEST_ASSERT_EQUAL_UINT8(1, sensorRegistryAdd(&registry, 0, 0x77, 1000, 0));
+  TEST_ASSERT_EQUAL_UINT8(2, sensorRegistryAdd(&registry, 1, 0x76, 1000, 0));
+  TEST_ASSERT_EQUAL_UINT8(3, sensorRegistryAdd(&registry, 1, 0x77, 1000, 0));
+  TEST_ASSERT_EQUAL_UINT8(SENSOR_REGISTRY_SIZE, sensorRegistryAdd(&registry, 0, 0x76, 1000, 0));
+  TEST_ASSERT_EQUAL_UINT8(SENSOR_REGISTRY_SIZE, registry.count);
+}
+
+
+// Every sensor is due first at the time it was added, and only in the mask of its own bus.
+void test_due_masks_per_bus(void) {
+  sensorRegistryAdd(&registry, 0, 0x76, 1000, 0);
+  sensorRegistryAdd(&registry, 1, 0x76, 1000, 0);
+  sensorRegistryAdd(&registry, 0, 0x77, 1000, 500);
+  TEST_ASSERT_EQUAL_HEX8(0x01, sensorRegistryDue(&registry, 0, 0));
+  TEST_ASSERT_EQUAL_HEX8(0x02, sensorRegistryDue(&registry, 1, 0));
+  TEST_ASSERT_EQUAL_HEX8(0x05, sensorRegistryDue(&registry, 0, 500));
+
+  sensorRegistryRecord(&registry, 0, &READING, 500);
+  TEST_ASSERT_EQUAL_HEX8(0x04, sensorRegistryDue(&registry, 0, 999));
+  TEST_ASSERT_EQUAL_HEX8(0x05, sensorRegistryDue(&registry, 0, 1000));
+}
+
+
+// Each sensor is read at its own interval, and the interval of one does not change the schedule of another.
+void test_per_sensor_intervals(void) {
+  sensorRegistryAdd(&registry, 0, 0x76, 100, 0);
+  sensorRegistryAdd(&registry, 0, 0x77, 1000, 0);
+  sensorRegistryAdd(&registry, 1, 0x76, 300, 0);
+  TEST_ASSERT_EQUAL_UINT32(600 + 60 + 200, runSchedule(0, 60000, 100));
+  TEST_ASSERT_EQUAL_UINT32(600, registry.readings[0]);
+  TEST_ASSERT_EQUAL_UINT32(60, registry.readings[1]);
+  TEST_ASSERT_EQUAL_UINT32(200, registry.readings[2]);
+  TEST_ASSERT_EQUAL_UINT32(59000, registry.reading_ms[1]);
+  for (uint8_t id = 0; id < 3; id++) {
+    TEST_ASSERT_EQUAL_UINT32(0, registry.late[id]);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 10.0, sensorRegistryRate(&registry, 0, 60000));
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 1.0, sensorRegistryRate(&registry, 1, 60000));
+}
+
+
+// A read taken late within its interval keeps the grid, so the next one is not delayed.
+void test_jitter_keeps_the_grid(void) {
+  sensorRegistryAdd(&registry, 0, 0x76, 1000, 0);
+  sensorRegistryRecord(&registry, 0, &READING, 0);
+  sensorRegistryRecord(&registry, 0, &READING, 1400);
+  TEST_ASSERT_EQUAL_UINT32(2000, registry.next_read_ms[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, registry.late[0]);
+}
+
+
+// A read a whole interval late (e.g. after the bus was held) starts a new grid from now and is counted,
+// there is no burst of reads to catch up.
+void test_late_read_starts_a_new_grid(void) {
+  sensorRegistryAdd(&registry, 0, 0x76, 1000, 0);
+  sensorRegistryRecord(&registry, 0, &READING, 0);
+  sensorRegistryRecord(&registry, 0, &READING, 5300);
+  TEST_ASSERT_EQUAL_UINT32(6300, registry.next_read_ms[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, registry.late[0]);
+  TEST_ASSERT_EQUAL_HEX8(0, sensorRegistryDue(&registry, 0, 6299));
+}
+
+
+// A failed read is counted as an error, keeps the previous reading and still moves the schedule on.
+void test_failed_read(void) {
+  sensorRegistryAdd(&registry, 0, 0x76, 1000, 0);
+  sensorRegistryRecord(&registry, 0, &READING, 0);
+  sensorRegistryRecord(&registry, 0, NULL, 1000);
+  TEST_ASSERT_EQUAL_UINT32(1, registry.readings[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, registry.errors[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, registry.reading_ms[0]);
+  TEST_ASSERT_EQUAL_FLOAT(READING.pressure, sensorRegistryReading(&registry, 0).pressure);
+  TEST_ASSERT_EQUAL_UINT32(2000, registry.next_read_ms[0]);
+}
+
+
+// The schedule runs on across the wrap of the 32 bit millisecond counter after about 49.7 days.
+void test_schedule_across_the_counter_wrap(void) {
+  uint32_t start_ms = 0xFFFFFFFF - 4999;
+  sensorRegistryInit(&registry, start_ms);
+  sensorRegistryAdd(&registry, 0, 0x76, 1000, start_ms);
+  sensorRegistryAdd(&registry, 1, 0x76, 250, start_ms);
+  TEST_ASSERT_EQUAL_UINT32(10 + 40, runSchedule(start_ms, start_ms + 10000, 250));
+  TEST_ASSERT_EQUAL_UINT32(0, registry.late[0] + registry.late[1]);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 4.0, sensorRegistryRate(&registry, 1, start_ms + 10000));
+}
+
+
+// The bus utilization is the share of the time the reads held the bus mutex.
+void test_bus_utilization(void) {
+  sensorRegistryBusHold(&registry, 0, 300);
+  sensorRegistryBusHold(&registry, 0, 200);
+  TEST_ASSERT_EQUAL_UINT32(2, registry.bus_holds[0]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001, 0.05, sensorRegistryBusUtilization(&registry, 0, 1000));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, sensorRegistryBusUtilization(&registry, 1, 1000));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, sensorRegistryBusUtilization(&registry, 0, 0));
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_ids_and_limits);
+  RUN_TEST(test_due_masks_per_bus);
+  RUN_TEST(test_per_sensor_intervals);
+  RUN_TEST(test_jitter_keeps_the_grid);
+  RUN_TEST(test_late_read_starts_a_new_grid);
+  RUN_TEST(test_failed_read);
+  RUN_TEST(test_schedule_across_the_counter_wrap);
+  RUN_TEST(test_bus_utilization);
+  return UNITY_END();
+}
@@ -0,0 +1,149 @@
+// Checks the Welford statistics of stream_stats against a two pass reference in double precision,
+// at a pressure offset of about 1013 hPa where a float sum of squares loses the small noise entirely
+// and a slow drift would bias an unshifted float mean, and the empty and single sample windows.
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "stream_stats.h"
+
+static StreamStats_t stats;
+
+
+// Mean, variance, minimum and maximum of the values in two passes in double precision.
+typedef struct {
+  double mean;
+  double variance;
+  float min;
+  float max;
+} Reference_t;
+
+static Reference_t twoPass(const std::vector<float>& values) {
+  Reference_t reference = {0.0, 0.0, values[0], values[0]};
+  for (float value : values) {
+    reference.mean += value;
+    reference.min = fminf(reference.min, value);
+    reference.max = fmaxf(reference.max, value);
+  }
+  reference.mean /= values.size();
+  for (float value : values) {
+    reference.variance += (value - reference.mean) * (value - reference.mean);
+  }
+  reference.variance /= values.size() - 1;
+  return reference;
+}
+
+// Pressures around 'offset' hPa with uniform noise of +-'noise' hPa, in steps of 0.01 hPa.
+static std::vector<float> noisyPressures(uint32_t count, float offset, float noise) {
+  std::vector<float> values;
+  int32_t steps = (int32_t)lroundf(noise * 100);
+  for (uint32_t i = 0; i < count; i++) {
+    values.push_back(offset + (rand() % (2 * steps + 1) - steps) / 100.0f);
+  }
+  return values;
+}
+
+// Adds the values and compares every result with the reference, the variance to within 'relative'.
+static void checkAgainstReference(const std::vector<float>& values, double relative) {
+  streamStatsReset(&stats);
+  for (float value : values) {
+    streamStatsAdd(&stats, value);
+  }
+  Reference_t reference = twoPass(values);
+  TEST_ASSERT_EQUAL_UINT32(values.size(), stats.count);
+  TEST_ASSERT_FLOAT_WITHIN(fabs(reference.mean) * 1e-6, reference.mean, stats.mean);
+  TEST_ASSERT_FLOAT_WITHIN(reference.variance * relative, reference.variance, streamStatsVariance(&stats));
+  TEST_ASSERT_FLOAT_WITHIN(sqrt(reference.variance) * relative, sqrt(reference.variance), streamStatsStdDev(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(reference.min, stats.min);
+  TEST_ASSERT_EQUAL_FLOAT(reference.max, stats.max);
+}
+
+
+void setUp(void) {
+  srand(11);
+  streamStatsReset(&stats);
+}
+
+void tearDown(void) {}
+
+
+void test_empty_window(void) {
+  TEST_ASSERT_EQUAL_UINT32(0, stats.count);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.mean);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, streamStatsVariance(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, streamStatsStdDev(&stats));
+}
+
+
+// One value is the mean, minimum and maximum, and has no variance.
+void test_single_sample(void) {
+  streamStatsAdd(&stats, 1013.25f);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.count);
+  TEST_ASSERT_EQUAL_FLOAT(1013.25f, stats.mean);
+  TEST_ASSERT_EQUAL_FLOAT(1013.25f, stats.min);
+  TEST_ASSERT_EQUAL_FLOAT(1013.25f, stats.max);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, streamStatsVariance(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, streamStatsStdDev(&stats));
+}
+
+
+// Negative values set the minimum, the zeroed minimum of the reset must not stick.
+void test_negative_values(void) {
+  std::vector<float> values = {-12.5f, -3.0f, -20.25f, -7.75f};
+  checkAgainstReference(values, 1e-5);
+  TEST_ASSERT_EQUAL_FLOAT(-3.0f, stats.max);
+}
+
+
+// A reset starts a new window without any trace of the previous one.
+void test_reset_starts_a_new_window(void) {
+  checkAgainstReference(noisyPressures(100, 1013.0f, 0.5f), 1e-3);
+  checkAgainstReference(noisyPressures(3, 20.0f, 0.1f), 1e-4);
+}
+
+
+// About 1013 hPa with noise of a few hundredths: the variance (about 1e-3 hPa^2) is 9 orders of magnitude
+// below the square of the offset, which a float sum of squares cannot resolve but Welford's algorithm can.
+void test_stable_at_a_large_offset(void) {
+  static const uint32_t WINDOWS[] = {2, 10, 60, 600, 3600};
+  for (uint32_t count : WINDOWS) {
+    std::vector<float> values = noisyPressures(count, 1013.0f, 0.05f);
+    checkAgainstReference(values, 1e-3);
+
+    float sum = 0.0f, sum_of_squares = 0.0f;
+    for (float value : values) {
+      sum += value;
+      sum_of_squares += value * value;
+    }
+    float naive = (sum_of_squares - sum * sum / count) / (count - 1);
+    printf("\n%4u samples  two pass variance %.6f  Welford %.6f  float sum of squares %.6f", (unsigned)count,
+           twoPass(values).variance, streamStatsVariance(&stats), naive);
+  }
+  printf("\n");
+}
+
+
+// A slow drift under the noise, as the pressure does over a window, must not bias the variance.
+void test_stable_with_a_drift(void) {
+  std::vector<float> values = noisyPressures(3600, 1013.0f, 0.05f);
+  for (uint32_t i = 0; i < values.size(); i++) {
+    values[i] += i * 0.0005f;
+  }
+  checkAgainstReference(values, 1e-3);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_window);
+  RUN_TEST(test_single_sample);
+  RUN_TEST(test_negative_values);
+  RUN_TEST(test_reset_starts_a_new_window);
+  RUN_TEST(test_stable_at_a_large_offset);
+  RUN_TEST(test_stable_with_a_drift);
+  return UNITY_END();
+}
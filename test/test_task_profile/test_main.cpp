@@ -0,0 +1,153 @@
+// Checks the loop profiling and the absolute time schedule of task_profile, and simulates an hour of
+// a 1 s sampling task under bus contention, scheduled at absolute times (vTaskDelayUntil with
+// taskProfileSchedule, as waitForNextPeriod in main.cpp) against a relative delay after every iteration.
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "task_profile.h"
+
+static const uint32_t PERIOD_MS = 1000;
+
+static TaskProfile_t profile;
+
+
+void setUp(void) {
+  taskProfileInit(&profile, PERIOD_MS * 1000);
+}
+
+void tearDown(void) {}
+
+
+void test_profile_records_period_execution_time_and_overruns(void) {
+  taskProfileBegin(&profile, 0);
+  taskProfileEnd(&profile, 200000);
+  taskProfileBegin(&profile, 1000000);
+  taskProfileEnd(&profile, 2500000);
+
+  TEST_ASSERT_EQUAL_UINT32(1, profile.period_us.count);
+  TEST_ASSERT_EQUAL_UINT32(1000000, profile.period_us.max);
+  TEST_ASSERT_EQUAL_UINT32(2, profile.exec_us.count);
+  TEST_ASSERT_EQUAL_UINT32(1500000, profile.exec_us.max);
+  TEST_ASSERT_EQUAL_UINT32(1, profile.overruns);
+}
+
+
+void test_event_driven_task_has_no_overruns(void) {
+  taskProfileInit(&profile, 0);
+  taskProfileBegin(&profile, 0);
+  taskProfileEnd(&profile, 5000000);
+  TEST_ASSERT_EQUAL_UINT32(0, profile.overruns);
+}
+
+
+void test_schedule_on_time_keeps_the_release(void) {
+  uint32_t release = 5000;
+  TEST_ASSERT_TRUE(taskProfileSchedule(&profile, &release, PERIOD_MS, 5999));
+  TEST_ASSERT_EQUAL_UINT32(5000, release);
+  TEST_ASSERT_EQUAL_UINT32(0, profile.deadline_misses);
+}
+
+
+// A late iteration starts the next one right away at the last release time, keeping the phase.
+void test_missed_deadline_skips_whole_periods_and_keeps_the_phase(void) {
+  uint32_t release = 5000;
+  TEST_ASSERT_FALSE(taskProfileSchedule(&profile, &release, PERIOD_MS, 6200));
+  TEST_ASSERT_EQUAL_UINT32(6000, release);
+  TEST_ASSERT_EQUAL_UINT32(1, profile.deadline_misses);
+  TEST_ASSERT_EQUAL_UINT32(0, profile.skipped_periods);
+
+  TEST_ASSERT_FALSE(taskProfileSchedule(&profile, &release, PERIOD_MS, 9500));
+  TEST_ASSERT_EQUAL_UINT32(9000, release);
+  TEST_ASSERT_EQUAL_UINT32(2, profile.deadline_misses);
+  TEST_ASSERT_EQUAL_UINT32(2, profile.skipped_periods);
+}
+
+
+void test_schedule_across_the_tick_counter_wrap(void) {
+  uint32_t release = 0xFFFFFF00;
+  TEST_ASSERT_TRUE(taskProfileSchedule(&profile, &release, PERIOD_MS, 0x100));
+  TEST_ASSERT_FALSE(taskProfileSchedule(&profile, &release, PERIOD_MS, 0xFFFFFF00 + 2500));
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFF00 + 2000, release);
+}
+
+
+typedef struct {
+  uint32_t samples;
+  uint32_t late_starts;         // Iterations that did not start on the 1 s grid.
+  uint32_t last_start_ms;
+  uint32_t deadline_misses;
+  uint32_t skipped_periods;
+} ScheduleResult_t;
+
+// Work of one iteration in ms: a sensor read and a wait for the bus held by other tasks,
+// with a long stall (e.g. an SD card flush holding the bus) every 600 iterations.
+static uint32_t workMs(uint32_t iteration) {
+  uint32_t bus_wait_ms = rand() % 4 == 0 ? rand() % 120 : 0;
+  uint32_t stall_ms = iteration % 600 == 599 ? 2300 : 0;
+  return 45 + bus_wait_ms + stall_ms;
+}
+
+// Runs the task for 'duration_ms' of simulated time.
+static ScheduleResult_t simulate(bool absolute, uint32_t duration_ms) {
+  ScheduleResult_t result = {};
+  taskProfileInit(&profile, PERIOD_MS * 1000);
+  srand(16);
+  uint32_t now = 0;
+  uint32_t release = 0;
+  while (now < duration_ms) {
+    result.samples++;
+    result.last_start_ms = now;
+    if (now % PERIOD_MS != 0) {
+      result.late_starts++;
+    }
+    now += workMs(result.samples - 1);
+
+    if (!absolute) {
+      now += PERIOD_MS;                     // vTaskDelay(period).
+    }
+    else if (taskProfileSchedule(&profile, &release, PERIOD_MS, now)) {
+      release += PERIOD_MS;                 // vTaskDelayUntil(&release, period).
+      now = release;
+    }
+  }
+  result.deadline_misses = profile.deadline_misses;
+  result.skipped_periods = profile.skipped_periods;
+  return result;
+}
+
+
+// An hour at 1 Hz. The relative delay drifts by the work of every iteration and loses samples,
+// the absolute schedule stays on the grid: only the iteration right after a stall starts late,
+// and every period is either sampled or counted as skipped.
+void test_simulate_absolute_against_relative_delay(void) {
+  const uint32_t duration_ms = 3600000;
+  ScheduleResult_t relative = simulate(false, duration_ms);
+  ScheduleResult_t absolute = simulate(true, duration_ms);
+
+  printf("\n1 s period for 1 h with bus waits and a 2.3 s stall every 600 iterations\n");
+  printf("relative  %4u samples  %4u late starts  drift of the last sample %6u ms\n", (unsigned)relative.samples,
+         (unsigned)relative.late_starts, (unsigned)(relative.last_start_ms - (relative.samples - 1) * PERIOD_MS));
+  printf("absolute  %4u samples  %4u late starts  %u deadline misses  %u skipped periods\n", (unsigned)absolute.samples,
+         (unsigned)absolute.late_starts, (unsigned)absolute.deadline_misses, (unsigned)absolute.skipped_periods);
+
+  TEST_ASSERT_GREATER_THAN_UINT32(0, absolute.deadline_misses);
+  TEST_ASSERT_EQUAL_UINT32(absolute.deadline_misses, absolute.late_starts);
+  TEST_ASSERT_EQUAL_UINT32(duration_ms / PERIOD_MS, absolute.samples + absolute.skipped_periods);
+  TEST_ASSERT_LESS_THAN_UINT32(absolute.samples - 100, relative.samples);
+  TEST_ASSERT_GREATER_THAN_UINT32(100000, relative.last_start_ms - (relative.samples - 1) * PERIOD_MS);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_profile_records_period_execution_time_and_overruns);
+  RUN_TEST(test_event_driven_task_has_no_overruns);
+  RUN_TEST(test_schedule_on_time_keeps_the_release);
+  RUN_TEST(test_missed_deadline_skips_whole_periods_and_keeps_the_phase);
+  RUN_TEST(test_schedule_across_the_tick_counter_wrap);
+  RUN_TEST(test_simulate_absolute_against_relative_delay);
+  return UNITY_END();
+}
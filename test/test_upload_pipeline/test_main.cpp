@@ -0,0 +1,136 @@
+// Checks the slots of upload_pipeline: the in flight limit, completions that arrive out of order or
+// after their attempt timed out, the retry backoff, giving up, and slots released without being sent.
+
+#include <unity.h>
+#include "upload_pipeline.h"
+
+static const uint8_t MAX_IN_FLIGHT = 3;
+static const uint8_t MAX_ATTEMPTS = 3;
+static const uint32_t TIMEOUT_MS = 10000;
+static const uint32_t RETRY_MIN_MS = 1000;
+static const uint32_t RETRY_MAX_MS = 1500;
+
+static UploadPipeline_t pipeline;
+
+
+void setUp(void) {
+  uploadPipelineInit(&pipeline, MAX_IN_FLIGHT, MAX_ATTEMPTS, TIMEOUT_MS, RETRY_MIN_MS, RETRY_MAX_MS);
+}
+
+void tearDown(void) {}
+
+
+void test_acquire_stops_at_max_in_flight(void) {
+  for (uint8_t i = 0; i < MAX_IN_FLIGHT; i++) {
+    TEST_ASSERT_NOT_NULL(uploadPipelineAcquire(&pipeline));
+  }
+  TEST_ASSERT_NULL(uploadPipelineAcquire(&pipeline));
+  TEST_ASSERT_EQUAL_UINT32(1, pipeline.full);
+  TEST_ASSERT_EQUAL_UINT8(0, uploadPipelineAvailable(&pipeline));
+  TEST_ASSERT_EQUAL_UINT8(MAX_IN_FLIGHT, pipeline.in_use_max);
+}
+
+
+// Each completion lands on its own slot, whatever the order.
+void test_completions_out_of_order(void) {
+  UploadSlot_t* first = uploadPipelineAcquire(&pipeline);
+  UploadSlot_t* second = uploadPipelineAcquire(&pipeline);
+  uint32_t first_generation = uploadPipelineSent(&pipeline, first, 0);
+  uint32_t second_generation = uploadPipelineSent(&pipeline, second, 10);
+
+  TEST_ASSERT_TRUE(uploadPipelineComplete(&pipeline, uploadPipelineIndex(&pipeline, second), second_generation, true));
+  UploadSlot_t* slot;
+  TEST_ASSERT_EQUAL(UPLOAD_EVENT_DONE, uploadPipelinePoll(&pipeline, 200, &slot));
+  TEST_ASSERT_EQUAL_PTR(second, slot);
+  TEST_ASSERT_EQUAL(UPLOAD_EVENT_NONE, uploadPipelinePoll(&pipeline, 200, &slot));
+
+  TEST_ASSERT_TRUE(uploadPipelineComplete(&pipeline, uploadPipelineIndex(&pipeline, first), first_generation, true));
+  TEST_ASSERT_EQUAL(UPLOAD_EVENT_DONE, uploadPipelinePoll(&pipeline, 300, &slot));
+  TEST_ASSERT_EQUAL_PTR(first, slot);
+  TEST_ASSERT_EQUAL_UINT32(2, pipeline.acked);
+  TEST_ASSERT_EQUAL_UINT32(300, pipeline.ack_ms.max);
+  TEST_ASSERT_EQUAL_UINT8(0, uploadPipelineInUse(&pipeline));
+}
+
+
+// A completion of an attempt that already timed out is ignored, the retry gets a new generation.
+void test_late_completion_of_a_timed_out_attempt_is_ignored(void) {
+  UploadSlot_t* slot = uploadPipelineAcquire(&pipeline);
+  uint8_t index = uploadPipelineIndex(&pipeline, slot);
+  uint32_t generation = uploadPipelineSent(&pipeline, slot, 0);
+
+  UploadSlot_t* polled;
+  TEST_ASSERT_EQUAL(UPLOAD_EVENT_NONE, uploadPipelinePoll(&pipeline, TIMEOUT_MS, &polled));
+  TEST_ASSERT_EQUAL_UINT32(1, pipeline.timeouts);
+  TEST_ASSERT_EQUAL(UPLOAD_SLOT_RETRY_WAIT, slot->state);
+  TEST_ASSERT_FALSE(uploadPipelineComplete(&pipeline, index, generation, true));
+
+  TEST_ASSERT_EQUAL(UPLOAD_EVENT_NONE, uploadPipelinePoll(&pipeline, TIMEOUT_MS + RETRY_MIN_MS - 1, &polled));
+  TEST_ASSERT_EQUAL(UPLOAD_EVENT_RESEND, uploadPipelinePoll(&pipeline, TIMEOUT_MS + RETRY_MIN_MS, &polled));
+  TEST_ASSERT_EQUAL_PTR(slot, polled);
+  uint32_t retry_generation = uploadPipelineSent(&pipeline, slot, TIMEOUT_MS + RETRY_MIN_MS);
+  TEST_ASSERT_NOT_EQUAL(generation, retry_generation);
+  TEST_ASSERT_FALSE(uploadPipelineComplete(&pipeline, index, generation, true));
+  TEST_ASSERT_TRUE(uploadPipelineComplete(&pipeline, index, retry_generation, true));
+  TEST_ASSERT_EQUAL(UPLOAD_EVENT_DONE, uploadPipelinePoll(&pipeline, TIMEOUT_MS + RETRY_MIN_MS + 50, &polled));
+  TEST_ASSERT_EQUAL_UINT32(TIMEOUT_MS + RETRY_MIN_MS + 50, pipeline.delivery_ms.max);
+}
+
+
+// Failed attempts are retried after a doubling delay up to the maximum, then given up with the payload intact.
+void test_failures_back_off_and_give_up(void) {
+  UploadSlot_t* slot = uploadPipelineAcquire(&pipeline);
+  slot->windows = 7;
+  uint8_t index = uploadPipelineIndex(&pipeline, slot);
+  uint32_t now_ms = 0;
+  UploadSlot_t* polled;
+
+  uint32_t expected_delays[] = {RETRY_MIN_MS, RETRY_MAX_MS};
+  for (uint8_t attempt = 0; attempt < MAX_ATTEMPTS - 1; attempt++) {
+    uploadPipelineComplete(&pipeline, index, uploadPipelineSent(&pipeline, slot, now_ms), false);
+    TEST_ASSERT_EQUAL(UPLOAD_EVENT_NONE, uploadPipelinePoll(&pipeline, now_ms, &polled));
+    TEST_ASSERT_EQUAL_UINT32(now_ms + expected_delays[attempt], slot->retry_at_ms);
+    now_ms = slot->retry_at_ms;
+    TEST_ASSERT_EQUAL(UPLOAD_EVENT_RESEND, uploadPipelinePoll(&pipeline, now_ms, &polled));
+  }
+  uploadPipelineComplete(&pipeline, index, uploadPipelineSent(&pipeline, slot, now_ms), false);
+  TEST_ASSERT_EQUAL(UPLOAD_EVENT_GIVE_UP, uploadPipelinePoll(&pipeline, now_ms, &polled));
+  TEST_ASSERT_EQUAL_PTR(slot, polled);
+  TEST_ASSERT_EQUAL_UINT8(7, polled->windows);
+  TEST_ASSERT_EQUAL(UPLOAD_SLOT_FREE, slot->state);
+
+  TEST_ASSERT_EQUAL_UINT32(MAX_ATTEMPTS, pipeline.sent);
+  TEST_ASSERT_EQUAL_UINT32(MAX_ATTEMPTS, pipeline.failed);
+  TEST_ASSERT_EQUAL_UINT32(MAX_ATTEMPTS - 1, pipeline.retries);
+  TEST_ASSERT_EQUAL_UINT32(1, pipeline.given_up);
+}
+
+
+// A retry that is not sent (e.g. while the link is down) is released and counted, not given up.
+void test_released_retry_is_counted(void) {
+  UploadSlot_t* slot = uploadPipelineAcquire(&pipeline);
+  uint8_t index = uploadPipelineIndex(&pipeline, slot);
+  uploadPipelineComplete(&pipeline, index, uploadPipelineSent(&pipeline, slot, 0), false);
+  UploadSlot_t* polled;
+  uploadPipelinePoll(&pipeline, 0, &polled);
+  TEST_ASSERT_EQUAL(UPLOAD_EVENT_RESEND, uploadPipelinePoll(&pipeline, RETRY_MIN_MS, &polled));
+
+  uploadPipelineRelease(&pipeline, polled);
+  TEST_ASSERT_EQUAL_UINT32(1, pipeline.released);
+  TEST_ASSERT_EQUAL_UINT32(0, pipeline.given_up);
+  TEST_ASSERT_EQUAL_UINT8(0, uploadPipelineInUse(&pipeline));
+  TEST_ASSERT_EQUAL(UPLOAD_EVENT_NONE, uploadPipelinePoll(&pipeline, 100000, &polled));
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_acquire_stops_at_max_in_flight);
+  RUN_TEST(test_completions_out_of_order);
+  RUN_TEST(test_late_completion_of_a_timed_out_attempt_is_ignored);
+  RUN_TEST(test_failures_back_off_and_give_up);
+  RUN_TEST(test_released_retry_is_counted);
+  return UNITY_END();
+}
@@ -0,0 +1,245 @@
+// Checks the backoff, jitter, link quality and statistics of the wifi_link manager, and runs it for a
+// day against a simulated access point that keeps dropping out, updated every WIFI_STATUS_INTERVAL_MS
+// as in updateConnectivity. The attempts and the time offline are compared against retrying at a fixed interval.
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "wifi_link.h"
+
+// The settings of main.cpp.
+static const uint32_t STATUS_INTERVAL_MS = 500;
+static const uint32_t CONNECT_TIMEOUT_MS = 10000;
+static const uint32_t BACKOFF_MIN_MS = 1000;
+static const uint32_t BACKOFF_MAX_MS = 60000;
+
+static WifiLink_t link;
+
+
+// Runs updates every STATUS_INTERVAL_MS with the link down until the manager asks for an attempt,
+// and returns the time of that update.
+static uint32_t nextAttempt(uint32_t now_ms) {
+  while (wifiLinkUpdate(&link, false, 0, now_ms) != WIFI_ACTION_CONNECT) {
+    now_ms += STATUS_INTERVAL_MS;
+  }
+  return now_ms;
+}
+
+
+void setUp(void) {
+  wifiLinkInit(&link, CONNECT_TIMEOUT_MS, BACKOFF_MIN_MS, BACKOFF_MAX_MS, 22, 0);
+}
+
+void tearDown(void) {}
+
+
+void test_first_update_starts_an_attempt(void) {
+  TEST_ASSERT_EQUAL(WIFI_ACTION_CONNECT, wifiLinkUpdate(&link, false, 0, 0));
+  TEST_ASSERT_EQUAL(WIFI_LINK_CONNECTING, link.state);
+  TEST_ASSERT_EQUAL(WIFI_ACTION_NONE, wifiLinkUpdate(&link, true, -60, 2500));
+  TEST_ASSERT_EQUAL(WIFI_LINK_UP, link.state);
+  TEST_ASSERT_EQUAL(WIFI_QUALITY_GOOD, wifiLinkQuality(&link));
+  TEST_ASSERT_EQUAL_INT(-60, wifiLinkRssi(&link));
+  TEST_ASSERT_EQUAL_UINT32(1, link.attempts);
+  TEST_ASSERT_EQUAL_UINT32(1, link.connects);
+  TEST_ASSERT_EQUAL_UINT32(2500, link.reconnect_ms_last);
+  TEST_ASSERT_EQUAL_UINT32(2500, wifiLinkOfflineMs(&link, 9000));
+}
+
+
+// Every failed attempt doubles the delay before the next one up to the maximum,
+// and each delay falls between half and all of the backoff.
+void test_failed_attempts_back_off_up_to_the_maximum(void) {
+  uint32_t now_ms = nextAttempt(0);
+  uint32_t expected_backoff_ms = BACKOFF_MIN_MS;
+  for (uint8_t i = 0; i < 12; i++) {
+    uint32_t timeout_ms = now_ms + CONNECT_TIMEOUT_MS;
+    now_ms = nextAttempt(timeout_ms);
+    expected_backoff_ms = expected_backoff_ms * 2 > BACKOFF_MAX_MS ? BACKOFF_MAX_MS : expected_backoff_ms * 2;
+    TEST_ASSERT_EQUAL_UINT32(expected_backoff_ms, link.backoff_ms);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(expected_backoff_ms / 2, now_ms - timeout_ms);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(expected_backoff_ms + STATUS_INTERVAL_MS, now_ms - timeout_ms);
+  }
+  TEST_ASSERT_EQUAL_UINT32(12, link.failed_attempts);
+  TEST_ASSERT_EQUAL_UINT32(13, link.attempts);
+}
+
+
+// A lost link is retried after the minimum backoff, and a connection resets the backoff.
+void test_lost_link_is_retried_after_the_minimum_backoff(void) {
+  uint32_t now_ms = nextAttempt(0);
+  now_ms = nextAttempt(now_ms + CONNECT_TIMEOUT_MS);
+  wifiLinkUpdate(&link, true, -65, now_ms + 3000);
+  TEST_ASSERT_EQUAL_UINT32(BACKOFF_MIN_MS, link.backoff_ms);
+
+  uint32_t lost_ms = now_ms + 60000;
+  wifiLinkUpdate(&link, false, 0, lost_ms);
+  TEST_ASSERT_EQUAL(WIFI_LINK_DOWN, link.state);
+  TEST_ASSERT_EQUAL(WIFI_QUALITY_OFFLINE, wifiLinkQuality(&link));
+  TEST_ASSERT_EQUAL_INT(0, wifiLinkRssi(&link));
+  TEST_ASSERT_EQUAL_UINT32(1, link.disconnects);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(BACKOFF_MIN_MS + STATUS_INTERVAL_MS, nextAttempt(lost_ms) - lost_ms);
+
+  // The current outage counts towards the time offline before it ends.
+  uint32_t offline_ms = link.offline_ms_total;
+  TEST_ASSERT_EQUAL_UINT32(offline_ms + 5000, wifiLinkOfflineMs(&link, lost_ms + 5000));
+}
+
+
+// Devices with different seeds spread their retries after a common outage.
+void test_jitter_spreads_devices(void) {
+  uint32_t first_retry_ms[8];
+  for (uint8_t device = 0; device < 8; device++) {
+    wifiLinkInit(&link, CONNECT_TIMEOUT_MS, BACKOFF_MIN_MS, BACKOFF_MAX_MS, 1000 + device, 0);
+    uint32_t now_ms = nextAttempt(0);
+    for (uint8_t i = 0; i < 5; i++) {
+      now_ms = nextAttempt(now_ms + CONNECT_TIMEOUT_MS);
+    }
+    first_retry_ms[device] = now_ms;
+  }
+  uint8_t distinct = 0;
+  for (uint8_t i = 0; i < 8; i++) {
+    bool seen = false;
+    for (uint8_t j = 0; j < i; j++) {
+      seen |= first_retry_ms[j] == first_retry_ms[i];
+    }
+    distinct += !seen;
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(4, distinct);
+}
+
+
+// The quality only turns poor below -80 dBm and good again at -72 dBm, so an RSSI moving between the two does not flap.
+void test_quality_has_hysteresis(void) {
+  uint32_t now_ms = nextAttempt(0);
+  wifiLinkUpdate(&link, true, -85, now_ms);
+  TEST_ASSERT_EQUAL(WIFI_QUALITY_POOR, wifiLinkQuality(&link));
+
+  uint8_t changes = 0;
+  WifiLinkQuality_t quality = wifiLinkQuality(&link);
+  for (uint8_t i = 0; i < 40; i++) {
+    now_ms += STATUS_INTERVAL_MS;
+    wifiLinkUpdate(&link, true, i % 2 ? -82 : -74, now_ms);
+    changes += wifiLinkQuality(&link) != quality;
+    quality = wifiLinkQuality(&link);
+  }
+  TEST_ASSERT_EQUAL_UINT8(0, changes);
+  TEST_ASSERT_EQUAL(WIFI_QUALITY_POOR, quality);
+
+  for (uint8_t i = 0; i < 20; i++) {
+    now_ms += STATUS_INTERVAL_MS;
+    wifiLinkUpdate(&link, true, -60, now_ms);
+  }
+  TEST_ASSERT_EQUAL(WIFI_QUALITY_GOOD, wifiLinkQuality(&link));
+}
+
+
+// An access point that is up and down for random times, and a driver that connects 'CONNECT_MS'
+// after an attempt is started if the access point is up by then, and gives up after CONNECT_TIMEOUT_MS.
+// It does not reconnect on its own (setAutoReconnect(false)).
+typedef struct {
+  uint32_t toggle_ms;       // Next time the access point changes state.
+  bool ap_up;
+  bool connecting;
+  uint32_t attempt_ms;
+  bool connected;
+  uint32_t attempts;
+  uint32_t offline_ms;      // Time the driver was not connected, as seen at the updates.
+} FlappingLink_t;
+
+static const uint32_t CONNECT_MS = 3000;
+
+// Advances the simulated link to 'now_ms'. Outages last from 5 s to 15 min, up times from 1 min to 1 h.
+static void flappingLinkAdvance(FlappingLink_t* sim, uint32_t now_ms) {
+  while ((int32_t)(now_ms - sim->toggle_ms) >= 0) {
+    sim->ap_up = !sim->ap_up;
+    sim->toggle_ms += sim->ap_up ? 60000 + rand() % 3540000 : 5000 + rand() % 895000;
+  }
+  if (!sim->ap_up) {
+    sim->connected = false;
+  }
+  else if (sim->connecting && now_ms - sim->attempt_ms >= CONNECT_MS) {
+    sim->connected = true;
+    sim->connecting = false;
+  }
+  if (sim->connecting && now_ms - sim->attempt_ms >= CONNECT_TIMEOUT_MS) {
+    sim->connecting = false;
+  }
+}
+
+// Runs a day of updates. With 'fixed_retry_ms' > 0 the manager is replaced by a retry 'fixed_retry_ms' after
+// every failed attempt or lost link, without backoff.
+static FlappingLink_t simulateDay(uint32_t fixed_retry_ms) {
+  const uint32_t day_ms = 86400000;
+  FlappingLink_t sim = {};
+  sim.ap_up = true;
+  sim.toggle_ms = 600000;
+  srand(22);
+  wifiLinkInit(&link, CONNECT_TIMEOUT_MS, BACKOFF_MIN_MS, BACKOFF_MAX_MS, 22, 0);
+
+  uint32_t retry_ms = 0;
+  for (uint32_t now_ms = 0; now_ms < day_ms; now_ms += STATUS_INTERVAL_MS) {
+    bool was_up = sim.connected || sim.connecting;
+    flappingLinkAdvance(&sim, now_ms);
+    bool attempt;
+    if (fixed_retry_ms > 0) {
+      if (was_up && !sim.connected && !sim.connecting) {
+        retry_ms = now_ms + fixed_retry_ms;
+      }
+      attempt = !sim.connected && !sim.connecting && (int32_t)(now_ms - retry_ms) >= 0;
+    }
+    else {
+      attempt = wifiLinkUpdate(&link, sim.connected, -65, now_ms) == WIFI_ACTION_CONNECT;
+    }
+    if (attempt) {
+      // WiFi.disconnect() and WiFi.begin().
+      sim.connected = false;
+      sim.connecting = true;
+      sim.attempt_ms = now_ms;
+      sim.attempts++;
+    }
+    sim.offline_ms += sim.connected ? 0 : STATUS_INTERVAL_MS;
+  }
+  return sim;
+}
+
+
+void test_simulate_a_day_of_a_flapping_link(void) {
+  FlappingLink_t fixed = simulateDay(BACKOFF_MIN_MS);
+  FlappingLink_t managed = simulateDay(0);
+  uint32_t now_ms = 86400000;
+
+  printf("\na day with an access point that drops out for 5 s to 15 min, updates every %u ms\n", (unsigned)STATUS_INTERVAL_MS);
+  printf("fixed %u ms retry  %5u attempts  offline %6u s\n", (unsigned)BACKOFF_MIN_MS, (unsigned)fixed.attempts,
+         (unsigned)(fixed.offline_ms / 1000));
+  printf("wifi_link          %5u attempts  offline %6u s (reported %u s)  %u failed, %u connects, %u disconnects, "
+         "reconnect last %u ms max %u ms\n", (unsigned)managed.attempts, (unsigned)(managed.offline_ms / 1000),
+         (unsigned)(wifiLinkOfflineMs(&link, now_ms) / 1000), (unsigned)link.failed_attempts, (unsigned)link.connects,
+         (unsigned)link.disconnects, (unsigned)link.reconnect_ms_last, (unsigned)link.reconnect_ms_max);
+
+  // The statistics agree with what the driver saw, and every attempt ended or is still running.
+  TEST_ASSERT_EQUAL_UINT32(managed.attempts, link.attempts);
+  TEST_ASSERT_GREATER_THAN_UINT32(5, link.disconnects);
+  TEST_ASSERT_EQUAL_UINT32(link.disconnects + (link.state == WIFI_LINK_UP), link.connects);
+  TEST_ASSERT_EQUAL_UINT32(link.attempts, link.connects + link.failed_attempts + (link.state == WIFI_LINK_CONNECTING));
+  TEST_ASSERT_UINT32_WITHIN(STATUS_INTERVAL_MS * link.connects, managed.offline_ms, wifiLinkOfflineMs(&link, now_ms));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(BACKOFF_MAX_MS + CONNECT_TIMEOUT_MS + STATUS_INTERVAL_MS + 15 * 60000, link.reconnect_ms_max);
+
+  // The backoff costs some time offline, limited by the maximum delay per outage, for far fewer attempts.
+  TEST_ASSERT_TRUE(managed.attempts * 3 < fixed.attempts);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(fixed.offline_ms + (link.disconnects + 1) * BACKOFF_MAX_MS, managed.offline_ms);
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_first_update_starts_an_attempt);
+  RUN_TEST(test_failed_attempts_back_off_up_to_the_maximum);
+  RUN_TEST(test_lost_link_is_retried_after_the_minimum_backoff);
+  RUN_TEST(test_jitter_spreads_devices);
+  RUN_TEST(test_quality_has_hysteresis);
+  RUN_TEST(test_simulate_a_day_of_a_flapping_link);
+  return UNITY_END();
+}
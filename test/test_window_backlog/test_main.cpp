@@ -0,0 +1,306 @@
+// Checks the window_backlog that keeps the windows logged before the wall clock is known, the window_journal
+// it is spilled to on the simulated SD card, the order in which both are replayed to the log (as
+// logStatsToSdCard in main.cpp), the conversion of their monotonic times once NTP has synchronized
+// (as wallClockTime in main.cpp), and measures the
+// time to the first sample after boot on the simulated BMP280: starting the sensor right away against
+// waiting for Wi-Fi and NTP first, as the system monitor did before.
+
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include <SD.h>
+#include "window_backlog.h"
+#include "window_journal.h"
+#include "bmp280_driver.h"
+#include "fake_bmp280.h"
+
+static const uint8_t ADDRESS = 0x76;
+static const uint32_t NEVER = 0xFFFFFFFF;
+
+// SENSOR_LOW_POWER_CONFIG of main.cpp.
+static const Bmp280Config_t LOW_POWER = {BMP280_OVERSAMPLING_X2, BMP280_OVERSAMPLING_X16, BMP280_FILTER_OFF,
+                                         BMP280_STANDBY_0_5_MS, BMP280_MODE_FORCED};
+
+static const char* const JOURNAL_PATH = "/unsynced.dat";
+static const uint8_t REPLAY_BATCH = 8;  // SD_CARD_UNSYNCED_REPLAY_BATCH of main.cpp.
+
+static WindowBacklog_t backlog;
+static WindowJournal_t journal;
+static TwoWire bus(2);
+static FakeBmp280 fake;
+
+
+// A window of one reading, with the pressure telling the windows apart.
+static SensorStats_t window(float pressure) {
+  SensorStats_t stats;
+  sensorStatsReset(&stats);
+  SensorData_t reading = {20.0f, pressure};
+  sensorStatsAdd(&stats, &reading);
+  return stats;
+}
+
+// wallClockTime of main.cpp, with the time and the monotonic clock of the moment of the conversion.
+static uint32_t wallClockTime(uint32_t monotonic_ms, uint32_t now_unix, uint32_t now_ms) {
+  return now_unix - (now_ms - monotonic_ms) / 1000;
+}
+
+
+void setUp(void) {
+  windowBacklogReset(&backlog);
+  windowJournalInit(&journal, JOURNAL_PATH);
+  SD.format();
+  SD.present = true;
+  SD.space = -1;
+  fakeClockSet(0);
+  fake = FakeBmp280();
+  bus.detach(ADDRESS);
+  bus.attach(ADDRESS, &fake);
+  bus.setClock(100000);
+  bus.resetStats();
+}
+
+void tearDown(void) {}
+
+
+void test_empty_backlog(void) {
+  TEST_ASSERT_NULL(windowBacklogPeek(&backlog));
+  windowBacklogPop(&backlog);
+  TEST_ASSERT_EQUAL_UINT8(0, backlog.count);
+}
+
+
+void test_windows_come_out_oldest_first(void) {
+  for (uint8_t i = 0; i < 10; i++) {
+    SensorStats_t stats = window(1000.0f + i);
+    TEST_ASSERT_TRUE(windowBacklogPush(&backlog, i * 1000, i % 2, &stats));
+  }
+  for (uint8_t i = 0; i < 10; i++) {
+    const BackloggedWindow_t* oldest = windowBacklogPeek(&backlog);
+    TEST_ASSERT_NOT_NULL(oldest);
+    TEST_ASSERT_EQUAL_UINT32(i * 1000, oldest->time);
+    TEST_ASSERT_EQUAL_UINT8(i % 2, oldest->sensor_id);
+    TEST_ASSERT_EQUAL_FLOAT(1000.0f + i, oldest->stats.pressure.mean);
+    windowBacklogPop(&backlog);
+  }
+  TEST_ASSERT_NULL(windowBacklogPeek(&backlog));
+  TEST_ASSERT_EQUAL_UINT32(0, backlog.dropped);
+}
+
+
+// A full backlog drops its oldest windows and keeps the latest WINDOW_BACKLOG_SIZE in order.
+void test_full_backlog_drops_the_oldest_windows(void) {
+  const uint32_t pushed = WINDOW_BACKLOG_SIZE + 10;
+  for (uint32_t i = 0; i < pushed; i++) {
+    SensorStats_t stats = window(1000.0f + i);
+    TEST_ASSERT_EQUAL(i < WINDOW_BACKLOG_SIZE, windowBacklogPush(&backlog, i, 0, &stats));
+  }
+  TEST_ASSERT_EQUAL_UINT8(WINDOW_BACKLOG_SIZE, backlog.count);
+  TEST_ASSERT_EQUAL_UINT32(10, backlog.dropped);
+
+  for (uint32_t i = 10; i < pushed; i++) {
+    TEST_ASSERT_EQUAL_UINT32(i, windowBacklogPeek(&backlog)->time);
+    windowBacklogPop(&backlog);
+  }
+  TEST_ASSERT_EQUAL_UINT8(0, backlog.count);
+
+  windowBacklogReset(&backlog);
+  TEST_ASSERT_EQUAL_UINT32(0, backlog.dropped);
+}
+
+
+// Windows logged every minute from boot are stamped once the time is synchronized 5 min 30 s after boot,
+// and keep their spacing and end at the time of the synchronization.
+void test_backlogged_windows_get_wall_clock_times_after_the_sync(void) {
+  const uint32_t sync_ms = 330000, sync_unix = 1792195200;
+  for (uint32_t minute = 1; minute <= 5; minute++) {
+    SensorStats_t stats = window(1000.0f);
+    windowBacklogPush(&backlog, minute * 60000, 0, &stats);
+  }
+
+  uint32_t previous = 0;
+  const BackloggedWindow_t* oldest;
+  while ((oldest = windowBacklogPeek(&backlog)) != NULL) {
+    uint32_t time = wallClockTime(oldest->time, sync_unix, sync_ms);
+    if (previous != 0) {
+      TEST_ASSERT_EQUAL_UINT32(60, time - previous);
+    }
+    previous = time;
+    windowBacklogPop(&backlog);
+  }
+  TEST_ASSERT_EQUAL_UINT32(sync_unix - 30, previous);
+}
+
+
+// Windows spilled to the journal in several rounds are read back in batches, oldest first.
+void test_journal_returns_the_spilled_windows_in_order(void) {
+  for (uint32_t round = 0; round < 3; round++) {
+    for (uint32_t i = 0; i < WINDOW_BACKLOG_SIZE; i++) {
+      SensorStats_t stats = window(1000.0f);
+      windowBacklogPush(&backlog, round * WINDOW_BACKLOG_SIZE + i, 0, &stats);
+    }
+    TEST_ASSERT_TRUE(windowJournalSpill(&journal, &backlog));
+    TEST_ASSERT_EQUAL_UINT8(0, backlog.count);
+  }
+  TEST_ASSERT_EQUAL_UINT32(3 * WINDOW_BACKLOG_SIZE, journal.windows);
+
+  BackloggedWindow_t windows[REPLAY_BATCH];
+  uint32_t expected = 0;
+  while (windowJournalPending(&journal)) {
+    size_t count = windowJournalRead(&journal, windows, REPLAY_BATCH);
+    TEST_ASSERT_TRUE(count > 0);
+    for (size_t i = 0; i < count; i++) {
+      TEST_ASSERT_EQUAL_UINT32(expected++, windows[i].time);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(3 * WINDOW_BACKLOG_SIZE, expected);
+  TEST_ASSERT_TRUE(windowJournalClear(&journal));
+  TEST_ASSERT_FALSE(SD.exists(JOURNAL_PATH));
+  TEST_ASSERT_EQUAL_UINT32(0, journal.windows);
+}
+
+
+// A journal that lost its file (e.g. the card was swapped) gives up on the missing windows.
+void test_journal_without_its_file_gives_up(void) {
+  SensorStats_t stats = window(1000.0f);
+  windowBacklogPush(&backlog, 1, 0, &stats);
+  TEST_ASSERT_TRUE(windowJournalSpill(&journal, &backlog));
+  SD.format();
+
+  BackloggedWindow_t windows[REPLAY_BATCH];
+  TEST_ASSERT_EQUAL(0, windowJournalRead(&journal, windows, REPLAY_BATCH));
+  TEST_ASSERT_FALSE(windowJournalPending(&journal));
+  TEST_ASSERT_TRUE(windowJournalClear(&journal));
+}
+
+
+// The SD card log and whether the spi_mutex can be taken, for the model of logStatsToSdCard below.
+static std::vector<uint32_t> sd_log;
+static bool spi_mutex_free;
+
+// replayUnsyncedJournal of main.cpp: false if the spi_mutex could not be taken before the end.
+static bool replayJournal() {
+  while (windowJournalPending(&journal)) {
+    if (!spi_mutex_free) {
+      return false;
+    }
+    BackloggedWindow_t windows[REPLAY_BATCH];
+    size_t count = windowJournalRead(&journal, windows, REPLAY_BATCH);
+    for (size_t i = 0; i < count; i++) {
+      sd_log.push_back(windows[i].time);
+    }
+    // The mutex is taken by another task after the first batch.
+    spi_mutex_free = false;
+  }
+  return windowJournalClear(&journal);
+}
+
+// logStatsToSdCard of main.cpp with the card present.
+static void logWindow(uint32_t time, bool synced) {
+  SensorStats_t stats = window(1000.0f);
+  if (!synced || (journal.windows > 0 && !replayJournal())) {
+    if (backlog.count == WINDOW_BACKLOG_SIZE) {
+      TEST_ASSERT_TRUE(windowJournalSpill(&journal, &backlog));
+    }
+    windowBacklogPush(&backlog, time, 0, &stats);
+    return;
+  }
+  const BackloggedWindow_t* oldest;
+  while ((oldest = windowBacklogPeek(&backlog)) != NULL) {
+    sd_log.push_back(oldest->time);
+    windowBacklogPop(&backlog);
+  }
+  sd_log.push_back(time);
+}
+
+
+// A replay of the journal that stops partway because the spi_mutex is busy keeps the new windows
+// back until the journal is written completely, so the log stays complete and in time order.
+void test_replay_stopped_partway_keeps_the_log_in_order(void) {
+  sd_log.clear();
+  uint32_t time = 0;
+  while (time < 3 * WINDOW_BACKLOG_SIZE + 10) {
+    logWindow(time++, false);
+  }
+  TEST_ASSERT_EQUAL_UINT32(3 * WINDOW_BACKLOG_SIZE, journal.windows);
+
+  // The first window after the sync only gets one batch of the journal written, and so do the next ones
+  // until the journal is done, while the backlog spills behind the journal again.
+  for (uint32_t i = 0; i < 3 * WINDOW_BACKLOG_SIZE; i++) {
+    spi_mutex_free = true;
+    logWindow(time++, true);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, journal.windows);
+  TEST_ASSERT_EQUAL_UINT32(time, sd_log.size());
+  for (uint32_t i = 0; i < time; i++) {
+    TEST_ASSERT_EQUAL_UINT32(i, sd_log[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, backlog.dropped);
+}
+
+
+// Simulated time from boot to the first reading of the sensor: the Wi-Fi connection and the NTP
+// synchronization are waited for first if 'wait_for_network', as the system monitor did before.
+// 'wifi_ms' and 'ntp_ms' are the times they take, NEVER at a site without Wi-Fi.
+static uint32_t firstSampleMs(bool wait_for_network, uint32_t wifi_ms, uint32_t ntp_ms) {
+  const uint32_t give_up_ms = 600000;
+  fakeClockSet(0);
+  if (wait_for_network) {
+    if (wifi_ms == NEVER || wifi_ms + ntp_ms > give_up_ms) {
+      return NEVER;
+    }
+    fakeClockAdvance((uint64_t)(wifi_ms + ntp_ms) * 1000);
+  }
+
+  Bmp280_t sensor = {};
+  SensorData_t reading;
+  TEST_ASSERT_TRUE(bmp280Begin(&sensor, &bus, ADDRESS, &LOW_POWER));
+  TEST_ASSERT_TRUE(bmp280StartMeasurement(&sensor));
+  fakeClockAdvance((uint64_t)bmp280MeasurementTimeMs(&LOW_POWER) * 1000);
+  TEST_ASSERT_TRUE(bmp280ReadMeasurement(&sensor, &reading));
+  return millis();
+}
+
+
+void test_time_to_first_sample(void) {
+  static const struct {
+    const char* name;
+    uint32_t wifi_ms;
+    uint32_t ntp_ms;
+  } SITES[] = {
+    {"good Wi-Fi", 2500, 800},
+    {"weak Wi-Fi", 14000, 3000},
+    {"no Wi-Fi", NEVER, 0},
+  };
+
+  printf("\ntime to the first sample after boot\n");
+  for (const auto& site : SITES) {
+    uint32_t waiting = firstSampleMs(true, site.wifi_ms, site.ntp_ms);
+    uint32_t fast = firstSampleMs(false, site.wifi_ms, site.ntp_ms);
+    if (waiting == NEVER) {
+      printf("%-11s  waiting for the network: none in 10 min  fast start: %u ms\n", site.name, (unsigned)fast);
+    }
+    else {
+      printf("%-11s  waiting for the network: %6u ms        fast start: %u ms\n", site.name, (unsigned)waiting, (unsigned)fast);
+    }
+
+    // Sensor reset, configuration, one conversion and the readout.
+    TEST_ASSERT_TRUE(fast < 100);
+    TEST_ASSERT_TRUE(waiting == NEVER || waiting >= site.wifi_ms + site.ntp_ms);
+  }
+}
+
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_backlog);
+  RUN_TEST(test_windows_come_out_oldest_first);
+  RUN_TEST(test_full_backlog_drops_the_oldest_windows);
+  RUN_TEST(test_backlogged_windows_get_wall_clock_times_after_the_sync);
+  RUN_TEST(test_journal_returns_the_spilled_windows_in_order);
+  RUN_TEST(test_journal_without_its_file_gives_up);
+  RUN_TEST(test_replay_stopped_partway_keeps_the_log_in_order);
+  RUN_TEST(test_time_to_first_sample);
+  return UNITY_END();
+}
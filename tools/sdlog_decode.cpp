@@ -0,0 +1,270 @@
+// Host command line tool that validates binary SD card logs (see src/binary_log.h and src/compressed_log.h)
+// and exports them to CSV in the same column layout as the CSV log, with the sensor ID of every record last.
+// Both block formats are recognized by their magic, so a file may mix them.
+//
+// Build:  g++ -std=c++17 -O2 -Isrc tools/sdlog_decode.cpp src/binary_log.cpp src/compressed_log.cpp src/sensor_utils.cpp -o sdlog_decode
+// Usage:  sdlog_decode [--base64] [--bench] <log.bin> [out.csv]
+//
+// --base64 decodes the input as base64 text first, e.g. a compressed block copied from the
+// "compressed" node of the Firebase database.
+// --bench re-encodes the decoded records as CSV, binary and compressed logs and prints the size of each,
+// the compression ratio and the encoding time per record, to evaluate the formats on recorded data.
+//
+// Corrupted blocks are skipped: the decoder searches forward for the next valid block header,
+// so a single bad sector only loses the records stored in it.
+// A summary is printed to stderr and the exit code is 1 if any corruption was found.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <map>
+#include <vector>
+#include "binary_log.h"
+#include "compressed_log.h"
+
+
+// Reads a whole file into memory.
+static bool readFile(const char* path, std::vector<uint8_t>* contents) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+
+  uint8_t chunk[4096];
+  size_t length;
+  while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    contents->insert(contents->end(), chunk, chunk + length);
+  }
+  fclose(file);
+  return true;
+}
+
+
+// Decodes base64 (RFC 4648) text, ignoring quotes, whitespace and anything else outside the alphabet.
+static std::vector<uint8_t> decodeBase64(const std::vector<uint8_t>& text) {
+  static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::vector<uint8_t> bytes;
+  uint32_t group = 0;
+  uint8_t bits = 0;
+
+  for (uint8_t ch : text) {
+    const char* digit = ch != 0 ? strchr(BASE64, ch) : NULL;
+    if (digit == NULL) {
+      continue;
+    }
+    group = (group << 6) | (uint32_t)(digit - BASE64);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      bytes.push_back((group >> bits) & 0xFF);
+    }
+  }
+  return bytes;
+}
+
+
+// Formats a record as a line of the CSV export.
+static int formatRecord(const BinaryLogRecord_t* record, char* line, size_t size) {
+  time_t time = record->time;
+  struct tm time_info;
+  gmtime_r(&time, &time_info);
+  char time_text[24];
+  strftime(time_text, sizeof(time_text), "%Y-%m-%dT%H:%M:%SZ", &time_info);
+  return snprintf(line, size, "%s,%.2f,%.2f,%.2f,%u\n", time_text, record->data.temperature, toFahrenheit(record->data.temperature),
+                  record->data.pressure, (unsigned)record->sensor_id);
+}
+
+
+// Encodes the records in every format the logger can write and prints the sizes and encoding times.
+// Like the logger the binary formats keep one block per sensor, since a block holds the records of one sensor.
+// Each encoding is repeated until it has run for a while so the time per record is not dominated by the clock resolution.
+static void runBenchmark(const std::vector<BinaryLogRecord_t>& records) {
+  typedef std::chrono::steady_clock Clock;
+  static const double MIN_BENCH_SECONDS = 0.5;
+
+  if (records.empty()) {
+    fprintf(stderr, "No records to benchmark.\n");
+    return;
+  }
+
+  const char* names[3] = {"CSV", "Binary", "Compressed"};
+  size_t sizes[3] = {0, 0, 0};
+  double ns_per_record[3] = {0, 0, 0};
+
+  for (int format = 0; format < 3; format++) {
+    size_t rounds = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do {
+      size_t size = 0;
+      char line[96];
+      std::map<uint8_t, BinaryLogBlock_t> blocks;
+      std::map<uint8_t, CompressedLogBlock_t> compressed;
+      uint8_t encoded[BINARY_LOG_MAX_BLOCK_SIZE];
+
+      for (const BinaryLogRecord_t& record : records) {
+        if (format == 0) {
+          size += formatRecord(&record, line, sizeof(line));
+        }
+        else if (format == 1) {
+          if (blocks.count(record.sensor_id) == 0) {
+            binaryLogBlockReset(&blocks[record.sensor_id]);
+            blocks[record.sensor_id].sensor_id = record.sensor_id;
+          }
+          BinaryLogBlock_t* block = &blocks[record.sensor_id];
+          if (!binaryLogBlockAdd(block, record.time, &record.data)) {
+            size += binaryLogBlockEncode(block, encoded);
+            binaryLogBlockReset(block);
+            block->sensor_id = record.sensor_id;
+            binaryLogBlockAdd(block, record.time, &record.data);
+          }
+        }
+        else {
+          if (compressed.count(record.sensor_id) == 0) {
+            compressedLogReset(&compressed[record.sensor_id]);
+            compressed[record.sensor_id].sensor_id = record.sensor_id;
+          }
+          CompressedLogBlock_t* block = &compressed[record.sensor_id];
+          if (!compressedLogAdd(block, record.time, &record.data)) {
+            size += compressedLogFinish(block);
+            compressedLogReset(block);
+            block->sensor_id = record.sensor_id;
+            compressedLogAdd(block, record.time, &record.data);
+          }
+        }
+      }
+      for (auto& entry : blocks) {
+        size += binaryLogBlockEncode(&entry.second, encoded);
+      }
+      for (auto& entry : compressed) {
+        size += compressedLogFinish(&entry.second);
+      }
+
+      sizes[format] = size;
+      rounds++;
+      elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < MIN_BENCH_SECONDS);
+    ns_per_record[format] = elapsed * 1e9 / (rounds * records.size());
+  }
+
+  fprintf(stderr, "Benchmark over %zu records:\n", records.size());
+  for (int format = 0; format < 3; format++) {
+    fprintf(stderr, "  %-10s %8zu bytes, %6.2f bytes/record, %5.1fx smaller than CSV, %7.1f ns/record to encode\n",
+            names[format], sizes[format], (double)sizes[format] / records.size(),
+            (double)sizes[0] / sizes[format], ns_per_record[format]);
+  }
+}
+
+
+int main(int argc, char** argv) {
+  bool base64 = false, bench = false;
+  int arg = 1;
+  for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+    if (strcmp(argv[arg], "--base64") == 0) {
+      base64 = true;
+    }
+    else if (strcmp(argv[arg], "--bench") == 0) {
+      bench = true;
+    }
+    else {
+      break;
+    }
+  }
+
+  if (argc - arg < 1 || argc - arg > 2 || (arg < argc && strncmp(argv[arg], "--", 2) == 0)) {
+    fprintf(stderr, "Usage: %s [--base64] [--bench] <log.bin> [out.csv]\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<uint8_t> contents;
+  if (!readFile(argv[arg], &contents)) {
+    fprintf(stderr, "Cannot read '%s'.\n", argv[arg]);
+    return 2;
+  }
+  if (base64) {
+    contents = decodeBase64(contents);
+  }
+
+  FILE* out = stdout;
+  if (argc - arg == 2) {
+    out = fopen(argv[arg + 1], "w");
+    if (out == NULL) {
+      fprintf(stderr, "Cannot write '%s'.\n", argv[arg + 1]);
+      return 2;
+    }
+  }
+
+  size_t offset = 0;
+  size_t blocks = 0, records = 0, bad_crc = 0, skipped_bytes = 0;
+  bool truncated = false;
+  BinaryLogBlock_t block;
+  CompressedLogReader_t reader;
+  std::vector<BinaryLogRecord_t> decoded;
+
+  while (offset < contents.size()) {
+    size_t block_size = 0;
+    const uint8_t* in = contents.data() + offset;
+    size_t length = contents.size() - offset;
+
+    // The magic tells which format the block is in.
+    BinaryLogStatus_t status;
+    if (length >= 4 && memcmp(in, "WSLC", 4) == 0) {
+      status = compressedLogOpen(in, length, &reader, &block_size);
+      if (status == BINARY_LOG_OK) {
+        BinaryLogRecord_t record;
+        while (compressedLogNext(&reader, &record)) {
+          decoded.push_back(record);
+        }
+        records += reader.index;
+      }
+    }
+    else {
+      status = binaryLogBlockDecode(in, length, &block, &block_size);
+      if (status == BINARY_LOG_OK) {
+        for (uint8_t i = 0; i < block.count; i++) {
+          decoded.push_back(binaryLogBlockRecord(&block, i));
+        }
+        records += block.count;
+      }
+    }
+
+    if (status == BINARY_LOG_OK) {
+      blocks++;
+      offset += block_size;
+      continue;
+    }
+
+    // A block cut short at the end of the file (e.g. power loss during a write).
+    if (status == BINARY_LOG_TRUNCATED) {
+      truncated = true;
+      skipped_bytes += contents.size() - offset;
+      break;
+    }
+
+    // Corrupted block, resynchronize on the next byte.
+    if (status == BINARY_LOG_BAD_CRC) {
+      bad_crc++;
+    }
+    skipped_bytes++;
+    offset++;
+  }
+
+  fprintf(out, "Time,Temperature_C,Temperature_F,Pressure_hPa,Sensor\n");
+  char line[96];
+  for (const BinaryLogRecord_t& record : decoded) {
+    formatRecord(&record, line, sizeof(line));
+    fputs(line, out);
+  }
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  fprintf(stderr, "%zu blocks, %zu records, %zu bad CRC, %zu bytes skipped%s.\n",
+          blocks, records, bad_crc, skipped_bytes, truncated ? ", truncated at end of file" : "");
+  if (bench) {
+    runBenchmark(decoded);
+  }
+  return (bad_crc > 0 || skipped_bytes > 0) ? 1 : 0;
+}